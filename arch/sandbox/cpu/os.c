@@ -14,10 +14,13 @@
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <linux/if_tun.h>
 #include <linux/types.h>
 
 #include <asm/getopt.h>
@@ -27,9 +30,13 @@
 
 /* Operating System Interface */
 
+/*
+ * Padded so that the memory handed out (including emulated RAM) is cache-line
+ * aligned like real DRAM, and drivers take their aligned fast paths.
+ */
 struct os_mem_hdr {
 	size_t length;		/* number of bytes in the block */
-};
+} __attribute__((aligned(64)));
 
 ssize_t os_read(int fd, void *buf, size_t count)
 {
@@ -535,3 +542,23 @@ int os_jump_to_image(const void *dest, int size)
 
 	return unlink(fname);
 }
+
+int os_tap_open(const char *ifname)
+{
+	struct ifreq ifr;
+	int fd;
+
+	fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (fd < 0)
+		return -1;
+
+	memset(&ifr, '\0', sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
@@ -4,6 +4,7 @@
  */
 
 #include <common.h>
+#include <cli.h>
 #include <os.h>
 #include <asm/getopt.h>
 #include <asm/io.h>
@@ -76,6 +77,8 @@ int sandbox_main_loop_init(void)
 
 	/* Execute command if required */
 	if (state->cmd) {
+		/* hush needs its variables set up, as main_loop() does */
+		cli_init();
 		run_command_list(state->cmd, -1, 0);
 		if (!state->interactive)
 			os_exit(state->exit_type);
@@ -194,6 +197,23 @@ static const char *term_args[STATE_TERM_COUNT] = {
 	"cooked",
 };
 
+static int sandbox_cmdline_cb_tap(struct sandbox_state *state,
+				  const char *arg)
+{
+	state->tap_name = arg;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(tap, 1, "Use host tap interface for Ethernet");
+
+static int sandbox_cmdline_cb_tap_drop(struct sandbox_state *state,
+				       const char *arg)
+{
+	state->tap_drop = simple_strtoul(arg, NULL, 0);
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(tap_drop, 1,
+		    "Drop on average 1 in N received frames, to test loss");
+
 static int sandbox_cmdline_cb_terminal(struct sandbox_state *state,
 				       const char *arg)
 {
@@ -67,6 +67,8 @@ struct sandbox_state {
 	bool ignore_missing_state_on_read;	/* No error if state missing */
 	bool show_lcd;			/* Show LCD on start-up */
 	enum state_terminal_raw term_raw;	/* Terminal raw/cooked */
+	const char *tap_name;		/* Host tap interface for Ethernet */
+	unsigned int tap_drop;		/* Drop 1 in this many rx frames */
 
 	/* Pointer to information for each SPI bus/cs */
 	struct sandbox_spi_info spi[CONFIG_SANDBOX_SPI_MAX_BUS]
@@ -6,7 +6,9 @@
 #include <common.h>
 #include <cros_ec.h>
 #include <dm.h>
+#include <netdev.h>
 #include <os.h>
+#include <sandboxmmc.h>
 #include <asm/u-boot-sandbox.h>
 
 /*
@@ -53,6 +55,20 @@ int board_early_init_f(void)
 }
 #endif
 
+#ifdef CONFIG_ETH_SANDBOX
+int board_eth_init(bd_t *bis)
+{
+	return sandbox_eth_initialize(bis);
+}
+#endif
+
+#ifdef CONFIG_SANDBOX_MMC
+int board_mmc_init(bd_t *bis)
+{
+	return sandbox_mmc_init();
+}
+#endif
+
 int arch_early_init_r(void)
 {
 #ifdef CONFIG_CROS_EC
@@ -41,35 +41,68 @@
 #include <part.h>
 #include <sparse_format.h>
 
-void write_sparse_image(block_dev_desc_t *dev_desc,
-		disk_partition_t *info, const char *part_name,
-		void *data, unsigned sz)
+/* Blocks written at once for a fill chunk */
+#define SPARSE_FILL_BLOCKS	64
+
+static int sparse_fail(struct sparse_stream *s, const char *msg)
+{
+	fastboot_fail(msg);
+	s->state = SPARSE_ERROR;
+	return -1;
+}
+
+/* Write 'blkcnt' blocks from 'buf' at the next block of the partition */
+static int sparse_write_blocks(struct sparse_stream *s, lbaint_t blkcnt,
+			       const void *buf)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
 	lbaint_t blks;
-	uint32_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
-	int i;
-
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *) data;
-
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t))
-	{
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+
+	if (s->blk + blkcnt > s->info->start + s->info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		return sparse_fail(s, "Request would exceed partition size!");
+	}
+
+	blks = s->dev_desc->block_write(s->dev_desc->dev, s->blk, blkcnt,
+					(void *)buf);
+	if (blks != blkcnt) {
+		printf("%s: Write failed, block # " LBAFU "\n", __func__,
+		       s->blk + blks);
+		return sparse_fail(s, "flash write failure");
 	}
+	s->blk += blkcnt;
+	s->bytes_written += blkcnt * s->info->blksz;
+
+	return 0;
+}
+
+/*
+ * Gather the 'size' byte header 'hdr' from 'data'. Return the number of
+ * bytes used; s->hdr_bytes reaches 'size' when the header is complete.
+ */
+static unsigned int sparse_gather(struct sparse_stream *s, void *hdr,
+				  unsigned int size, const void *data,
+				  unsigned int len)
+{
+	unsigned int n = min(len, size - s->hdr_bytes);
+
+	memcpy(hdr + s->hdr_bytes, data, n);
+	s->hdr_bytes += n;
+
+	return n;
+}
+
+static void sparse_next_chunk(struct sparse_stream *s)
+{
+	s->hdr_bytes = 0;
+	if (++s->chunk >= s->sparse_header.total_chunks)
+		s->state = SPARSE_DONE;
+	else
+		s->state = SPARSE_CHUNK_HEADER;
+}
+
+static int sparse_start(struct sparse_stream *s)
+{
+	sparse_header_t *sparse_header = &s->sparse_header;
 
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
@@ -82,162 +115,319 @@ void write_sparse_image(block_dev_desc_t *dev_desc,
 	debug("total_chunks: %d\n", sparse_header->total_chunks);
 
 	/* verify sparse_header->blk_sz is an exact multiple of info->blksz */
-	if (sparse_header->blk_sz !=
-	    (sparse_header->blk_sz & ~(info->blksz - 1))) {
+	if (!sparse_header->blk_sz || sparse_header->blk_sz !=
+	    (sparse_header->blk_sz & ~(s->info->blksz - 1))) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
-		fastboot_fail("sparse image block size issue");
-		return;
+		return sparse_fail(s, "sparse image block size issue");
 	}
 
+	if (sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_fail(s, "sparse image header size issue");
+
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk=0; chunk<sparse_header->total_chunks; chunk++)
-	{
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *) data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	/*
+	 * Skip the remaining bytes in a header that is longer than we
+	 * expected.
+	 */
+	s->skip = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+	s->hdr_bytes = 0;
+	s->state = sparse_header->total_chunks ? SPARSE_CHUNK_HEADER :
+						 SPARSE_DONE;
+
+	return 0;
+}
+
+static int sparse_start_chunk(struct sparse_stream *s)
+{
+	sparse_header_t *sparse_header = &s->sparse_header;
+	chunk_header_t *chunk_header = &s->chunk_header;
+	uint64_t chunk_data_sz;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	/*
+	 * Skip the remaining bytes in a header that is longer than we
+	 * expected.
+	 */
+	s->skip = sparse_header->chunk_hdr_sz - sizeof(chunk_header_t);
+	s->hdr_bytes = 0;
+
+	chunk_data_sz = (uint64_t)sparse_header->blk_sz *
+			chunk_header->chunk_sz;
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz))
+			return sparse_fail(s,
+				"Bogus chunk size for chunk type Raw");
+
+		s->data_left = chunk_data_sz;
+		s->total_blocks += chunk_header->chunk_sz;
+		s->state = SPARSE_CHUNK_RAW;
+		if (!s->data_left)
+			sparse_next_chunk(s);
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
+			return sparse_fail(s,
+				"Bogus chunk size for chunk type FILL");
+
+		s->data_left = chunk_data_sz;
+		s->total_blocks += chunk_header->chunk_sz;
+		s->state = SPARSE_CHUNK_FILL;
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		s->blk += chunk_data_sz / s->info->blksz;
+		s->total_blocks += chunk_header->chunk_sz;
+		sparse_next_chunk(s);
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz < sparse_header->chunk_hdr_sz)
+			return sparse_fail(s,
+				"Bogus chunk size for chunk type CRC32");
+
+		/* The CRC is not checked */
+		s->skip += chunk_header->total_sz - sparse_header->chunk_hdr_sz;
+		s->total_blocks += chunk_header->chunk_sz;
+		sparse_next_chunk(s);
+		break;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_fail(s, "Unknown chunk type");
+	}
+
+	return 0;
+}
+
+static int sparse_write_fill(struct sparse_stream *s)
+{
+	lbaint_t blkcnt = s->data_left / s->info->blksz;
+	lbaint_t bufcnt = min(blkcnt, (lbaint_t)SPARSE_FILL_BLOCKS);
+	uint32_t *fill_buf;
+	int i, ret = 0;
+
+	if (!blkcnt)
+		return 0;
+
+	fill_buf = memalign(ARCH_DMA_MINALIGN,
+			    ROUNDUP(bufcnt * s->info->blksz,
+				    ARCH_DMA_MINALIGN));
+	if (!fill_buf)
+		return sparse_fail(s, "Malloc failed for: CHUNK_TYPE_FILL");
+
+	for (i = 0; i < bufcnt * s->info->blksz / sizeof(uint32_t); i++)
+		fill_buf[i] = s->fill_val;
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t))
-		{
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
+	while (blkcnt && !ret) {
+		bufcnt = min(blkcnt, bufcnt);
+		ret = sparse_write_blocks(s, bufcnt, fill_buf);
+		blkcnt -= bufcnt;
+	}
+	free(fill_buf);
+
+	return ret;
+}
+
+/*
+ * Write raw data from 'data', keeping a partial block in s->blkbuf until
+ * the rest of it arrives. Return the number of bytes used or -1.
+ */
+static int sparse_write_raw(struct sparse_stream *s, const void *data,
+			    unsigned int len)
+{
+	unsigned int blksz = s->info->blksz;
+	unsigned int used = 0, n;
+	lbaint_t blkcnt;
+
+	if (len > s->data_left)
+		len = s->data_left;
+
+	if (s->blkbuf_len) {
+		n = min(len, blksz - s->blkbuf_len);
+		memcpy(s->blkbuf + s->blkbuf_len, data, n);
+		s->blkbuf_len += n;
+		used = n;
+		if (s->blkbuf_len == blksz) {
+			if (sparse_write_blocks(s, 1, s->blkbuf))
+				return -1;
+			s->blkbuf_len = 0;
 		}
+	}
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		blkcnt = chunk_data_sz / info->blksz;
-		switch (chunk_header->chunk_type)
-		{
-			case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz))
-			{
-				fastboot_fail(
-					"Bogus chunk size for chunk type Raw");
-				return;
-			}
+	blkcnt = (len - used) / blksz;
+	if (blkcnt) {
+		if (sparse_write_blocks(s, blkcnt, data + used))
+			return -1;
+		used += blkcnt * blksz;
+	}
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
+	if (used < len) {
+		memcpy(s->blkbuf, data + used, len - used);
+		s->blkbuf_len = len - used;
+		used = len;
+	}
+	s->data_left -= used;
 
-			blks = dev_desc->block_write(dev_desc->dev, blk, blkcnt,
-						     data);
-			if (blks != blkcnt) {
-				printf("%s: Write failed " LBAFU "\n",
-				       __func__, blks);
-				fastboot_fail("flash write failure");
-				return;
-			}
-			blk += blkcnt;
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+	return used;
+}
 
-			case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
-			{
-				fastboot_fail(
-					"Bogus chunk size for chunk type FILL");
-				return;
-			}
+int sparse_stream_init(struct sparse_stream *s, block_dev_desc_t *dev_desc,
+		       disk_partition_t *info, const char *part_name,
+		       int sparse, uint64_t raw_size)
+{
+	memset(s, 0, sizeof(*s));
+	s->dev_desc = dev_desc;
+	s->info = info;
+	s->part_name = part_name;
+	s->sparse = sparse;
+	s->blk = info->start;
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(info->blksz,
-						    ARCH_DMA_MINALIGN));
-			if (!fill_buf)
-			{
-				fastboot_fail(
-					"Malloc failed for: CHUNK_TYPE_FILL");
-				return;
-			}
+	if (!sparse &&
+	    DIV_ROUND_UP(raw_size, info->blksz) > (uint64_t)info->size) {
+		error("too large for partition: '%s'\n", part_name);
+		return sparse_fail(s, "too large for partition");
+	}
 
-			fill_val = *(uint32_t *)data;
-			data = (char *) data + sizeof(uint32_t);
+	s->blkbuf = memalign(ARCH_DMA_MINALIGN,
+			     ROUNDUP(info->blksz, ARCH_DMA_MINALIGN));
+	if (!s->blkbuf)
+		return sparse_fail(s, "Malloc failed for block buffer");
 
-			for (i = 0; i < (info->blksz / sizeof(fill_val)); i++)
-				fill_buf[i] = fill_val;
+	if (sparse) {
+		s->state = SPARSE_HEADER;
+	} else {
+		puts("Flashing Raw Image\n");
+		s->data_left = raw_size;
+		s->state = raw_size ? SPARSE_CHUNK_RAW : SPARSE_DONE;
+	}
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
+	return 0;
+}
 
-			for (i = 0; i < blkcnt; i++) {
-				blks = dev_desc->block_write(dev_desc->dev,
-							     blk, 1, fill_buf);
-				if (blks != 1) {
-					printf(
-					    "%s: Write failed, block # " LBAFU "\n",
-					    __func__, blkcnt);
-					fastboot_fail("flash write failure");
-					free(fill_buf);
-					return;
-				}
-				blk++;
-			}
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_data_sz / sparse_header->blk_sz;
+int sparse_stream_write(struct sparse_stream *s, const void *data,
+			unsigned int len)
+{
+	int n = 0;
+
+	while (len && s->state != SPARSE_DONE) {
+		if (s->skip) {
+			n = min(len, s->skip);
+			s->skip -= n;
+			data += n;
+			len -= n;
+			continue;
+		}
 
-			free(fill_buf);
+		switch (s->state) {
+		case SPARSE_HEADER:
+			n = sparse_gather(s, &s->sparse_header,
+					  sizeof(sparse_header_t), data, len);
+			if (s->hdr_bytes == sizeof(sparse_header_t) &&
+			    sparse_start(s))
+				return -1;
 			break;
 
-			case CHUNK_TYPE_DONT_CARE:
-			total_blocks += chunk_header->chunk_sz;
+		case SPARSE_CHUNK_HEADER:
+			n = sparse_gather(s, &s->chunk_header,
+					  sizeof(chunk_header_t), data, len);
+			if (s->hdr_bytes == sizeof(chunk_header_t) &&
+			    sparse_start_chunk(s))
+				return -1;
 			break;
 
-			case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz)
-			{
-				fastboot_fail(
-					"Bogus chunk size for chunk type Dont Care");
-				return;
+		case SPARSE_CHUNK_FILL:
+			n = sparse_gather(s, &s->fill_val, sizeof(uint32_t),
+					  data, len);
+			if (s->hdr_bytes == sizeof(uint32_t)) {
+				if (sparse_write_fill(s))
+					return -1;
+				sparse_next_chunk(s);
 			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
 			break;
 
-			default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			fastboot_fail("Unknown chunk type");
-			return;
+		case SPARSE_CHUNK_RAW:
+			n = sparse_write_raw(s, data, len);
+			if (n < 0)
+				return -1;
+			if (!s->data_left && s->sparse)
+				sparse_next_chunk(s);
+			else if (!s->data_left)
+				s->state = SPARSE_DONE;
+			break;
+
+		default:
+			return -1;
 		}
+		data += n;
+		len -= n;
 	}
 
-	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	return 0;
+}
 
-	if (total_blocks != sparse_header->total_blks)
-		fastboot_fail("sparse image write failure");
+int sparse_stream_finish(struct sparse_stream *s)
+{
+	int ret = -1;
 
+	if (s->state == SPARSE_ERROR)
+		goto out;
+
+	if (s->state != SPARSE_DONE) {
+		fastboot_fail("image is incomplete");
+		goto out;
+	}
+
+	/* The end of a raw image that is not a whole number of blocks */
+	if (s->blkbuf_len) {
+		memset(s->blkbuf + s->blkbuf_len, 0,
+		       s->info->blksz - s->blkbuf_len);
+		if (sparse_write_blocks(s, 1, s->blkbuf))
+			goto out;
+	}
+
+	if (s->sparse) {
+		debug("Wrote %d blocks, expected to write %d blocks\n",
+		      s->total_blocks, s->sparse_header.total_blks);
+		if (s->total_blocks != s->sparse_header.total_blks) {
+			fastboot_fail("sparse image write failure");
+			goto out;
+		}
+	}
+
+	printf("........ wrote %llu bytes to '%s'\n",
+	       (unsigned long long)s->bytes_written, s->part_name);
 	fastboot_okay("");
-	return;
+	ret = 0;
+out:
+	free(s->blkbuf);
+	s->blkbuf = NULL;
+
+	return ret;
+}
+
+void write_sparse_image(block_dev_desc_t *dev_desc,
+		disk_partition_t *info, const char *part_name,
+		void *data, unsigned sz)
+{
+	struct sparse_stream s;
+
+	if (sparse_stream_init(&s, dev_desc, info, part_name, 1, 0))
+		return;
+
+	sparse_stream_write(&s, data, sz);
+	sparse_stream_finish(&s);
 }
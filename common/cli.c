@@ -125,8 +125,13 @@ int do_run(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			return 1;
 		}
 
+#if defined(CONFIG_SYS_HUSH_PARSER) && defined(CONFIG_HUSH_PARSE_CACHE)
+		if (parse_string_cached(argv[i], arg, FLAG_PARSE_SEMICOLON))
+			return 1;
+#else
 		if (run_command(arg, flag) != 0)
 			return 1;
+#endif
 	}
 	return 0;
 }
@@ -1519,6 +1519,7 @@ static int run_pipe_real(struct pipe *pi)
 	struct child_prog *child;
 	struct built_in_command *x;
 	char *p;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -1531,6 +1532,7 @@ static int run_pipe_real(struct pipe *pi)
 	int flag = do_repeat ? CMD_FLAG_REPEAT : 0;
 	struct child_prog *child;
 	char *p;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -1597,6 +1599,8 @@ static int run_pipe_real(struct pipe *pi)
 			}
 			return EXIT_SUCCESS;   /* don't worry about errors in set_local_var() yet */
 		}
+		/* count in a copy, as a cached pipe is run again */
+		sp = child->sp;
 		for (i = 0; is_assignment(child->argv[i]); i++) {
 			p = insert_var_value(child->argv[i]);
 #ifndef __U_BOOT__
@@ -1605,11 +1609,11 @@ static int run_pipe_real(struct pipe *pi)
 			set_local_var(p, 0);
 #endif
 			if (p != child->argv[i]) {
-				child->sp--;
+				sp--;
 				free(p);
 			}
 		}
-		if (child->sp) {
+		if (sp) {
 			char * str = NULL;
 
 			str = make_string(child->argv + i,
@@ -1737,12 +1741,31 @@ static int run_pipe_real(struct pipe *pi)
 	return -1;
 }
 
+#ifdef __U_BOOT__
+/* leave a for loop early, giving it back the variable name it was parsed
+ * with, so that the pipe can be run again */
+static void abort_for_loop(struct pipe *for_pipe, char *save_name,
+			   char **list, char **save_list)
+{
+	if (!list)
+		return;
+	free(for_pipe->progs->argv[0]);
+	for_pipe->progs->argv[0] = save_name;
+	while (*list)
+		free(*list++);
+	free(save_list);
+}
+#endif
+
 static int run_list_real(struct pipe *pi)
 {
 	char *save_name = NULL;
 	char **list = NULL;
 	char **save_list = NULL;
 	struct pipe *rpipe;
+#ifdef __U_BOOT__
+	struct pipe *for_pipe = NULL;
+#endif
 	int flag_rep = 0;
 #ifndef __U_BOOT__
 	int save_num_progs;
@@ -1781,6 +1804,8 @@ static int run_list_real(struct pipe *pi)
 				/* check Ctrl-C */
 				ctrlc();
 				if ((had_ctrlc())) {
+					abort_for_loop(for_pipe, save_name,
+						       list, save_list);
 					return 1;
 				}
 #endif
@@ -1811,6 +1836,9 @@ static int run_list_real(struct pipe *pi)
 					pi->progs->argv[0]);
 				save_list = list;
 				save_name = pi->progs->argv[0];
+#ifdef __U_BOOT__
+				for_pipe = pi;
+#endif
 				pi->progs->argv[0] = NULL;
 				flag_rep = 1;
 			}
@@ -1881,6 +1909,7 @@ static int run_list_real(struct pipe *pi)
 #else
 		if (rcode < -1) {
 			last_return_code = -rcode - 2;
+			abort_for_loop(for_pipe, save_name, list, save_list);
 			return -2;	/* exit */
 		}
 		last_return_code=(rcode == 0) ? 0 : 1;
@@ -3254,6 +3283,143 @@ int parse_string_outer(const char *s, int flag)
 #endif
 }
 
+#ifdef CONFIG_HUSH_PARSE_CACHE
+/*
+ * Parsed commands of the environment variables executed with "run", so that
+ * scripts which run the same variables over and over only parse them once.
+ * An entry is used only while its variable still holds the text it was
+ * parsed from: changing the variable by any means (setenv, env import, ...)
+ * makes the entry stale, and it is parsed again on the next run.
+ */
+#define PARSE_CACHE_SIZE	8
+
+struct parse_cache {
+	char *name;		/* variable name, NULL if the entry is free */
+	char *text;		/* its value when parsed */
+	int flag;		/* parser flags used */
+	struct pipe *list;	/* parsed commands */
+	int busy;		/* being run, so cannot be replaced */
+	ulong used;		/* when last run, to replace the oldest */
+};
+
+static struct parse_cache parse_cache[PARSE_CACHE_SIZE];
+static ulong parse_cache_clock;
+
+/* parse the first line of s like parse_stream_outer(), without running it */
+static struct pipe *parse_string_only(const char *s, int flag)
+{
+	struct in_str input;
+	struct p_context ctx;
+	o_string temp = NULL_O_STRING;
+	char *p = NULL;
+	int rcode;
+
+	if (!(p = strchr(s, '\n')) || *++p) {
+		p = xmalloc(strlen(s) + 2);
+		strcpy(p, s);
+		strcat(p, "\n");
+		s = p;
+	} else {
+		p = NULL;
+	}
+	setup_string_in_str(&input, s);
+
+	ctx.type = flag;
+	initialize_context(&ctx);
+	update_ifs_map();
+	if (!(flag & FLAG_PARSE_SEMICOLON) || (flag & FLAG_REPARSING))
+		mapset((uchar *)";$&|", 0);
+	input.promptmode = 1;
+	rcode = parse_stream(&temp, &ctx, &input, '\n');
+	if (rcode == 1)
+		flag_repeat = 0;
+	if (rcode != 1 && ctx.old_flag != 0) {
+		syntax();
+		flag_repeat = 0;
+	}
+	if (rcode != 1 && ctx.old_flag == 0) {
+		done_word(&temp, &ctx);
+		done_pipe(&ctx, PIPE_SEQ);
+	} else {
+		if (ctx.old_flag != 0)
+			free(ctx.stack);
+		free_pipe_list(ctx.list_head, 0);
+		ctx.list_head = NULL;
+	}
+	b_free(&temp);
+	free(p);
+
+	return ctx.list_head;
+}
+
+static void parse_cache_free(struct parse_cache *pc)
+{
+	free(pc->name);
+	free(pc->text);
+	if (pc->list)
+		free_pipe_list(pc->list, 0);
+	memset(pc, 0, sizeof(*pc));
+}
+
+/*
+ * Run the commands s held by environment variable name, as
+ * parse_string_outer(s, flag | FLAG_EXIT_FROM_LOOP) would
+ */
+int parse_string_cached(const char *name, const char *s, int flag)
+{
+	struct parse_cache *pc, *slot = NULL;
+	struct parse_cache *const end = parse_cache + PARSE_CACHE_SIZE;
+	int code;
+
+	flag |= FLAG_EXIT_FROM_LOOP;
+	if (!s || !*s)
+		return 1;
+
+	/* find the variable, and else a free entry or the oldest one */
+	for (pc = parse_cache; pc < end; pc++) {
+		if (pc->name && !strcmp(pc->name, name))
+			break;
+		if (!pc->busy && (!slot || (slot->name &&
+					    (!pc->name || pc->used < slot->used))))
+			slot = pc;
+	}
+	if (pc < end && (pc->busy || pc->flag != flag || strcmp(pc->text, s))) {
+		/* stale, parse again in place unless it is being run */
+		slot = pc->busy ? NULL : pc;
+		pc = end;
+	}
+
+	if (pc == end) {
+		/* a variable running itself, or every entry busy */
+		if (!slot)
+			return parse_string_outer(s, flag);
+		parse_cache_free(slot);
+		slot->list = parse_string_only(s, flag);
+		if (!slot->list)
+			return 1;
+		slot->name = xmalloc(strlen(name) + 1);
+		strcpy(slot->name, name);
+		slot->text = xmalloc(strlen(s) + 1);
+		strcpy(slot->text, s);
+		slot->flag = flag;
+		pc = slot;
+	}
+
+	pc->used = ++parse_cache_clock;
+	pc->busy++;
+	code = run_list_real(pc->list);
+	pc->busy--;
+
+	/* as parse_stream_outer() does after run_list() */
+	if (code == -2)		/* exit */
+		code = 0;
+	if (code == -1)
+		flag_repeat = 0;
+
+	return (code != 0) ? 1 : 0;
+}
+#endif /* CONFIG_HUSH_PARSE_CACHE */
+
 #ifndef __U_BOOT__
 static int parse_file_outer(FILE *f)
 #else
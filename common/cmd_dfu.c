@@ -39,6 +39,7 @@ static int do_dfu(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	int controller_index = simple_strtoul(usb_controller, NULL, 0);
 	board_usb_init(controller_index, USB_INIT_DEVICE);
 	dfu_clear_detach();
+	dfu_set_write_behind(true);
 	g_dnl_register("usb_dnl_dfu");
 	while (1) {
 		if (dfu_detach()) {
@@ -65,9 +66,13 @@ static int do_dfu(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			goto exit;
 
 		usb_gadget_handle_interrupts();
+
+		/* write received data while the host prepares the next */
+		dfu_write_pending();
 	}
 exit:
 	g_dnl_unregister();
+	dfu_set_write_behind(false);
 done:
 	dfu_free_entities();
 
@@ -33,6 +33,7 @@
 #include <image.h>
 #include <linux/ctype.h>
 #include <asm/byteorder.h>
+#include <asm/io.h>
 #include <ext4fs.h>
 #include <linux/stat.h>
 #include <malloc.h>
@@ -98,7 +99,8 @@ int do_ext4_write(cmd_tbl_t *cmdtp, int flag, int argc,
 	}
 
 	/* start write */
-	if (ext4fs_write(filename, (unsigned char *)ram_address, file_size)) {
+	if (ext4fs_write(filename, map_sysmem(ram_address, file_size),
+			 file_size)) {
 		printf("** Error ext4fs_write() **\n");
 		goto fail;
 	}
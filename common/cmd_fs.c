@@ -51,6 +51,25 @@ U_BOOT_CMD(
 	"      If 'pos' is 0 or omitted, the file is read from the start."
 )
 
+#ifdef CONFIG_CMD_ZLOAD
+static int do_zload_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
+				char * const argv[])
+{
+	return do_zload(cmdtp, flag, argc, argv, FS_TYPE_ANY);
+}
+
+U_BOOT_CMD(
+	zload,	6,	0,	do_zload_wrapper,
+	"load and uncompress a file from a filesystem",
+	"<interface> [<dev[:part]> [<addr> [<filename> [max_bytes]]]]\n"
+	"    - Load file 'filename' from partition 'part' on device type\n"
+	"      'interface' instance 'dev', uncompressing it to address 'addr'\n"
+	"      while it is read. gzip, lzma and lzop files are detected, other\n"
+	"      files are copied unchanged. 'max_bytes' limits the uncompressed\n"
+	"      size, by default CONFIG_SYS_BOOTM_LEN."
+)
+#endif
+
 static int do_ls_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
 				char * const argv[])
 {
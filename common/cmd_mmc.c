@@ -8,6 +8,7 @@
 #include <common.h>
 #include <command.h>
 #include <mmc.h>
+#include <asm/io.h>
 
 static int curr_device = -1;
 #ifndef CONFIG_GENERIC_MMC
@@ -285,12 +286,13 @@ static int do_mmc_read(cmd_tbl_t *cmdtp, int flag,
 {
 	struct mmc *mmc;
 	u32 blk, cnt, n;
-	void *addr;
+	ulong addr;
+	void *buf;
 
 	if (argc != 4)
 		return CMD_RET_USAGE;
 
-	addr = (void *)simple_strtoul(argv[1], NULL, 16);
+	addr = simple_strtoul(argv[1], NULL, 16);
 	blk = simple_strtoul(argv[2], NULL, 16);
 	cnt = simple_strtoul(argv[3], NULL, 16);
 
@@ -301,9 +303,11 @@ static int do_mmc_read(cmd_tbl_t *cmdtp, int flag,
 	printf("\nMMC read: dev # %d, block # %d, count %d ... ",
 	       curr_device, blk, cnt);
 
-	n = mmc->block_dev.block_read(curr_device, blk, cnt, addr);
+	buf = map_sysmem(addr, cnt * 512);
+	n = mmc->block_dev.block_read(curr_device, blk, cnt, buf);
+	unmap_sysmem(buf);
 	/* flush cache after read */
-	flush_cache((ulong)addr, cnt * 512); /* FIXME */
+	flush_cache(addr, cnt * 512); /* FIXME */
 	printf("%d blocks read: %s\n", n, (n == cnt) ? "OK" : "ERROR");
 
 	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
@@ -313,12 +317,13 @@ static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 {
 	struct mmc *mmc;
 	u32 blk, cnt, n;
-	void *addr;
+	ulong addr;
+	void *buf;
 
 	if (argc != 4)
 		return CMD_RET_USAGE;
 
-	addr = (void *)simple_strtoul(argv[1], NULL, 16);
+	addr = simple_strtoul(argv[1], NULL, 16);
 	blk = simple_strtoul(argv[2], NULL, 16);
 	cnt = simple_strtoul(argv[3], NULL, 16);
 
@@ -333,7 +338,9 @@ static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 		printf("Error: card is write protected!\n");
 		return CMD_RET_FAILURE;
 	}
-	n = mmc->block_dev.block_write(curr_device, blk, cnt, addr);
+	buf = map_sysmem(addr, cnt * 512);
+	n = mmc->block_dev.block_write(curr_device, blk, cnt, buf);
+	unmap_sysmem(buf);
 	printf("%d blocks written: %s\n", n, (n == cnt) ? "OK" : "ERROR");
 
 	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
@@ -113,6 +113,20 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	return netboot_common(WGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	wget,	3,	1,	do_wget,
+	"boot image via network using HTTP protocol",
+	"[loadAddress] [[hostIPaddr:]path]\n"
+	"The server port is taken from 'httpdstport', default 80."
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -257,6 +271,45 @@ static int netboot_common(enum proto_t proto, cmd_tbl_t *cmdtp, int argc,
 	return rcode;
 }
 
+#if defined(CONFIG_CMD_ETHSTATS)
+static int do_ethstats(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char * const argv[])
+{
+	struct eth_device *dev;
+	struct eth_rx_stats *s;
+	int reset = 0;
+	int i;
+
+	if (argc == 2 && !strcmp(argv[1], "reset"))
+		reset = 1;
+	else if (argc != 1)
+		return CMD_RET_USAGE;
+
+	for (i = 0; (dev = eth_get_dev_by_index(i)) != NULL; i++) {
+		s = &dev->rx_stats;
+		if (reset) {
+			memset(s, 0, sizeof(*s));
+			continue;
+		}
+		printf("%s: received %lu frames, ", dev->name, s->packets);
+		print_size(s->bytes, "\n");
+		printf("  errors %lu, dropped %lu, overruns %lu, "
+		       "largest batch %lu\n", s->errors, s->dropped,
+		       s->overruns, s->max_batch);
+	}
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	ethstats,	2,	1,	do_ethstats,
+	"show Ethernet receive statistics",
+	"[reset]\n"
+	"'overruns' counts polls which found every receive buffer full;\n"
+	"if it grows, more buffers (CONFIG_ETH_RX_RING_SIZE) may help."
+);
+#endif
+
 #if defined(CONFIG_CMD_PING)
 static int do_ping(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
@@ -8,6 +8,8 @@
 #include <fs.h>
 #include <part.h>
 #include <sandboxblockdev.h>
+#include <sandboxmmc.h>
+#include <sandboxnand.h>
 #include <asm/errno.h>
 
 static int do_sandbox_load(cmd_tbl_t *cmdtp, int flag, int argc,
@@ -81,16 +83,88 @@ static int do_sandbox_info(cmd_tbl_t *cmdtp, int flag, int argc,
 		struct host_block_dev *host_dev = blk_dev->priv;
 		printf("%12lu %s\n", (unsigned long)blk_dev->lba,
 		       host_dev->filename);
+		printf("    reads: %lu (%lu blocks), writes: %lu (%lu blocks)\n",
+		       host_dev->read_calls, host_dev->read_blocks,
+		       host_dev->write_calls, host_dev->write_blocks);
 	}
 	return 0;
 }
 
+#ifdef CONFIG_SANDBOX_MMC
+static int do_sandbox_mmc(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char * const argv[])
+{
+	static const char * const modes[] = { "stop", "cmd23", "queue" };
+	const struct sandbox_mmc_stats *stats;
+	unsigned long total = 0;
+	int i;
+
+	if (argc == 3 && !strcmp(argv[1], "mode")) {
+		for (i = 0; i < ARRAY_SIZE(modes); i++) {
+			if (!strcmp(argv[2], modes[i])) {
+				sandbox_mmc_set_mode(i);
+				return 0;
+			}
+		}
+		return CMD_RET_USAGE;
+	} else if (argc == 2 && !strcmp(argv[1], "reset")) {
+		sandbox_mmc_reset_stats();
+		return 0;
+	} else if (argc != 1) {
+		return CMD_RET_USAGE;
+	}
+
+	stats = sandbox_mmc_get_stats();
+	puts("commands:");
+	for (i = 0; i < ARRAY_SIZE(stats->cmds); i++) {
+		if (stats->cmds[i])
+			printf(" CMD%d=%lu", i, stats->cmds[i]);
+		total += stats->cmds[i];
+	}
+	printf("\ntotal: %lu, busy: %lu, queued reads: %lu\n", total,
+	       stats->busy, stats->queued);
+	printf("blocks read: %lu, written: %lu\n", stats->blocks_read,
+	       stats->blocks_written);
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_NAND_SANDBOX
+static int do_sandbox_nand(cmd_tbl_t *cmdtp, int flag, int argc,
+			   char * const argv[])
+{
+	const struct sandbox_nand_stats *stats;
+
+	if (argc == 2 && !strcmp(argv[1], "reset")) {
+		sandbox_nand_reset_stats();
+		return 0;
+	} else if (argc != 1) {
+		return CMD_RET_USAGE;
+	}
+
+	stats = sandbox_nand_get_stats();
+	printf("commands: %lu, pages read: %lu (%lu bytes)\n", stats->cmds,
+	       stats->page_reads, stats->bytes_read);
+	printf("pages programmed: %lu, blocks erased: %lu\n",
+	       stats->page_programs, stats->block_erases);
+
+	return 0;
+}
+#endif
+
 static cmd_tbl_t cmd_sandbox_sub[] = {
 	U_BOOT_CMD_MKENT(load, 7, 0, do_sandbox_load, "", ""),
 	U_BOOT_CMD_MKENT(ls, 3, 0, do_sandbox_ls, "", ""),
 	U_BOOT_CMD_MKENT(save, 6, 0, do_sandbox_save, "", ""),
 	U_BOOT_CMD_MKENT(bind, 3, 0, do_sandbox_bind, "", ""),
 	U_BOOT_CMD_MKENT(info, 3, 0, do_sandbox_info, "", ""),
+#ifdef CONFIG_SANDBOX_MMC
+	U_BOOT_CMD_MKENT(mmc, 3, 0, do_sandbox_mmc, "", ""),
+#endif
+#ifdef CONFIG_NAND_SANDBOX
+	U_BOOT_CMD_MKENT(nand, 2, 0, do_sandbox_nand, "", ""),
+#endif
 };
 
 static int do_sandbox(cmd_tbl_t *cmdtp, int flag, int argc,
@@ -121,6 +195,14 @@ U_BOOT_CMD(
 		"save a file to host\n"
 	"sb bind <dev> [<filename>] - bind \"host\" device to file\n"
 	"sb info [<dev>]            - show device binding & info\n"
+#ifdef CONFIG_SANDBOX_MMC
+	"sb mmc [reset]             - show/reset emulated MMC command counts\n"
+	"sb mmc mode <stop|cmd23|queue> - set how the emulated MMC host\n"
+	"                             reads, then use 'mmc rescan'\n"
+#endif
+#ifdef CONFIG_NAND_SANDBOX
+	"sb nand [reset]            - show/reset emulated NAND read counts\n"
+#endif
 	"sb commands use the \"hostfs\" device. The \"host\" device is used\n"
 	"with standard IO commands such as fatls or ext2load"
 );
@@ -292,16 +292,28 @@ static int do_spi_flash_read_write(int argc, char * const argv[])
 		ret = spi_flash_update(flash, offset, len, buf);
 	} else if (strncmp(argv[0], "read", 4) == 0 ||
 			strncmp(argv[0], "write", 5) == 0) {
+		ulong start, delta;
 		int read;
 
 		read = strncmp(argv[0], "read", 4) == 0;
+		start = get_timer(0);
 		if (read)
 			ret = spi_flash_read(flash, offset, len, buf);
 		else
 			ret = spi_flash_write(flash, offset, len, buf);
+		delta = get_timer(start);
 
-		printf("SF: %zu bytes @ %#x %s: %s\n", (size_t)len, (u32)offset,
+		printf("SF: %zu bytes @ %#x %s: %s", (size_t)len, (u32)offset,
 		       read ? "Read" : "Written", ret ? "ERROR" : "OK");
+		if (!ret) {
+			printf(" in %lu ms", delta);
+			if (delta > 0) {
+				puts(" (");
+				print_size(len / delta * 1000, "/s");
+				puts(")");
+			}
+		}
+		puts("\n");
 	}
 
 	unmap_physmem(buf, len);
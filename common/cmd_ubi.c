@@ -22,6 +22,7 @@
 #include <linux/err.h>
 #include <ubi_uboot.h>
 #include <asm/errno.h>
+#include <asm/io.h>
 #include <jffs2/load_kernel.h>
 
 #undef ubi_msg
@@ -39,6 +40,10 @@ static int ubi_initialized;
 
 struct selected_dev {
 	char part_name[80];
+	char vid_header_offset[16];
+	u64 part_offset;
+	u64 part_size;
+	unsigned int write_gen;
 	int selected;
 	int nr;
 	struct mtd_info *mtd_info;
@@ -85,6 +90,9 @@ static void display_ubi_info(struct ubi_device *ubi)
 	ubi_msg("number of PEBs reserved for bad PEB handling: %d",
 			ubi->beb_rsvd_pebs);
 	ubi_msg("max/mean erase counter: %d/%d", ubi->max_ec, ubi->mean_ec);
+	ubi_msg("attach time: %lu ms, headers of %d PEBs read%s",
+			ubi->attach_time, ubi->scanned_peb_count,
+			ubi->fm ? ", using fastmap" : "");
 }
 
 static int ubi_info(int layout)
@@ -443,19 +451,8 @@ static int ubi_dev_scan(struct mtd_info *info, char *ubidev,
 	return 0;
 }
 
-int ubi_part(char *part_name, const char *vid_header_offset)
+static int ubi_detach(void)
 {
-	int err = 0;
-	char mtd_dev[16];
-	struct mtd_device *dev;
-	struct part_info *part;
-	u8 pnum;
-
-	if (mtdparts_init() != 0) {
-		printf("Error initializing mtdparts!\n");
-		return 1;
-	}
-
 #ifdef CONFIG_CMD_UBIFS
 	/*
 	 * Automatically unmount UBIFS partition when user
@@ -466,15 +463,30 @@ int ubi_part(char *part_name, const char *vid_header_offset)
 		cmd_ubifs_umount();
 #endif
 
-	/* todo: get dev number for NAND... */
-	ubi_dev.nr = 0;
-
 	/*
 	 * Call ubi_exit() before re-initializing the UBI subsystem
 	 */
 	if (ubi_initialized) {
 		ubi_exit();
 		del_mtd_partitions(ubi_dev.mtd_info);
+		ubi_initialized = 0;
+	}
+	ubi_dev.selected = 0;
+
+	return 0;
+}
+
+int ubi_part(char *part_name, const char *vid_header_offset)
+{
+	int err = 0;
+	char mtd_dev[16];
+	struct mtd_device *dev;
+	struct part_info *part;
+	u8 pnum;
+
+	if (mtdparts_init() != 0) {
+		printf("Error initializing mtdparts!\n");
+		return 1;
 	}
 
 	/*
@@ -485,6 +497,30 @@ int ubi_part(char *part_name, const char *vid_header_offset)
 		printf("Partition %s not found!\n", part_name);
 		return 1;
 	}
+
+	if (!vid_header_offset)
+		vid_header_offset = "";
+
+	/*
+	 * Attaching reads the headers of every PEB, so if the same partition
+	 * is selected again keep it attached, unless the device was written
+	 * or erased behind UBI's back since (e.g. by the nand commands). UBI
+	 * itself writes through the partition, which leaves the device's
+	 * write_gen alone.
+	 */
+	if (ubi_initialized && ubi_dev.selected &&
+	    !strcmp(ubi_dev.part_name, part_name) &&
+	    ubi_dev.part_offset == part->offset &&
+	    ubi_dev.part_size == part->size &&
+	    !strcmp(ubi_dev.vid_header_offset, vid_header_offset) &&
+	    ubi_dev.mtd_info->write_gen == ubi_dev.write_gen)
+		return 0;
+
+	ubi_detach();
+
+	/* todo: get dev number for NAND... */
+	ubi_dev.nr = 0;
+
 	sprintf(mtd_dev, "%s%d", MTD_DEV_TYPE(dev->id->type), dev->id->num);
 	ubi_dev.mtd_info = get_mtd_device_nm(mtd_dev);
 	if (IS_ERR(ubi_dev.mtd_info)) {
@@ -496,13 +532,18 @@ int ubi_part(char *part_name, const char *vid_header_offset)
 	ubi_dev.selected = 1;
 
 	strcpy(ubi_dev.part_name, part_name);
+	strncpy(ubi_dev.vid_header_offset, vid_header_offset,
+		sizeof(ubi_dev.vid_header_offset) - 1);
+	ubi_dev.part_offset = part->offset;
+	ubi_dev.part_size = part->size;
 	err = ubi_dev_scan(ubi_dev.mtd_info, ubi_dev.part_name,
-			vid_header_offset);
+			*vid_header_offset ? vid_header_offset : NULL);
 	if (err) {
 		printf("UBI init error %d\n", err);
 		ubi_dev.selected = 0;
 		return err;
 	}
+	ubi_dev.write_gen = ubi_dev.mtd_info->write_gen;
 
 	ubi = ubi_devices[0];
 
@@ -541,6 +582,9 @@ static int do_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return ubi_part(argv[2], vid_header_offset);
 	}
 
+	if (strcmp(argv[1], "detach") == 0)
+		return ubi_detach();
+
 	if ((strcmp(argv[1], "part") != 0) && (!ubi_dev.selected)) {
 		printf("Error, no UBI device/partition selected!\n");
 		return 1;
@@ -613,15 +657,17 @@ static int do_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		    strncmp(argv[1] + 5, ".part", 5) == 0) {
 			if (argc < 6) {
 				ret = ubi_volume_continue_write(argv[3],
-						(void *)addr, size);
+						map_sysmem(addr, size), size);
 			} else {
 				size_t full_size;
 				full_size = simple_strtoul(argv[5], NULL, 16);
 				ret = ubi_volume_begin_write(argv[3],
-						(void *)addr, size, full_size);
+						map_sysmem(addr, size), size,
+						full_size);
 			}
 		} else {
-			ret = ubi_volume_write(argv[3], (void *)addr, size);
+			ret = ubi_volume_write(argv[3], map_sysmem(addr, size),
+					       size);
 		}
 		if (!ret) {
 			printf("%lld bytes written to volume %s\n", size,
@@ -650,7 +696,8 @@ static int do_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			printf("Read %lld bytes from volume %s to %lx\n", size,
 			       argv[3], addr);
 
-			return ubi_volume_read(argv[3], (char *)addr, size);
+			return ubi_volume_read(argv[3], map_sysmem(addr, size),
+					       size);
 		}
 	}
 
@@ -664,6 +711,8 @@ U_BOOT_CMD(
 	"part [part] [offset]\n"
 		" - Show or set current partition (with optional VID"
 		" header offset)\n"
+	"ubi detach"
+		" - Detach the current partition\n"
 	"ubi info [l[ayout]]"
 		" - Display volume and ubi layout information\n"
 	"ubi check volumename"
@@ -24,13 +24,15 @@ static int ubifs_mounted;
 static int do_ubifs_mount(cmd_tbl_t *cmdtp, int flag, int argc,
 				char * const argv[])
 {
-	char *vol_name;
+	char *vol_name, *options = NULL;
 	int ret;
 
-	if (argc != 2)
+	if (argc < 2 || argc > 3)
 		return CMD_RET_USAGE;
 
 	vol_name = argv[1];
+	if (argc == 3)
+		options = argv[2];
 	debug("Using volume %s\n", vol_name);
 
 	if (ubifs_initialized == 0) {
@@ -38,7 +40,7 @@ static int do_ubifs_mount(cmd_tbl_t *cmdtp, int flag, int argc,
 		ubifs_initialized = 1;
 	}
 
-	ret = uboot_ubifs_mount(vol_name);
+	ret = uboot_ubifs_mount(vol_name, options);
 	if (ret)
 		return -1;
 
@@ -146,10 +148,11 @@ static int do_ubifs_load(cmd_tbl_t *cmdtp, int flag, int argc,
 }
 
 U_BOOT_CMD(
-	ubifsmount, 2, 0, do_ubifs_mount,
+	ubifsmount, 3, 0, do_ubifs_mount,
 	"mount UBIFS volume",
-	"<volume-name>\n"
-	"    - mount 'volume-name' volume"
+	"<volume-name> [bulk_read|no_bulk_read]\n"
+	"    - mount 'volume-name' volume, reading consecutive data nodes\n"
+	"      of a file at once unless 'no_bulk_read' is given"
 );
 
 U_BOOT_CMD(
@@ -11,8 +11,11 @@
 
 #include <common.h>
 #include <command.h>
+#include <malloc.h>
 #include <linux/ctype.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 /*
  * Use puts() instead of printf() to avoid printf buffer overflow
  * for long help messages
@@ -119,10 +122,79 @@ cmd_tbl_t *find_cmd_tbl (const char *cmd, cmd_tbl_t *table, int table_len)
 	return NULL;	/* not found or ambiguous command */
 }
 
+/*
+ * Index of the command table sorted by name, for a binary search instead of
+ * a scan of every command. The linker sorts the table by the C identifier of
+ * each entry, which is not always the command name (e.g. "?"), so the index
+ * is built once, on first use after relocation. Before that, BSS may not be
+ * usable yet, so the index is not even looked at.
+ */
+static cmd_tbl_t **cmd_index;
+static int cmd_index_len;
+
+static int build_cmd_index(void)
+{
+	cmd_tbl_t *cmdtp = ll_entry_start(cmd_tbl_t, cmd);
+	const int len = ll_entry_count(cmd_tbl_t, cmd);
+	cmd_tbl_t **index;
+	int i, j;
+
+	index = malloc(len * sizeof(*index));
+	if (!index)
+		return -1;
+
+	/* Insertion sort, as the table is almost sorted already */
+	for (i = 0; i < len; i++, cmdtp++) {
+		for (j = i; j > 0 &&
+		     strcmp(index[j - 1]->name, cmdtp->name) > 0; j--)
+			index[j] = index[j - 1];
+		index[j] = cmdtp;
+	}
+	cmd_index = index;
+	cmd_index_len = len;
+
+	return 0;
+}
+
+/* Same as find_cmd_tbl() on the whole command table, using the index */
+static cmd_tbl_t *find_cmd_index(const char *cmd)
+{
+	int lo = 0, hi = cmd_index_len, mid;
+	const char *p;
+	int len;
+
+	len = ((p = strchr(cmd, '.')) == NULL) ? strlen(cmd) : (p - cmd);
+
+	/* First command whose name does not sort before the one wanted */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strncmp(cmd_index[mid]->name, cmd, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == cmd_index_len || strncmp(cmd_index[lo]->name, cmd, len))
+		return NULL;
+
+	/* A full match sorts before the commands it abbreviates */
+	if (cmd_index[lo]->name[len] == '\0')
+		return cmd_index[lo];
+	if (lo + 1 < cmd_index_len &&
+	    !strncmp(cmd_index[lo + 1]->name, cmd, len))
+		return NULL;	/* ambiguous abbreviation */
+
+	return cmd_index[lo];
+}
+
 cmd_tbl_t *find_cmd (const char *cmd)
 {
 	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
 	const int len = ll_entry_count(cmd_tbl_t, cmd);
+
+	if (cmd && (gd->flags & GD_FLG_RELOC) &&
+	    (cmd_index || !build_cmd_index()))
+		return find_cmd_index(cmd);
+
 	return find_cmd_tbl(cmd, start, len);
 }
 
@@ -118,6 +118,24 @@ static void fini_mmc_for_env(struct mmc *mmc)
 #endif
 }
 
+static inline int read_env(struct mmc *mmc, unsigned long size,
+			   unsigned long offset, const void *buffer)
+{
+	uint blk_start, blk_cnt, n;
+	int dev = CONFIG_SYS_MMC_ENV_DEV;
+
+#ifdef CONFIG_SPL_BUILD
+	dev = 0;
+#endif
+
+	blk_start	= ALIGN(offset, mmc->read_bl_len) / mmc->read_bl_len;
+	blk_cnt		= ALIGN(size, mmc->read_bl_len) / mmc->read_bl_len;
+
+	n = mmc->block_dev.block_read(dev, blk_start, blk_cnt, (uchar *)buffer);
+
+	return (n == blk_cnt) ? 0 : -1;
+}
+
 #ifdef CONFIG_CMD_SAVEENV
 static inline int write_env(struct mmc *mmc, unsigned long size,
 			    unsigned long offset, const void *buffer)
@@ -133,6 +151,49 @@ static inline int write_env(struct mmc *mmc, unsigned long size,
 	return (n == blk_cnt) ? 0 : -1;
 }
 
+/*
+ * Write only the blocks in which the new environment differs from what
+ * is at "offset" now, or all of them if that cannot be read
+ */
+static int write_env_changed(struct mmc *mmc, unsigned long offset,
+			     const u_char *env, ulong *written)
+{
+	uint blksz = mmc->write_bl_len;
+	uint blk_cnt = ALIGN(CONFIG_ENV_SIZE, blksz) / blksz;
+	uint i, n, len;
+	u_char *old;
+	int ret = 0;
+
+	old = memalign(ARCH_DMA_MINALIGN,
+		       ALIGN(CONFIG_ENV_SIZE, max(blksz, mmc->read_bl_len)));
+	if (!old || read_env(mmc, CONFIG_ENV_SIZE, offset, old)) {
+		free(old);
+		*written = blk_cnt * blksz;
+		return write_env(mmc, CONFIG_ENV_SIZE, offset, env);
+	}
+
+	for (i = 0; i < blk_cnt && !ret; i += n) {
+		/* Find the next run of changed blocks */
+		for (n = 0; i + n < blk_cnt; n++) {
+			len = min(blksz, CONFIG_ENV_SIZE - (i + n) * blksz);
+			if (!memcmp(old + (i + n) * blksz,
+				    env + (i + n) * blksz, len))
+				break;
+		}
+		if (!n) {
+			n = 1;
+			continue;
+		}
+
+		ret = write_env(mmc, n * blksz, offset + i * blksz,
+				env + i * blksz);
+		*written += n * blksz;
+	}
+	free(old);
+
+	return ret;
+}
+
 #ifdef CONFIG_ENV_OFFSET_REDUND
 static unsigned char env_flags;
 #endif
@@ -141,6 +202,7 @@ int saveenv(void)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(env_t, env_new, 1);
 	struct mmc *mmc = find_mmc_device(CONFIG_SYS_MMC_ENV_DEV);
+	ulong	written = 0;
 	u32	offset;
 	int	ret, copy = 0;
 
@@ -165,13 +227,13 @@ int saveenv(void)
 
 	printf("Writing to %sMMC(%d)... ", copy ? "redundant " : "",
 	       CONFIG_SYS_MMC_ENV_DEV);
-	if (write_env(mmc, CONFIG_ENV_SIZE, offset, (u_char *)env_new)) {
+	if (write_env_changed(mmc, offset, (u_char *)env_new, &written)) {
 		puts("failed\n");
 		ret = 1;
 		goto fini;
 	}
 
-	puts("done\n");
+	printf("done, %lu bytes written\n", written);
 	ret = 0;
 
 #ifdef CONFIG_ENV_OFFSET_REDUND
@@ -184,24 +246,6 @@ fini:
 }
 #endif /* CONFIG_CMD_SAVEENV */
 
-static inline int read_env(struct mmc *mmc, unsigned long size,
-			   unsigned long offset, const void *buffer)
-{
-	uint blk_start, blk_cnt, n;
-	int dev = CONFIG_SYS_MMC_ENV_DEV;
-
-#ifdef CONFIG_SPL_BUILD
-	dev = 0;
-#endif
-
-	blk_start	= ALIGN(offset, mmc->read_bl_len) / mmc->read_bl_len;
-	blk_cnt		= ALIGN(size, mmc->read_bl_len) / mmc->read_bl_len;
-
-	n = mmc->block_dev.block_read(dev, blk_start, blk_cnt, (uchar *)buffer);
-
-	return (n == blk_cnt) ? 0 : -1;
-}
-
 #ifdef CONFIG_ENV_OFFSET_REDUND
 void env_relocate_spec(void)
 {
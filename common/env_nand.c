@@ -123,33 +123,53 @@ int env_init(void)
 /*
  * The legacy NAND code saved the environment in the first NAND device i.e.,
  * nand_dev_desc + 0. This is also the behaviour using the new NAND code.
+ *
+ * Only the blocks whose contents change are erased and written; a block
+ * which cannot be read back cleanly is written again as well. The number
+ * of bytes written is added to *written.
  */
-int writeenv(size_t offset, u_char *buf)
+int writeenv(size_t offset, u_char *buf, ulong *written)
 {
 	size_t end = offset + CONFIG_ENV_RANGE;
 	size_t amount_saved = 0;
-	size_t blocksize, len;
-	u_char *char_ptr;
+	size_t blocksize, len, rlen;
+	u_char *char_ptr, *old;
+	int ret = 1;
 
 	blocksize = nand_info[0].erasesize;
 	len = min(blocksize, CONFIG_ENV_SIZE);
 
+	old = malloc(len);
+	if (!old)
+		return 1;
+
 	while (amount_saved < CONFIG_ENV_SIZE && offset < end) {
 		if (nand_block_isbad(&nand_info[0], offset)) {
 			offset += blocksize;
 		} else {
 			char_ptr = &buf[amount_saved];
-			if (nand_write(&nand_info[0], offset, &len, char_ptr))
-				return 1;
+			rlen = len;
+			if (nand_read(&nand_info[0], offset, &rlen, old) ||
+			    memcmp(old, char_ptr, len)) {
+				if (nand_erase(&nand_info[0], offset,
+					       blocksize) ||
+				    nand_write(&nand_info[0], offset, &len,
+					       char_ptr))
+					goto done;
+				*written += len;
+			}
 
 			offset += blocksize;
 			amount_saved += len;
 		}
 	}
-	if (amount_saved != CONFIG_ENV_SIZE)
-		return 1;
+	if (amount_saved == CONFIG_ENV_SIZE)
+		ret = 0;
 
-	return 0;
+done:
+	free(old);
+
+	return ret;
 }
 
 struct env_location {
@@ -160,15 +180,15 @@ struct env_location {
 static int erase_and_write_env(const struct env_location *location,
 		u_char *env_new)
 {
+	ulong written = 0;
 	int ret = 0;
 
-	printf("Erasing %s...\n", location->name);
-	if (nand_erase_opts(&nand_info[0], &location->erase_opts))
-		return 1;
-
 	printf("Writing to %s... ", location->name);
-	ret = writeenv(location->erase_opts.offset, env_new);
-	puts(ret ? "FAILED!\n" : "OK\n");
+	ret = writeenv(location->erase_opts.offset, env_new, &written);
+	if (ret)
+		puts("FAILED!\n");
+	else
+		printf("OK, %lu bytes written\n", written);
 
 	return ret;
 }
@@ -44,12 +44,60 @@ char *env_name_spec = "SPI Flash";
 
 static struct spi_flash *env_flash;
 
+#define ENV_SECT_RANGE	ALIGN(CONFIG_ENV_SIZE, CONFIG_ENV_SECT_SIZE)
+
+/*
+ * Write a new environment image at "offset", but only erase and write
+ * the sectors in which it differs from what is on the flash. Anything
+ * after the environment in its last sector is kept. The number of bytes
+ * written is added to *written.
+ */
+static int env_sf_write(u32 offset, const env_t *env, ulong *written)
+{
+	const char *new = (const char *)env;
+	u32 off, len;
+	char *buf;
+	int ret;
+
+	buf = malloc(ENV_SECT_RANGE);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = spi_flash_read(env_flash, offset, ENV_SECT_RANGE, buf);
+	if (ret)
+		goto done;
+
+	for (off = 0; off < ENV_SECT_RANGE; off += CONFIG_ENV_SECT_SIZE) {
+		len = CONFIG_ENV_SIZE - off;
+		if (len > CONFIG_ENV_SECT_SIZE)
+			len = CONFIG_ENV_SECT_SIZE;
+		if (!memcmp(buf + off, new + off, len))
+			continue;
+
+		memcpy(buf + off, new + off, len);
+		ret = spi_flash_erase(env_flash, offset + off,
+				      CONFIG_ENV_SECT_SIZE);
+		if (ret)
+			goto done;
+		ret = spi_flash_write(env_flash, offset + off,
+				      CONFIG_ENV_SECT_SIZE, buf + off);
+		if (ret)
+			goto done;
+		*written += CONFIG_ENV_SECT_SIZE;
+	}
+
+done:
+	free(buf);
+
+	return ret;
+}
+
 #if defined(CONFIG_ENV_OFFSET_REDUND)
 int saveenv(void)
 {
 	env_t	env_new;
-	char	*saved_buffer = NULL, flag = OBSOLETE_FLAG;
-	u32	saved_size, saved_offset, sector = 1;
+	char	flag = OBSOLETE_FLAG;
+	ulong	written = 0;
 	int	ret;
 
 	if (!env_flash) {
@@ -75,61 +123,26 @@ int saveenv(void)
 		env_offset = CONFIG_ENV_OFFSET_REDUND;
 	}
 
-	/* Is the sector larger than the env (i.e. embedded) */
-	if (CONFIG_ENV_SECT_SIZE > CONFIG_ENV_SIZE) {
-		saved_size = CONFIG_ENV_SECT_SIZE - CONFIG_ENV_SIZE;
-		saved_offset = env_new_offset + CONFIG_ENV_SIZE;
-		saved_buffer = malloc(saved_size);
-		if (!saved_buffer) {
-			ret = 1;
-			goto done;
-		}
-		ret = spi_flash_read(env_flash, saved_offset,
-					saved_size, saved_buffer);
-		if (ret)
-			goto done;
-	}
-
-	if (CONFIG_ENV_SIZE > CONFIG_ENV_SECT_SIZE) {
-		sector = CONFIG_ENV_SIZE / CONFIG_ENV_SECT_SIZE;
-		if (CONFIG_ENV_SIZE % CONFIG_ENV_SECT_SIZE)
-			sector++;
-	}
-
-	puts("Erasing SPI flash...");
-	ret = spi_flash_erase(env_flash, env_new_offset,
-				sector * CONFIG_ENV_SECT_SIZE);
-	if (ret)
-		goto done;
-
 	puts("Writing to SPI flash...");
-
-	ret = spi_flash_write(env_flash, env_new_offset,
-		CONFIG_ENV_SIZE, &env_new);
+	ret = env_sf_write(env_new_offset, &env_new, &written);
 	if (ret)
 		goto done;
 
-	if (CONFIG_ENV_SECT_SIZE > CONFIG_ENV_SIZE) {
-		ret = spi_flash_write(env_flash, saved_offset,
-					saved_size, saved_buffer);
-		if (ret)
-			goto done;
-	}
-
 	ret = spi_flash_write(env_flash, env_offset + offsetof(env_t, flags),
 				sizeof(env_new.flags), &flag);
 	if (ret)
 		goto done;
+	written += sizeof(env_new.flags);
 
-	puts("done\n");
+	printf("done, %lu bytes written\n", written);
 
 	gd->env_valid = gd->env_valid == 2 ? 1 : 2;
 
 	printf("Valid environment: %d\n", (int)gd->env_valid);
 
  done:
-	if (saved_buffer)
-		free(saved_buffer);
+	if (ret)
+		puts("failed\n");
 
 	return ret;
 }
@@ -220,9 +233,8 @@ out:
 #else
 int saveenv(void)
 {
-	u32	saved_size, saved_offset, sector = 1;
-	char	*saved_buffer = NULL;
-	int	ret = 1;
+	ulong	written = 0;
+	int	ret;
 	env_t	env_new;
 
 	if (!env_flash) {
@@ -235,57 +247,20 @@ int saveenv(void)
 		}
 	}
 
-	/* Is the sector larger than the env (i.e. embedded) */
-	if (CONFIG_ENV_SECT_SIZE > CONFIG_ENV_SIZE) {
-		saved_size = CONFIG_ENV_SECT_SIZE - CONFIG_ENV_SIZE;
-		saved_offset = CONFIG_ENV_OFFSET + CONFIG_ENV_SIZE;
-		saved_buffer = malloc(saved_size);
-		if (!saved_buffer)
-			goto done;
-
-		ret = spi_flash_read(env_flash, saved_offset,
-			saved_size, saved_buffer);
-		if (ret)
-			goto done;
-	}
-
-	if (CONFIG_ENV_SIZE > CONFIG_ENV_SECT_SIZE) {
-		sector = CONFIG_ENV_SIZE / CONFIG_ENV_SECT_SIZE;
-		if (CONFIG_ENV_SIZE % CONFIG_ENV_SECT_SIZE)
-			sector++;
-	}
-
 	ret = env_export(&env_new);
 	if (ret)
-		goto done;
-
-	puts("Erasing SPI flash...");
-	ret = spi_flash_erase(env_flash, CONFIG_ENV_OFFSET,
-		sector * CONFIG_ENV_SECT_SIZE);
-	if (ret)
-		goto done;
+		return ret;
 
 	puts("Writing to SPI flash...");
-	ret = spi_flash_write(env_flash, CONFIG_ENV_OFFSET,
-		CONFIG_ENV_SIZE, &env_new);
-	if (ret)
-		goto done;
-
-	if (CONFIG_ENV_SECT_SIZE > CONFIG_ENV_SIZE) {
-		ret = spi_flash_write(env_flash, saved_offset,
-			saved_size, saved_buffer);
-		if (ret)
-			goto done;
+	ret = env_sf_write(CONFIG_ENV_OFFSET, &env_new, &written);
+	if (ret) {
+		puts("failed\n");
+		return ret;
 	}
 
-	ret = 0;
-	puts("done\n");
+	printf("done, %lu bytes written\n", written);
 
- done:
-	if (saved_buffer)
-		free(saved_buffer);
-
-	return ret;
+	return 0;
 }
 
 void env_relocate_spec(void)
@@ -6,6 +6,7 @@
 
 #include <common.h>
 #include <fb_mmc.h>
+#include <malloc.h>
 #include <part.h>
 #include <aboot.h>
 #include <sparse_format.h>
@@ -59,30 +60,42 @@ static void write_raw_image(block_dev_desc_t *dev_desc, disk_partition_t *info,
 	fastboot_okay("");
 }
 
-void fb_mmc_flash_write(const char *cmd, void *download_buffer,
-			unsigned int download_bytes, char *response)
+static block_dev_desc_t *fb_mmc_get_part(const char *cmd,
+					 disk_partition_t *info)
 {
-	int ret;
 	block_dev_desc_t *dev_desc;
-	disk_partition_t info;
-
-	/* initialize the response buffer */
-	response_str = response;
+	int ret;
 
 	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
 	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
 		error("invalid mmc device\n");
 		fastboot_fail("invalid mmc device");
-		return;
+		return NULL;
 	}
 
-	ret = get_partition_info_efi_by_name(dev_desc, cmd, &info);
+	ret = get_partition_info_efi_by_name(dev_desc, cmd, info);
 	if (ret) {
 		error("cannot find partition: '%s'\n", cmd);
 		fastboot_fail("cannot find partition");
-		return;
+		return NULL;
 	}
 
+	return dev_desc;
+}
+
+void fb_mmc_flash_write(const char *cmd, void *download_buffer,
+			unsigned int download_bytes, char *response)
+{
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+
+	/* initialize the response buffer */
+	response_str = response;
+
+	dev_desc = fb_mmc_get_part(cmd, &info);
+	if (!dev_desc)
+		return;
+
 	if (is_sparse_image(download_buffer))
 		write_sparse_image(dev_desc, &info, cmd, download_buffer,
 				   download_bytes);
@@ -90,3 +103,128 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 		write_raw_image(dev_desc, &info, cmd, download_buffer,
 				download_bytes);
 }
+
+/* Largest download offered for streaming, below 2 GiB for older clients */
+#define FB_MMC_STREAM_MAX	0x7ffff000
+
+/* Partition that the next download is written to while it arrives */
+static block_dev_desc_t *stream_dev;
+static disk_partition_t stream_info;
+static int stream_armed;		/* The next download is streamed */
+static struct sparse_stream stream;
+static unsigned int stream_size;	/* Size of the download */
+static unsigned int stream_bytes;	/* Bytes of it received so far */
+static char stream_head[sizeof(sparse_header_t)];	/* Its first bytes */
+static unsigned int stream_head_len;
+static ulong stream_start;
+static int stream_done;			/* stream_response holds a result */
+static char stream_response[RESPONSE_LEN];
+
+void fb_mmc_stream_prepare(const char *cmd, char *response)
+{
+	response_str = response;
+	stream_dev = NULL;
+	stream_armed = 0;
+	stream_done = 0;
+
+	if (*cmd) {
+		stream_dev = fb_mmc_get_part(cmd, &stream_info);
+		if (!stream_dev)
+			return;
+		stream_armed = 1;
+		printf("Writing the next download to '%s' as it arrives\n",
+		       cmd);
+	}
+	fastboot_okay("");
+}
+
+void fb_mmc_stream_cancel(void)
+{
+	stream_armed = 0;
+}
+
+unsigned int fb_mmc_stream_max_size(void)
+{
+	uint64_t size;
+
+	if (!stream_armed)
+		return 0;
+
+	size = (uint64_t)stream_info.size * stream_info.blksz;
+
+	return min(size, (uint64_t)FB_MMC_STREAM_MAX);
+}
+
+void fb_mmc_stream_start(unsigned int size)
+{
+	/* In case the previous download never finished */
+	free(stream.blkbuf);
+	memset(&stream, 0, sizeof(stream));
+
+	/* Only this download goes to the partition, the next one to RAM */
+	stream_armed = 0;
+	stream_size = size;
+	stream_bytes = 0;
+	stream_head_len = 0;
+	stream_done = 0;
+	stream_start = get_timer(0);
+	memset(stream_response, 0, sizeof(stream_response));
+}
+
+void fb_mmc_stream_write(const void *buf, unsigned int len)
+{
+	const char *part_name = (const char *)stream_info.name;
+	unsigned int n;
+
+	response_str = stream_response;
+	stream_bytes += len;
+
+	/* Gather the start of the image to tell a sparse one from a raw one */
+	if (stream_head_len < sizeof(stream_head)) {
+		n = min(len, (unsigned int)sizeof(stream_head) - stream_head_len);
+		memcpy(stream_head + stream_head_len, buf, n);
+		stream_head_len += n;
+		buf += n;
+		len -= n;
+		if (stream_head_len < sizeof(stream_head) &&
+		    stream_bytes < stream_size)
+			return;
+
+		sparse_stream_init(&stream, stream_dev, &stream_info, part_name,
+				   stream_head_len == sizeof(stream_head) &&
+				   is_sparse_image(stream_head), stream_size);
+		sparse_stream_write(&stream, stream_head, stream_head_len);
+	}
+
+	sparse_stream_write(&stream, buf, len);
+}
+
+void fb_mmc_stream_end(void)
+{
+	ulong time;
+
+	response_str = stream_response;
+	sparse_stream_finish(&stream);
+	stream_done = 1;
+
+	time = max(get_timer(stream_start), 1UL);
+	printf("%u bytes downloaded and written in %lu ms, %lu KiB/s\n",
+	       stream_bytes, time, (ulong)(stream_bytes / time * 1000 / 1024));
+}
+
+int fb_mmc_flash_streamed(const char *cmd, char *response)
+{
+	if (!stream_done)
+		return 0;
+
+	stream_done = 0;
+	if (strcmp(cmd, (const char *)stream_info.name)) {
+		error("image was written to '%s'\n", stream_info.name);
+		response_str = response;
+		fastboot_fail("image was written to another partition");
+	} else {
+		strcpy(response, stream_response);
+	}
+
+	return 1;
+}
@@ -19,11 +19,15 @@
 #include <u-boot/sha256.h>
 #include <asm/io.h>
 #include <asm/errno.h>
+#include <asm/unaligned.h>
 
-#ifdef CONFIG_CMD_SHA1SUM
+#if defined(CONFIG_CMD_SHA1SUM) || defined(CONFIG_FIT)
 static int hash_init_sha1(struct hash_algo *algo, void **ctxp)
 {
 	sha1_context *ctx = malloc(sizeof(sha1_context));
+
+	if (!ctx)
+		return -1;
 	sha1_starts(ctx);
 	*ctxp = ctx;
 	return 0;
@@ -52,6 +56,9 @@ static int hash_finish_sha1(struct hash_algo *algo, void *ctx, void *dest_buf,
 static int hash_init_sha256(struct hash_algo *algo, void **ctxp)
 {
 	sha256_context *ctx = malloc(sizeof(sha256_context));
+
+	if (!ctx)
+		return -1;
 	sha256_starts(ctx);
 	*ctxp = ctx;
 	return 0;
@@ -79,6 +86,9 @@ static int hash_finish_sha256(struct hash_algo *algo, void *ctx, void
 static int hash_init_crc32(struct hash_algo *algo, void **ctxp)
 {
 	uint32_t *ctx = malloc(sizeof(uint32_t));
+
+	if (!ctx)
+		return -1;
 	*ctx = 0;
 	*ctxp = ctx;
 	return 0;
@@ -97,7 +107,8 @@ static int hash_finish_crc32(struct hash_algo *algo, void *ctx, void *dest_buf,
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint32_t *)dest_buf) = *((uint32_t *)ctx);
+	/* Same byte order as crc32_wd_buf() */
+	put_unaligned_be32(*((uint32_t *)ctx), dest_buf);
 	free(ctx);
 	return 0;
 }
@@ -118,19 +129,30 @@ static struct hash_algo hash_algo[] = {
 		SHA1_SUM_LEN,
 		hw_sha1,
 		CHUNKSZ_SHA1,
+#ifdef CONFIG_SHA_PROG_HW_ACCEL
+		hw_sha_init,
+		hw_sha_update,
+		hw_sha_finish,
+#endif
 	}, {
 		"sha256",
 		SHA256_SUM_LEN,
 		hw_sha256,
 		CHUNKSZ_SHA256,
+#ifdef CONFIG_SHA_PROG_HW_ACCEL
+		hw_sha_init,
+		hw_sha_update,
+		hw_sha_finish,
+#endif
 	},
 #endif
 	/*
 	 * This is CONFIG_CMD_SHA1SUM instead of CONFIG_SHA1 since otherwise
 	 * it bloats the code for boards which use SHA1 but not the 'hash'
-	 * or 'sha1sum' commands.
+	 * or 'sha1sum' commands. FIT verification hashes through this table
+	 * too.
 	 */
-#ifdef CONFIG_CMD_SHA1SUM
+#if defined(CONFIG_CMD_SHA1SUM) || defined(CONFIG_FIT)
 	{
 		"sha1",
 		SHA1_SUM_LEN,
@@ -311,6 +333,28 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop)
 	return -EPROTONOSUPPORT;
 }
 
+int hash_progressive_lookup_algo(const char *algo_name,
+				 struct hash_algo **algop)
+{
+	int i;
+
+	/*
+	 * An algorithm may be listed more than once, for example with and
+	 * without hardware acceleration. Use the first that can be fed a
+	 * chunk at a time.
+	 */
+	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
+		if (!strcmp(algo_name, hash_algo[i].name) &&
+		    hash_algo[i].hash_init) {
+			*algop = &hash_algo[i];
+			return 0;
+		}
+	}
+
+	debug("Unknown progressive hash algorithm '%s'\n", algo_name);
+	return -EPROTONOSUPPORT;
+}
+
 void hash_show(struct hash_algo *algo, ulong addr, ulong len, uint8_t *output)
 {
 	int i;
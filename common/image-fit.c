@@ -16,6 +16,7 @@
 #else
 #include <common.h>
 #include <errno.h>
+#include <watchdog.h>
 #include <asm/io.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
@@ -853,6 +854,81 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 	return 0;
 }
 
+#if !defined(USE_HOSTCC) && !defined(CONFIG_SPL_BUILD)
+#define IMAGE_ENABLE_PROG_HASH	1
+#else
+#define IMAGE_ENABLE_PROG_HASH	0
+#endif
+
+/* Maximum number of hash nodes in an image which are hashed in one pass */
+#define FIT_MAX_HASHES		4
+
+#if IMAGE_ENABLE_PROG_HASH
+/**
+ * fit_hash_progressive - hash data with several algorithms in one pass
+ * @data: pointer to the input data
+ * @data_len: data length
+ * @algo: list of algorithms, from hash_progressive_lookup_algo()
+ * @value: list of buffers to hold the hash values, one for each algorithm
+ * @count: number of algorithms, at most FIT_MAX_HASHES
+ *
+ * The data is fed to each algorithm CHUNKSZ bytes at a time, so that every
+ * chunk is read from memory once and is still in cache when the second and
+ * later algorithms see it. The watchdog is reset after each chunk. The
+ * algorithms may use hardware acceleration (CONFIG_SHA_PROG_HW_ACCEL).
+ *
+ * returns:
+ *     0, on success
+ *    -1, on error
+ */
+static int fit_hash_progressive(const void *data, size_t data_len,
+				struct hash_algo **algo, uint8_t **value,
+				int count)
+{
+	void *ctx[FIT_MAX_HASHES];
+	const uint8_t *buf = data;
+	const uint8_t *end = buf + data_len;
+	size_t chunk;
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (algo[i]->hash_init(algo[i], &ctx[i])) {
+			count = i;
+			ret = -1;
+			goto finish;
+		}
+	}
+
+	do {
+		chunk = end - buf;
+		if (chunk > CHUNKSZ)
+			chunk = CHUNKSZ;
+		for (i = 0; i < count; i++) {
+			if (!ctx[i])
+				continue;
+			/* A failed update frees its context */
+			if (algo[i]->hash_update(algo[i], ctx[i], buf, chunk,
+						 buf + chunk == end)) {
+				ctx[i] = NULL;
+				ret = -1;
+			}
+		}
+		buf += chunk;
+		WATCHDOG_RESET();
+	} while (!ret && buf < end);
+
+finish:
+	for (i = 0; i < count; i++) {
+		if (ctx[i] && algo[i]->hash_finish(algo[i], ctx[i], value[i],
+						   algo[i]->digest_size))
+			ret = -1;
+	}
+
+	return ret;
+}
+#endif /* IMAGE_ENABLE_PROG_HASH */
+
 /**
  * calculate_hash - calculate and return hash for provided input data
  * @data: pointer to the input data
@@ -874,6 +950,17 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len)
 {
+#if IMAGE_ENABLE_PROG_HASH
+	struct hash_algo *prog_algo;
+
+	if (!hash_progressive_lookup_algo(algo, &prog_algo)) {
+		if (fit_hash_progressive(data, data_len, &prog_algo, &value,
+					 1))
+			return -1;
+		*value_len = prog_algo->digest_size;
+		return 0;
+	}
+#endif
 	if (IMAGE_ENABLE_CRC32 && strcmp(algo, "crc32") == 0) {
 		*((uint32_t *)value) = crc32_wd(0, data, data_len,
 							CHUNKSZ_CRC32);
@@ -897,8 +984,15 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/* Hash value calculated ahead of fit_image_check_hash() */
+struct fit_hash_value {
+	int noffset;
+	int len;
+};
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size, const uint8_t *precalc,
+				int precalc_len, char **err_msgp)
 {
 	uint8_t value[FIT_MAX_HASH_LEN];
 	int value_len;
@@ -929,7 +1023,10 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (precalc) {
+		memcpy(value, precalc, precalc_len);
+		value_len = precalc_len;
+	} else if (calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -945,6 +1042,72 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	return 0;
 }
 
+/**
+ * fit_image_precalc_hashes - calculate all hashes of an image in one pass
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @data: image data
+ * @size: image data length
+ * @hashes: returns the hash node offset and value length for each hash
+ * @values: returns the hash values
+ *
+ * Rather than reading the image data from memory once for each hash node,
+ * this feeds the data to all of the hash algorithms together. Hash nodes
+ * which are ignored, use an algorithm which cannot be run progressively or
+ * do not fit in the list are left for fit_image_check_hash() to calculate.
+ *
+ * returns:
+ *     number of hash values calculated (0 if none or on error)
+ */
+static int fit_image_precalc_hashes(const void *fit, int image_noffset,
+				    const void *data, size_t size,
+				    struct fit_hash_value *hashes,
+				    uint8_t (*values)[FIT_MAX_HASH_LEN])
+{
+#if IMAGE_ENABLE_PROG_HASH
+	struct hash_algo *algo[FIT_MAX_HASHES];
+	uint8_t *dest[FIT_MAX_HASHES];
+	int count = 0;
+	int noffset;
+	const char *name;
+	char *algo_name;
+	int ignore;
+
+	fdt_for_each_subnode(fit, noffset, image_noffset) {
+		if (count == FIT_MAX_HASHES)
+			break;
+		name = fit_get_name(fit, noffset, NULL);
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo_name))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		if (hash_progressive_lookup_algo(algo_name, &algo[count]))
+			continue;
+		hashes[count].noffset = noffset;
+		hashes[count].len = algo[count]->digest_size;
+		dest[count] = values[count];
+		count++;
+	}
+
+	/* Nothing to share with a single hash */
+	if (count < 2)
+		return 0;
+
+	if (fit_hash_progressive(data, size, algo, dest, count))
+		return 0;
+
+	return count;
+#else
+	return 0;
+#endif
+}
+
 /**
  * fit_image_verify - verify data intergity
  * @fit: pointer to the FIT format image header
@@ -965,7 +1128,11 @@ int fit_image_verify(const void *fit, int image_noffset)
 	int		noffset = 0;
 	char		*err_msg = "";
 	int verify_all = 1;
+	struct fit_hash_value hashes[FIT_MAX_HASHES];
+	uint8_t values[FIT_MAX_HASHES][FIT_MAX_HASH_LEN];
+	int nhashes;
 	int ret;
+	int i;
 
 	/* Get image data and data length */
 	if (fit_image_get_data(fit, image_noffset, &data, &size)) {
@@ -981,6 +1148,9 @@ int fit_image_verify(const void *fit, int image_noffset)
 		goto error;
 	}
 
+	nhashes = fit_image_precalc_hashes(fit, image_noffset, data, size,
+					   hashes, values);
+
 	/* Process all hash subnodes of the component image node */
 	for (noffset = fdt_first_subnode(fit, image_noffset);
 	     noffset >= 0;
@@ -994,7 +1164,13 @@ int fit_image_verify(const void *fit, int image_noffset)
 		 */
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
+			for (i = 0; i < nhashes; i++) {
+				if (hashes[i].noffset == noffset)
+					break;
+			}
 			if (fit_image_check_hash(fit, noffset, data, size,
+						 i < nhashes ? values[i] : NULL,
+						 i < nhashes ? hashes[i].len : 0,
 						 &err_msg))
 				goto error;
 			puts("+ ");
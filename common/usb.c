@@ -247,6 +247,56 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 		return -1;
 }
 
+/*-------------------------------------------------------------------
+ * submits a data and a status bulk-in message as one queue, and waits
+ * for completion. returns 0 if Ok, -ENOSYS if the host controller can't
+ * do this (nothing is sent) or -1 if Error.
+ * synchronous behavior
+ */
+int usb_bulk_msg_pair(struct usb_device *dev, unsigned int pipe,
+			void *data, int len, int *actual_length,
+			void *data2, int len2, int *actual_length2, int timeout)
+{
+	int ret;
+
+	if (len < 0 || len2 < 0)
+		return -1;
+	dev->status = USB_ST_NOT_PROC; /*not yet processed */
+	*actual_length2 = 0;
+	ret = submit_bulk_msg_pair(dev, pipe, data, len, data2, len2,
+				   actual_length2);
+	if (ret == -ENOSYS)
+		return ret;
+	if (ret < 0)
+		return -1;
+	while (timeout--) {
+		if (!((volatile unsigned long)dev->status & USB_ST_NOT_PROC))
+			break;
+		mdelay(1);
+	}
+	*actual_length = dev->act_len;
+	if (dev->status == 0)
+		return 0;
+	else
+		return -1;
+}
+
+/*
+ * Host controllers which don't say otherwise are assumed to cope with 20
+ * blocks of 512 bytes per transfer, which is what USB storage always used
+ */
+__weak size_t usb_max_xfer_size(struct usb_device *dev)
+{
+	return 20 * 512;
+}
+
+__weak int submit_bulk_msg_pair(struct usb_device *dev, unsigned long pipe,
+			void *buffer, int transfer_len, void *buffer2,
+			int transfer_len2, int *actual_len2)
+{
+	return -ENOSYS;
+}
+
 
 /*-------------------------------------------------------------------
  * Max Packet stuff
@@ -35,6 +35,8 @@
 #include <command.h>
 #include <asm/byteorder.h>
 #include <asm/processor.h>
+#include <div64.h>
+#include <errno.h>
 
 #include <part.h>
 #include <usb.h>
@@ -131,19 +133,23 @@ struct us_data {
 	trans_cmnd	transport;		/* transport routine */
 };
 
-#ifdef CONFIG_USB_EHCI
 /*
- * The U-Boot EHCI driver can handle any transfer length as long as there is
- * enough free heap space left, but the SCSI READ(10) and WRITE(10) commands are
- * limited to 65535 blocks.
+ * The SCSI READ(10) and WRITE(10) commands are limited to 65535 blocks. The
+ * host controller may allow less, see usb_stor_max_xfer_blk().
  */
 #define USB_MAX_XFER_BLK	65535
-#else
-#define USB_MAX_XFER_BLK	20
-#endif
 
 static struct us_data usb_stor[USB_MAX_STOR_DEV];
 
+/* Read statistics for each storage device, shown by usb_stor_info() */
+struct usb_stor_stats {
+	unsigned long long bytes;	/* bytes read */
+	unsigned long ms;		/* time spent reading */
+	unsigned long cmds;		/* READ(10) commands sent */
+};
+
+static struct usb_stor_stats usb_stor_stats[USB_MAX_STOR_DEV];
+
 
 #define USB_STOR_TRANSPORT_GOOD	   0
 #define USB_STOR_TRANSPORT_FAILED -1
@@ -172,6 +178,31 @@ static void usb_show_progress(void)
 	debug(".");
 }
 
+/* Number of blocks to ask for in each READ(10) or WRITE(10) command */
+static unsigned short usb_stor_max_xfer_blk(struct usb_device *dev,
+					    block_dev_desc_t *dev_desc)
+{
+	size_t blks = usb_max_xfer_size(dev) / dev_desc->blksz;
+
+	if (blks > USB_MAX_XFER_BLK)
+		blks = USB_MAX_XFER_BLK;
+	return blks ? blks : 1;
+}
+
+static void usb_stor_show_stats(int device)
+{
+	struct usb_stor_stats *stats = &usb_stor_stats[device];
+
+	printf("            Read: %llu bytes in %lu ms with %lu commands",
+	       stats->bytes, stats->ms, stats->cmds);
+	if (stats->ms > 0) {
+		puts(" (");
+		print_size(lldiv(stats->bytes * 1000, stats->ms), "/s");
+		puts(")");
+	}
+	puts("\n");
+}
+
 /*******************************************************************************
  * show info on storage devices; 'usb start/init' must be invoked earlier
  * as we only retrieve structures populated during devices initialization
@@ -184,6 +215,8 @@ int usb_stor_info(void)
 		for (i = 0; i < usb_max_devs; i++) {
 			printf("  Device %d: ", i);
 			dev_print(&usb_dev_desc[i]);
+			if (usb_stor_stats[i].cmds)
+				usb_stor_show_stats(i);
 		}
 		return 0;
 	}
@@ -232,6 +265,7 @@ int usb_stor_scan(int mode)
 		usb_dev_desc[i].block_read = usb_stor_read;
 		usb_dev_desc[i].block_write = usb_stor_write;
 	}
+	memset(usb_stor_stats, 0, sizeof(usb_stor_stats));
 
 	usb_max_devs = 0;
 	for (i = 0; i < USB_MAX_DEVICE; i++) {
@@ -688,8 +722,24 @@ static int usb_stor_BBB_transport(ccb *srb, struct us_data *us)
 		pipe = pipein;
 	else
 		pipe = pipeout;
-	result = usb_bulk_msg(us->pusb_dev, pipe, srb->pdata, srb->datalen,
-			      &data_actlen, USB_CNTL_TIMEOUT * 5);
+	result = -ENOSYS;
+	if (dir_in) {
+		/*
+		 * If the host can, queue the STATUS phase behind the data so
+		 * that it doesn't wait for another round trip. A stall in
+		 * either phase is handled below and the CSW read again.
+		 */
+		result = usb_bulk_msg_pair(us->pusb_dev, pipe, srb->pdata,
+					   srb->datalen, &data_actlen, csw,
+					   UMASS_BBB_CSW_SIZE, &actlen,
+					   USB_CNTL_TIMEOUT * 5);
+		if (result == 0)
+			goto check_csw;
+	}
+	if (result == -ENOSYS)
+		result = usb_bulk_msg(us->pusb_dev, pipe, srb->pdata,
+				      srb->datalen, &data_actlen,
+				      USB_CNTL_TIMEOUT * 5);
 	/* special handling of STALL in DATA phase */
 	if ((result < 0) && (us->pusb_dev->status & USB_ST_STALLED)) {
 		debug("DATA:stall\n");
@@ -735,6 +785,7 @@ again:
 		usb_stor_BBB_reset(us);
 		return USB_STOR_TRANSPORT_FAILED;
 	}
+check_csw:
 #ifdef BBB_XPORT_TRACE
 	ptr = (unsigned char *)csw;
 	for (index = 0; index < UMASS_BBB_CSW_SIZE; index++)
@@ -1042,11 +1093,12 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks, max_xfer_blk;
 	struct usb_device *dev;
 	struct us_data *ss;
 	int retry, i;
 	ccb *srb = &usb_ccb;
+	ulong ts;
 
 	if (blkcnt == 0)
 		return 0;
@@ -1069,6 +1121,8 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 	buf_addr = (unsigned long)buffer;
 	start = blknr;
 	blks = blkcnt;
+	max_xfer_blk = usb_stor_max_xfer_blk(dev, &usb_dev_desc[device]);
+	ts = get_timer(0);
 
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF
 	      " buffer %lx\n", device, start, blks, buf_addr);
@@ -1077,15 +1131,16 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > max_xfer_blk)
+			smallblks = max_xfer_blk;
 		else
 			smallblks = (unsigned short) blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == max_xfer_blk)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
+		usb_stor_stats[device].cmds++;
 		if (usb_read_10(srb, ss, start, smallblks)) {
 			debug("Read ERROR\n");
 			usb_request_sense(srb, ss);
@@ -1099,13 +1154,16 @@ retry_it:
 		buf_addr += srb->datalen;
 	} while (blks != 0);
 	ss->flags &= ~USB_READY;
+	usb_stor_stats[device].bytes +=
+		(unsigned long long)blkcnt * usb_dev_desc[device].blksz;
+	usb_stor_stats[device].ms += get_timer(ts);
 
 	debug("usb_read: end startblk " LBAF
 	      ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= max_xfer_blk)
 		debug("\n");
 	return blkcnt;
 }
@@ -1115,7 +1173,7 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks, max_xfer_blk;
 	struct usb_device *dev;
 	struct us_data *ss;
 	int retry, i;
@@ -1143,6 +1201,7 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 	buf_addr = (unsigned long)buffer;
 	start = blknr;
 	blks = blkcnt;
+	max_xfer_blk = usb_stor_max_xfer_blk(dev, &usb_dev_desc[device]);
 
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF
 	      " buffer %lx\n", device, start, blks, buf_addr);
@@ -1153,12 +1212,12 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 		 */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > max_xfer_blk)
+			smallblks = max_xfer_blk;
 		else
 			smallblks = (unsigned short) blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == max_xfer_blk)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1180,7 +1239,7 @@ retry_it:
 	      start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= max_xfer_blk)
 		debug("\n");
 	return blkcnt;
 
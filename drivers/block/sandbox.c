@@ -37,6 +37,9 @@ static unsigned long host_block_read(int dev, unsigned long start,
 	}
 	ssize_t len = os_read(host_dev->fd, buffer,
 			      blkcnt * host_dev->blk_dev.blksz);
+	host_dev->read_calls++;
+	if (len >= 0)
+		host_dev->read_blocks += len / host_dev->blk_dev.blksz;
 	if (len >= 0)
 		return len / host_dev->blk_dev.blksz;
 	return -1;
@@ -54,6 +57,9 @@ static unsigned long host_block_write(int dev, unsigned long start,
 	}
 	ssize_t len = os_write(host_dev->fd, buffer, blkcnt *
 			       host_dev->blk_dev.blksz);
+	host_dev->write_calls++;
+	if (len >= 0)
+		host_dev->write_blocks += len / host_dev->blk_dev.blksz;
 	if (len >= 0)
 		return len / host_dev->blk_dev.blksz;
 	return -1;
@@ -85,6 +91,11 @@ int host_dev_bind(int dev, char *filename)
 		return 1;
 	}
 
+	host_dev->read_calls = 0;
+	host_dev->read_blocks = 0;
+	host_dev->write_calls = 0;
+	host_dev->write_blocks = 0;
+
 	block_dev_desc_t *blk_dev = &host_dev->blk_dev;
 	blk_dev->if_type = IF_TYPE_HOST;
 	blk_dev->priv = host_dev;
@@ -9,6 +9,7 @@
 
 #include <common.h>
 #include <errno.h>
+#include <malloc.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -18,6 +19,8 @@
 #include <fdtdec.h>
 #include <linux/compiler.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 struct driver *lists_driver_lookup_name(const char *name)
 {
 	struct driver *drv =
@@ -111,54 +114,231 @@ static int driver_check_compatible(const void *blob, int offset,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
-		   struct udevice **devp)
+/*
+ * Index of driver compatible strings, hashed with open addressing. Each slot
+ * holds the position of the driver in the linker list and of the string in
+ * its of_match list, which keeps the table small.
+ */
+struct dm_compat_slot {
+	u16 drv;
+	u16 match;
+};
+
+#define DM_COMPAT_EMPTY		0xffff
+
+struct dm_compat_index {
+	struct driver *driver;		/* Start of driver linker list */
+	uint mask;			/* Number of slots - 1 */
+	struct dm_compat_slot slot[0];
+};
+
+static uint compat_hash(const char *str, int len)
+{
+	uint hash = 5381;
+
+	while (len--)
+		hash = hash * 33 + *str++;
+
+	return hash;
+}
+
+/**
+ * compat_find_slot() - Find the slot for a compatible string
+ *
+ * @idx:	Index to search
+ * @str:	Compatible string (need not be nul-terminated)
+ * @len:	Length of @str
+ * @return the slot holding @str, or the empty slot where it would go
+ */
+static struct dm_compat_slot *compat_find_slot(struct dm_compat_index *idx,
+					       const char *str, int len)
+{
+	struct dm_compat_slot *slot;
+	struct driver *entry;
+	const char *compat;
+	uint i;
+
+	for (i = compat_hash(str, len) & idx->mask;; i = (i + 1) & idx->mask) {
+		slot = &idx->slot[i];
+		if (slot->drv == DM_COMPAT_EMPTY)
+			return slot;
+		entry = idx->driver + slot->drv;
+		compat = entry->of_match[slot->match].compatible;
+		if (!strncmp(compat, str, len) && !compat[len])
+			return slot;
+	}
+}
+
+void lists_init(void)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *of_match;
+	struct dm_compat_index *idx;
+	struct dm_compat_slot *slot;
 	struct driver *entry;
-	struct udevice *dev;
-	bool found = false;
-	const char *name;
-	int result = 0;
-	int ret = 0;
+	const char *compat;
+	int count = 0;
+	uint size;
+	int j;
 
-	dm_dbg("bind node %s\n", fdt_get_name(blob, offset, NULL));
-	if (devp)
-		*devp = NULL;
+	DM_COMPAT_NON_CONST = NULL;
+	if (n_ents >= DM_COMPAT_EMPTY)
+		return;
 	for (entry = driver; entry != driver + n_ents; entry++) {
-		ret = driver_check_compatible(blob, offset, entry->of_match);
-		name = fdt_get_name(blob, offset, NULL);
-		if (ret == -ENOENT) {
-			continue;
-		} else if (ret == -ENODEV) {
-			dm_dbg("Device '%s' has no compatible string\n", name);
-			break;
-		} else if (ret) {
-			dm_warn("Device tree error at offset %d\n", offset);
-			if (!result || ret != -ENOENT)
-				result = ret;
-			break;
+		for (of_match = entry->of_match;
+		     of_match && of_match->compatible; of_match++)
+			count++;
+	}
+
+	/* Keep the table at most half full so that probe chains stay short */
+	for (size = 1; size < count * 2; size <<= 1)
+		;
+	idx = malloc(sizeof(*idx) + size * sizeof(idx->slot[0]));
+	if (!idx) {
+		dm_warn("No memory for driver index, binding will be slow\n");
+		return;
+	}
+	idx->driver = driver;
+	idx->mask = size - 1;
+	memset(idx->slot, 0xff, size * sizeof(idx->slot[0]));
+
+	/*
+	 * Where drivers share a string, the first in the linker list wins, as
+	 * it would when checking each driver in turn
+	 */
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		of_match = entry->of_match;
+		for (j = 0; of_match && of_match[j].compatible; j++) {
+			compat = of_match[j].compatible;
+			slot = compat_find_slot(idx, compat, strlen(compat));
+			if (slot->drv == DM_COMPAT_EMPTY) {
+				slot->drv = entry - driver;
+				slot->match = j;
+			}
 		}
+	}
+	DM_COMPAT_NON_CONST = idx;
+}
+
+void lists_uninit(void)
+{
+	free(DM_COMPAT_NON_CONST);
+	DM_COMPAT_NON_CONST = NULL;
+}
+
+/**
+ * lists_lookup_fdt() - Find the driver for a node using the index
+ *
+ * Of all the drivers matching one of the node's compatible strings, this
+ * picks the first in the linker list, like lists_scan_fdt().
+ *
+ * @idx:	Index set up by lists_init()
+ * @blob:	Device tree pointer
+ * @offset:	Offset of node in device tree
+ * @drvp:	Returns the driver found
+ * @return 0 if found, -ENOENT if no match, -ENODEV if the node does not
+ * have a compatible string, -EINVAL if there is a device tree error
+ */
+static int lists_lookup_fdt(struct dm_compat_index *idx, const void *blob,
+			    int offset, struct driver **drvp)
+{
+	struct dm_compat_slot *slot;
+	struct driver *best = NULL;
+	const char *list, *end;
+	int len;
+
+	list = fdt_getprop(blob, offset, "compatible", &len);
+	if (!list)
+		return len == -FDT_ERR_NOTFOUND ? -ENODEV : -EINVAL;
+
+	for (end = list + len; list < end; list += len + 1) {
+		len = strnlen(list, end - list);
+		slot = compat_find_slot(idx, list, len);
+		if (slot->drv != DM_COMPAT_EMPTY &&
+		    (!best || idx->driver + slot->drv < best))
+			best = idx->driver + slot->drv;
+	}
+	if (!best)
+		return -ENOENT;
+	*drvp = best;
+
+	return 0;
+}
+
+/**
+ * lists_scan_fdt() - Find the driver for a node by checking each driver
+ *
+ * @blob:	Device tree pointer
+ * @offset:	Offset of node in device tree
+ * @drvp:	Returns the driver found
+ * @return 0 if found, -ENOENT if no match, -ENODEV if the node does not
+ * have a compatible string, -EINVAL if there is a device tree error
+ */
+static int lists_scan_fdt(const void *blob, int offset, struct driver **drvp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+	int ret;
 
-		dm_dbg("   - found match at '%s'\n", entry->name);
-		ret = device_bind(parent, entry, name, NULL, offset, &dev);
-		if (ret) {
-			dm_warn("Error binding driver '%s'\n", entry->name);
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		ret = driver_check_compatible(blob, offset, entry->of_match);
+		if (ret != -ENOENT) {
+			if (!ret)
+				*drvp = entry;
 			return ret;
-		} else {
-			found = true;
-			if (devp)
-				*devp = dev;
 		}
-		break;
 	}
 
-	if (!found && !result && ret != -ENODEV) {
-		dm_dbg("No match for node '%s'\n",
-		       fdt_get_name(blob, offset, NULL));
+	return -ENOENT;
+}
+
+int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
+		   struct udevice **devp)
+{
+	struct driver *entry;
+	struct udevice *dev;
+	const char *name;
+	int ret;
+
+	name = fdt_get_name(blob, offset, NULL);
+	dm_dbg("bind node %s\n", name);
+	if (devp)
+		*devp = NULL;
+
+	if (gd->dm_compat)
+		ret = lists_lookup_fdt(gd->dm_compat, blob, offset, &entry);
+	else
+		ret = lists_scan_fdt(blob, offset, &entry);
+	if (ret == -ENOENT) {
+		dm_dbg("No match for node '%s'\n", name);
+		return 0;
+	} else if (ret == -ENODEV) {
+		dm_dbg("Device '%s' has no compatible string\n", name);
+		return 0;
+	} else if (ret) {
+		dm_warn("Device tree error at offset %d\n", offset);
+		return ret;
 	}
 
-	return result;
+	dm_dbg("   - found match at '%s'\n", entry->name);
+	ret = device_bind(parent, entry, name, NULL, offset, &dev);
+	if (ret) {
+		dm_warn("Error binding driver '%s'\n", entry->name);
+		return ret;
+	}
+	if (devp)
+		*devp = dev;
+
+	return 0;
+}
+#else
+void lists_init(void)
+{
+}
+
+void lists_uninit(void)
+{
 }
 #endif
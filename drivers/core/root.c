@@ -46,6 +46,16 @@ int dm_init(void)
 	}
 	INIT_LIST_HEAD(&DM_UCLASS_ROOT_NON_CONST);
 
+	/*
+	 * Anything allocated before relocation is left behind, so these are
+	 * always created afresh
+	 */
+	DM_UCLASS_TABLE_NON_CONST = calloc(UCLASS_COUNT,
+					   sizeof(struct uclass *));
+	if (!DM_UCLASS_TABLE_NON_CONST)
+		return -ENOMEM;
+	lists_init();
+
 	ret = device_bind_by_name(NULL, false, &root_info, &DM_ROOT_NON_CONST);
 	if (ret)
 		return ret;
@@ -60,6 +70,9 @@ int dm_uninit(void)
 {
 	device_remove(dm_root());
 	device_unbind(dm_root());
+	lists_uninit();
+	free(DM_UCLASS_TABLE_NON_CONST);
+	DM_UCLASS_TABLE_NON_CONST = NULL;
 
 	return 0;
 }
@@ -21,21 +21,10 @@ DECLARE_GLOBAL_DATA_PTR;
 
 struct uclass *uclass_find(enum uclass_id key)
 {
-	struct uclass *uc;
-
-	if (!gd->dm_root)
+	if (!gd->dm_root || key < 0 || key >= UCLASS_COUNT)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
-	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
-		if (uc->uc_drv->id == key)
-			return uc;
-	}
 
-	return NULL;
+	return gd->uclass_table[key];
 }
 
 /**
@@ -74,6 +63,7 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, &DM_UCLASS_ROOT_NON_CONST);
+	DM_UCLASS_TABLE_NON_CONST[id] = uc;
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -90,6 +80,7 @@ fail:
 		uc->priv = NULL;
 	}
 	list_del(&uc->sibling_node);
+	DM_UCLASS_TABLE_NON_CONST[id] = NULL;
 fail_mem:
 	free(uc);
 
@@ -115,6 +106,7 @@ int uclass_destroy(struct uclass *uc)
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
 	list_del(&uc->sibling_node);
+	DM_UCLASS_TABLE_NON_CONST[uc_drv->id] = NULL;
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
 	free(uc);
@@ -7,6 +7,10 @@
 #include <common.h>
 #include "ace_sha.h"
 
+#ifdef CONFIG_SHA_PROG_HW_ACCEL
+#error "ACE only hashes whole buffers, disable CONFIG_SHA_PROG_HW_ACCEL"
+#endif
+
 #ifdef CONFIG_SHA_HW_ACCEL
 #include <u-boot/sha256.h>
 #include <u-boot/sha1.h>
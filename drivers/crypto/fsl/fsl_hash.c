@@ -7,6 +7,10 @@
 
 #include <common.h>
 #include <malloc.h>
+#include <fsl_sec.h>
+#include <hash.h>
+#include <hw_sha.h>
+#include <asm/errno.h>
 #include "jobdesc.h"
 #include "desc.h"
 #include "jr.h"
@@ -75,3 +79,110 @@ void hw_sha1(const unsigned char *pbuf, unsigned int buf_len,
 	if (caam_hash(pbuf, buf_len, pout, SHA1))
 		printf("CAAM was not setup properly or it is faulty\n");
 }
+
+#ifdef CONFIG_SHA_PROG_HW_ACCEL
+/*
+ * Progressive hashing collects the buffers in a scatter/gather table and
+ * hashes them all with a single job in hw_sha_finish(). A buffer which
+ * follows the previous one in memory extends its entry, so hashing an image
+ * a chunk at a time takes a single entry.
+ */
+#define MAX_SG_32	128
+
+struct sha_ctx {
+	struct sg_entry sg_tbl[MAX_SG_32];
+	u32 hash[SHA256_DIGEST_SIZE / 4];
+	uint32_t sha_desc[MAX_CAAM_DESCSIZE];
+	enum caam_hash_algos algo;
+	unsigned int sg_num;
+	uint32_t len;		/* Total length of the buffers */
+	uint32_t last_len;	/* Length of the last entry */
+	const u8 *next;		/* End of the last buffer */
+};
+
+int hw_sha_init(struct hash_algo *algo, void **ctxp)
+{
+	struct sha_ctx *ctx;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		debug("Cannot allocate memory for context\n");
+		return -ENOMEM;
+	}
+	ctx->algo = strcmp(algo->name, "sha1") ? SHA256 : SHA1;
+	*ctxp = ctx;
+
+	return 0;
+}
+
+int hw_sha_update(struct hash_algo *algo, void *hash_ctx, const void *buf,
+		  unsigned int size, int is_last)
+{
+	struct sha_ctx *ctx = hash_ctx;
+	struct sg_entry *sg;
+	dma_addr_t addr;
+
+	if (ctx->sg_num && buf == ctx->next &&
+	    ctx->last_len + size <= SG_ENTRY_LENGTH_MASK) {
+		sg = &ctx->sg_tbl[ctx->sg_num - 1];
+		ctx->last_len += size;
+	} else {
+		if (ctx->sg_num == MAX_SG_32) {
+			debug("Too many buffers for the scatter/gather table\n");
+			free(ctx);
+			return -EINVAL;
+		}
+		sg = &ctx->sg_tbl[ctx->sg_num++];
+		ctx->last_len = size;
+
+		addr = virt_to_phys((void *)buf);
+#ifdef CONFIG_PHYS_64BIT
+		sec_out32(&sg->addr_hi, (uint32_t)(addr >> 32));
+#else
+		sec_out32(&sg->addr_hi, 0x0);
+#endif
+		sec_out32(&sg->addr_lo, (uint32_t)addr);
+	}
+	sec_out32(&sg->len_flag, ctx->last_len);
+	ctx->next = (const u8 *)buf + size;
+	ctx->len += size;
+
+	return 0;
+}
+
+int hw_sha_finish(struct hash_algo *algo, void *hash_ctx, void *dest_buf,
+		  int size)
+{
+	struct sha_ctx *ctx = hash_ctx;
+	unsigned int digestsize = driver_hash[ctx->algo].digestsize;
+	int ret;
+
+	if (size < digestsize) {
+		free(ctx);
+		return -EINVAL;
+	}
+
+	if (!ctx->sg_num) {
+		/* Nothing to gather, hash the empty message */
+		ret = caam_hash((const unsigned char *)ctx->hash, 0,
+				(unsigned char *)ctx->hash, ctx->algo);
+	} else {
+		sec_out32(&ctx->sg_tbl[ctx->sg_num - 1].len_flag,
+			  ctx->last_len | SG_ENTRY_FINAL_BIT);
+		inline_cnstr_jobdesc_hash(ctx->sha_desc,
+					  (uint8_t *)ctx->sg_tbl, ctx->len,
+					  (uint8_t *)ctx->hash,
+					  driver_hash[ctx->algo].alg_type,
+					  digestsize, 1);
+		ret = run_descriptor_jr(ctx->sha_desc);
+	}
+
+	if (ret)
+		debug("Error %x\n", ret);
+	else
+		memcpy(dest_buf, ctx->hash, digestsize);
+
+	free(ctx);
+	return ret;
+}
+#endif /* CONFIG_SHA_PROG_HW_ACCEL */
@@ -14,6 +14,7 @@
 #include <fat.h>
 #include <dfu.h>
 #include <hash.h>
+#include <div64.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
 
@@ -90,11 +91,30 @@ int dfu_init_env_entities(char *interface, char *devstr)
 
 static unsigned char *dfu_buf;
 static unsigned long dfu_buf_size = CONFIG_SYS_DFU_DATA_BUF_SIZE;
+static int dfu_buf_count = 1;
+
+/*
+ * With write-behind, dfu_buf holds a ring of dfu_buf_count buffers. When
+ * dfu_write() has filled one it is queued here and the next one is filled,
+ * while dfu_write_pending() writes the queued data to the medium a piece at
+ * a time from the loop that services the USB gadget. dfu_write() only
+ * writes synchronously when the whole ring is full.
+ */
+static bool dfu_write_behind;
+static struct {
+	u8 *buf;	/* Data still to be written */
+	long len;	/* and its length */
+} dfu_pending[CONFIG_SYS_DFU_DATA_BUF_COUNT];
+static int dfu_pending_first;	/* Oldest queued buffer */
+static int dfu_pending_cnt;	/* Number of queued buffers */
+static int dfu_pending_ret;	/* Error of a background write */
+static struct dfu_entity *dfu_pending_dfu;
 
 unsigned char *dfu_free_buf(void)
 {
 	free(dfu_buf);
 	dfu_buf = NULL;
+	dfu_pending_cnt = 0;
 	return dfu_buf;
 }
 
@@ -116,14 +136,35 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	if (dfu->max_buf_size && dfu_buf_size > dfu->max_buf_size)
 		dfu_buf_size = dfu->max_buf_size;
 
-	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
-	if (dfu_buf == NULL)
+	dfu_buf_count = 1;
+	if (dfu_write_behind) {
+		s = getenv("dfu_bufcnt");
+		dfu_buf_count = s ? simple_strtol(s, NULL, 10) :
+				CONFIG_SYS_DFU_DATA_BUF_COUNT;
+		dfu_buf_count = max(1, min(dfu_buf_count,
+					   CONFIG_SYS_DFU_DATA_BUF_COUNT));
+	}
+
+	/* Fewer buffers will do if memory is short */
+	do {
+		dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+				   dfu_buf_size * dfu_buf_count);
+	} while (dfu_buf == NULL && --dfu_buf_count);
+
+	if (dfu_buf == NULL) {
+		dfu_buf_count = 1;
 		printf("%s: Could not memalign 0x%lx bytes\n",
 		       __func__, dfu_buf_size);
+	}
 
 	return dfu_buf;
 }
 
+void dfu_set_write_behind(bool enable)
+{
+	dfu_write_behind = enable;
+}
+
 static char *dfu_get_hash_algo(void)
 {
 	char *s;
@@ -141,39 +182,99 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
-static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+/* Write up to 'max' bytes of the oldest queued buffer, all of it if 0 */
+static int dfu_write_buffer_drain(struct dfu_entity *dfu, long max)
+{
+	int slot = dfu_pending_first;
+	long w_size = dfu_pending[slot].len;
+	ulong start;
+	int ret;
+
+	if (max && w_size > max)
+		w_size = max;
+
+	start = get_timer(0);
+	ret = dfu->write_medium(dfu, dfu->offset, dfu_pending[slot].buf,
+				&w_size);
+	dfu->write_time += get_timer(start);
+	if (ret) {
+		debug("%s: Write error!\n", __func__);
+		return ret;
+	}
+
+	/* update offset */
+	dfu->offset += w_size;
+
+	/* the medium may have rounded the last piece up */
+	dfu_pending[slot].buf += w_size;
+	dfu_pending[slot].len -= w_size;
+	if (dfu_pending[slot].len <= 0) {
+		dfu_pending_first = (slot + 1) % dfu_buf_count;
+		dfu_pending_cnt--;
+		puts("#");
+	}
+
+	return 0;
+}
+
+/* Queue the buffer being filled and go on with the next one of the ring */
+static int dfu_write_buffer_queue(struct dfu_entity *dfu)
 {
-	long w_size;
+	int slot = (dfu_pending_first + dfu_pending_cnt) % dfu_buf_count;
 	int ret;
 
 	/* flush size? */
-	w_size = dfu->i_buf - dfu->i_buf_start;
-	if (w_size == 0)
+	if (dfu->i_buf == dfu->i_buf_start)
 		return 0;
 
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
+	dfu_pending[slot].buf = dfu->i_buf_start;
+	dfu_pending[slot].len = dfu->i_buf - dfu->i_buf_start;
+	dfu_pending_cnt++;
+	dfu_pending_dfu = dfu;
 
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
-	if (ret)
-		debug("%s: Write error!\n", __func__);
+	/* the next buffer must be free before it is filled */
+	while (dfu_pending_cnt == dfu_buf_count) {
+		ret = dfu_write_buffer_drain(dfu, 0);
+		if (ret)
+			return ret;
+	}
 
-	/* point back */
+	slot = (slot + 1) % dfu_buf_count;
+	dfu->i_buf_start = dfu_buf + slot * dfu_buf_size;
+	dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
 	dfu->i_buf = dfu->i_buf_start;
 
-	/* update offset */
-	dfu->offset += w_size;
+	return 0;
+}
 
-	puts("#");
+int dfu_write_pending(void)
+{
+	struct dfu_entity *dfu = dfu_pending_dfu;
 
-	return ret;
+	if (!dfu_pending_cnt || dfu_pending_ret)
+		return dfu_pending_ret;
+
+	dfu_pending_ret = dfu_write_buffer_drain(dfu, dfu->write_size);
+
+	return dfu_pending_ret;
+}
+
+static void dfu_show_stats(struct dfu_entity *dfu)
+{
+	ulong time = max(get_timer(dfu->start_time), 1UL);
+
+	printf("DFU %s (alt %d): %llu bytes in %lu ms, %llu KiB/s, medium busy %lu ms\n",
+	       dfu->name, dfu->alt, dfu->received, time,
+	       lldiv(dfu->received, time) * 1000 / 1024, dfu->write_time);
 }
 
 void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
 {
 	/* clear everything */
 	dfu_free_buf();
+	dfu_pending_first = 0;
+	dfu_pending_ret = 0;
+	dfu_pending_dfu = NULL;
 	dfu->crc = 0;
 	dfu->offset = 0;
 	dfu->i_blk_seq_num = 0;
@@ -187,7 +288,11 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
 	int ret = 0;
 
-	ret = dfu_write_buffer_drain(dfu);
+	ret = dfu_pending_ret;
+	if (!ret)
+		ret = dfu_write_buffer_queue(dfu);
+	while (!ret && dfu_pending_cnt)
+		ret = dfu_write_buffer_drain(dfu, 0);
 	if (ret)
 		return ret;
 
@@ -197,6 +302,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	if (dfu_hash_algo)
 		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
 		       dfu->crc);
+	dfu_show_stats(dfu);
 
 	dfu_write_transaction_cleanup(dfu);
 
@@ -222,10 +328,24 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 			return -ENOMEM;
 		dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
 		dfu->i_buf = dfu->i_buf_start;
+		dfu->received = 0;
+		dfu->write_time = 0;
+		dfu->start_time = get_timer(0);
+
+		/* drop what an aborted transfer left behind */
+		dfu_pending_first = 0;
+		dfu_pending_cnt = 0;
+		dfu_pending_ret = 0;
 
 		dfu->inited = 1;
 	}
 
+	if (dfu_pending_ret) {
+		ret = dfu_pending_ret;
+		dfu_write_transaction_cleanup(dfu);
+		return ret;
+	}
+
 	if (dfu->i_blk_seq_num != blk_seq_num) {
 		printf("%s: Wrong sequence number! [%d] [%d]\n",
 		       __func__, dfu->i_blk_seq_num, blk_seq_num);
@@ -251,7 +371,7 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_queue(dfu);
 		if (ret) {
 			dfu_write_transaction_cleanup(dfu);
 			return ret;
@@ -268,10 +388,16 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	memcpy(dfu->i_buf, buf, size);
 	dfu->i_buf += size;
+	dfu->received += size;
+
+	/* hash the data while it is still in the cache */
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc, buf,
+					   size, 0);
 
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_queue(dfu);
 		if (ret) {
 			dfu_write_transaction_cleanup(dfu);
 			return ret;
@@ -422,6 +548,7 @@ static int dfu_fill_entity(struct dfu_entity *dfu, char *s, int alt,
 
 	dfu->alt = alt;
 	dfu->max_buf_size = 0;
+	dfu->write_size = 0;
 	dfu->free_entity = NULL;
 
 	/* Specific for mmc device */
@@ -460,6 +587,10 @@ void dfu_free_entities(void)
 		free(t);
 	INIT_LIST_HEAD(&dfu_list);
 
+	/* and whatever an aborted transfer left queued for them */
+	dfu_free_buf();
+	dfu_pending_dfu = NULL;
+
 	alt_num_cnt = 0;
 }
 
@@ -358,6 +358,10 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 		dfu->data.mmc.part = third_arg;
 	}
 
+	/* files are only copied to dfu_file_buf until the flush */
+	if (dfu->layout == DFU_RAW_ADDR)
+		dfu->write_size = CONFIG_SYS_DFU_WRITE_SIZE;
+
 	dfu->dev_type = DFU_DEV_MMC;
 	dfu->get_medium_size = dfu_get_medium_size_mmc;
 	dfu->read_medium = dfu_read_medium_mmc;
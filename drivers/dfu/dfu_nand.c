@@ -224,6 +224,13 @@ int dfu_fill_entity_nand(struct dfu_entity *dfu, char *devstr, char *s)
 		return -1;
 	}
 
+	/* each write erases what it covers, so write whole blocks */
+	if (nand_curr_device >= 0 &&
+	    nand_curr_device < CONFIG_SYS_MAX_NAND_DEVICE &&
+	    nand_info[nand_curr_device].name)
+		dfu->write_size = roundup(CONFIG_SYS_DFU_WRITE_SIZE,
+				nand_info[nand_curr_device].erasesize);
+
 	dfu->get_medium_size = dfu_get_medium_size_nand;
 	dfu->read_medium = dfu_read_medium_nand;
 	dfu->write_medium = dfu_write_medium_nand;
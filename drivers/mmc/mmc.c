@@ -158,15 +158,23 @@ int mmc_send_status(struct mmc *mmc, int timeout)
 int mmc_set_blocklen(struct mmc *mmc, int len)
 {
 	struct mmc_cmd cmd;
+	int err;
 
 	if (mmc->card_caps & MMC_MODE_DDR_52MHz)
 		return 0;
 
+	/* The card keeps the length until it is reset */
+	if (mmc->blocklen == len)
+		return 0;
+
 	cmd.cmdidx = MMC_CMD_SET_BLOCKLEN;
 	cmd.resp_type = MMC_RSP_R1;
 	cmd.cmdarg = len;
 
-	return mmc_send_cmd(mmc, &cmd, NULL);
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+	mmc->blocklen = err ? 0 : len;
+
+	return err;
 }
 
 struct mmc *find_mmc_device(int dev_num)
@@ -188,33 +196,51 @@ struct mmc *find_mmc_device(int dev_num)
 	return NULL;
 }
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
-			   lbaint_t blkcnt)
+static void mmc_prepare_read(struct mmc *mmc, struct mmc_read_req *req,
+			     void *dst, lbaint_t start, lbaint_t blkcnt)
 {
-	struct mmc_cmd cmd;
-	struct mmc_data data;
+	struct mmc_cmd *cmd = &req->cmd;
+	struct mmc_data *data = &req->data;
+
+	req->sbc.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	req->sbc.cmdarg = blkcnt;
+	req->sbc.resp_type = MMC_RSP_R1;
 
 	if (blkcnt > 1)
-		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		cmd->cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->read_bl_len;
+		cmd->cmdarg = start * mmc->read_bl_len;
 
-	cmd.resp_type = MMC_RSP_R1;
+	cmd->resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	data->dest = dst;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
+
+static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct mmc_read_req req;
+	struct mmc_cmd cmd;
+	int sbc = blkcnt > 1 && (mmc->card_caps & MMC_MODE_CMD23);
 
-	if (mmc_send_cmd(mmc, &cmd, &data))
+	mmc_prepare_read(mmc, &req, dst, start, blkcnt);
+
+	/* With the block count set up front, the card stops by itself */
+	if (sbc && mmc_send_cmd(mmc, &req.sbc, NULL))
 		return 0;
 
-	if (blkcnt > 1) {
+	if (mmc_send_cmd(mmc, &req.cmd, &req.data))
+		return 0;
+
+	if (blkcnt > 1 && !sbc) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -229,9 +255,45 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 	return blkcnt;
 }
 
-static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
+/*
+ * Keep the host supplied with reads so that it can set up the next one while
+ * the current one is transferring. Reads complete in the order queued.
+ */
+static lbaint_t mmc_read_queued(struct mmc *mmc, void *dst, lbaint_t start,
+				lbaint_t blkcnt, lbaint_t max)
 {
+	const struct mmc_ops *ops = mmc->cfg->ops;
+	struct mmc_read_req req[MMC_READ_QUEUE_DEPTH];
 	lbaint_t cur, blocks_todo = blkcnt;
+	int next = 0, queued = 0;
+	int err = 0;
+
+	while ((blocks_todo && !err) || queued) {
+		if (blocks_todo && !err && queued < MMC_READ_QUEUE_DEPTH) {
+			cur = min(blocks_todo, max);
+			mmc_prepare_read(mmc, &req[next], dst, start, cur);
+			err = ops->queue_read(mmc, &req[next]);
+			if (err)
+				continue;
+			next = (next + 1) % MMC_READ_QUEUE_DEPTH;
+			queued++;
+			blocks_todo -= cur;
+			start += cur;
+			dst += cur * mmc->read_bl_len;
+		} else {
+			/* On error, still wait for everything queued */
+			if (ops->wait_read(mmc) && !err)
+				err = -EIO;
+			queued--;
+		}
+	}
+
+	return err ? 0 : blkcnt;
+}
+
+static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
+{
+	lbaint_t cur, max, blocks_todo = blkcnt;
 
 	if (blkcnt == 0)
 		return 0;
@@ -251,9 +313,16 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len))
 		return 0;
 
+	/* CMD23 has a 16-bit block count */
+	max = mmc->cfg->b_max;
+	if (mmc->card_caps & MMC_MODE_CMD23) {
+		max = min(max, (lbaint_t)0xffff);
+		if (mmc->cfg->ops->queue_read)
+			return mmc_read_queued(mmc, dst, start, blkcnt, max);
+	}
+
 	do {
-		cur = (blocks_todo > mmc->cfg->b_max) ?
-			mmc->cfg->b_max : blocks_todo;
+		cur = (blocks_todo > max) ? max : blocks_todo;
 		if(mmc_read_blocks(mmc, dst, start, cur) != cur)
 			return 0;
 		blocks_todo -= cur;
@@ -274,6 +343,7 @@ static int mmc_go_idle(struct mmc *mmc)
 	cmd.cmdidx = MMC_CMD_GO_IDLE_STATE;
 	cmd.cmdarg = 0;
 	cmd.resp_type = MMC_RSP_NONE;
+	mmc->blocklen = 0;
 
 	err = mmc_send_cmd(mmc, &cmd, NULL);
 
@@ -491,6 +561,10 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (mmc_host_is_spi(mmc))
 		return 0;
 
+	/* Set block count was added in version 3.1 */
+	if (mmc->version >= MMC_VERSION_3)
+		mmc->card_caps |= MMC_MODE_CMD23;
+
 	/* Only version 4 supports high-speed */
 	if (mmc->version < MMC_VERSION_4)
 		return 0;
@@ -710,6 +784,9 @@ retry_scr:
 	if (mmc->scr[0] & SD_DATA_4BIT)
 		mmc->card_caps |= MMC_MODE_4BIT;
 
+	if (mmc->scr[0] & SD_CMD23_SUPPORT)
+		mmc->card_caps |= MMC_MODE_CMD23;
+
 	/* Version 1.0 doesn't support switching */
 	if (mmc->version == SD_VERSION_1_0)
 		return 0;
@@ -0,0 +1,319 @@
+/*
+ * Emulated eMMC card for sandbox
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ *
+ * The card is held in host memory and the emulation works at the command
+ * level, so it checks the command sequence that the MMC core sends. For
+ * example a multi-block read without CMD23 must be followed by CMD12, and
+ * CMD12 is refused when the card is not sending data. Each command is
+ * counted, so that the cost of a read can be measured.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <mmc.h>
+#include <os.h>
+#include <sandboxmmc.h>
+#include <asm/unaligned.h>
+
+#ifndef CONFIG_SANDBOX_MMC_SIZE
+#define CONFIG_SANDBOX_MMC_SIZE	(64 << 20)
+#endif
+
+#define SANDBOX_MMC_BLOCKS	(CONFIG_SANDBOX_MMC_SIZE / MMC_MAX_BLOCK_LEN)
+
+/* Card states, as reported by CMD13 */
+#define STATE_IDLE	0
+#define STATE_READY	1
+#define STATE_IDENT	2
+#define STATE_STBY	3
+#define STATE_TRAN	4
+#define STATE_DATA	5
+#define STATE_RCV	6
+
+struct sandbox_mmc {
+	struct mmc_config cfg;
+	struct mmc *mmc;
+	u8 *data;
+	int state;
+	uint blocklen;
+	uint block_count;		/* Set by CMD23, 0 for open-ended */
+	uint erase_start;
+	uint erase_end;
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	struct mmc_read_req *queue[MMC_READ_QUEUE_DEPTH];
+	int queue_head;
+	int queue_len;
+	struct sandbox_mmc_stats stats;
+};
+
+static struct sandbox_mmc sandbox_mmc;
+
+static int sandbox_mmc_rw(struct sandbox_mmc *priv, struct mmc_cmd *cmd,
+			  struct mmc_data *data)
+{
+	bool multi = cmd->cmdidx == MMC_CMD_READ_MULTIPLE_BLOCK ||
+		cmd->cmdidx == MMC_CMD_WRITE_MULTIPLE_BLOCK;
+	uint blocks;
+
+	if (priv->state != STATE_TRAN || !data ||
+	    data->blocksize != priv->blocklen)
+		return COMM_ERR;
+	if (!multi && data->blocks != 1)
+		return COMM_ERR;
+	if (multi && priv->block_count && data->blocks != priv->block_count)
+		return COMM_ERR;
+	blocks = data->blocks;
+	if (cmd->cmdarg >= SANDBOX_MMC_BLOCKS ||
+	    blocks > SANDBOX_MMC_BLOCKS - cmd->cmdarg)
+		return COMM_ERR;
+
+	if (data->flags & MMC_DATA_READ) {
+		memcpy(data->dest, priv->data + cmd->cmdarg * MMC_MAX_BLOCK_LEN,
+		       blocks * MMC_MAX_BLOCK_LEN);
+		priv->stats.blocks_read += blocks;
+	} else {
+		memcpy(priv->data + cmd->cmdarg * MMC_MAX_BLOCK_LEN, data->src,
+		       blocks * MMC_MAX_BLOCK_LEN);
+		priv->stats.blocks_written += blocks;
+	}
+
+	/* An open-ended transfer carries on until CMD12 */
+	if (multi && !priv->block_count)
+		priv->state = data->flags & MMC_DATA_READ ? STATE_DATA :
+			STATE_RCV;
+	priv->block_count = 0;
+
+	return 0;
+}
+
+static int sandbox_mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+				struct mmc_data *data)
+{
+	struct sandbox_mmc *priv = mmc->priv;
+	u8 *ext_csd = priv->ext_csd;
+	uint index;
+
+	if (cmd->cmdidx < ARRAY_SIZE(priv->stats.cmds))
+		priv->stats.cmds[cmd->cmdidx]++;
+	if (cmd->resp_type & MMC_RSP_BUSY)
+		priv->stats.busy++;
+
+	memset(cmd->response, '\0', sizeof(cmd->response));
+	switch (cmd->cmdidx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		priv->state = STATE_IDLE;
+		priv->blocklen = MMC_MAX_BLOCK_LEN;
+		priv->block_count = 0;
+		ext_csd[EXT_CSD_PART_CONF] = 0;
+		ext_csd[EXT_CSD_BUS_WIDTH] = 0;
+		ext_csd[EXT_CSD_HS_TIMING] = 0;
+		break;
+	case MMC_CMD_SEND_OP_COND:
+		/* Powered up, sector addressing, 2.7-3.6V */
+		cmd->response[0] = OCR_BUSY | OCR_HCS | 0x00ff8000;
+		priv->state = STATE_READY;
+		break;
+	case MMC_CMD_ALL_SEND_CID:
+		cmd->response[0] = 0x15000053;	/* Manufacturer, "S" */
+		cmd->response[1] = 0x414e4442;	/* "ANDB" */
+		cmd->response[2] = 0x58101234;	/* "X", rev 1.0, serial */
+		cmd->response[3] = 0x56780000;
+		priv->state = STATE_IDENT;
+		break;
+	case MMC_CMD_SET_RELATIVE_ADDR:
+		priv->state = STATE_STBY;
+		break;
+	case MMC_CMD_SEND_CSD:
+		/* Version 4 and 26MHz, 512-byte blocks, size in 512KB units */
+		cmd->response[0] = 4 << 26 | 0x32;
+		cmd->response[1] = 9 << 16;
+		cmd->response[2] = (CONFIG_SANDBOX_MMC_SIZE / (512 << 10) - 1)
+			<< 16;
+		cmd->response[3] = 9 << 22;
+		break;
+	case MMC_CMD_SELECT_CARD:
+		priv->state = STATE_TRAN;
+		break;
+	case MMC_CMD_SEND_EXT_CSD:
+		/* This is SD_CMD_SEND_IF_COND when there is no data */
+		if (!data)
+			return TIMEOUT;
+		if (priv->state != STATE_TRAN)
+			return COMM_ERR;
+		memcpy(data->dest, ext_csd, MMC_MAX_BLOCK_LEN);
+		break;
+	case MMC_CMD_SWITCH:
+		index = (cmd->cmdarg >> 16) & 0xff;
+		if (index != EXT_CSD_PART_CONF && index != EXT_CSD_BUS_WIDTH &&
+		    index != EXT_CSD_HS_TIMING) {
+			cmd->response[0] = MMC_STATUS_SWITCH_ERROR;
+			break;
+		}
+		ext_csd[index] = (cmd->cmdarg >> 8) & 0xff;
+		break;
+	case MMC_CMD_STOP_TRANSMISSION:
+		if (priv->state != STATE_DATA && priv->state != STATE_RCV)
+			return COMM_ERR;
+		priv->state = STATE_TRAN;
+		break;
+	case MMC_CMD_SEND_STATUS:
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | priv->state << 9;
+		break;
+	case MMC_CMD_SET_BLOCKLEN:
+		if (cmd->cmdarg != MMC_MAX_BLOCK_LEN)
+			return COMM_ERR;
+		priv->blocklen = cmd->cmdarg;
+		break;
+	case MMC_CMD_SET_BLOCK_COUNT:
+		if (priv->state != STATE_TRAN || !(cmd->cmdarg & 0xffff))
+			return COMM_ERR;
+		priv->block_count = cmd->cmdarg & 0xffff;
+		break;
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		return sandbox_mmc_rw(priv, cmd, data);
+	case MMC_CMD_ERASE_GROUP_START:
+		priv->erase_start = cmd->cmdarg;
+		break;
+	case MMC_CMD_ERASE_GROUP_END:
+		priv->erase_end = cmd->cmdarg;
+		break;
+	case MMC_CMD_ERASE:
+		if (priv->erase_end < priv->erase_start ||
+		    priv->erase_end >= SANDBOX_MMC_BLOCKS)
+			return COMM_ERR;
+		memset(priv->data + priv->erase_start * MMC_MAX_BLOCK_LEN, 0,
+		       (priv->erase_end - priv->erase_start + 1) *
+		       MMC_MAX_BLOCK_LEN);
+		break;
+	default:
+		/* Includes MMC_CMD_APP_CMD, which eMMC does not answer */
+		return TIMEOUT;
+	}
+
+	return 0;
+}
+
+static void sandbox_mmc_set_ios(struct mmc *mmc)
+{
+}
+
+static int sandbox_mmc_init_card(struct mmc *mmc)
+{
+	return 0;
+}
+
+static int sandbox_mmc_queue_read(struct mmc *mmc, struct mmc_read_req *req)
+{
+	struct sandbox_mmc *priv = mmc->priv;
+	int pos;
+
+	if (priv->queue_len == MMC_READ_QUEUE_DEPTH)
+		return -EBUSY;
+	pos = (priv->queue_head + priv->queue_len) % MMC_READ_QUEUE_DEPTH;
+	priv->queue[pos] = req;
+	priv->queue_len++;
+	priv->stats.queued++;
+
+	return 0;
+}
+
+static int sandbox_mmc_wait_read(struct mmc *mmc)
+{
+	struct sandbox_mmc *priv = mmc->priv;
+	struct mmc_read_req *req;
+	int ret;
+
+	if (!priv->queue_len)
+		return -EINVAL;
+	req = priv->queue[priv->queue_head];
+	priv->queue_head = (priv->queue_head + 1) % MMC_READ_QUEUE_DEPTH;
+	priv->queue_len--;
+
+	/* The transfer happens now, in the order the reads were queued */
+	if (req->data.blocks > 1) {
+		ret = sandbox_mmc_send_cmd(mmc, &req->sbc, NULL);
+		if (ret)
+			return ret;
+	}
+
+	return sandbox_mmc_send_cmd(mmc, &req->cmd, &req->data);
+}
+
+static const struct mmc_ops sandbox_mmc_ops = {
+	.send_cmd	= sandbox_mmc_send_cmd,
+	.set_ios	= sandbox_mmc_set_ios,
+	.init		= sandbox_mmc_init_card,
+};
+
+static const struct mmc_ops sandbox_mmc_queue_ops = {
+	.send_cmd	= sandbox_mmc_send_cmd,
+	.set_ios	= sandbox_mmc_set_ios,
+	.init		= sandbox_mmc_init_card,
+	.queue_read	= sandbox_mmc_queue_read,
+	.wait_read	= sandbox_mmc_wait_read,
+};
+
+void sandbox_mmc_set_mode(enum sandbox_mmc_mode mode)
+{
+	struct mmc_config *cfg = &sandbox_mmc.cfg;
+
+	cfg->ops = &sandbox_mmc_ops;
+	cfg->host_caps &= ~MMC_MODE_CMD23;
+	if (mode != SANDBOX_MMC_STOP)
+		cfg->host_caps |= MMC_MODE_CMD23;
+	if (mode == SANDBOX_MMC_QUEUE)
+		cfg->ops = &sandbox_mmc_queue_ops;
+
+	/* The host capabilities are checked when the card is set up */
+	if (sandbox_mmc.mmc)
+		sandbox_mmc.mmc->has_init = 0;
+}
+
+const struct sandbox_mmc_stats *sandbox_mmc_get_stats(void)
+{
+	return &sandbox_mmc.stats;
+}
+
+void sandbox_mmc_reset_stats(void)
+{
+	memset(&sandbox_mmc.stats, '\0', sizeof(sandbox_mmc.stats));
+}
+
+int sandbox_mmc_init(void)
+{
+	struct sandbox_mmc *priv = &sandbox_mmc;
+	struct mmc_config *cfg = &priv->cfg;
+	u8 *ext_csd = priv->ext_csd;
+
+	/* This is mapped from the host, so starts out zeroed */
+	priv->data = os_malloc(CONFIG_SANDBOX_MMC_SIZE);
+	if (!priv->data)
+		return -ENOMEM;
+
+	ext_csd[EXT_CSD_REV] = 5;	/* 4.41 */
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+		EXT_CSD_CARD_TYPE_52;
+	put_unaligned_le32(SANDBOX_MMC_BLOCKS, &ext_csd[EXT_CSD_SEC_CNT]);
+
+	cfg->name = "sandbox";
+	cfg->host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT |
+		MMC_MODE_8BIT | MMC_MODE_HC;
+	cfg->voltages = MMC_VDD_32_33 | MMC_VDD_33_34;
+	cfg->f_min = 400000;
+	cfg->f_max = 52000000;
+	cfg->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
+	cfg->part_type = PART_TYPE_UNKNOWN;
+	sandbox_mmc_set_mode(SANDBOX_MMC_QUEUE);
+
+	priv->mmc = mmc_create(cfg, priv);
+	if (!priv->mmc)
+		return -ENOMEM;
+
+	return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * Emulated NAND flash chip for sandbox
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ *
+ * The chip is held in host memory and the emulation works at the command
+ * level, so the generic NAND code is used just as on real hardware,
+ * including its software ECC. Reads go through the chip's page register
+ * and programming a page can only clear bits. Each command, each page
+ * loaded into the register and each byte read out is counted, so that the
+ * cost of a read can be measured.
+ */
+
+#include <common.h>
+#include <nand.h>
+#include <os.h>
+#include <sandboxnand.h>
+#include <linux/mtd/nand.h>
+
+/* Samsung K9F1G08U0: 128MiB, 2KiB pages with 64 bytes OOB, 128KiB blocks */
+static const u8 sandbox_nand_id[] = { NAND_MFR_SAMSUNG, 0xf1, 0x00, 0x95,
+				      0x40 };
+
+#define SB_NAND_PAGE_SIZE	2048
+#define SB_NAND_OOB_SIZE	64
+#define SB_NAND_RAW_SIZE	(SB_NAND_PAGE_SIZE + SB_NAND_OOB_SIZE)
+#define SB_NAND_BLOCK_PAGES	64
+#define SB_NAND_BLOCKS		1024
+#define SB_NAND_PAGES		(SB_NAND_BLOCKS * SB_NAND_BLOCK_PAGES)
+
+/* What read_byte() and read_buf() return */
+enum sandbox_nand_output {
+	OUTPUT_STATUS,
+	OUTPUT_ID,
+	OUTPUT_PAGE,
+};
+
+struct sandbox_nand {
+	/*
+	 * Data and OOB of each block, allocated when the block is first
+	 * programmed. A NULL block is erased.
+	 */
+	u8 *blocks[SB_NAND_BLOCKS];
+	u8 reg[SB_NAND_RAW_SIZE];	/* Page register */
+	int page;			/* Page being programmed */
+	int erase_page;			/* Set by ERASE1 */
+	uint column;
+	enum sandbox_nand_output output;
+	u8 status;
+	struct sandbox_nand_stats stats;
+};
+
+static struct sandbox_nand sandbox_nand;
+
+static void sandbox_nand_load(struct sandbox_nand *priv, int page)
+{
+	u8 *block = priv->blocks[page / SB_NAND_BLOCK_PAGES];
+
+	if (block)
+		memcpy(priv->reg, block + page % SB_NAND_BLOCK_PAGES *
+		       SB_NAND_RAW_SIZE, SB_NAND_RAW_SIZE);
+	else
+		memset(priv->reg, 0xff, SB_NAND_RAW_SIZE);
+	priv->stats.page_reads++;
+}
+
+static int sandbox_nand_program(struct sandbox_nand *priv)
+{
+	int blk = priv->page / SB_NAND_BLOCK_PAGES;
+	u8 *p;
+	int i;
+
+	if (!priv->blocks[blk]) {
+		priv->blocks[blk] = os_malloc(SB_NAND_BLOCK_PAGES *
+					      SB_NAND_RAW_SIZE);
+		if (!priv->blocks[blk])
+			return -1;
+		memset(priv->blocks[blk], 0xff, SB_NAND_BLOCK_PAGES *
+		       SB_NAND_RAW_SIZE);
+	}
+
+	/* Programming can only turn ones into zeroes */
+	p = priv->blocks[blk] + priv->page % SB_NAND_BLOCK_PAGES *
+		SB_NAND_RAW_SIZE;
+	for (i = 0; i < SB_NAND_RAW_SIZE; i++)
+		p[i] &= priv->reg[i];
+	priv->stats.page_programs++;
+
+	return 0;
+}
+
+static void sandbox_nand_erase(struct sandbox_nand *priv, int page)
+{
+	int blk = page / SB_NAND_BLOCK_PAGES;
+
+	os_free(priv->blocks[blk]);
+	priv->blocks[blk] = NULL;
+	priv->stats.block_erases++;
+}
+
+static void sandbox_nand_cmdfunc(struct mtd_info *mtd, unsigned command,
+				 int column, int page_addr)
+{
+	struct sandbox_nand *priv = &sandbox_nand;
+
+	priv->stats.cmds++;
+	switch (command) {
+	case NAND_CMD_RESET:
+		priv->status = NAND_STATUS_READY | NAND_STATUS_WP;
+		priv->output = OUTPUT_STATUS;
+		break;
+	case NAND_CMD_READID:
+		/* Only the plain ID, this is neither ONFI nor JEDEC */
+		priv->column = column ? sizeof(sandbox_nand_id) : 0;
+		priv->output = OUTPUT_ID;
+		break;
+	case NAND_CMD_STATUS:
+		priv->output = OUTPUT_STATUS;
+		break;
+	case NAND_CMD_READOOB:
+		/* Large page chips read the OOB with READ0 after the data */
+		column += SB_NAND_PAGE_SIZE;
+		/* Fall through */
+	case NAND_CMD_READ0:
+		if (page_addr < 0 || page_addr >= SB_NAND_PAGES ||
+		    column < 0 || column >= SB_NAND_RAW_SIZE)
+			goto fail;
+		sandbox_nand_load(priv, page_addr);
+		priv->column = column;
+		priv->output = OUTPUT_PAGE;
+		break;
+	case NAND_CMD_RNDOUT:
+	case NAND_CMD_RNDIN:
+		if (column < 0 || column >= SB_NAND_RAW_SIZE)
+			goto fail;
+		priv->column = column;
+		break;
+	case NAND_CMD_SEQIN:
+		if (page_addr < 0 || page_addr >= SB_NAND_PAGES ||
+		    column < 0 || column >= SB_NAND_RAW_SIZE)
+			goto fail;
+		memset(priv->reg, 0xff, SB_NAND_RAW_SIZE);
+		priv->page = page_addr;
+		priv->column = column;
+		priv->output = OUTPUT_PAGE;
+		break;
+	case NAND_CMD_PAGEPROG:
+		if (priv->page < 0 || sandbox_nand_program(priv))
+			goto fail;
+		priv->page = -1;
+		priv->status = NAND_STATUS_READY | NAND_STATUS_WP;
+		break;
+	case NAND_CMD_ERASE1:
+		if (page_addr < 0 || page_addr >= SB_NAND_PAGES)
+			goto fail;
+		priv->erase_page = page_addr;
+		break;
+	case NAND_CMD_ERASE2:
+		if (priv->erase_page < 0)
+			goto fail;
+		sandbox_nand_erase(priv, priv->erase_page);
+		priv->erase_page = -1;
+		priv->status = NAND_STATUS_READY | NAND_STATUS_WP;
+		break;
+	default:
+		debug("%s: unsupported command %#x\n", __func__, command);
+		goto fail;
+	}
+
+	return;
+fail:
+	priv->status = NAND_STATUS_READY | NAND_STATUS_WP | NAND_STATUS_FAIL;
+	priv->output = OUTPUT_STATUS;
+}
+
+static uint8_t sandbox_nand_read_byte(struct mtd_info *mtd)
+{
+	struct sandbox_nand *priv = &sandbox_nand;
+
+	switch (priv->output) {
+	case OUTPUT_ID:
+		if (priv->column < sizeof(sandbox_nand_id))
+			return sandbox_nand_id[priv->column++];
+		return 0;
+	case OUTPUT_PAGE:
+		if (priv->column >= SB_NAND_RAW_SIZE)
+			return 0xff;
+		priv->stats.bytes_read++;
+		return priv->reg[priv->column++];
+	default:
+		return priv->status;
+	}
+}
+
+static void sandbox_nand_read_buf(struct mtd_info *mtd, uint8_t *buf,
+				  int len)
+{
+	struct sandbox_nand *priv = &sandbox_nand;
+	int n;
+
+	if (priv->output != OUTPUT_PAGE) {
+		while (len--)
+			*buf++ = sandbox_nand_read_byte(mtd);
+		return;
+	}
+
+	n = min_t(int, len, SB_NAND_RAW_SIZE - priv->column);
+	memcpy(buf, priv->reg + priv->column, n);
+	memset(buf + n, 0xff, len - n);
+	priv->column += n;
+	priv->stats.bytes_read += n;
+}
+
+static void sandbox_nand_write_buf(struct mtd_info *mtd, const uint8_t *buf,
+				   int len)
+{
+	struct sandbox_nand *priv = &sandbox_nand;
+	int n;
+
+	if (priv->page < 0)
+		return;
+	n = min_t(int, len, SB_NAND_RAW_SIZE - priv->column);
+	memcpy(priv->reg + priv->column, buf, n);
+	priv->column += n;
+}
+
+static int sandbox_nand_dev_ready(struct mtd_info *mtd)
+{
+	/* Everything completes at once */
+	return 1;
+}
+
+static void sandbox_nand_select_chip(struct mtd_info *mtd, int chip)
+{
+}
+
+const struct sandbox_nand_stats *sandbox_nand_get_stats(void)
+{
+	return &sandbox_nand.stats;
+}
+
+void sandbox_nand_reset_stats(void)
+{
+	memset(&sandbox_nand.stats, '\0', sizeof(sandbox_nand.stats));
+}
+
+int board_nand_init(struct nand_chip *nand)
+{
+	sandbox_nand.page = -1;
+	sandbox_nand.erase_page = -1;
+	sandbox_nand.status = NAND_STATUS_READY | NAND_STATUS_WP;
+
+	nand->cmdfunc = sandbox_nand_cmdfunc;
+	nand->read_byte = sandbox_nand_read_byte;
+	nand->read_buf = sandbox_nand_read_buf;
+	nand->write_buf = sandbox_nand_write_buf;
+	nand->dev_ready = sandbox_nand_dev_ready;
+	nand->select_chip = sandbox_nand_select_chip;
+	nand->ecc.mode = NAND_ECC_SOFT;
+
+	return 0;
+}
@@ -64,6 +64,25 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 /* Used to quickly bulk erase backing store */
 static u8 sandbox_sf_0xff[0x1000];
 
+/*
+ * The read commands we understand. Those with an e_rd_cmd bit are only
+ * accepted from flashes which support them (see spi_flash_params).
+ */
+static const struct sandbox_sf_read_cmd {
+	u8 cmd;
+	u8 e_rd_cmd;
+	u8 dummy_bytes;
+	u8 addr_nbits;
+	u8 data_nbits;
+} sandbox_sf_read_cmds[] = {
+	{ CMD_READ_ARRAY_SLOW,		0,			0, 1, 1 },
+	{ CMD_READ_ARRAY_FAST,		0,			1, 1, 1 },
+	{ CMD_READ_DUAL_OUTPUT_FAST,	DUAL_OUTPUT_FAST,	1, 1, 2 },
+	{ CMD_READ_DUAL_IO_FAST,	DUAL_IO_FAST,		1, 2, 2 },
+	{ CMD_READ_QUAD_OUTPUT_FAST,	QUAD_OUTPUT_FAST,	1, 1, 4 },
+	{ CMD_READ_QUAD_IO_FAST,	QUAD_IO_FAST,		2, 4, 4 },
+};
+
 /* Internal state data for each SPI flash */
 struct sandbox_spi_flash {
 	unsigned int cs;	/* Chip select we are attached to */
@@ -240,11 +259,31 @@ static void sandbox_spi_tristate(u8 *buf, uint len)
 	memset(buf, 0xff, len);
 }
 
+/* Look up a read command, returning NULL if this flash doesn't support it */
+static const struct sandbox_sf_read_cmd *sandbox_sf_find_read_cmd(
+		const struct spi_flash_params *data, uint cmd)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sandbox_sf_read_cmds); i++) {
+		const struct sandbox_sf_read_cmd *rd = &sandbox_sf_read_cmds[i];
+
+		if (rd->cmd != cmd)
+			continue;
+		if (rd->e_rd_cmd && !(data->e_rd_cmd & rd->e_rd_cmd))
+			return NULL;
+		return rd;
+	}
+
+	return NULL;
+}
+
 /* Figure out what command this stream is telling us to do */
 static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 				  u8 *tx)
 {
 	enum sandbox_sf_state oldstate = sbsf->state;
+	const struct sandbox_sf_read_cmd *rd;
 
 	/* We need to output a byte for the cmd byte we just ate */
 	if (tx)
@@ -257,8 +296,24 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		sbsf->cmd = SF_ID;
 		break;
 	case CMD_READ_ARRAY_FAST:
-		sbsf->pad_addr_bytes = 1;
 	case CMD_READ_ARRAY_SLOW:
+	case CMD_READ_DUAL_OUTPUT_FAST:
+	case CMD_READ_DUAL_IO_FAST:
+	case CMD_READ_QUAD_OUTPUT_FAST:
+	case CMD_READ_QUAD_IO_FAST:
+		rd = sandbox_sf_find_read_cmd(sbsf->data, sbsf->cmd);
+		if (!rd) {
+			debug(" read cmd not supported: %#x\n", sbsf->cmd);
+			return -EIO;
+		}
+		sbsf->pad_addr_bytes = rd->dummy_bytes;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_QUAD_PAGE_PROGRAM:
+		if (!(sbsf->data->flags & WR_QPP)) {
+			debug(" quad page program not supported\n");
+			return -EIO;
+		}
 	case CMD_PAGE_PROGRAM:
 		sbsf->state = SF_ADDR;
 		break;
@@ -393,9 +448,14 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 			switch (sbsf->cmd) {
 			case CMD_READ_ARRAY_FAST:
 			case CMD_READ_ARRAY_SLOW:
+			case CMD_READ_DUAL_OUTPUT_FAST:
+			case CMD_READ_DUAL_IO_FAST:
+			case CMD_READ_QUAD_OUTPUT_FAST:
+			case CMD_READ_QUAD_IO_FAST:
 				sbsf->state = SF_READ;
 				break;
 			case CMD_PAGE_PROGRAM:
+			case CMD_QUAD_PAGE_PROGRAM:
 				sbsf->state = SF_WRITE;
 				break;
 			default:
@@ -510,6 +570,45 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 	return pos == bytes ? 0 : -EIO;
 }
 
+/*
+ * Emulate a controller's flash read engine, checking that the read is set
+ * up the way a real flash would need it
+ */
+static int sandbox_sf_read_flash(struct udevice *dev,
+				 struct spi_flash_read_msg *msg)
+{
+	struct sandbox_spi_flash *sbsf = dev_get_priv(dev);
+	const struct sandbox_sf_read_cmd *rd;
+	int ret;
+
+	rd = sandbox_sf_find_read_cmd(sbsf->data, msg->read_opcode);
+	if (!rd || msg->addr_width != SF_ADDR_LEN ||
+	    msg->dummy_bytes != rd->dummy_bytes || msg->opcode_nbits != 1 ||
+	    msg->addr_nbits != rd->addr_nbits ||
+	    msg->data_nbits != rd->data_nbits) {
+		printf("sandbox_sf: bad read: cmd %#x, %u-%u-%u lines, %u address, %u dummy bytes\n",
+		       msg->read_opcode, msg->opcode_nbits, msg->addr_nbits,
+		       msg->data_nbits, msg->addr_width, msg->dummy_bytes);
+		return -EIO;
+	}
+	debug("sandbox_sf: read_flash cmd %#x off %#x len %#zx\n",
+	      msg->read_opcode, msg->from, msg->len);
+
+	if (os_lseek(sbsf->fd, msg->from, OS_SEEK_SET) < 0) {
+		puts("sandbox_sf: os_lseek() failed");
+		return -EIO;
+	}
+	ret = os_read(sbsf->fd, msg->buf, msg->len);
+	if (ret < 0) {
+		puts("sandbox_sf: os_read() failed\n");
+		return -EIO;
+	}
+	/* Past the end of the file the flash is erased */
+	memset(msg->buf + ret, 0xff, msg->len - ret);
+
+	return 0;
+}
+
 int sandbox_sf_ofdata_to_platdata(struct udevice *dev)
 {
 	struct sandbox_spi_flash_plat_data *pdata = dev_get_platdata(dev);
@@ -529,6 +628,7 @@ int sandbox_sf_ofdata_to_platdata(struct udevice *dev)
 
 static const struct dm_spi_emul_ops sandbox_sf_emul_ops = {
 	.xfer          = sandbox_sf_xfer,
+	.read_flash    = sandbox_sf_read_flash,
 };
 
 #ifdef CONFIG_SPI_FLASH
@@ -359,12 +359,57 @@ int spi_flash_read_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+/*
+ * Read using the controller's flash read engine, if it has one. Returns
+ * -ENOSYS if not, in which case nothing was read.
+ */
+static int spi_flash_read_engine(struct spi_flash *flash, u32 addr,
+				 size_t len, void *data)
+{
+	struct spi_flash_read_msg msg;
+	int ret;
+
+	memset(&msg, '\0', sizeof(msg));
+	msg.from = addr;
+	msg.len = len;
+	msg.buf = data;
+	msg.read_opcode = flash->read_cmd;
+	msg.addr_width = SPI_FLASH_3B_ADDR_LEN;
+	msg.dummy_bytes = flash->dummy_byte;
+	msg.opcode_nbits = 1;
+	msg.addr_nbits = 1;
+	msg.data_nbits = 1;
+	switch (flash->read_cmd) {
+	case CMD_READ_QUAD_IO_FAST:
+		msg.addr_nbits = 4;
+	case CMD_READ_QUAD_OUTPUT_FAST:
+		msg.data_nbits = 4;
+		break;
+	case CMD_READ_DUAL_IO_FAST:
+		msg.addr_nbits = 2;
+	case CMD_READ_DUAL_OUTPUT_FAST:
+		msg.data_nbits = 2;
+		break;
+	}
+
+	ret = spi_claim_bus(flash->spi);
+	if (ret) {
+		debug("SF: unable to claim SPI bus\n");
+		return ret;
+	}
+	ret = spi_read_flash(flash->spi, &msg);
+	spi_release_bus(flash->spi);
+
+	return ret;
+}
+
 int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		size_t len, void *data)
 {
 	u8 *cmd, cmdsz;
 	u32 remain_len, read_len, read_addr;
 	int bank_sel = 0;
+	bool use_engine = true;
 	int ret = -1;
 
 	/* Handle memory-mapped SPI */
@@ -408,9 +453,16 @@ int spi_flash_cmd_read_ops(struct spi_flash *flash, u32 offset,
 		else
 			read_len = remain_len;
 
-		spi_flash_addr(read_addr, cmd);
-
-		ret = spi_flash_read_common(flash, cmd, cmdsz, data, read_len);
+		ret = -ENOSYS;
+		if (use_engine)
+			ret = spi_flash_read_engine(flash, read_addr, read_len,
+						    data);
+		if (ret == -ENOSYS) {
+			use_engine = false;
+			spi_flash_addr(read_addr, cmd);
+			ret = spi_flash_read_common(flash, cmd, cmdsz, data,
+						    read_len);
+		}
 		if (ret < 0) {
 			debug("SF: read failed\n");
 			break;
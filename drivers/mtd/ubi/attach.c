@@ -80,9 +80,8 @@
 #include <linux/err.h>
 #endif
 
-#include <linux/math64.h>
-
 #include <ubi_uboot.h>
+#include <linux/math64.h>
 #include "ubi.h"
 
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
@@ -826,6 +825,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi->scanned_peb_count++;
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1390,7 +1390,9 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+	unsigned long start = get_timer(0);
 
+	ubi->scanned_peb_count = 0;
 	ai = alloc_ai("ubi_aeb_slab_cache");
 	if (!ai)
 		return -ENOMEM;
@@ -1469,6 +1471,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 #endif
 
 	destroy_ai(ai);
+	ubi->attach_time = get_timer(start);
 	return 0;
 
 out_wl:
@@ -1057,6 +1057,9 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 		ubi->image_seq);
 	ubi_msg("available PEBs: %d, total reserved PEBs: %d, PEBs reserved for bad PEB handling: %d",
 		ubi->avail_pebs, ubi->rsvd_pebs, ubi->beb_rsvd_pebs);
+	ubi_msg("attached in %lu ms, headers of %d PEBs read%s",
+		ubi->attach_time, ubi->scanned_peb_count,
+		ubi->fm ? ", using fastmap" : "");
 
 	/*
 	 * The below lock makes sure we do not race with 'ubi_thread()' which
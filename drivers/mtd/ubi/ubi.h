@@ -462,6 +462,8 @@ struct ubi_debug_info {
  * @corr_peb_count: count of corrupted physical eraseblocks (preserved and not
  *                  used by UBI)
  * @erroneous_peb_count: count of erroneous physical eraseblocks in @erroneous
+ * @scanned_peb_count: count of PEBs whose headers were read when attaching
+ * @attach_time: time it took to attach, in milliseconds
  * @max_erroneous: maximum allowed amount of erroneous physical eraseblocks
  * @min_io_size: minimal input/output unit size of the underlying MTD device
  * @hdrs_min_io_size: minimal I/O unit size used for VID and EC headers
@@ -565,6 +567,8 @@ struct ubi_device {
 	int good_peb_count;
 	int corr_peb_count;
 	int erroneous_peb_count;
+	int scanned_peb_count;
+	unsigned long attach_time;
 	int max_erroneous;
 	int min_io_size;
 	int hdrs_min_io_size;
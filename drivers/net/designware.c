@@ -167,7 +167,7 @@ static void rx_descs_init(struct eth_device *dev)
 			   sizeof(priv->rx_mac_descrtable));
 
 	writel((ulong)&desc_table_p[0], &dma_p->rxdesclistaddr);
-	priv->rx_currdescnum = 0;
+	priv->rx_ring.head = 0;
 }
 
 static int dw_write_hwaddr(struct eth_device *dev)
@@ -336,52 +336,64 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 	return 0;
 }
 
-static int dw_eth_recv(struct eth_device *dev)
+static int dw_rx_check(struct eth_device *dev, unsigned int idx,
+		       uchar **pkt)
 {
 	struct dw_eth_dev *priv = dev->priv;
-	u32 status, desc_num = priv->rx_currdescnum;
-	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
-	int length = 0;
+	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[idx];
 	uint32_t desc_start = (uint32_t)desc_p;
 	uint32_t desc_end = desc_start +
 		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
 	uint32_t data_start = (uint32_t)desc_p->dmamac_addr;
-	uint32_t data_end;
+	u32 status;
+	int length;
 
 	/* Invalidate entire buffer descriptor */
 	invalidate_dcache_range(desc_start, desc_end);
 
 	status = desc_p->txrx_status;
 
-	/* Check  if the owner is the CPU */
-	if (!(status & DESC_RXSTS_OWNBYDMA)) {
+	/* Still owned by the DMA: nothing received here yet */
+	if (status & DESC_RXSTS_OWNBYDMA)
+		return 0;
+	if (status & DESC_RXSTS_ERROR)
+		return -EIO;
+
+	length = (status & DESC_RXSTS_FRMLENMSK) >> DESC_RXSTS_FRMLENSHFT;
 
-		length = (status & DESC_RXSTS_FRMLENMSK) >> \
-			 DESC_RXSTS_FRMLENSHFT;
+	/* Invalidate received data */
+	invalidate_dcache_range(data_start,
+				data_start + roundup(length, ARCH_DMA_MINALIGN));
+	*pkt = desc_p->dmamac_addr;
 
-		/* Invalidate received data */
-		data_end = data_start + roundup(length, ARCH_DMA_MINALIGN);
-		invalidate_dcache_range(data_start, data_end);
+	return length;
+}
 
-		NetReceive(desc_p->dmamac_addr, length);
+static void dw_rx_release(struct eth_device *dev, unsigned int idx)
+{
+	struct dw_eth_dev *priv = dev->priv;
+	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[idx];
+	uint32_t desc_start = (uint32_t)desc_p;
+	uint32_t desc_end = desc_start +
+		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
 
-		/*
-		 * Make the current descriptor valid again and go to
-		 * the next one
-		 */
-		desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
+	/* Make the descriptor valid again */
+	desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
 
-		/* Flush only status field - others weren't changed */
-		flush_dcache_range(desc_start, desc_end);
+	/* Flush only status field - others weren't changed */
+	flush_dcache_range(desc_start, desc_end);
+}
 
-		/* Test the wrap-around condition. */
-		if (++desc_num >= CONFIG_RX_DESCR_NUM)
-			desc_num = 0;
-	}
+static int dw_eth_recv(struct eth_device *dev)
+{
+	struct dw_eth_dev *priv = dev->priv;
+	u32 missed;
 
-	priv->rx_currdescnum = desc_num;
+	/* Frames the DMA had no descriptor for, cleared by reading */
+	missed = readl(&priv->dma_regs_p->missedframes);
+	dev->rx_stats.dropped += (missed & 0xffff) + ((missed >> 17) & 0x7ff);
 
-	return length;
+	return eth_rx_ring_poll(dev, &priv->rx_ring);
 }
 
 static int dw_phy_init(struct eth_device *dev)
@@ -440,6 +452,9 @@ int designware_initialize(ulong base_addr, u32 interface)
 	priv->mac_regs_p = (struct eth_mac_regs *)base_addr;
 	priv->dma_regs_p = (struct eth_dma_regs *)(base_addr +
 			DW_DMA_BASE_OFFSET);
+	priv->rx_ring.size = CONFIG_RX_DESCR_NUM;
+	priv->rx_ring.check = dw_rx_check;
+	priv->rx_ring.release = dw_rx_release;
 
 	dev->init = dw_eth_init;
 	dev->send = dw_eth_send;
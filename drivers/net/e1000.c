@@ -29,6 +29,7 @@ tested on both gig copper and gig fiber boards
  *  Copyright 2011 Freescale Semiconductor, Inc.
  */
 
+#include <errno.h>
 #include "e1000.h"
 
 #define TOUT_LOOP   100000
@@ -44,12 +45,18 @@ tested on both gig copper and gig fiber boards
 /* Intel i210 needs the DMA descriptor rings aligned to 128b */
 #define E1000_BUFFER_ALIGN	128
 
+/* Receive descriptors, a multiple of 8 as RDLEN counts 128 byte units */
+#define E1000_RX_RING_SIZE	ETH_RX_RING_SIZE(16)
+#define E1000_RX_BUF_SIZE	2048
+
 DEFINE_ALIGN_BUFFER(struct e1000_tx_desc, tx_base, 16, E1000_BUFFER_ALIGN);
-DEFINE_ALIGN_BUFFER(struct e1000_rx_desc, rx_base, 16, E1000_BUFFER_ALIGN);
-DEFINE_ALIGN_BUFFER(unsigned char, packet, 4096, E1000_BUFFER_ALIGN);
+DEFINE_ALIGN_BUFFER(struct e1000_rx_desc, rx_base, E1000_RX_RING_SIZE,
+		    E1000_BUFFER_ALIGN);
+DEFINE_ALIGN_BUFFER(unsigned char, rx_buffers,
+		    E1000_RX_RING_SIZE * E1000_RX_BUF_SIZE, E1000_BUFFER_ALIGN);
 
 static int tx_tail;
-static int rx_tail, rx_last;
+static struct eth_rx_ring rx_ring;
 
 static struct pci_device_id e1000_supported[] = {
 	{PCI_VENDOR_ID_INTEL, PCI_DEVICE_ID_INTEL_82542},
@@ -4915,30 +4922,27 @@ e1000_sw_init(struct eth_device *nic)
 	return E1000_SUCCESS;
 }
 
-void
-fill_rx(struct e1000_hw *hw)
+/* Put an empty buffer in receive descriptor @idx */
+static void
+fill_rx(struct e1000_hw *hw, unsigned int idx)
 {
-	struct e1000_rx_desc *rd;
+	struct e1000_rx_desc *rd = rx_base + idx;
+	unsigned char *buf = rx_buffers + idx * E1000_RX_BUF_SIZE;
 	uint32_t flush_start, flush_end;
 
-	rx_last = rx_tail;
-	rd = rx_base + rx_tail;
-	rx_tail = (rx_tail + 1) % 8;
 	memset(rd, 0, 16);
-	rd->buffer_addr = cpu_to_le64((u32)packet);
+	rd->buffer_addr = cpu_to_le64((u32)buf);
 
 	/*
 	 * Make sure there are no stale data in WB over this area, which
 	 * might get written into the memory while the e1000 also writes
 	 * into the same memory area.
 	 */
-	invalidate_dcache_range((u32)packet, (u32)packet + 4096);
+	invalidate_dcache_range((u32)buf, (u32)buf + E1000_RX_BUF_SIZE);
 	/* Dump the DMA descriptor into RAM. */
 	flush_start = ((u32)rd) & ~(ARCH_DMA_MINALIGN - 1);
 	flush_end = flush_start + roundup(sizeof(*rd), ARCH_DMA_MINALIGN);
 	flush_dcache_range(flush_start, flush_end);
-
-	E1000_WRITE_REG(hw, RDT, rx_tail);
 }
 
 /**
@@ -5079,7 +5083,8 @@ static void
 e1000_configure_rx(struct e1000_hw *hw)
 {
 	unsigned long rctl, ctrl_ext;
-	rx_tail = 0;
+	unsigned int i;
+
 	/* make sure receives are disabled while setting up the descriptors */
 	rctl = E1000_READ_REG(hw, RCTL);
 	E1000_WRITE_REG(hw, RCTL, rctl & ~E1000_RCTL_EN);
@@ -5102,7 +5107,7 @@ e1000_configure_rx(struct e1000_hw *hw)
 	E1000_WRITE_REG(hw, RDBAL, (u32) rx_base);
 	E1000_WRITE_REG(hw, RDBAH, 0);
 
-	E1000_WRITE_REG(hw, RDLEN, 128);
+	E1000_WRITE_REG(hw, RDLEN, E1000_RX_RING_SIZE * sizeof(*rx_base));
 
 	/* Setup the HW Rx Head and Tail Descriptor Pointers */
 	E1000_WRITE_REG(hw, RDH, 0);
@@ -5119,38 +5124,67 @@ e1000_configure_rx(struct e1000_hw *hw)
 
 	E1000_WRITE_REG(hw, RCTL, rctl);
 
-	fill_rx(hw);
+	/*
+	 * The hardware fills descriptors from RDH up to RDT, so one is always
+	 * kept back to tell a full ring from an empty one.
+	 */
+	for (i = 0; i < E1000_RX_RING_SIZE; i++)
+		fill_rx(hw, i);
+	rx_ring.head = 0;
+	E1000_WRITE_REG(hw, RDT, E1000_RX_RING_SIZE - 1);
 }
 
-/**************************************************************************
-POLL - Wait for a frame
-***************************************************************************/
 static int
-e1000_poll(struct eth_device *nic)
+e1000_rx_check(struct eth_device *nic, unsigned int idx, uchar **pkt)
 {
 	struct e1000_hw *hw = nic->priv;
-	struct e1000_rx_desc *rd;
+	struct e1000_rx_desc *rd = rx_base + idx;
+	unsigned char *buf = rx_buffers + idx * E1000_RX_BUF_SIZE;
 	uint32_t inval_start, inval_end;
 	uint32_t len;
 
-	/* return true if there's an ethernet packet ready to read */
-	rd = rx_base + rx_last;
-
 	/* Re-load the descriptor from RAM. */
 	inval_start = ((u32)rd) & ~(ARCH_DMA_MINALIGN - 1);
 	inval_end = inval_start + roundup(sizeof(*rd), ARCH_DMA_MINALIGN);
 	invalidate_dcache_range(inval_start, inval_end);
 
-	if (!(le32_to_cpu(rd->status)) & E1000_RXD_STAT_DD)
+	if (!(rd->status & E1000_RXD_STAT_DD))
 		return 0;
-	/*DEBUGOUT("recv: packet len=%d \n", rd->length); */
+	if ((rd->errors & E1000_RXD_ERR_FRAME_ERR_MASK) &&
+	    !hw->tbi_compatibility_on)
+		return -EIO;
+
 	/* Packet received, make sure the data are re-loaded from RAM. */
-	len = le32_to_cpu(rd->length);
-	invalidate_dcache_range((u32)packet,
-				(u32)packet + roundup(len, ARCH_DMA_MINALIGN));
-	NetReceive((uchar *)packet, len);
-	fill_rx(hw);
-	return 1;
+	len = le16_to_cpu(rd->length);
+	invalidate_dcache_range((u32)buf,
+				(u32)buf + roundup(len, ARCH_DMA_MINALIGN));
+	*pkt = buf;
+
+	return len;
+}
+
+static void
+e1000_rx_release(struct eth_device *nic, unsigned int idx)
+{
+	struct e1000_hw *hw = nic->priv;
+
+	/* Hand the previous descriptor over, keeping this one back */
+	fill_rx(hw, idx);
+	E1000_WRITE_REG(hw, RDT, idx);
+}
+
+/**************************************************************************
+POLL - Wait for a frame
+***************************************************************************/
+static int
+e1000_poll(struct eth_device *nic)
+{
+	struct e1000_hw *hw = nic->priv;
+
+	/* Frames lost for lack of a descriptor, cleared by reading */
+	nic->rx_stats.dropped += E1000_READ_REG(hw, MPC);
+
+	return eth_rx_ring_poll(nic, &rx_ring);
 }
 
 /**************************************************************************
@@ -5408,6 +5442,9 @@ e1000_initialize(bd_t * bis)
 		/* Set up the function pointers and register the device */
 		nic->init = e1000_init;
 		nic->recv = e1000_poll;
+		rx_ring.size = E1000_RX_RING_SIZE;
+		rx_ring.check = e1000_rx_check;
+		rx_ring.release = e1000_rx_release;
 		nic->send = e1000_transmit;
 		nic->halt = e1000_disable;
 		eth_register(nic);
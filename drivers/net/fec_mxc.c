@@ -306,7 +306,7 @@ static void fec_rbd_init(struct fec_priv *fec, int count, int dsize)
 
 	/* Mark the last RBD to close the ring. */
 	fec->rbd_base[i - 1].status = FEC_RBD_WRAP | FEC_RBD_EMPTY;
-	fec->rbd_index = 0;
+	fec->rx_ring.head = 0;
 
 	flush_dcache_range((unsigned)fec->rbd_base,
 			   (unsigned)fec->rbd_base + size);
@@ -426,7 +426,7 @@ static int fec_open(struct eth_device *edev)
 	debug("fec_open: fec_open(dev)\n");
 	/* full-duplex, heartbeat disabled */
 	writel(1 << 2, &fec->eth->x_cntrl);
-	fec->rbd_index = 0;
+	fec->rx_ring.head = 0;
 
 	/* Invalidate all descriptors */
 	for (i = 0; i < FEC_RBD_NUM - 1; i++)
@@ -610,7 +610,7 @@ static void fec_halt(struct eth_device *dev)
 	 */
 	writel(readl(&fec->eth->ecntrl) & ~FEC_ECNTRL_ETHER_EN,
 			&fec->eth->ecntrl);
-	fec->rbd_index = 0;
+	fec->rx_ring.head = 0;
 	fec->tbd_index = 0;
 	debug("eth_halt: done\n");
 }
@@ -762,22 +762,110 @@ out:
 	return ret;
 }
 
+/*
+ * Check one receive descriptor and copy its frame out.
+ *
+ * Read the buffer status. Before the status can be read, the data cache
+ * must be invalidated, because the data in RAM might have been changed
+ * by DMA. The descriptors are properly aligned to cachelines so there's
+ * no need to worry they'd overlap.
+ *
+ * WARNING: By invalidating the descriptor here, we also invalidate
+ * the descriptors surrounding this one. Therefore we can NOT change the
+ * contents of this descriptor nor the surrounding ones. The problem is
+ * that in order to mark the descriptor as processed, we need to change
+ * the descriptor. The solution is to mark the whole cache line when all
+ * descriptors in the cache line are processed, see fec_rx_release().
+ */
+static int fec_rx_check(struct eth_device *dev, unsigned int idx,
+			uchar **pkt)
+{
+	struct fec_priv *fec = (struct fec_priv *)dev->priv;
+	struct fec_bd *rbd = &fec->rbd_base[idx];
+	int frame_length;
+	struct nbuf *frame;
+	uint16_t bd_status;
+	uint32_t addr, size, end;
+
+	addr = (uint32_t)rbd;
+	addr &= ~(ARCH_DMA_MINALIGN - 1);
+	size = roundup(sizeof(struct fec_bd), ARCH_DMA_MINALIGN);
+	invalidate_dcache_range(addr, addr + size);
+
+	bd_status = readw(&rbd->status);
+	debug("fec_recv: status 0x%x\n", bd_status);
+
+	if (bd_status & FEC_RBD_EMPTY)
+		return 0;
+
+	if (!(bd_status & FEC_RBD_LAST) || (bd_status & FEC_RBD_ERR) ||
+	    (readw(&rbd->data_length) - 4) <= 14) {
+		if (bd_status & FEC_RBD_ERR)
+			printf("error frame: 0x%08lx 0x%08x\n",
+			       (ulong)rbd->data_pointer, bd_status);
+		return -EIO;
+	}
+
+	/*
+	 * Get buffer address and size
+	 */
+	frame = (struct nbuf *)readl(&rbd->data_pointer);
+	frame_length = readw(&rbd->data_length) - 4;
+	/*
+	 * Invalidate data cache over the buffer
+	 */
+	addr = (uint32_t)frame;
+	end = roundup(addr + frame_length, ARCH_DMA_MINALIGN);
+	addr &= ~(ARCH_DMA_MINALIGN - 1);
+	invalidate_dcache_range(addr, end);
+
+	/*
+	 *  Fill the buffer and pass it to upper layers
+	 */
+#ifdef CONFIG_FEC_MXC_SWAP_PACKET
+	swap_packet((uint32_t *)frame->data, frame_length);
+#endif
+	memcpy(NetRxPackets[0], frame->data, frame_length);
+	*pkt = NetRxPackets[0];
+
+	return frame_length;
+}
+
+/*
+ * Free the buffer and restart the engine. Here we check if the whole
+ * cacheline of descriptors was already processed and if so, we mark it
+ * free as whole.
+ */
+static void fec_rx_release(struct eth_device *dev, unsigned int idx)
+{
+	struct fec_priv *fec = (struct fec_priv *)dev->priv;
+	uint32_t addr, size;
+	unsigned int i;
+
+	size = RXDESC_PER_CACHELINE - 1;
+	if ((idx & size) == size) {
+		i = idx - size;
+		addr = (uint32_t)&fec->rbd_base[i];
+		for (; i <= idx; i++) {
+			fec_rbd_clean(i == (FEC_RBD_NUM - 1),
+				      &fec->rbd_base[i]);
+		}
+		flush_dcache_range(addr, addr + ARCH_DMA_MINALIGN);
+	}
+
+	fec_rx_task_enable(fec);
+}
+
 /**
- * Pull one frame from the card
+ * Pull all received frames from the card
  * @param[in] dev Our ethernet device to handle
- * @return Length of packet read
+ * @return Number of bytes read
  */
 static int fec_recv(struct eth_device *dev)
 {
 	struct fec_priv *fec = (struct fec_priv *)dev->priv;
-	struct fec_bd *rbd = &fec->rbd_base[fec->rbd_index];
 	unsigned long ievent;
-	int frame_length, len = 0;
-	struct nbuf *frame;
-	uint16_t bd_status;
-	uint32_t addr, size, end;
-	int i;
-	ALLOC_CACHE_ALIGN_BUFFER(uchar, buff, FEC_MAX_PKT_SIZE);
+	int len;
 
 	/*
 	 * Check if any critical events have happened
@@ -806,80 +894,7 @@ static int fec_recv(struct eth_device *dev)
 		}
 	}
 
-	/*
-	 * Read the buffer status. Before the status can be read, the data cache
-	 * must be invalidated, because the data in RAM might have been changed
-	 * by DMA. The descriptors are properly aligned to cachelines so there's
-	 * no need to worry they'd overlap.
-	 *
-	 * WARNING: By invalidating the descriptor here, we also invalidate
-	 * the descriptors surrounding this one. Therefore we can NOT change the
-	 * contents of this descriptor nor the surrounding ones. The problem is
-	 * that in order to mark the descriptor as processed, we need to change
-	 * the descriptor. The solution is to mark the whole cache line when all
-	 * descriptors in the cache line are processed.
-	 */
-	addr = (uint32_t)rbd;
-	addr &= ~(ARCH_DMA_MINALIGN - 1);
-	size = roundup(sizeof(struct fec_bd), ARCH_DMA_MINALIGN);
-	invalidate_dcache_range(addr, addr + size);
-
-	bd_status = readw(&rbd->status);
-	debug("fec_recv: status 0x%x\n", bd_status);
-
-	if (!(bd_status & FEC_RBD_EMPTY)) {
-		if ((bd_status & FEC_RBD_LAST) && !(bd_status & FEC_RBD_ERR) &&
-			((readw(&rbd->data_length) - 4) > 14)) {
-			/*
-			 * Get buffer address and size
-			 */
-			frame = (struct nbuf *)readl(&rbd->data_pointer);
-			frame_length = readw(&rbd->data_length) - 4;
-			/*
-			 * Invalidate data cache over the buffer
-			 */
-			addr = (uint32_t)frame;
-			end = roundup(addr + frame_length, ARCH_DMA_MINALIGN);
-			addr &= ~(ARCH_DMA_MINALIGN - 1);
-			invalidate_dcache_range(addr, end);
-
-			/*
-			 *  Fill the buffer and pass it to upper layers
-			 */
-#ifdef CONFIG_FEC_MXC_SWAP_PACKET
-			swap_packet((uint32_t *)frame->data, frame_length);
-#endif
-			memcpy(buff, frame->data, frame_length);
-			NetReceive(buff, frame_length);
-			len = frame_length;
-		} else {
-			if (bd_status & FEC_RBD_ERR)
-				printf("error frame: 0x%08lx 0x%08x\n",
-						(ulong)rbd->data_pointer,
-						bd_status);
-		}
-
-		/*
-		 * Free the current buffer, restart the engine and move forward
-		 * to the next buffer. Here we check if the whole cacheline of
-		 * descriptors was already processed and if so, we mark it free
-		 * as whole.
-		 */
-		size = RXDESC_PER_CACHELINE - 1;
-		if ((fec->rbd_index & size) == size) {
-			i = fec->rbd_index - size;
-			addr = (uint32_t)&fec->rbd_base[i];
-			for (; i <= fec->rbd_index ; i++) {
-				fec_rbd_clean(i == (FEC_RBD_NUM - 1),
-					      &fec->rbd_base[i]);
-			}
-			flush_dcache_range(addr,
-				addr + ARCH_DMA_MINALIGN);
-		}
-
-		fec_rx_task_enable(fec);
-		fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
-	}
+	len = eth_rx_ring_poll(dev, &fec->rx_ring);
 	debug("fec_recv: stop\n");
 
 	return len;
@@ -933,7 +948,7 @@ static int fec_alloc_descs(struct fec_priv *fec)
 	/* Mark the last RBD to close the ring. */
 	fec->rbd_base[i - 1].status = FEC_RBD_WRAP | FEC_RBD_EMPTY;
 
-	fec->rbd_index = 0;
+	fec->rx_ring.head = 0;
 	fec->tbd_index = 0;
 
 	return 0;
@@ -998,6 +1013,9 @@ static int fec_probe(bd_t *bd, int dev_id, uint32_t base_addr,
 	edev->init = fec_init;
 	edev->send = fec_send;
 	edev->recv = fec_recv;
+	fec->rx_ring.size = FEC_RBD_NUM;
+	fec->rx_ring.check = fec_rx_check;
+	fec->rx_ring.release = fec_rx_release;
 	edev->halt = fec_halt;
 	edev->write_hwaddr = fec_set_hwaddr;
 
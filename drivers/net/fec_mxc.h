@@ -251,7 +251,7 @@ struct fec_priv {
 	struct ethernet_regs *eth;	/* pointer to register'S base */
 	enum xceiver_type xcv_type;	/* transceiver type */
 	struct fec_bd *rbd_base;	/* RBD ring */
-	int rbd_index;			/* next receive BD to read */
+	struct eth_rx_ring rx_ring;	/* head is the next BD to read */
 	struct fec_bd *tbd_base;	/* TBD ring */
 	int tbd_index;			/* next transmit BD to write */
 	bd_t *bd;
@@ -272,7 +272,7 @@ struct fec_priv {
  * The number defines the stocked memory buffers for the receiving task.
  * Larger values makes no sense in this limited environment.
  */
-#define FEC_RBD_NUM		64
+#define FEC_RBD_NUM		ETH_RX_RING_SIZE(64)
 
 /**
  * @brief Define the ethernet packet size limit in memory
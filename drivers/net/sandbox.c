@@ -0,0 +1,116 @@
+/*
+ * Sandbox Ethernet driver, using a host tap interface
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <net.h>
+#include <netdev.h>
+#include <os.h>
+#include <asm/state.h>
+
+struct sb_tap_priv {
+	const char *ifname;	/* Host interface name */
+	int fd;			/* Host file descriptor, or -1 if closed */
+	unsigned int drop;	/* Drop 1 in this many rx frames, 0 for none */
+	u32 seed;		/* Drop pattern, the same on every run */
+};
+
+/* Decide whether to lose the next received frame */
+static bool sb_tap_drop(struct sb_tap_priv *priv)
+{
+	if (!priv->drop)
+		return false;
+	priv->seed = priv->seed * 1103515245 + 12345;
+
+	return (priv->seed >> 16) % priv->drop == 0;
+}
+
+static int sb_tap_init(struct eth_device *dev, bd_t *bis)
+{
+	struct sb_tap_priv *priv = dev->priv;
+
+	if (priv->fd >= 0)
+		return 0;
+
+	priv->fd = os_tap_open(priv->ifname);
+	if (priv->fd < 0) {
+		printf("%s: cannot attach to host interface '%s'\n", dev->name,
+		       priv->ifname);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void sb_tap_halt(struct eth_device *dev)
+{
+	struct sb_tap_priv *priv = dev->priv;
+
+	if (priv->fd >= 0) {
+		os_close(priv->fd);
+		priv->fd = -1;
+	}
+}
+
+static int sb_tap_send(struct eth_device *dev, void *packet, int length)
+{
+	struct sb_tap_priv *priv = dev->priv;
+
+	if (os_write(priv->fd, packet, length) != length)
+		return -1;
+
+	return 0;
+}
+
+static int sb_tap_recv(struct eth_device *dev)
+{
+	struct sb_tap_priv *priv = dev->priv;
+	ssize_t len;
+
+	/* Hand over everything the host has queued, one frame per read */
+	while ((len = os_read(priv->fd, NetRxPackets[0], PKTSIZE_ALIGN)) > 0) {
+		if (sb_tap_drop(priv))
+			dev->rx_stats.dropped++;
+		else
+			NetReceive(NetRxPackets[0], len);
+	}
+
+	return 0;
+}
+
+int sandbox_eth_initialize(bd_t *bis)
+{
+	struct sandbox_state *state = state_get_current();
+	struct sb_tap_priv *priv;
+	struct eth_device *dev;
+
+	/* Without --tap there is nothing to attach to */
+	if (!state->tap_name)
+		return 0;
+
+	dev = calloc(1, sizeof(*dev));
+	priv = calloc(1, sizeof(*priv));
+	if (!dev || !priv) {
+		free(dev);
+		free(priv);
+		return -ENOMEM;
+	}
+
+	priv->ifname = state->tap_name;
+	priv->fd = -1;
+	priv->drop = state->tap_drop;
+	priv->seed = 1;
+
+	sprintf(dev->name, "sb_tap");
+	dev->priv = priv;
+	dev->init = sb_tap_init;
+	dev->halt = sb_tap_halt;
+	dev->send = sb_tap_send;
+	dev->recv = sb_tap_recv;
+
+	return eth_register(dev);
+}
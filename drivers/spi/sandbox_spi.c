@@ -49,27 +49,14 @@ __weak int sandbox_spi_get_emul(struct sandbox_state *state,
 	return -ENOENT;
 }
 
-static int sandbox_spi_xfer(struct udevice *slave, unsigned int bitlen,
-			    const void *dout, void *din, unsigned long flags)
+/* Find the emulation for a slave and make sure it is probed */
+static int sandbox_spi_find_emul(struct udevice *slave, struct udevice **emulp)
 {
 	struct udevice *bus = slave->parent;
 	struct sandbox_state *state = state_get_current();
-	struct dm_spi_emul_ops *ops;
 	struct udevice *emul;
-	uint bytes = bitlen / 8, i;
-	int ret;
-	u8 *tx = (void *)dout, *rx = din;
 	uint busnum, cs;
-
-	if (bitlen == 0)
-		return 0;
-
-	/* we can only do 8 bit transfers */
-	if (bitlen % 8) {
-		printf("sandbox_spi: xfer: invalid bitlen size %u; needs to be 8bit\n",
-		       bitlen);
-		return -EINVAL;
-	}
+	int ret;
 
 	busnum = bus->seq;
 	cs = spi_chip_select(slave);
@@ -86,6 +73,33 @@ static int sandbox_spi_xfer(struct udevice *slave, unsigned int bitlen,
 		return -ENOENT;
 	}
 	ret = device_probe(emul);
+	if (ret)
+		return ret;
+	*emulp = emul;
+
+	return 0;
+}
+
+static int sandbox_spi_xfer(struct udevice *slave, unsigned int bitlen,
+			    const void *dout, void *din, unsigned long flags)
+{
+	struct dm_spi_emul_ops *ops;
+	struct udevice *emul;
+	uint bytes = bitlen / 8, i;
+	int ret;
+	u8 *tx = (void *)dout, *rx = din;
+
+	if (bitlen == 0)
+		return 0;
+
+	/* we can only do 8 bit transfers */
+	if (bitlen % 8) {
+		printf("sandbox_spi: xfer: invalid bitlen size %u; needs to be 8bit\n",
+		       bitlen);
+		return -EINVAL;
+	}
+
+	ret = sandbox_spi_find_emul(slave, &emul);
 	if (ret)
 		return ret;
 
@@ -124,6 +138,24 @@ static int sandbox_spi_xfer(struct udevice *slave, unsigned int bitlen,
 	return ret;
 }
 
+/* Act as a controller which can read a whole flash region in one go */
+static int sandbox_spi_read_flash(struct udevice *slave,
+				  struct spi_flash_read_msg *msg)
+{
+	struct dm_spi_emul_ops *ops;
+	struct udevice *emul;
+	int ret;
+
+	ret = sandbox_spi_find_emul(slave, &emul);
+	if (ret)
+		return ret;
+	ops = spi_emul_get_ops(emul);
+	if (!ops->read_flash)
+		return -ENOSYS;
+
+	return ops->read_flash(emul, msg);
+}
+
 static int sandbox_spi_set_speed(struct udevice *bus, uint speed)
 {
 	return 0;
@@ -146,6 +178,7 @@ static int sandbox_cs_info(struct udevice *bus, uint cs,
 
 static const struct dm_spi_ops sandbox_spi_ops = {
 	.xfer		= sandbox_spi_xfer,
+	.read_flash	= sandbox_spi_read_flash,
 	.set_speed	= sandbox_spi_set_speed,
 	.set_mode	= sandbox_spi_set_mode,
 	.cs_info	= sandbox_cs_info,
@@ -92,6 +92,18 @@ int spi_xfer(struct spi_slave *slave, unsigned int bitlen,
 	return spi_get_ops(bus)->xfer(dev, bitlen, dout, din, flags);
 }
 
+int spi_read_flash(struct spi_slave *slave, struct spi_flash_read_msg *msg)
+{
+	struct udevice *dev = slave->dev;
+	struct udevice *bus = dev->parent;
+	struct dm_spi_ops *ops = spi_get_ops(bus);
+
+	if (bus->uclass->uc_drv->id != UCLASS_SPI || !ops->read_flash)
+		return -ENOSYS;
+
+	return ops->read_flash(dev, msg);
+}
+
 int spi_post_bind(struct udevice *dev)
 {
 	/* Scan the bus for devices */
@@ -368,6 +380,19 @@ int spi_ofdata_to_platdata(const void *blob, int node,
 		mode |= SPI_PREAMBLE;
 	spi->mode = mode;
 
+	/* Extra data lines allow faster SPI flash commands */
+	switch (fdtdec_get_int(blob, node, "spi-rx-bus-width", 1)) {
+	case 4:
+		spi->op_mode_rx = SPI_OPM_RX_EXTN;
+		break;
+	case 2:
+		spi->op_mode_rx = SPI_OPM_RX_AS | SPI_OPM_RX_DOUT |
+				  SPI_OPM_RX_DIO;
+		break;
+	}
+	if (fdtdec_get_int(blob, node, "spi-tx-bus-width", 1) == 4)
+		spi->op_mode_tx = SPI_OPM_TX_QPP;
+
 	return 0;
 }
 
@@ -5,9 +5,11 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <fdtdec.h>
 #include <malloc.h>
 #include <spi.h>
+#include <linux/compiler.h>
 
 int spi_set_wordlen(struct spi_slave *slave, unsigned int wordlen)
 {
@@ -21,6 +23,13 @@ int spi_set_wordlen(struct spi_slave *slave, unsigned int wordlen)
 	return 0;
 }
 
+/* Controllers with a flash read engine can provide their own */
+__weak int spi_read_flash(struct spi_slave *slave,
+			  struct spi_flash_read_msg *msg)
+{
+	return -ENOSYS;
+}
+
 void *spi_do_alloc_slave(int offset, int size, unsigned int bus,
 			 unsigned int cs)
 {
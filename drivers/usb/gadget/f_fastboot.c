@@ -39,12 +39,27 @@
 
 #define EP_BUFFER_SIZE			4096
 
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+/* Requests queued at once on the OUT endpoint while streaming a download */
+#ifndef CONFIG_FASTBOOT_STREAM_REQS
+#define CONFIG_FASTBOOT_STREAM_REQS	2
+#endif
+/* Size of each of them, a multiple of the maximum packet size */
+#ifndef CONFIG_FASTBOOT_STREAM_REQ_SIZE
+#define CONFIG_FASTBOOT_STREAM_REQ_SIZE	16384
+#endif
+#endif
+
 struct f_fastboot {
 	struct usb_function usb_function;
 
 	/* IN/OUT EP's and corresponding requests */
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	/* OUT requests used for downloads written to flash as they arrive */
+	struct usb_request *stream_req[CONFIG_FASTBOOT_STREAM_REQS];
+#endif
 };
 
 static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
@@ -55,6 +70,7 @@ static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
 static struct f_fastboot *fastboot_func;
 static unsigned int download_size;
 static unsigned int download_bytes;
+static int download_streaming;
 
 static struct usb_endpoint_descriptor fs_ep_in = {
 	.bLength            = USB_DT_ENDPOINT_SIZE,
@@ -172,6 +188,7 @@ static void fastboot_unbind(struct usb_configuration *c, struct usb_function *f)
 static void fastboot_disable(struct usb_function *f)
 {
 	struct f_fastboot *f_fb = func_to_fastboot(f);
+	int __maybe_unused i;
 
 	usb_ep_disable(f_fb->out_ep);
 	usb_ep_disable(f_fb->in_ep);
@@ -186,9 +203,21 @@ static void fastboot_disable(struct usb_function *f)
 		usb_ep_free_request(f_fb->in_ep, f_fb->in_req);
 		f_fb->in_req = NULL;
 	}
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	for (i = 0; i < CONFIG_FASTBOOT_STREAM_REQS; i++) {
+		if (f_fb->stream_req[i]) {
+			free(f_fb->stream_req[i]->buf);
+			usb_ep_free_request(f_fb->out_ep, f_fb->stream_req[i]);
+			f_fb->stream_req[i] = NULL;
+		}
+	}
+	fb_mmc_stream_cancel();
+#endif
+	download_streaming = 0;
 }
 
-static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
+static struct usb_request *fastboot_start_ep(struct usb_ep *ep,
+					     unsigned int size)
 {
 	struct usb_request *req;
 
@@ -196,8 +225,8 @@ static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
 	if (!req)
 		return NULL;
 
-	req->length = EP_BUFFER_SIZE;
-	req->buf = memalign(CONFIG_SYS_CACHELINE_SIZE, EP_BUFFER_SIZE);
+	req->length = size;
+	req->buf = memalign(CONFIG_SYS_CACHELINE_SIZE, size);
 	if (!req->buf) {
 		usb_ep_free_request(ep, req);
 		return NULL;
@@ -228,7 +257,7 @@ static int fastboot_set_alt(struct usb_function *f,
 		return ret;
 	}
 
-	f_fb->out_req = fastboot_start_ep(f_fb->out_ep);
+	f_fb->out_req = fastboot_start_ep(f_fb->out_ep, EP_BUFFER_SIZE);
 	if (!f_fb->out_req) {
 		puts("failed to alloc out req\n");
 		ret = -EINVAL;
@@ -242,7 +271,7 @@ static int fastboot_set_alt(struct usb_function *f,
 		goto err;
 	}
 
-	f_fb->in_req = fastboot_start_ep(f_fb->in_ep);
+	f_fb->in_req = fastboot_start_ep(f_fb->in_ep, EP_BUFFER_SIZE);
 	if (!f_fb->in_req) {
 		puts("failed alloc req in\n");
 		ret = -EINVAL;
@@ -330,6 +359,15 @@ static int strcmp_l1(const char *s1, const char *s2)
 	return strncmp(s1, s2, strlen(s1));
 }
 
+static unsigned int fastboot_max_download_size(void)
+{
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	if (fb_mmc_stream_max_size())
+		return fb_mmc_stream_max_size();
+#endif
+	return CONFIG_USB_FASTBOOT_BUF_SIZE;
+}
+
 static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
@@ -355,7 +393,7 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 		!strcmp_l1("max-download-size", cmd)) {
 		char str_num[12];
 
-		sprintf(str_num, "0x%08x", CONFIG_USB_FASTBOOT_BUF_SIZE);
+		sprintf(str_num, "0x%08x", fastboot_max_download_size());
 		strncat(response, str_num, chars_left);
 	} else if (!strcmp_l1("serialno", cmd)) {
 		s = getenv("serial#");
@@ -381,13 +419,27 @@ static unsigned int rx_bytes_expected(void)
 }
 
 #define BYTES_PER_DOT	0x20000
+static void fastboot_dl_progress(unsigned int transfer_size)
+{
+	unsigned int pre_dot_num, now_dot_num;
+
+	pre_dot_num = download_bytes / BYTES_PER_DOT;
+	download_bytes += transfer_size;
+	now_dot_num = download_bytes / BYTES_PER_DOT;
+
+	if (pre_dot_num != now_dot_num) {
+		putc('.');
+		if (!(now_dot_num % 74))
+			putc('\n');
+	}
+}
+
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
 	char response[RESPONSE_LEN];
 	unsigned int transfer_size = download_size - download_bytes;
 	const unsigned char *buffer = req->buf;
 	unsigned int buffer_size = req->actual;
-	unsigned int pre_dot_num, now_dot_num;
 
 	if (req->status != 0) {
 		printf("Bad status: %d\n", req->status);
@@ -400,15 +452,7 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	memcpy((void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_bytes,
 	       buffer, transfer_size);
 
-	pre_dot_num = download_bytes / BYTES_PER_DOT;
-	download_bytes += transfer_size;
-	now_dot_num = download_bytes / BYTES_PER_DOT;
-
-	if (pre_dot_num != now_dot_num) {
-		putc('.');
-		if (!(now_dot_num % 74))
-			putc('\n');
-	}
+	fastboot_dl_progress(transfer_size);
 
 	/* Check if transfer is done */
 	if (download_bytes >= download_size) {
@@ -434,6 +478,89 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	usb_ep_queue(ep, req, 0);
 }
 
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+/* Bytes that the queued streaming requests are waiting for */
+static int stream_queued;
+
+/* Queue 'req' for the next part of a streamed download, if any is left */
+static void fastboot_stream_queue(struct usb_ep *ep, struct usb_request *req)
+{
+	int left = download_size - download_bytes - stream_queued;
+
+	if (left <= 0)
+		return;
+
+	req->length = min(left, CONFIG_FASTBOOT_STREAM_REQ_SIZE);
+	if (req->length < ep->maxpacket)
+		req->length = ep->maxpacket;
+	req->actual = 0;
+	stream_queued += req->length;
+	usb_ep_queue(ep, req, 0);
+}
+
+/*
+ * Several requests are queued on the OUT endpoint. While one of them is
+ * written to flash here, the controller receives the next ones.
+ */
+static void rx_handler_dl_stream(struct usb_ep *ep, struct usb_request *req)
+{
+	unsigned int transfer_size = download_size - download_bytes;
+	struct usb_request *out_req = fastboot_func->out_req;
+
+	stream_queued -= req->length;
+	if (req->status != 0) {
+		printf("Bad status: %d\n", req->status);
+		return;
+	}
+
+	if (req->actual < transfer_size)
+		transfer_size = req->actual;
+
+	fb_mmc_stream_write(req->buf, transfer_size);
+	fastboot_dl_progress(transfer_size);
+
+	if (download_bytes < download_size) {
+		fastboot_stream_queue(ep, req);
+		return;
+	}
+
+	printf("\ndownloading of %d bytes finished\n", download_bytes);
+	fb_mmc_stream_end();
+	download_size = 0;
+	download_streaming = 0;
+	fastboot_tx_write_str("OKAY");
+
+	/* Back to receiving commands */
+	out_req->actual = 0;
+	usb_ep_queue(ep, out_req, 0);
+}
+
+static int fastboot_stream_start(struct usb_ep *ep)
+{
+	struct f_fastboot *f_fb = fastboot_func;
+	int i;
+
+	for (i = 0; i < CONFIG_FASTBOOT_STREAM_REQS; i++) {
+		if (f_fb->stream_req[i])
+			continue;
+
+		f_fb->stream_req[i] = fastboot_start_ep(ep,
+					CONFIG_FASTBOOT_STREAM_REQ_SIZE);
+		if (!f_fb->stream_req[i])
+			return -ENOMEM;
+		f_fb->stream_req[i]->complete = rx_handler_dl_stream;
+	}
+
+	fb_mmc_stream_start(download_size);
+	download_streaming = 1;
+	stream_queued = 0;
+	for (i = 0; i < CONFIG_FASTBOOT_STREAM_REQS; i++)
+		fastboot_stream_queue(ep, f_fb->stream_req[i]);
+
+	return 0;
+}
+#endif
+
 static void cb_download(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
@@ -447,9 +574,18 @@ static void cb_download(struct usb_ep *ep, struct usb_request *req)
 
 	if (0 == download_size) {
 		sprintf(response, "FAILdata invalid size");
-	} else if (download_size > CONFIG_USB_FASTBOOT_BUF_SIZE) {
+	} else if (download_size > fastboot_max_download_size()) {
 		download_size = 0;
 		sprintf(response, "FAILdata too large");
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	} else if (fb_mmc_stream_max_size()) {
+		if (fastboot_stream_start(ep)) {
+			download_size = 0;
+			sprintf(response, "FAILout of memory");
+		} else {
+			sprintf(response, "DATA%08x", download_size);
+		}
+#endif
 	} else {
 		sprintf(response, "DATA%08x", download_size);
 		req->complete = rx_handler_dl_image;
@@ -495,13 +631,32 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 
 	strcpy(response, "FAILno flash device defined");
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
-	fb_mmc_flash_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
-			   download_bytes, response);
+	if (!fb_mmc_flash_streamed(cmd, response))
+		fb_mmc_flash_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
+				   download_bytes, response);
 #endif
 	fastboot_tx_write_str(response);
 }
 #endif
 
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+/*
+ * "oem stream <partition>" writes the next download to the partition while
+ * it arrives, "oem stream" goes back to downloading into RAM
+ */
+static void cb_oem_stream(struct usb_ep *ep, struct usb_request *req)
+{
+	char *cmd = req->buf + strlen("oem stream");
+	char response[RESPONSE_LEN] = "";
+
+	while (*cmd == ' ' || *cmd == ':')
+		cmd++;
+
+	fb_mmc_stream_prepare(cmd, response);
+	fastboot_tx_write_str(response);
+}
+#endif
+
 struct cmd_dispatch_info {
 	char *cmd;
 	void (*cb)(struct usb_ep *ep, struct usb_request *req);
@@ -527,6 +682,12 @@ static const struct cmd_dispatch_info cmd_dispatch_info[] = {
 		.cb = cb_flash,
 	},
 #endif
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	{
+		.cmd = "oem stream",
+		.cb = cb_oem_stream,
+	},
+#endif
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
@@ -556,7 +717,8 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 		}
 	}
 
-	if (req->status == 0) {
+	/* A streamed download uses other requests, see cb_download() */
+	if (req->status == 0 && !download_streaming) {
 		*cmdbuf = '\0';
 		req->actual = 0;
 		usb_ep_queue(ep, req, 0);
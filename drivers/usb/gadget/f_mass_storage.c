@@ -318,6 +318,13 @@ struct fsg_common {
 	struct fsg_buffhd	*next_buffhd_to_drain;
 	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
 
+	/* Sectors following a sequential read, fetched ahead of time */
+	void			*ra_buf;
+	u32			ra_lba;		/* First sector in ra_buf */
+	u32			ra_count;	/* Valid sectors in ra_buf */
+	u32			ra_next;	/* Sector after the last read */
+	int			ra_wanted;
+
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
 
@@ -697,16 +704,86 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Buffers are read from and written to the medium in runs of up to half
+ * the ring, so the other half can be on the wire meanwhile.  The buffers
+ * are allocated as one block, which makes a run that does not wrap around
+ * the end of the ring a single contiguous buffer.
+ */
+#define FSG_RUN		(FSG_NUM_BUFFERS > 1 ? FSG_NUM_BUFFERS / 2 : 1)
+
+/* Count the buffers in state @state from @bh on, up to a run */
+static unsigned int fsg_run_length(struct fsg_common *common,
+				   struct fsg_buffhd *bh,
+				   enum fsg_buffer_state state)
+{
+	unsigned int n = 0;
+
+	while (n < FSG_RUN && bh + n < common->buffhds + FSG_NUM_BUFFERS &&
+	       bh[n].state == state)
+		n++;
+
+	return n;
+}
+
+/*
+ * Read sectors, taking what the read-ahead buffer already holds from
+ * there.  Returns the number of sectors read.
+ */
+static int fsg_read(struct fsg_common *common, u32 lba, u32 count, void *buf)
+{
+	u32 n = 0;
+	int rc;
+
+	if (lba >= common->ra_lba &&
+	    lba < common->ra_lba + common->ra_count) {
+		n = min(count, common->ra_lba + common->ra_count - lba);
+		memcpy(buf, common->ra_buf + ((lba - common->ra_lba) << 9),
+		       n << 9);
+		if (n == count)
+			return n;
+	}
+
+	rc = ums->read_sector(ums, lba + n, count - n, buf + (n << 9));
+
+	return rc > 0 ? n + rc : n;
+}
+
+/*
+ * Fetch the sectors following a sequential read into the read-ahead
+ * buffer.  Called while the host sends the next CBW.
+ */
+static void fsg_read_ahead(struct fsg_common *common)
+{
+	struct fsg_lun	*curlun = &common->luns[common->lun];
+	u32		count;
+	int		rc;
+
+	if (!common->ra_wanted)
+		return;
+	common->ra_wanted = 0;
+
+	common->ra_lba = common->ra_next;
+	common->ra_count = 0;
+	if (common->ra_lba >= curlun->num_sectors)
+		return;
+
+	count = min((u32)(FSG_RUN * FSG_BUFLEN / SECTOR_SIZE),
+		    (u32)(curlun->num_sectors - common->ra_lba));
+	rc = ums->read_sector(ums, common->ra_lba, count, common->ra_buf);
+	if (rc > 0)
+		common->ra_count = rc;
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = &common->luns[common->lun];
-	u32			lba;
+	u32			lba, end;
 	struct fsg_buffhd	*bh;
 	int			rc;
 	u32			amount_left;
 	loff_t			file_offset;
-	unsigned int		amount;
-	unsigned int		partial_page;
+	unsigned int		amount, left;
 	ssize_t			nread;
 
 	/* Get the starting Logical Block Address and check that it's
@@ -737,20 +814,6 @@ static int do_read(struct fsg_common *common)
 
 	for (;;) {
 
-		/* Figure out how much we need to read:
-		 * Try to read the remaining amount.
-		 * But don't read more than the buffer size.
-		 * And don't try to read past the end of the file.
-		 * Finally, if we're not at a page boundary, don't read past
-		 *	the next page.
-		 * If this means reading 0 then we were asked to read past
-		 *	the end of file. */
-		amount = min(amount_left, FSG_BUFLEN);
-		partial_page = file_offset & (PAGE_CACHE_SIZE - 1);
-		if (partial_page > 0)
-			amount = min(amount, (unsigned int) PAGE_CACHE_SIZE -
-					partial_page);
-
 		/* Wait for the next buffer to become available */
 		bh = common->next_buffhd_to_fill;
 		while (bh->state != BUF_STATE_EMPTY) {
@@ -759,22 +822,17 @@ static int do_read(struct fsg_common *common)
 				return rc;
 		}
 
-		/* If we were asked to read past the end of file,
-		 * end with an empty buffer. */
-		if (amount == 0) {
-			curlun->sense_data =
-					SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
-			curlun->info_valid = 1;
-			bh->inreq->length = 0;
-			bh->state = BUF_STATE_FULL;
-			break;
-		}
+		/* Figure out how much we need to read:
+		 * Try to read the remaining amount.
+		 * But don't read more than the empty buffers following
+		 *	this one can hold. */
+		amount = min(amount_left,
+			     fsg_run_length(common, bh, BUF_STATE_EMPTY) *
+			     FSG_BUFLEN);
 
 		/* Perform the read */
-		rc = ums->read_sector(ums,
-				      file_offset / SECTOR_SIZE,
-				      amount / SECTOR_SIZE,
-				      (char __user *)bh->buf);
+		rc = fsg_read(common, file_offset / SECTOR_SIZE,
+			      amount / SECTOR_SIZE, (char __user *)bh->buf);
 		if (!rc)
 			return -EIO;
 
@@ -796,8 +854,27 @@ static int do_read(struct fsg_common *common)
 		file_offset  += nread;
 		amount_left  -= nread;
 		common->residue -= nread;
-		bh->inreq->length = nread;
-		bh->state = BUF_STATE_FULL;
+
+		/* Send the buffers, except the last one of the command,
+		 * which finish_reply() sends */
+		for (left = nread;;) {
+			bh->inreq->length = min(left, FSG_BUFLEN);
+			bh->state = BUF_STATE_FULL;
+			left -= bh->inreq->length;
+			if (!left && (nread < amount || amount_left == 0))
+				break;
+
+			bh->inreq->zero = 0;
+			START_TRANSFER_OR(common, bulk_in, bh->inreq,
+				       &bh->inreq_busy, &bh->state)
+				/* Don't know what to do if
+				 * common->fsg is NULL */
+				return -EIO;
+			common->next_buffhd_to_fill = bh->next;
+			if (!left)
+				break;
+			bh = bh->next;
+		}
 
 		/* If an error occurred, report it and its position */
 		if (nread < amount) {
@@ -808,17 +885,17 @@ static int do_read(struct fsg_common *common)
 
 		if (amount_left == 0)
 			break;		/* No more left to read */
-
-		/* Send this buffer and go read some more */
-		bh->inreq->zero = 0;
-		START_TRANSFER_OR(common, bulk_in, bh->inreq,
-			       &bh->inreq_busy, &bh->state)
-			/* Don't know what to do if
-			 * common->fsg is NULL */
-			return -EIO;
-		common->next_buffhd_to_fill = bh->next;
 	}
 
+	/* A read that picks up where the previous one ended is probably
+	 * part of a sequential stream: fetch what follows unless the
+	 * read-ahead buffer already holds it */
+	end = file_offset / SECTOR_SIZE;
+	if (lba == common->ra_next &&
+	    (end < common->ra_lba || end >= common->ra_lba + common->ra_count))
+		common->ra_wanted = 1;
+	common->ra_next = end;
+
 	return -EIO;		/* No default reply */
 }
 
@@ -833,7 +910,8 @@ static int do_write(struct fsg_common *common)
 	u32			amount_left_to_req, amount_left_to_write;
 	loff_t			usb_offset, file_offset;
 	unsigned int		amount;
-	unsigned int		partial_page;
+	unsigned int		i, n;
+	void			*buf;
 	ssize_t			nwritten;
 	int			rc;
 
@@ -863,6 +941,10 @@ static int do_write(struct fsg_common *common)
 		return -EINVAL;
 	}
 
+	/* Whatever was read ahead may be overwritten now */
+	common->ra_count = 0;
+	common->ra_wanted = 0;
+
 	/* Carry out the file writes */
 	get_some_more = 1;
 	file_offset = usb_offset = ((loff_t) lba) << 9;
@@ -879,16 +961,12 @@ static int do_write(struct fsg_common *common)
 			 * Try to get the remaining amount.
 			 * But don't get more than the buffer size.
 			 * And don't try to go past the end of the file.
-			 * If we're not at a page boundary,
-			 *	don't go past the next page.
 			 * If this means getting 0, then we were asked
 			 *	to write past the end of file.
-			 * Finally, round down to a block boundary. */
+			 * Finally, round down to a block boundary.
+			 * Only the last buffer of a command is left partly
+			 * empty, so that full ones can be written together. */
 			amount = min(amount_left_to_req, FSG_BUFLEN);
-			partial_page = usb_offset & (PAGE_CACHE_SIZE - 1);
-			if (partial_page > 0)
-				amount = min(amount,
-	(unsigned int) PAGE_CACHE_SIZE - partial_page);
 
 			if (amount == 0) {
 				get_some_more = 0;
@@ -932,23 +1010,51 @@ static int do_write(struct fsg_common *common)
 		if (bh->state == BUF_STATE_EMPTY && !get_some_more)
 			break;			/* We stopped early */
 		if (bh->state == BUF_STATE_FULL) {
-			common->next_buffhd_to_drain = bh->next;
-			bh->state = BUF_STATE_EMPTY;
 
 			/* Did something go wrong with the transfer? */
 			if (bh->outreq->status != 0) {
+				common->next_buffhd_to_drain = bh->next;
+				bh->state = BUF_STATE_EMPTY;
 				curlun->sense_data = SS_COMMUNICATION_FAILURE;
 				curlun->info_valid = 1;
 				break;
 			}
 
-			amount = bh->outreq->actual;
+			/* Write the following buffers along with this one
+			 * while the previous one is completely full and the
+			 * next one was received without error.  Wait for one
+			 * still being received to complete first. */
+			n = fsg_run_length(common, bh, BUF_STATE_FULL);
+			for (i = 1; i < n; i++) {
+				if (bh[i - 1].outreq->actual != FSG_BUFLEN ||
+				    bh[i].outreq->status != 0)
+					break;
+			}
+			n = i;
+			if (n < FSG_RUN &&
+			    bh[n - 1].outreq->actual == FSG_BUFLEN &&
+			    bh + n < common->buffhds + FSG_NUM_BUFFERS &&
+			    bh[n].state == BUF_STATE_BUSY) {
+				rc = sleep_thread(common);
+				if (rc)
+					return rc;
+				continue;
+			}
+
+			amount = 0;
+			for (i = 0; i < n; i++) {
+				amount += bh[i].outreq->actual;
+				bh[i].state = BUF_STATE_EMPTY;
+			}
+			common->next_buffhd_to_drain = bh[n - 1].next;
+			buf = bh->buf;
+			bh += n - 1;
 
 			/* Perform the write */
 			rc = ums->write_sector(ums,
 					       file_offset / SECTOR_SIZE,
 					       amount / SECTOR_SIZE,
-					       (char __user *)bh->buf);
+					       (char __user *)buf);
 			if (!rc)
 				return -EIO;
 			nwritten = rc * SECTOR_SIZE;
@@ -2145,6 +2251,9 @@ static int get_next_command(struct fsg_common *common)
 	 * can reuse it for the next filling.  No need to advance
 	 * next_buffhd_to_fill. */
 
+	/* Keep the medium busy while the host sends the CBW */
+	fsg_read_ahead(common);
+
 	/* Wait for the CBW to arrive */
 	while (bh->state != BUF_STATE_FULL) {
 		rc = sleep_thread(common);
@@ -2452,6 +2561,7 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 	struct usb_gadget *gadget = cdev->gadget;
 	struct fsg_buffhd *bh;
 	struct fsg_lun *curlun;
+	char *buf;
 	int nluns, i, rc;
 
 	/* Find out how many LUNs there should be */
@@ -2506,7 +2616,14 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 	}
 	common->lun = 0;
 
-	/* Data buffers cyclic list */
+	/* Data buffers cyclic list, in one block so runs of them can be
+	 * read and written at once */
+	buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+		       FSG_NUM_BUFFERS * FSG_BUFLEN);
+	if (unlikely(!buf)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
 	bh = common->buffhds;
 
 	i = FSG_NUM_BUFFERS;
@@ -2517,14 +2634,18 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 buffhds_first_it:
 		bh->inreq_busy = 0;
 		bh->outreq_busy = 0;
-		bh->buf = memalign(CONFIG_SYS_CACHELINE_SIZE, FSG_BUFLEN);
-		if (unlikely(!bh->buf)) {
-			rc = -ENOMEM;
-			goto error_release;
-		}
+		bh->buf = buf;
+		buf += FSG_BUFLEN;
 	} while (--i);
 	bh->next = common->buffhds;
 
+	common->ra_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+				  FSG_RUN * FSG_BUFLEN);
+	if (unlikely(!common->ra_buf)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
+
 	snprintf(common->inquiry_string, sizeof common->inquiry_string,
 		 "%-8s%-16s%04x",
 		 "Linux   ",
@@ -2583,13 +2704,8 @@ static void fsg_common_release(struct kref *ref)
 		kfree(common->luns);
 	}
 
-	{
-		struct fsg_buffhd *bh = common->buffhds;
-		unsigned i = FSG_NUM_BUFFERS;
-		do {
-			kfree(bh->buf);
-		} while (++bh, --i);
-	}
+	kfree(common->buffhds[0].buf);
+	kfree(common->ra_buf);
 
 	if (common->free_storage_on_release)
 		kfree(common);
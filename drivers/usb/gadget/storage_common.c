@@ -305,11 +305,23 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
-/* Number of buffers we will use.  2 is enough for double-buffering */
-#define FSG_NUM_BUFFERS	2
+/*
+ * Number of buffers we will use.  2 is enough for double-buffering, more
+ * let the medium be read or written several buffers at a time while the
+ * rest of the ring is on the wire.
+ */
+#ifdef CONFIG_UMS_NUM_BUFFERS
+#define FSG_NUM_BUFFERS	CONFIG_UMS_NUM_BUFFERS
+#else
+#define FSG_NUM_BUFFERS	4
+#endif
 
-/* Default size of buffer length. */
+/* Default size of buffer length, a multiple of the sector size. */
+#ifdef CONFIG_UMS_BUFLEN
+#define FSG_BUFLEN	((u32)CONFIG_UMS_BUFLEN)
+#else
 #define FSG_BUFLEN	((u32)16384)
+#endif
 
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
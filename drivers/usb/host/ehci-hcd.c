@@ -296,14 +296,21 @@ static void ehci_update_endpt2_dev_n_port(struct usb_device *dev,
 				     QH_ENDPT2_HUBADDR(ttdev->parent->devnum));
 }
 
+/*
+ * Submit a transfer on the async schedule and wait for it. If buffer2 is not
+ * NULL, a second bulk-in transfer of length2 bytes is queued behind the data
+ * and its length is returned in *actual2.
+ */
 static int
 ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
-		   int length, struct devrequest *req)
+		   int length, struct devrequest *req, void *buffer2,
+		   int length2, int *actual2)
 {
 	ALLOC_ALIGN_BUFFER(struct QH, qh, 1, USB_DMA_MINALIGN);
 	struct qTD *qtd;
 	int qtd_count = 0;
 	int qtd_counter = 0;
+	int data_first, data_end, i;
 	volatile struct qTD *vtd;
 	unsigned long ts;
 	uint32_t *tdp;
@@ -375,6 +382,8 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		 */
 		qtd_count += 2 + length / xfr_sz;
 	}
+	if (buffer2 != NULL)
+		qtd_count++;
 /*
  * Threshold value based on the worst-case total size of the allocated qTDs for
  * a mass-storage transfer of 65535 blocks of 512 bytes.
@@ -406,9 +415,15 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	qh->qh_link = cpu_to_hc32((uint32_t)&ctrl->qh_list | QH_LINK_TYPE_QH);
 	c = (dev->speed != USB_SPEED_HIGH) && !usb_pipeendpoint(pipe);
 	maxpacket = usb_maxpacket(dev, pipe);
+	/*
+	 * The data toggle normally comes from each qTD. When a second
+	 * transfer is queued we cannot know in advance where the first one
+	 * ends, so let the controller keep track of it in the QH instead.
+	 */
 	endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(c) |
 		QH_ENDPT1_MAXPKTLEN(maxpacket) | QH_ENDPT1_H(0) |
-		QH_ENDPT1_DTC(QH_ENDPT1_DTC_DT_FROM_QTD) |
+		QH_ENDPT1_DTC(buffer2 ? QH_ENDPT1_DTC_IGNORE_QTD_TD :
+			      QH_ENDPT1_DTC_DT_FROM_QTD) |
 		QH_ENDPT1_EPS(ehci_encode_speed(dev->speed)) |
 		QH_ENDPT1_ENDPT(usb_pipeendpoint(pipe)) | QH_ENDPT1_I(0) |
 		QH_ENDPT1_DEVADDR(usb_pipedevice(pipe));
@@ -418,6 +433,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	ehci_update_endpt2_dev_n_port(dev, qh);
 	qh->qh_overlay.qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
 	qh->qh_overlay.qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qh_overlay.qt_token = cpu_to_hc32(QT_TOKEN_DT(toggle));
 
 	tdp = &qh->qh_overlay.qt_next;
 
@@ -448,6 +464,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		toggle = 1;
 	}
 
+	data_first = qtd_counter;
 	if (length > 0 || req == NULL) {
 		uint8_t *buf_ptr = buffer;
 		int left_length = length;
@@ -515,6 +532,31 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 			left_length -= xfr_bytes;
 		} while (left_length > 0);
 	}
+	data_end = qtd_counter;
+
+	if (buffer2 != NULL) {
+		/*
+		 * A short packet ends the data early: send the controller
+		 * straight to this qTD rather than the rest of the data qTDs.
+		 */
+		for (i = data_first; i < data_end; i++)
+			qtd[i].qt_altnext =
+				cpu_to_hc32((uint32_t)&qtd[qtd_counter]);
+		qtd[qtd_counter].qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+		qtd[qtd_counter].qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+		token = QT_TOKEN_TOTALBYTES(length2) | QT_TOKEN_IOC(1) |
+			QT_TOKEN_CPAGE(0) | QT_TOKEN_CERR(3) |
+			QT_TOKEN_PID(QT_TOKEN_PID_IN) |
+			QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE);
+		qtd[qtd_counter].qt_token = cpu_to_hc32(token);
+		if (ehci_td_buffer(&qtd[qtd_counter], buffer2, length2)) {
+			printf("unable to construct second DATA TD\n");
+			goto fail;
+		}
+		/* Update previous qTD! */
+		*tdp = cpu_to_hc32((uint32_t)&qtd[qtd_counter]);
+		tdp = &qtd[qtd_counter++].qt_next;
+	}
 
 	if (req != NULL) {
 		/*
@@ -580,6 +622,10 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		token = hc32_to_cpu(vtd->qt_token);
 		if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE))
 			break;
+		/* An error halts the queue before it reaches the last qTD */
+		if (QT_TOKEN_GET_STATUS(hc32_to_cpu(qh->qh_overlay.qt_token)) &
+		    QT_TOKEN_STATUS_HALTED)
+			break;
 		WATCHDOG_RESET();
 	} while (get_timer(ts) < timeout);
 
@@ -594,9 +640,14 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	 */
 	invalidate_dcache_range((uint32_t)buffer,
 		ALIGN((uint32_t)buffer + length, ARCH_DMA_MINALIGN));
+	if (buffer2 != NULL)
+		invalidate_dcache_range((uint32_t)buffer2,
+			ALIGN((uint32_t)buffer2 + length2, ARCH_DMA_MINALIGN));
 
 	/* Check that the TD processing happened */
-	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)
+	if ((QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE) &&
+	    !(QT_TOKEN_GET_STATUS(hc32_to_cpu(qh->qh_overlay.qt_token)) &
+	      QT_TOKEN_STATUS_HALTED))
 		printf("EHCI timed out on TD - token=%#x\n", token);
 
 	/* Disable async schedule. */
@@ -640,6 +691,18 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 			break;
 		}
 		dev->act_len = length - QT_TOKEN_GET_TOTALBYTES(token);
+		if (buffer2 != NULL) {
+			/* Data qTDs skipped after a short packet count too */
+			dev->act_len = length;
+			for (i = data_first; i < data_end; i++)
+				dev->act_len -= QT_TOKEN_GET_TOTALBYTES(
+						hc32_to_cpu(qtd[i].qt_token));
+			token = hc32_to_cpu(vtd->qt_token);
+			if (!(QT_TOKEN_GET_STATUS(token) &
+			      QT_TOKEN_STATUS_ACTIVE))
+				*actual2 = length2 -
+					QT_TOKEN_GET_TOTALBYTES(token);
+		}
 	} else {
 		dev->act_len = 0;
 #ifndef CONFIG_USB_EHCI_FARADAY
@@ -1083,7 +1146,30 @@ submit_bulk_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 		debug("non-bulk pipe (type=%lu)", usb_pipetype(pipe));
 		return -1;
 	}
-	return ehci_submit_async(dev, pipe, buffer, length, NULL);
+	return ehci_submit_async(dev, pipe, buffer, length, NULL, NULL, 0,
+				 NULL);
+}
+
+int
+submit_bulk_msg_pair(struct usb_device *dev, unsigned long pipe, void *buffer,
+		     int length, void *buffer2, int length2, int *actual2)
+{
+
+	if (usb_pipetype(pipe) != PIPE_BULK || !usb_pipein(pipe)) {
+		debug("non-bulk-in pipe (type=%lu)", usb_pipetype(pipe));
+		return -1;
+	}
+	return ehci_submit_async(dev, pipe, buffer, length, NULL, buffer2,
+				 length2, actual2);
+}
+
+/*
+ * Transfers are only limited by the heap space for their qTDs (see the
+ * CONFIG_SYS_MALLOC_LEN check in ehci_submit_async())
+ */
+size_t usb_max_xfer_size(struct usb_device *dev)
+{
+	return ~(size_t)0;
 }
 
 int
@@ -1102,7 +1188,8 @@ submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 			dev->speed = USB_SPEED_HIGH;
 		return ehci_submit_root(dev, pipe, buffer, length, setup);
 	}
-	return ehci_submit_async(dev, pipe, buffer, length, setup);
+	return ehci_submit_async(dev, pipe, buffer, length, setup, NULL, 0,
+				 NULL);
 }
 
 struct int_queue {
@@ -890,6 +890,21 @@ submit_bulk_msg(struct usb_device *udev, unsigned long pipe, void *buffer,
 	return xhci_bulk_tx(udev, pipe, length, buffer);
 }
 
+/**
+ * returns the largest bulk transfer which fits on an endpoint ring
+ *
+ * Each TRB covers at most 64KB and the ring has a single segment. One TRB
+ * goes on the link, one more may be needed for an unaligned buffer and one
+ * must stay free so that the ring never looks empty when it is full.
+ *
+ * @param udev	pointer to the USB device
+ * @return maximum transfer size in bytes
+ */
+size_t usb_max_xfer_size(struct usb_device *udev)
+{
+	return (TRBS_PER_SEGMENT - 3) * TRB_MAX_BUFF_SIZE;
+}
+
 /**
  * submit the control type of request to the Root hub/Device based on the devnum
  *
@@ -845,36 +845,171 @@ int ext4fs_filename_check(char *filename)
 	return -1;
 }
 
+static inline int ext4fs_bmap_test(unsigned char *bmap, unsigned int bit)
+{
+	return bmap[bit / 8] & (1 << (bit % 8));
+}
+
+static inline void ext4fs_bmap_set(unsigned char *bmap, unsigned int bit)
+{
+	bmap[bit / 8] |= 1 << (bit % 8);
+}
+
+static int ext4fs_is_power_of(unsigned int n, unsigned int base)
+{
+	while (n > 1 && n % base == 0)
+		n /= base;
+
+	return n == 1;
+}
+
+/* Whether block group @group holds a backup of the superblock and GDT */
+static int ext4fs_bg_has_super(unsigned int group)
+{
+	struct ext_filesystem *fs = get_fs();
+
+	if (group <= 1 || !(fs->sb->feature_ro_compat &
+			    EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER))
+		return 1;
+
+	return ext4fs_is_power_of(group, 3) || ext4fs_is_power_of(group, 5) ||
+		ext4fs_is_power_of(group, 7);
+}
+
+/*
+ * Build the block bitmap of a group which is still EXT4_BG_BLOCK_UNINIT:
+ * only the superblock backup and the metadata of the group itself, if it is
+ * located in the group, are in use.
+ */
+static void ext4fs_init_block_bmap(unsigned char *bmap, unsigned int group)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = &fs->bgd[group];
+	uint32_t blk_per_grp = fs->sb->blocks_per_group;
+	uint32_t start = fs->sb->first_data_block + group * blk_per_grp;
+	uint32_t itable_blocks = fs->sb->inodes_per_group * fs->inodesz /
+		fs->blksz;
+	uint32_t i, len;
+
+	if (ext4fs_bg_has_super(group)) {
+		len = 1 + fs->no_blk_pergdt +
+			le16_to_cpu(fs->sb->reserved_gdt_blocks);
+		for (i = 0; i < len; i++)
+			ext4fs_bmap_set(bmap, i);
+	}
+	if (bgd->block_id - start < blk_per_grp)
+		ext4fs_bmap_set(bmap, bgd->block_id - start);
+	if (bgd->inode_id - start < blk_per_grp)
+		ext4fs_bmap_set(bmap, bgd->inode_id - start);
+	for (i = 0; i < itable_blocks; i++) {
+		if (bgd->inode_table_id + i - start < blk_per_grp)
+			ext4fs_bmap_set(bmap, bgd->inode_table_id + i - start);
+	}
+
+	/* past the end of the group or of the filesystem nothing is free */
+	len = min(blk_per_grp, fs->sb->total_blocks - start);
+	for (i = len; i < fs->blksz * 8; i++)
+		ext4fs_bmap_set(bmap, i);
+}
+
+static void ext4fs_init_inode_bmap(unsigned char *bmap, unsigned int group)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t i;
+
+	for (i = fs->sb->inodes_per_group; i < fs->blksz * 8; i++)
+		ext4fs_bmap_set(bmap, i);
+}
+
+/*
+ * Bitmaps are only read when a block group is first allocated from or freed
+ * to, and logged to the journal then. The group is marked dirty so that
+ * ext4fs_update() writes back its bitmap and descriptor, and nothing else.
+ */
+static unsigned char *ext4fs_get_bmap(unsigned int index, int dirty)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = &fs->bgd[index];
+	unsigned char **bmaps;
+	unsigned char *bmap;
+	uint16_t uninit;
+	uint32_t blknr;
+
+	if (dirty == EXT4_BG_BLOCK_DIRTY) {
+		bmaps = fs->blk_bmaps;
+		uninit = EXT4_BG_BLOCK_UNINIT;
+		blknr = bgd->block_id;
+	} else {
+		bmaps = fs->inode_bmaps;
+		uninit = EXT4_BG_INODE_UNINIT;
+		blknr = bgd->inode_id;
+	}
+
+	if (!bmaps[index]) {
+		bmap = zalloc(fs->blksz);
+		if (!bmap)
+			return NULL;
+		if (bgd->bg_flags & uninit) {
+			if (dirty == EXT4_BG_BLOCK_DIRTY)
+				ext4fs_init_block_bmap(bmap, index);
+			else
+				ext4fs_init_inode_bmap(bmap, index);
+			bgd->bg_flags &= ~uninit;
+		} else if (!ext4fs_devread((lbaint_t)blknr * fs->sect_perblk,
+					   0, fs->blksz, (char *)bmap)) {
+			free(bmap);
+			return NULL;
+		}
+		if (ext4fs_log_journal((char *)bmap, blknr)) {
+			free(bmap);
+			return NULL;
+		}
+		bmaps[index] = bmap;
+	}
+	fs->bg_dirty[index] |= dirty;
+
+	return bmaps[index];
+}
+
+/**
+ * ext4fs_get_block_bmap() - Get the block bitmap of a group for changing it
+ *
+ * @index:	block group number
+ * @return the bitmap, NULL if it cannot be read
+ */
+unsigned char *ext4fs_get_block_bmap(unsigned int index)
+{
+	return ext4fs_get_bmap(index, EXT4_BG_BLOCK_DIRTY);
+}
+
+/**
+ * ext4fs_get_inode_bmap() - Get the inode bitmap of a group for changing it
+ *
+ * @index:	block group number
+ * @return the bitmap, NULL if it cannot be read
+ */
+unsigned char *ext4fs_get_inode_bmap(unsigned int index)
+{
+	return ext4fs_get_bmap(index, EXT4_BG_INODE_DIRTY);
+}
+
 long int ext4fs_get_new_blk_no(void)
 {
 	short i;
-	short status;
 	int remainder;
 	unsigned int bg_idx;
-	static int prev_bg_bitmap_index = -1;
+	unsigned char *bmap;
 	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
-		goto fail;
 	struct ext2_block_group *bgd = (struct ext2_block_group *)fs->gdtable;
 
 	if (fs->first_pass_bbmap == 0) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
 			if (bgd[i].free_blocks) {
-				if (bgd[i].bg_flags & EXT4_BG_BLOCK_UNINIT) {
-					put_ext4(((uint64_t) ((uint64_t)bgd[i].block_id *
-							      (uint64_t)fs->blksz)),
-						 zero_buffer, fs->blksz);
-					bgd[i].bg_flags =
-					    bgd[i].
-					    bg_flags & ~EXT4_BG_BLOCK_UNINIT;
-					memcpy(fs->blk_bmaps[i], zero_buffer,
-					       fs->blksz);
-				}
-				fs->curr_blkno =
-				    _get_new_blk_no(fs->blk_bmaps[i]);
+				bmap = ext4fs_get_block_bmap(i);
+				if (!bmap)
+					return -1;
+				fs->curr_blkno = _get_new_blk_no(bmap);
 				if (fs->curr_blkno == -1)
 					/* if block bitmap is completely fill */
 					continue;
@@ -883,210 +1018,176 @@ long int ext4fs_get_new_blk_no(void)
 				fs->first_pass_bbmap++;
 				bgd[i].free_blocks--;
 				fs->sb->free_blocks--;
-				status = ext4fs_devread((lbaint_t)
-							bgd[i].block_id *
-							fs->sect_perblk, 0,
-							fs->blksz,
-							journal_buffer);
-				if (status == 0)
-					goto fail;
-				if (ext4fs_log_journal(journal_buffer,
-							bgd[i].block_id))
-					goto fail;
-				goto success;
+				return fs->curr_blkno;
 			} else {
 				debug("no space left on block group %d\n", i);
 			}
 		}
 
-		goto fail;
-	} else {
+		return -1;
+	}
+
 restart:
-		fs->curr_blkno++;
-		/* get the blockbitmap index respective to blockno */
-		bg_idx = fs->curr_blkno / blk_per_grp;
-		if (fs->blksz == 1024) {
-			remainder = fs->curr_blkno % blk_per_grp;
-			if (!remainder)
-				bg_idx--;
-		}
+	fs->curr_blkno++;
+	/* get the blockbitmap index respective to blockno */
+	bg_idx = fs->curr_blkno / blk_per_grp;
+	if (fs->blksz == 1024) {
+		remainder = fs->curr_blkno % blk_per_grp;
+		if (!remainder)
+			bg_idx--;
+	}
 
-		/*
-		 * To skip completely filled block group bitmaps
-		 * Optimize the block allocation
-		 */
-		if (bg_idx >= fs->no_blkgrp)
-			goto fail;
+	/*
+	 * To skip completely filled block group bitmaps
+	 * Optimize the block allocation
+	 */
+	if (bg_idx >= fs->no_blkgrp)
+		return -1;
 
-		if (bgd[bg_idx].free_blocks == 0) {
-			debug("block group %u is full. Skipping\n", bg_idx);
-			fs->curr_blkno = fs->curr_blkno + blk_per_grp;
-			fs->curr_blkno--;
-			goto restart;
-		}
+	if (bgd[bg_idx].free_blocks == 0) {
+		debug("block group %u is full. Skipping\n", bg_idx);
+		fs->curr_blkno = fs->curr_blkno + blk_per_grp;
+		fs->curr_blkno--;
+		goto restart;
+	}
 
-		if (bgd[bg_idx].bg_flags & EXT4_BG_BLOCK_UNINIT) {
-			memset(zero_buffer, '\0', fs->blksz);
-			put_ext4(((uint64_t) ((uint64_t)bgd[bg_idx].block_id *
-					(uint64_t)fs->blksz)), zero_buffer, fs->blksz);
-			memcpy(fs->blk_bmaps[bg_idx], zero_buffer, fs->blksz);
-			bgd[bg_idx].bg_flags = bgd[bg_idx].bg_flags &
-						~EXT4_BG_BLOCK_UNINIT;
-		}
+	bmap = ext4fs_get_block_bmap(bg_idx);
+	if (!bmap)
+		return -1;
+	if (ext4fs_set_block_bmap(fs->curr_blkno, bmap, bg_idx) != 0) {
+		debug("going for restart for the block no %ld %u\n",
+		      fs->curr_blkno, bg_idx);
+		goto restart;
+	}
 
-		if (ext4fs_set_block_bmap(fs->curr_blkno, fs->blk_bmaps[bg_idx],
-				   bg_idx) != 0) {
-			debug("going for restart for the block no %ld %u\n",
-			      fs->curr_blkno, bg_idx);
-			goto restart;
-		}
+	bgd[bg_idx].free_blocks--;
+	fs->sb->free_blocks--;
 
-		/* journal backup */
-		if (prev_bg_bitmap_index != bg_idx) {
-			memset(journal_buffer, '\0', fs->blksz);
-			status = ext4fs_devread((lbaint_t)bgd[bg_idx].block_id
-						* fs->sect_perblk,
-						0, fs->blksz, journal_buffer);
-			if (status == 0)
-				goto fail;
-			if (ext4fs_log_journal(journal_buffer,
-						bgd[bg_idx].block_id))
-				goto fail;
+	return fs->curr_blkno;
+}
+
+/**
+ * ext4fs_get_new_blk_run() - Allocate a run of contiguous blocks
+ *
+ * The search continues after the block allocated last, as for
+ * ext4fs_get_new_blk_no(), and a run ends at the end of its block group.
+ *
+ * @max:	number of blocks wanted
+ * @count:	returns the number of blocks allocated, 1 to @max
+ * @return first block of the run, -1 if there is no free block
+ */
+long int ext4fs_get_new_blk_run(unsigned int max, unsigned int *count)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = fs->bgd;
+	uint32_t first = fs->sb->first_data_block;
+	uint32_t blk_per_grp = fs->sb->blocks_per_group;
+	uint32_t pos, end, bit, len;
+	unsigned int bg_idx;
+	unsigned char *bmap;
+
+	pos = fs->first_pass_bbmap ? fs->curr_blkno + 1 - first : 0;
+	for (; pos < fs->sb->total_blocks - first;
+	     pos = (bg_idx + 1) * blk_per_grp) {
+		bg_idx = pos / blk_per_grp;
+		if (!bgd[bg_idx].free_blocks)
+			continue;
+		bmap = ext4fs_get_block_bmap(bg_idx);
+		if (!bmap)
+			return -1;
 
-			prev_bg_bitmap_index = bg_idx;
+		end = min(blk_per_grp, fs->sb->total_blocks - first -
+			  bg_idx * blk_per_grp);
+		bit = pos % blk_per_grp;
+		while (bit < end && ext4fs_bmap_test(bmap, bit)) {
+			if (bit % 8 == 0 && bmap[bit / 8] == 0xff)
+				bit += 8;
+			else
+				bit++;
 		}
-		bgd[bg_idx].free_blocks--;
-		fs->sb->free_blocks--;
-		goto success;
+		if (bit >= end)
+			continue;
+
+		max = min(max, (unsigned int)bgd[bg_idx].free_blocks);
+		for (len = 0; len < max && bit + len < end &&
+		     !ext4fs_bmap_test(bmap, bit + len); len++)
+			ext4fs_bmap_set(bmap, bit + len);
+
+		bgd[bg_idx].free_blocks -= len;
+		fs->sb->free_blocks -= len;
+		pos = first + bg_idx * blk_per_grp + bit;
+		fs->curr_blkno = pos + len - 1;
+		fs->first_pass_bbmap = 1;
+		*count = len;
+
+		return pos;
 	}
-success:
-	free(journal_buffer);
-	free(zero_buffer);
-
-	return fs->curr_blkno;
-fail:
-	free(journal_buffer);
-	free(zero_buffer);
 
 	return -1;
 }
 
+/* Only the inodes after the last one in use are left uninitialised */
+static void ext4fs_update_itable_unused(unsigned int index, int inode_no)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t unused = fs->sb->inodes_per_group - inode_no;
+
+	if (fs->bgd[index].bg_itable_unused > unused)
+		fs->bgd[index].bg_itable_unused = unused;
+}
+
 int ext4fs_get_new_inode_no(void)
 {
 	short i;
-	short status;
 	unsigned int ibmap_idx;
-	static int prev_inode_bitmap_index = -1;
+	unsigned char *bmap;
 	unsigned int inodes_per_grp = ext4fs_root->sblock.inodes_per_group;
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
-		goto fail;
 	struct ext2_block_group *bgd = (struct ext2_block_group *)fs->gdtable;
 
 	if (fs->first_pass_ibmap == 0) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
 			if (bgd[i].free_inodes) {
-				if (bgd[i].bg_itable_unused !=
-						bgd[i].free_inodes)
-					bgd[i].bg_itable_unused =
-						bgd[i].free_inodes;
-				if (bgd[i].bg_flags & EXT4_BG_INODE_UNINIT) {
-					put_ext4(((uint64_t)
-						  ((uint64_t)bgd[i].inode_id *
-							(uint64_t)fs->blksz)),
-						 zero_buffer, fs->blksz);
-					bgd[i].bg_flags = bgd[i].bg_flags &
-							~EXT4_BG_INODE_UNINIT;
-					memcpy(fs->inode_bmaps[i],
-					       zero_buffer, fs->blksz);
-				}
-				fs->curr_inode_no =
-				    _get_new_inode_no(fs->inode_bmaps[i]);
+				bmap = ext4fs_get_inode_bmap(i);
+				if (!bmap)
+					return -1;
+				fs->curr_inode_no = _get_new_inode_no(bmap);
 				if (fs->curr_inode_no == -1)
 					/* if block bitmap is completely fill */
 					continue;
+				ext4fs_update_itable_unused(i,
+							    fs->curr_inode_no);
 				fs->curr_inode_no = fs->curr_inode_no +
 							(i * inodes_per_grp);
 				fs->first_pass_ibmap++;
 				bgd[i].free_inodes--;
-				bgd[i].bg_itable_unused--;
 				fs->sb->free_inodes--;
-				status = ext4fs_devread((lbaint_t)
-							bgd[i].inode_id *
-							fs->sect_perblk, 0,
-							fs->blksz,
-							journal_buffer);
-				if (status == 0)
-					goto fail;
-				if (ext4fs_log_journal(journal_buffer,
-							bgd[i].inode_id))
-					goto fail;
-				goto success;
+				return fs->curr_inode_no;
 			} else
 				debug("no inode left on block group %d\n", i);
 		}
-		goto fail;
-	} else {
-restart:
-		fs->curr_inode_no++;
-		/* get the blockbitmap index respective to blockno */
-		ibmap_idx = fs->curr_inode_no / inodes_per_grp;
-		if (bgd[ibmap_idx].bg_flags & EXT4_BG_INODE_UNINIT) {
-			memset(zero_buffer, '\0', fs->blksz);
-			put_ext4(((uint64_t) ((uint64_t)bgd[ibmap_idx].inode_id *
-					      (uint64_t)fs->blksz)), zero_buffer,
-				 fs->blksz);
-			bgd[ibmap_idx].bg_flags =
-			    bgd[ibmap_idx].bg_flags & ~EXT4_BG_INODE_UNINIT;
-			memcpy(fs->inode_bmaps[ibmap_idx], zero_buffer,
-				fs->blksz);
-		}
+		return -1;
+	}
 
-		if (ext4fs_set_inode_bmap(fs->curr_inode_no,
-					  fs->inode_bmaps[ibmap_idx],
-					  ibmap_idx) != 0) {
-			debug("going for restart for the block no %d %u\n",
-			      fs->curr_inode_no, ibmap_idx);
-			goto restart;
-		}
+restart:
+	fs->curr_inode_no++;
+	/* get the blockbitmap index respective to blockno */
+	ibmap_idx = fs->curr_inode_no / inodes_per_grp;
+	bmap = ext4fs_get_inode_bmap(ibmap_idx);
+	if (!bmap)
+		return -1;
+	if (ext4fs_set_inode_bmap(fs->curr_inode_no, bmap, ibmap_idx) != 0) {
+		debug("going for restart for the block no %d %u\n",
+		      fs->curr_inode_no, ibmap_idx);
+		goto restart;
+	}
 
-		/* journal backup */
-		if (prev_inode_bitmap_index != ibmap_idx) {
-			memset(journal_buffer, '\0', fs->blksz);
-			status = ext4fs_devread((lbaint_t)
-						bgd[ibmap_idx].inode_id
-						* fs->sect_perblk,
-						0, fs->blksz, journal_buffer);
-			if (status == 0)
-				goto fail;
-			if (ext4fs_log_journal(journal_buffer,
-						bgd[ibmap_idx].inode_id))
-				goto fail;
-			prev_inode_bitmap_index = ibmap_idx;
-		}
-		if (bgd[ibmap_idx].bg_itable_unused !=
-				bgd[ibmap_idx].free_inodes)
-			bgd[ibmap_idx].bg_itable_unused =
-					bgd[ibmap_idx].free_inodes;
-		bgd[ibmap_idx].free_inodes--;
-		bgd[ibmap_idx].bg_itable_unused--;
-		fs->sb->free_inodes--;
-		goto success;
-	}
-
-success:
-	free(journal_buffer);
-	free(zero_buffer);
+	ext4fs_update_itable_unused(ibmap_idx, fs->curr_inode_no -
+				    ibmap_idx * inodes_per_grp);
+	bgd[ibmap_idx].free_inodes--;
+	fs->sb->free_inodes--;
 
 	return fs->curr_inode_no;
-fail:
-	free(journal_buffer);
-	free(zero_buffer);
-
-	return -1;
-
 }
 
 
@@ -1371,20 +1472,169 @@ fail:
 	free(ti_gp_buff_start_addr);
 }
 
-void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
-				unsigned int total_remaining_blocks,
-				unsigned int *total_no_of_block)
+/* Extents or indexes in the inode itself and in a tree block */
+#define EXT4_EXT_ROOT_MAX	((sizeof(((struct ext2_inode *)0)->b) - \
+				  sizeof(struct ext4_extent_header)) / \
+				 sizeof(struct ext4_extent))
+#define EXT4_EXT_BLOCK_MAX(blksz) (((blksz) - \
+				    sizeof(struct ext4_extent_header)) / \
+				   sizeof(struct ext4_extent))
+/* Longest initialised extent */
+#define EXT4_EXT_MAX_LEN	32768
+
+/*
+ * Map the file with extents of contiguous blocks, allocated as long as the
+ * block groups allow. Up to four extents fit in the inode; if there are more
+ * they go to leaf blocks, with as many levels of index blocks above them as
+ * it takes for the inode to hold the top level.
+ */
+static int alloc_extents(struct ext2_inode *file_inode,
+			 unsigned int *total_remaining_blocks,
+			 unsigned int *no_blks_reqd)
+{
+	struct ext4_extent_header *root, *node;
+	struct ext4_extent *extents = NULL, *ext;
+	struct ext4_extent_idx *index = NULL;
+	struct ext_filesystem *fs = get_fs();
+	unsigned int per_block = EXT4_EXT_BLOCK_MAX(fs->blksz);
+	unsigned int count = 0, size = 0, fileblock = 0;
+	unsigned int len, nodes, n, i, depth = 0;
+	long int blknr, next = -1;
+	char *buf = NULL, *entries;
+	int ret = -1;
+
+	while (*total_remaining_blocks) {
+		blknr = ext4fs_get_new_blk_run(min(*total_remaining_blocks,
+						   (unsigned int)EXT4_EXT_MAX_LEN),
+					       &len);
+		if (blknr == -1) {
+			printf("no block left to assign\n");
+			goto fail;
+		}
+		debug("EB %ld+%u: %u\n", blknr, len, *total_remaining_blocks);
+
+		ext = count ? &extents[count - 1] : NULL;
+		if (blknr == next &&
+		    le16_to_cpu(ext->ee_len) + len <= EXT4_EXT_MAX_LEN) {
+			ext->ee_len = cpu_to_le16(le16_to_cpu(ext->ee_len) +
+						  len);
+		} else {
+			if (count == size) {
+				size = size ? size * 2 : 16;
+				ext = realloc(extents, size * sizeof(*ext));
+				if (!ext) {
+					printf("No Memory\n");
+					goto fail;
+				}
+				extents = ext;
+			}
+			ext = &extents[count++];
+			ext->ee_block = cpu_to_le32(fileblock);
+			ext->ee_len = cpu_to_le16(len);
+			ext->ee_start_hi = 0;
+			ext->ee_start_lo = cpu_to_le32(blknr);
+		}
+		next = blknr + len;
+		fileblock += len;
+		*total_remaining_blocks -= len;
+	}
+
+	/*
+	 * Each level of tree blocks is indexed by the level above, built in
+	 * place in the index array. Extents and indexes are the same size and
+	 * both start with their first logical block.
+	 */
+	entries = (char *)extents;
+	n = count;
+	if (n > EXT4_EXT_ROOT_MAX) {
+		buf = zalloc(fs->blksz);
+		index = calloc(DIV_ROUND_UP(n, per_block), sizeof(*index));
+		if (!buf || !index)
+			goto fail;
+	}
+	while (n > EXT4_EXT_ROOT_MAX) {
+		nodes = DIV_ROUND_UP(n, per_block);
+		for (i = 0; i < nodes; i++) {
+			blknr = ext4fs_get_new_blk_no();
+			if (blknr == -1) {
+				printf("no block left to assign\n");
+				goto fail;
+			}
+			(*no_blks_reqd)++;
+
+			len = min(n - i * per_block, per_block);
+			memset(buf, '\0', fs->blksz);
+			node = (struct ext4_extent_header *)buf;
+			node->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+			node->eh_entries = cpu_to_le16(len);
+			node->eh_max = cpu_to_le16(per_block);
+			node->eh_depth = cpu_to_le16(depth);
+			memcpy(node + 1, entries + i * per_block * sizeof(*index),
+			       len * sizeof(*index));
+			put_ext4((uint64_t)blknr * fs->blksz, buf, fs->blksz);
+
+			index[i].ei_block =
+				((struct ext4_extent_idx *)(node + 1))->ei_block;
+			index[i].ei_leaf_lo = cpu_to_le32(blknr);
+			index[i].ei_leaf_hi = 0;
+			index[i].ei_unused = 0;
+		}
+		entries = (char *)index;
+		n = nodes;
+		depth++;
+	}
+
+	memset(&file_inode->b, '\0', sizeof(file_inode->b));
+	root = (struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	root->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	root->eh_entries = cpu_to_le16(n);
+	root->eh_max = cpu_to_le16(EXT4_EXT_ROOT_MAX);
+	root->eh_depth = cpu_to_le16(depth);
+	memcpy(root + 1, entries, n * sizeof(*index));
+	file_inode->flags |= cpu_to_le32(EXT4_EXTENTS_FL);
+	ret = 0;
+fail:
+	free(index);
+	free(buf);
+	free(extents);
+
+	return ret;
+}
+
+/**
+ * ext4fs_allocate_blocks() - Allocate the data blocks of a new file
+ *
+ * If the filesystem has extents the file is mapped by extents, otherwise by
+ * direct and indirect blocks.
+ *
+ * @file_inode:		inode of the file, its block map is filled in
+ * @total_remaining_blocks: number of data blocks
+ * @total_no_of_block:	increased by the number of mapping blocks needed
+ * @return 0 if all blocks were allocated, -1 otherwise
+ */
+int ext4fs_allocate_blocks(struct ext2_inode *file_inode,
+			   unsigned int total_remaining_blocks,
+			   unsigned int *total_no_of_block)
 {
 	short i;
 	long int direct_blockno;
 	unsigned int no_blks_reqd = 0;
+	struct ext_filesystem *fs = get_fs();
+
+	if (fs->sb->feature_incompat & EXT4_FEATURE_INCOMPAT_EXTENTS) {
+		if (alloc_extents(file_inode, &total_remaining_blocks,
+				  &no_blks_reqd))
+			return -1;
+		*total_no_of_block += no_blks_reqd;
+		return 0;
+	}
 
 	/* allocation of direct blocks */
 	for (i = 0; total_remaining_blocks && i < INDIRECT_BLOCKS; i++) {
 		direct_blockno = ext4fs_get_new_blk_no();
 		if (direct_blockno == -1) {
 			printf("no block left to assign\n");
-			return;
+			return -1;
 		}
 		file_inode->b.blocks.dir_blocks[i] = direct_blockno;
 		debug("DB %ld: %u\n", direct_blockno, total_remaining_blocks);
@@ -1399,47 +1649,201 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 	alloc_triple_indirect_block(file_inode, &total_remaining_blocks,
 				    &no_blks_reqd);
 	*total_no_of_block += no_blks_reqd;
+
+	return total_remaining_blocks ? -1 : 0;
 }
 
 #endif
 
-static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+/*
+ * Leaf extents of the extent-mapped inode that was looked up last. The whole
+ * extent tree is decoded once, so mapping further blocks of the same file is
+ * a binary search instead of a tree walk reading one block per level.
+ */
+static struct {
+	char root[sizeof(((struct ext2_inode *)0)->b)];	/* identifies the tree */
+	struct ext4_extent *extents;
+	int count;
+	int size;
+	int valid;
+} ext4fs_ext_cache;
+
+static void ext4fs_ext_cache_free(void)
 {
-	struct ext4_extent_idx *index;
-	unsigned long long block;
-	int blksz = EXT2_BLOCK_SIZE(data);
-	int i;
+	free(ext4fs_ext_cache.extents);
+	memset(&ext4fs_ext_cache, '\0', sizeof(ext4fs_ext_cache));
+}
 
-	while (1) {
-		index = (struct ext4_extent_idx *)(ext_block + 1);
+static int ext4fs_ext_cache_add(struct ext4_extent *extent)
+{
+	struct ext4_extent *extents;
+	int size;
+
+	if (ext4fs_ext_cache.count == ext4fs_ext_cache.size) {
+		size = ext4fs_ext_cache.size ? ext4fs_ext_cache.size * 2 : 16;
+		extents = realloc(ext4fs_ext_cache.extents,
+				  size * sizeof(struct ext4_extent));
+		if (!extents)
+			return -ENOMEM;
+		ext4fs_ext_cache.extents = extents;
+		ext4fs_ext_cache.size = size;
+	}
+	ext4fs_ext_cache.extents[ext4fs_ext_cache.count++] = *extent;
 
-		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
-			return 0;
+	return 0;
+}
 
-		if (ext_block->eh_depth == 0)
-			return ext_block;
-		i = -1;
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(index[i].ei_block));
+/*
+ * Collect the leaf extents below @ext_block in logical block order, reading
+ * each index and leaf block of the tree exactly once.
+ */
+static int ext4fs_ext_cache_fill(struct ext4_extent_header *ext_block,
+				 int depth)
+{
+	struct ext4_extent_idx *index;
+	struct ext4_extent *extent;
+	unsigned long long block;
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	int entries;
+	char *buf;
+	int i, ret = 0;
+
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(ext_block->eh_depth) != depth)
+		return -EINVAL;
+
+	entries = le16_to_cpu(ext_block->eh_entries);
+	if (!depth) {
+		extent = (struct ext4_extent *)(ext_block + 1);
+		for (i = 0; i < entries && !ret; i++)
+			ret = ext4fs_ext_cache_add(&extent[i]);
 
-		if (--i < 0)
-			return 0;
+		return ret;
+	}
+
+	buf = zalloc(blksz);
+	if (!buf)
+		return -ENOMEM;
 
+	index = (struct ext4_extent_idx *)(ext_block + 1);
+	for (i = 0; i < entries && !ret; i++) {
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf))
+			ret = -EIO;
 		else
-			return 0;
+			ret = ext4fs_ext_cache_fill(
+				(struct ext4_extent_header *)buf, depth - 1);
 	}
+	free(buf);
+
+	return ret;
+}
+
+static int ext4fs_ext_cache_load(struct ext2_inode *inode)
+{
+	struct ext4_extent_header *root;
+	int ret;
+
+	if (ext4fs_ext_cache.valid &&
+	    !memcmp(ext4fs_ext_cache.root, &inode->b, sizeof(inode->b)))
+		return 0;
+
+	ext4fs_ext_cache.valid = 0;
+	ext4fs_ext_cache.count = 0;
+	root = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	if (le16_to_cpu(root->eh_depth) > EXT4_MAX_EXTENT_DEPTH)
+		ret = -EINVAL;
+	else
+		ret = ext4fs_ext_cache_fill(root, le16_to_cpu(root->eh_depth));
+	if (ret) {
+		printf("invalid extent block\n");
+		return ret;
+	}
+	memcpy(ext4fs_ext_cache.root, &inode->b, sizeof(inode->b));
+	ext4fs_ext_cache.valid = 1;
+
+	return 0;
+}
+
+static unsigned long long ext4fs_extent_start(struct ext4_extent *extent)
+{
+	unsigned long long start;
+
+	start = le16_to_cpu(extent->ee_start_hi);
+	return (start << 32) + le32_to_cpu(extent->ee_start_lo);
+}
+
+/**
+ * ext4fs_map_extent() - Map a file block of an extent-mapped inode
+ *
+ * @inode:	inode using extents
+ * @fileblock:	logical block number within the file
+ * @count:	if not NULL, returns how many blocks starting at @fileblock are
+ *		physically contiguous, or belong to the same hole
+ * @return physical block number, 0 for a hole, -ve on error
+ */
+long int ext4fs_map_extent(struct ext2_inode *inode, uint32_t fileblock,
+			   uint32_t *count)
+{
+	struct ext4_extent *extent, *next;
+	unsigned long long start;
+	uint32_t first = 0, len = 0, run;
+	int lo, hi, mid;
+
+	if (ext4fs_ext_cache_load(inode))
+		return -EINVAL;
+
+	/* find the last extent starting at or before fileblock */
+	lo = 0;
+	hi = ext4fs_ext_cache.count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (le32_to_cpu(ext4fs_ext_cache.extents[mid].ee_block) <=
+		    fileblock)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	extent = lo ? &ext4fs_ext_cache.extents[lo - 1] : NULL;
+	next = lo < ext4fs_ext_cache.count ?
+		&ext4fs_ext_cache.extents[lo] : NULL;
+
+	if (extent) {
+		first = le32_to_cpu(extent->ee_block);
+		len = le16_to_cpu(extent->ee_len);
+	}
+
+	/* Hole: no extent maps this block */
+	if (!extent || fileblock - first >= len) {
+		if (count)
+			*count = next ? le32_to_cpu(next->ee_block) - fileblock :
+				 ~0U;
+		return 0;
+	}
+
+	start = ext4fs_extent_start(extent);
+	if (count) {
+		/* merge following extents that are also physically adjacent */
+		run = first + len - fileblock;
+		for (next = extent + 1;
+		     next < ext4fs_ext_cache.extents + ext4fs_ext_cache.count;
+		     next++) {
+			if (le32_to_cpu(next->ee_block) != first + len ||
+			    ext4fs_extent_start(next) != start + len)
+				break;
+			len += le16_to_cpu(next->ee_len);
+			run += le16_to_cpu(next->ee_len);
+		}
+		*count = run;
+	}
+
+	return start + fileblock - first;
 }
 
 static int ext4fs_blockgroup
@@ -1504,55 +1908,14 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
+
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
-	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i = -1;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
-		if (--i >= 0) {
-			fileblock -= le32_to_cpu(extent[i].ee_block);
-			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
-				return 0;
-			}
-
-			start = le16_to_cpu(extent[i].ee_start_hi);
-			start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
-			return fileblock + start;
-		}
-
-		printf("Extent Error\n");
-		free(buf);
-		return -1;
-	}
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(inode, fileblock, NULL);
 
 	/* Direct blocks. */
 	if (fileblock < INDIRECT_BLOCKS)
@@ -1853,6 +2216,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
  */
 void ext4fs_reinit_global(void)
 {
+	ext4fs_ext_cache_free();
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
@@ -2178,6 +2542,9 @@ int ext4fs_open(const char *filename)
 	if (ext4fs_root == NULL)
 		return -1;
 
+	/* Drop any file left open by a previous call */
+	if (ext4fs_file)
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
 	ext4fs_file = NULL;
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
@@ -41,6 +41,10 @@
 #define SUPERBLOCK_SIZE	1024
 #define F_FILE			1
 
+/* ext_filesystem.bg_dirty flags */
+#define EXT4_BG_BLOCK_DIRTY	0x01
+#define EXT4_BG_INODE_DIRTY	0x02
+
 static inline void *zalloc(size_t size)
 {
 	void *p = memalign(ARCH_DMA_MINALIGN, size);
@@ -62,7 +66,10 @@ uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
 int ext4fs_checksum_update(unsigned int i);
 int ext4fs_get_parent_inode_num(const char *dirname, char *dname, int flags);
 void ext4fs_update_parent_dentry(char *filename, int *p_ino, int file_type);
+unsigned char *ext4fs_get_block_bmap(unsigned int index);
+unsigned char *ext4fs_get_inode_bmap(unsigned int index);
 long int ext4fs_get_new_blk_no(void);
+long int ext4fs_get_new_blk_run(unsigned int max, unsigned int *count);
 int ext4fs_get_new_inode_no(void);
 void ext4fs_reset_block_bmap(long int blockno, unsigned char *buffer,
 					int index);
@@ -70,7 +77,7 @@ int ext4fs_set_block_bmap(long int blockno, unsigned char *buffer, int index);
 int ext4fs_set_inode_bmap(int inode_no, unsigned char *buffer, int index);
 void ext4fs_reset_inode_bmap(int inode_no, unsigned char *buffer, int index);
 int ext4fs_iget(int inode_no, struct ext2_inode *inode);
-void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
+int ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 				unsigned int total_remaining_blocks,
 				unsigned int *total_no_of_block);
 void put_ext4(uint64_t off, void *buf, uint32_t size);
@@ -29,7 +29,8 @@
 
 static void ext4fs_update(void)
 {
-	short i;
+	int i;
+	uint32_t gdt_blk, prev_gdt_blk = -1;
 	ext4fs_update_journal();
 	struct ext_filesystem *fs = get_fs();
 
@@ -37,24 +38,32 @@ static void ext4fs_update(void)
 	put_ext4((uint64_t)(SUPERBLOCK_SIZE),
 		 (struct ext2_sblock *)fs->sb, (uint32_t)SUPERBLOCK_SIZE);
 
-	/* update block groups */
+	/* update the bitmaps of the block groups which changed */
 	for (i = 0; i < fs->no_blkgrp; i++) {
+		if (!fs->bg_dirty[i])
+			continue;
 		fs->bgd[i].bg_checksum = ext4fs_checksum_update(i);
-		put_ext4((uint64_t)((uint64_t)fs->bgd[i].block_id * (uint64_t)fs->blksz),
-			 fs->blk_bmaps[i], fs->blksz);
+		if (fs->bg_dirty[i] & EXT4_BG_BLOCK_DIRTY)
+			put_ext4((uint64_t)fs->bgd[i].block_id * fs->blksz,
+				 fs->blk_bmaps[i], fs->blksz);
+		if (fs->bg_dirty[i] & EXT4_BG_INODE_DIRTY)
+			put_ext4((uint64_t)fs->bgd[i].inode_id * fs->blksz,
+				 fs->inode_bmaps[i], fs->blksz);
 	}
 
-	/* update inode table groups */
+	/* and the blocks of the descriptor table holding their descriptors */
 	for (i = 0; i < fs->no_blkgrp; i++) {
-		put_ext4((uint64_t) ((uint64_t)fs->bgd[i].inode_id * (uint64_t)fs->blksz),
-			 fs->inode_bmaps[i], fs->blksz);
+		if (!fs->bg_dirty[i])
+			continue;
+		fs->bg_dirty[i] = 0;
+		gdt_blk = i * sizeof(struct ext2_block_group) / fs->blksz;
+		if (gdt_blk == prev_gdt_blk)
+			continue;
+		put_ext4((uint64_t)(fs->gdtable_blkno + gdt_blk) * fs->blksz,
+			 fs->gdtable + gdt_blk * fs->blksz, fs->blksz);
+		prev_gdt_blk = gdt_blk;
 	}
 
-	/* update the block group descriptor table */
-	put_ext4((uint64_t)((uint64_t)fs->gdtable_blkno * (uint64_t)fs->blksz),
-		 (struct ext2_block_group *)fs->gdtable,
-		 (fs->blksz * fs->no_blk_pergdt));
-
 	ext4fs_dump_metadata();
 
 	gindex = 0;
@@ -94,75 +103,43 @@ fail:
 	return -1;
 }
 
-static void delete_single_indirect_block(struct ext2_inode *inode)
+/* Return a block to the free blocks of its group */
+static void ext4fs_free_blk(long int blknr)
 {
-	struct ext2_block_group *bgd = NULL;
-	static int prev_bg_bmap_idx = -1;
-	long int blknr;
-	int remainder;
-	int bg_idx;
-	int status;
 	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	if (!journal_buffer) {
-		printf("No memory\n");
+	unsigned char *bmap;
+	int bg_idx;
+
+	if (blknr <= 0)
 		return;
-	}
-	/* get  block group descriptor table */
-	bgd = (struct ext2_block_group *)fs->gdtable;
+	bg_idx = blknr / blk_per_grp;
+	if (fs->blksz == 1024 && !(blknr % blk_per_grp))
+		bg_idx--;
+	bmap = ext4fs_get_block_bmap(bg_idx);
+	if (!bmap)
+		return;
+	ext4fs_reset_block_bmap(blknr, bmap, bg_idx);
+	fs->bgd[bg_idx].free_blocks++;
+	fs->sb->free_blocks++;
+}
 
+static void delete_single_indirect_block(struct ext2_inode *inode)
+{
 	/* deleting the single indirect block associated with inode */
 	if (inode->b.blocks.indir_block != 0) {
 		debug("SIPB releasing %u\n", inode->b.blocks.indir_block);
-		blknr = inode->b.blocks.indir_block;
-		bg_idx = blknr / blk_per_grp;
-		if (fs->blksz == 1024) {
-			remainder = blknr % blk_per_grp;
-			if (!remainder)
-				bg_idx--;
-		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx], bg_idx);
-		bgd[bg_idx].free_blocks++;
-		fs->sb->free_blocks++;
-		/* journal backup */
-		if (prev_bg_bmap_idx != bg_idx) {
-			status =
-			    ext4fs_devread((lbaint_t)bgd[bg_idx].block_id *
-					   fs->sect_perblk, 0, fs->blksz,
-					   journal_buffer);
-			if (status == 0)
-				goto fail;
-			if (ext4fs_log_journal
-			    (journal_buffer, bgd[bg_idx].block_id))
-				goto fail;
-			prev_bg_bmap_idx = bg_idx;
-		}
+		ext4fs_free_blk(inode->b.blocks.indir_block);
 	}
-fail:
-	free(journal_buffer);
 }
 
 static void delete_double_indirect_block(struct ext2_inode *inode)
 {
 	int i;
-	short status;
-	static int prev_bg_bmap_idx = -1;
 	long int blknr;
-	int remainder;
-	int bg_idx;
-	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
 	unsigned int *di_buffer = NULL;
 	unsigned int *DIB_start_addr = NULL;
-	struct ext2_block_group *bgd = NULL;
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	if (!journal_buffer) {
-		printf("No memory\n");
-		return;
-	}
-	/* get the block group descriptor table */
-	bgd = (struct ext2_block_group *)fs->gdtable;
 
 	if (inode->b.blocks.double_indir_block != 0) {
 		di_buffer = zalloc(fs->blksz);
@@ -172,95 +149,33 @@ static void delete_double_indirect_block(struct ext2_inode *inode)
 		}
 		DIB_start_addr = (unsigned int *)di_buffer;
 		blknr = inode->b.blocks.double_indir_block;
-		status = ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0,
-					fs->blksz, (char *)di_buffer);
+		ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0,
+			       fs->blksz, (char *)di_buffer);
 		for (i = 0; i < fs->blksz / sizeof(int); i++) {
 			if (*di_buffer == 0)
 				break;
 
 			debug("DICB releasing %u\n", *di_buffer);
-			bg_idx = *di_buffer / blk_per_grp;
-			if (fs->blksz == 1024) {
-				remainder = *di_buffer % blk_per_grp;
-				if (!remainder)
-					bg_idx--;
-			}
-			ext4fs_reset_block_bmap(*di_buffer,
-					fs->blk_bmaps[bg_idx], bg_idx);
+			ext4fs_free_blk(*di_buffer);
 			di_buffer++;
-			bgd[bg_idx].free_blocks++;
-			fs->sb->free_blocks++;
-			/* journal backup */
-			if (prev_bg_bmap_idx != bg_idx) {
-				status = ext4fs_devread((lbaint_t)
-							bgd[bg_idx].block_id
-							* fs->sect_perblk, 0,
-							fs->blksz,
-							journal_buffer);
-				if (status == 0)
-					goto fail;
-
-				if (ext4fs_log_journal(journal_buffer,
-							bgd[bg_idx].block_id))
-					goto fail;
-				prev_bg_bmap_idx = bg_idx;
-			}
 		}
 
 		/* removing the parent double indirect block */
-		blknr = inode->b.blocks.double_indir_block;
-		bg_idx = blknr / blk_per_grp;
-		if (fs->blksz == 1024) {
-			remainder = blknr % blk_per_grp;
-			if (!remainder)
-				bg_idx--;
-		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx], bg_idx);
-		bgd[bg_idx].free_blocks++;
-		fs->sb->free_blocks++;
-		/* journal backup */
-		if (prev_bg_bmap_idx != bg_idx) {
-			memset(journal_buffer, '\0', fs->blksz);
-			status = ext4fs_devread((lbaint_t)bgd[bg_idx].block_id *
-						fs->sect_perblk, 0, fs->blksz,
-						journal_buffer);
-			if (status == 0)
-				goto fail;
-
-			if (ext4fs_log_journal(journal_buffer,
-						bgd[bg_idx].block_id))
-				goto fail;
-			prev_bg_bmap_idx = bg_idx;
-		}
+		ext4fs_free_blk(blknr);
 		debug("DIPB releasing %ld\n", blknr);
 	}
-fail:
 	free(DIB_start_addr);
-	free(journal_buffer);
 }
 
 static void delete_triple_indirect_block(struct ext2_inode *inode)
 {
 	int i, j;
-	short status;
-	static int prev_bg_bmap_idx = -1;
 	long int blknr;
-	int remainder;
-	int bg_idx;
-	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
 	unsigned int *tigp_buffer = NULL;
 	unsigned int *tib_start_addr = NULL;
 	unsigned int *tip_buffer = NULL;
 	unsigned int *tipb_start_addr = NULL;
-	struct ext2_block_group *bgd = NULL;
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	if (!journal_buffer) {
-		printf("No memory\n");
-		return;
-	}
-	/* get block group descriptor table */
-	bgd = (struct ext2_block_group *)fs->gdtable;
 
 	if (inode->b.blocks.triple_indir_block != 0) {
 		tigp_buffer = zalloc(fs->blksz);
@@ -270,8 +185,8 @@ static void delete_triple_indirect_block(struct ext2_inode *inode)
 		}
 		tib_start_addr = (unsigned int *)tigp_buffer;
 		blknr = inode->b.blocks.triple_indir_block;
-		status = ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0,
-					fs->blksz, (char *)tigp_buffer);
+		ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0,
+			       fs->blksz, (char *)tigp_buffer);
 		for (i = 0; i < fs->blksz / sizeof(int); i++) {
 			if (*tigp_buffer == 0)
 				break;
@@ -281,44 +196,14 @@ static void delete_triple_indirect_block(struct ext2_inode *inode)
 			if (!tip_buffer)
 				goto fail;
 			tipb_start_addr = (unsigned int *)tip_buffer;
-			status = ext4fs_devread((lbaint_t)(*tigp_buffer) *
-						fs->sect_perblk, 0, fs->blksz,
-						(char *)tip_buffer);
+			ext4fs_devread((lbaint_t)(*tigp_buffer) *
+				       fs->sect_perblk, 0, fs->blksz,
+				       (char *)tip_buffer);
 			for (j = 0; j < fs->blksz / sizeof(int); j++) {
 				if (*tip_buffer == 0)
 					break;
-				bg_idx = *tip_buffer / blk_per_grp;
-				if (fs->blksz == 1024) {
-					remainder = *tip_buffer % blk_per_grp;
-					if (!remainder)
-						bg_idx--;
-				}
-
-				ext4fs_reset_block_bmap(*tip_buffer,
-							fs->blk_bmaps[bg_idx],
-							bg_idx);
-
+				ext4fs_free_blk(*tip_buffer);
 				tip_buffer++;
-				bgd[bg_idx].free_blocks++;
-				fs->sb->free_blocks++;
-				/* journal backup */
-				if (prev_bg_bmap_idx != bg_idx) {
-					status =
-					    ext4fs_devread(
-							(lbaint_t)
-							bgd[bg_idx].block_id *
-							fs->sect_perblk, 0,
-							fs->blksz,
-							journal_buffer);
-					if (status == 0)
-						goto fail;
-
-					if (ext4fs_log_journal(journal_buffer,
-							       bgd[bg_idx].
-							       block_id))
-						goto fail;
-					prev_bg_bmap_idx = bg_idx;
-				}
 			}
 			free(tipb_start_addr);
 			tipb_start_addr = NULL;
@@ -327,67 +212,43 @@ static void delete_triple_indirect_block(struct ext2_inode *inode)
 			 * removing the grand parent blocks
 			 * which is connected to inode
 			 */
-			bg_idx = *tigp_buffer / blk_per_grp;
-			if (fs->blksz == 1024) {
-				remainder = *tigp_buffer % blk_per_grp;
-				if (!remainder)
-					bg_idx--;
-			}
-			ext4fs_reset_block_bmap(*tigp_buffer,
-						fs->blk_bmaps[bg_idx], bg_idx);
-
+			ext4fs_free_blk(*tigp_buffer);
 			tigp_buffer++;
-			bgd[bg_idx].free_blocks++;
-			fs->sb->free_blocks++;
-			/* journal backup */
-			if (prev_bg_bmap_idx != bg_idx) {
-				memset(journal_buffer, '\0', fs->blksz);
-				status =
-				    ext4fs_devread((lbaint_t)
-						   bgd[bg_idx].block_id *
-						   fs->sect_perblk, 0,
-						   fs->blksz, journal_buffer);
-				if (status == 0)
-					goto fail;
-
-				if (ext4fs_log_journal(journal_buffer,
-							bgd[bg_idx].block_id))
-					goto fail;
-				prev_bg_bmap_idx = bg_idx;
-			}
 		}
 
 		/* removing the grand parent triple indirect block */
-		blknr = inode->b.blocks.triple_indir_block;
-		bg_idx = blknr / blk_per_grp;
-		if (fs->blksz == 1024) {
-			remainder = blknr % blk_per_grp;
-			if (!remainder)
-				bg_idx--;
-		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx], bg_idx);
-		bgd[bg_idx].free_blocks++;
-		fs->sb->free_blocks++;
-		/* journal backup */
-		if (prev_bg_bmap_idx != bg_idx) {
-			memset(journal_buffer, '\0', fs->blksz);
-			status = ext4fs_devread((lbaint_t)bgd[bg_idx].block_id *
-						fs->sect_perblk, 0, fs->blksz,
-						journal_buffer);
-			if (status == 0)
-				goto fail;
-
-			if (ext4fs_log_journal(journal_buffer,
-						bgd[bg_idx].block_id))
-				goto fail;
-			prev_bg_bmap_idx = bg_idx;
-		}
+		ext4fs_free_blk(blknr);
 		debug("tigp buffer itself releasing %ld\n", blknr);
 	}
 fail:
 	free(tib_start_addr);
 	free(tipb_start_addr);
-	free(journal_buffer);
+}
+
+/* Release the index and leaf blocks below an extent tree node */
+static void delete_extent_tree(struct ext4_extent_header *eh)
+{
+	struct ext4_extent_idx *index = (struct ext4_extent_idx *)(eh + 1);
+	struct ext_filesystem *fs = get_fs();
+	long int blknr;
+	char *buf;
+	int i;
+
+	if (le16_to_cpu(eh->eh_magic) != EXT4_EXT_MAGIC || !eh->eh_depth)
+		return;
+
+	buf = zalloc(fs->blksz);
+	if (!buf)
+		return;
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++) {
+		blknr = le32_to_cpu(index[i].ei_leaf_lo);
+		if (ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0,
+				   fs->blksz, buf))
+			delete_extent_tree((struct ext4_extent_header *)buf);
+		debug("EXT4_EXTENTS tree block releasing %ld\n", blknr);
+		ext4fs_free_blk(blknr);
+	}
+	free(buf);
 }
 
 static int ext4fs_delete_file(int inodeno)
@@ -395,26 +256,21 @@ static int ext4fs_delete_file(int inodeno)
 	struct ext2_inode inode;
 	short status;
 	int i;
-	int remainder;
 	long int blknr;
-	int bg_idx;
 	int ibmap_idx;
 	char *read_buffer = NULL;
 	char *start_block_address = NULL;
+	unsigned char *bmap;
 	unsigned int no_blocks;
 
-	static int prev_bg_bmap_idx = -1;
 	unsigned int inodes_per_block;
 	long int blkno;
 	unsigned int blkoff;
-	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
 	unsigned int inode_per_grp = ext4fs_root->sblock.inodes_per_group;
 	struct ext2_inode *inode_buffer = NULL;
 	struct ext2_block_group *bgd = NULL;
 	struct ext_filesystem *fs = get_fs();
-	char *journal_buffer = zalloc(fs->blksz);
-	if (!journal_buffer)
-		return -ENOMEM;
+
 	/* get the block group descriptor table */
 	bgd = (struct ext2_block_group *)fs->gdtable;
 	status = ext4fs_read_inode(ext4fs_root, inodeno, &inode);
@@ -427,89 +283,23 @@ static int ext4fs_delete_file(int inodeno)
 		no_blocks++;
 
 	if (le32_to_cpu(inode.flags) & EXT4_EXTENTS_FL) {
-		struct ext2fs_node *node_inode =
-		    zalloc(sizeof(struct ext2fs_node));
-		if (!node_inode)
-			goto fail;
-		node_inode->data = ext4fs_root;
-		node_inode->ino = inodeno;
-		node_inode->inode_read = 0;
-		memcpy(&(node_inode->inode), &inode, sizeof(struct ext2_inode));
-
 		for (i = 0; i < no_blocks; i++) {
-			blknr = read_allocated_block(&(node_inode->inode), i);
-			bg_idx = blknr / blk_per_grp;
-			if (fs->blksz == 1024) {
-				remainder = blknr % blk_per_grp;
-				if (!remainder)
-					bg_idx--;
-			}
-			ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx],
-						bg_idx);
-			debug("EXT4_EXTENTS Block releasing %ld: %d\n",
-			      blknr, bg_idx);
-
-			bgd[bg_idx].free_blocks++;
-			fs->sb->free_blocks++;
-
-			/* journal backup */
-			if (prev_bg_bmap_idx != bg_idx) {
-				status =
-				    ext4fs_devread((lbaint_t)
-						   bgd[bg_idx].block_id *
-						   fs->sect_perblk, 0,
-						   fs->blksz, journal_buffer);
-				if (status == 0)
-					goto fail;
-				if (ext4fs_log_journal(journal_buffer,
-							bgd[bg_idx].block_id))
-					goto fail;
-				prev_bg_bmap_idx = bg_idx;
-			}
-		}
-		if (node_inode) {
-			free(node_inode);
-			node_inode = NULL;
+			blknr = read_allocated_block(&inode, i);
+			debug("EXT4_EXTENTS Block releasing %ld\n", blknr);
+			ext4fs_free_blk(blknr);
 		}
+		delete_extent_tree((struct ext4_extent_header *)
+				   inode.b.blocks.dir_blocks);
 	} else {
 
 		delete_single_indirect_block(&inode);
 		delete_double_indirect_block(&inode);
 		delete_triple_indirect_block(&inode);
 
-		/* read the block no allocated to a file */
-		no_blocks = inode.size / fs->blksz;
-		if (inode.size % fs->blksz)
-			no_blocks++;
 		for (i = 0; i < no_blocks; i++) {
 			blknr = read_allocated_block(&inode, i);
-			bg_idx = blknr / blk_per_grp;
-			if (fs->blksz == 1024) {
-				remainder = blknr % blk_per_grp;
-				if (!remainder)
-					bg_idx--;
-			}
-			ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx],
-						bg_idx);
-			debug("ActualB releasing %ld: %d\n", blknr, bg_idx);
-
-			bgd[bg_idx].free_blocks++;
-			fs->sb->free_blocks++;
-			/* journal backup */
-			if (prev_bg_bmap_idx != bg_idx) {
-				memset(journal_buffer, '\0', fs->blksz);
-				status = ext4fs_devread((lbaint_t)
-							bgd[bg_idx].block_id
-							* fs->sect_perblk,
-							0, fs->blksz,
-							journal_buffer);
-				if (status == 0)
-					goto fail;
-				if (ext4fs_log_journal(journal_buffer,
-						bgd[bg_idx].block_id))
-					goto fail;
-				prev_bg_bmap_idx = bg_idx;
-			}
+			debug("ActualB releasing %ld\n", blknr);
+			ext4fs_free_blk(blknr);
 		}
 	}
 
@@ -548,17 +338,12 @@ static int ext4fs_delete_file(int inodeno)
 
 	/* update the respective inode bitmaps */
 	inodeno++;
-	ext4fs_reset_inode_bmap(inodeno, fs->inode_bmaps[ibmap_idx], ibmap_idx);
+	bmap = ext4fs_get_inode_bmap(ibmap_idx);
+	if (!bmap)
+		goto fail;
+	ext4fs_reset_inode_bmap(inodeno, bmap, ibmap_idx);
 	bgd[ibmap_idx].free_inodes++;
 	fs->sb->free_inodes++;
-	/* journal backup */
-	memset(journal_buffer, '\0', fs->blksz);
-	status = ext4fs_devread((lbaint_t)bgd[ibmap_idx].inode_id *
-				fs->sect_perblk, 0, fs->blksz, journal_buffer);
-	if (status == 0)
-		goto fail;
-	if (ext4fs_log_journal(journal_buffer, bgd[ibmap_idx].inode_id))
-		goto fail;
 
 	ext4fs_update();
 	ext4fs_deinit();
@@ -570,19 +355,16 @@ static int ext4fs_delete_file(int inodeno)
 	}
 
 	free(start_block_address);
-	free(journal_buffer);
 
 	return 0;
 fail:
 	free(start_block_address);
-	free(journal_buffer);
 
 	return -1;
 }
 
 int ext4fs_init(void)
 {
-	short status;
 	int i;
 	unsigned int real_free_blocks = 0;
 	struct ext_filesystem *fs = get_fs();
@@ -617,43 +399,12 @@ int ext4fs_init(void)
 	}
 	fs->bgd = (struct ext2_block_group *)fs->gdtable;
 
-	/* load all the available bitmap block of the partition */
+	/* the bitmaps are loaded when first used */
 	fs->blk_bmaps = zalloc(fs->no_blkgrp * sizeof(char *));
-	if (!fs->blk_bmaps)
-		goto fail;
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		fs->blk_bmaps[i] = zalloc(fs->blksz);
-		if (!fs->blk_bmaps[i])
-			goto fail;
-	}
-
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		status =
-		    ext4fs_devread((lbaint_t)fs->bgd[i].block_id *
-				   fs->sect_perblk, 0,
-				   fs->blksz, (char *)fs->blk_bmaps[i]);
-		if (status == 0)
-			goto fail;
-	}
-
-	/* load all the available inode bitmap of the partition */
 	fs->inode_bmaps = zalloc(fs->no_blkgrp * sizeof(unsigned char *));
-	if (!fs->inode_bmaps)
+	fs->bg_dirty = zalloc(fs->no_blkgrp);
+	if (!fs->blk_bmaps || !fs->inode_bmaps || !fs->bg_dirty)
 		goto fail;
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		fs->inode_bmaps[i] = zalloc(fs->blksz);
-		if (!fs->inode_bmaps[i])
-			goto fail;
-	}
-
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		status = ext4fs_devread((lbaint_t)fs->bgd[i].inode_id *
-					fs->sect_perblk,
-					0, fs->blksz,
-					(char *)fs->inode_bmaps[i]);
-		if (status == 0)
-			goto fail;
-	}
 
 	/*
 	 * check filesystem consistency with free blocks of file system
@@ -707,23 +458,21 @@ void ext4fs_deinit(void)
 	fs->sb = NULL;
 
 	if (fs->blk_bmaps) {
-		for (i = 0; i < fs->no_blkgrp; i++) {
+		for (i = 0; i < fs->no_blkgrp; i++)
 			free(fs->blk_bmaps[i]);
-			fs->blk_bmaps[i] = NULL;
-		}
 		free(fs->blk_bmaps);
 		fs->blk_bmaps = NULL;
 	}
 
 	if (fs->inode_bmaps) {
-		for (i = 0; i < fs->no_blkgrp; i++) {
+		for (i = 0; i < fs->no_blkgrp; i++)
 			free(fs->inode_bmaps[i]);
-			fs->inode_bmaps[i] = NULL;
-		}
 		free(fs->inode_bmaps);
 		fs->inode_bmaps = NULL;
 	}
 
+	free(fs->bg_dirty);
+	fs->bg_dirty = NULL;
 
 	free(fs->gdtable);
 	fs->gdtable = NULL;
@@ -898,8 +647,9 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 	file_inode->size = sizebytes;
 
 	/* Allocate data blocks */
-	ext4fs_allocate_blocks(file_inode, blocks_remaining,
-			       &blks_reqd_for_file);
+	if (ext4fs_allocate_blocks(file_inode, blocks_remaining,
+				   &blks_reqd_for_file))
+		goto fail;
 	file_inode->blockcnt = (blks_reqd_for_file * fs->blksz) >>
 		fs->dev_desc->log2blksz;
 
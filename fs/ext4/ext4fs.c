@@ -44,18 +44,21 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
  * reads into one potentially more efficient larger sequential read action
+ *
+ * Extent-mapped files are resolved a whole extent at a time, so each
+ * physically contiguous run of the file is a single device read.
  */
 int ext4fs_read_file(struct ext2fs_node *node, int pos,
 		unsigned int len, char *buf)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
-	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = __le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
+	int extents = le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL;
+	uint64_t cur = pos;
+	uint64_t end;
 	lbaint_t delayed_start = 0;
 	lbaint_t delayed_extent = 0;
 	lbaint_t delayed_skipfirst = 0;
@@ -64,69 +67,53 @@ int ext4fs_read_file(struct ext2fs_node *node, int pos,
 	short status;
 
 	/* Adjust len so it we can't read past the end of the file. */
-	if (len > filesize)
-		len = filesize;
-
-	blockcnt = ((len + pos) + blocksize - 1) / blocksize;
-
-	for (i = pos / blocksize; i < blockcnt; i++) {
-		lbaint_t blknr;
-		int blockoff = pos % blocksize;
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(&(node->inode), i);
+	if (pos >= filesize)
+		return 0;
+	if (len > filesize - pos)
+		len = filesize - pos;
+	end = (uint64_t)pos + len;
+
+	while (cur < end) {
+		long int blknr;
+		uint32_t count = 1;
+		int skipfirst = cur % blocksize;
+		uint64_t bytes;
+
+		if (extents)
+			blknr = ext4fs_map_extent(&node->inode,
+						  cur / blocksize, &count);
+		else
+			blknr = read_allocated_block(&node->inode,
+						     cur / blocksize);
 		if (blknr < 0)
 			return -1;
 
-		blknr = blknr << log2_fs_blocksize;
+		bytes = min((uint64_t)count * blocksize - skipfirst,
+			    end - cur);
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) % blocksize;
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
-
-		/* First block. */
-		if (i == pos / blocksize) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
 		if (blknr) {
-			int status;
+			lbaint_t sector = (lbaint_t)blknr << log2_fs_blocksize;
 
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
+			if (delayed_extent && delayed_next == sector) {
+				delayed_extent += bytes;
+			} else {
+				if (delayed_extent) {	/* spill */
 					status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
 							delayed_extent,
 							delayed_buf);
 					if (status == 0)
 						return -1;
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
 				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
+				delayed_start = sector;
+				delayed_extent = bytes;
 				delayed_skipfirst = skipfirst;
 				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
 			}
+			delayed_next = sector +
+				((lbaint_t)count << log2_fs_blocksize);
 		} else {
-			if (previous_block_number != -1) {
+			if (delayed_extent) {
 				/* spill */
 				status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
@@ -134,20 +121,20 @@ int ext4fs_read_file(struct ext2fs_node *node, int pos,
 							delayed_buf);
 				if (status == 0)
 					return -1;
-				previous_block_number = -1;
+				delayed_extent = 0;
 			}
-			memset(buf, 0, blocksize - skipfirst);
+			memset(buf, 0, bytes);
 		}
-		buf += blocksize - skipfirst;
+		buf += bytes;
+		cur += bytes;
 	}
-	if (previous_block_number != -1) {
+	if (delayed_extent) {
 		/* spill */
 		status = ext4fs_devread(delayed_start,
 					delayed_skipfirst, delayed_extent,
 					delayed_buf);
 		if (status == 0)
 			return -1;
-		previous_block_number = -1;
 	}
 
 	return len;
@@ -213,21 +200,22 @@ int ext4_read_file(const char *filename, void *buf, int offset, int len)
 	int file_len;
 	int len_read;
 
-	if (offset != 0) {
-		printf("** Cannot support non-zero offset **\n");
-		return -1;
-	}
-
 	file_len = ext4fs_open(filename);
 	if (file_len < 0) {
 		printf("** File not found %s **\n", filename);
 		return -1;
 	}
 
-	if (len == 0)
-		len = file_len;
+	if (offset < 0 || offset > file_len) {
+		printf("** Offset %d is past the end of %s **\n", offset,
+		       filename);
+		return -1;
+	}
+
+	if (len == 0 || len > file_len - offset)
+		len = file_len - offset;
 
-	len_read = ext4fs_read(buf, len);
+	len_read = ext4fs_read_file(ext4fs_file, offset, len, buf);
 
 	return len_read;
 }
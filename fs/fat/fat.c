@@ -154,6 +154,70 @@ static void get_name(dir_entry *dirent, char *s_name)
 	downcase(s_name);
 }
 
+/*
+ * Set up the FAT window cache in mydata->fatbuf, which must hold
+ * FATCACHEWINDOWS * FATBUFSIZE bytes.
+ */
+static void fat_cache_init(fsdata *mydata)
+{
+	int i;
+
+	for (i = 0; i < FATCACHEWINDOWS; i++) {
+		mydata->fatcache[i].buf = mydata->fatbuf + i * FATBUFSIZE;
+		mydata->fatcache[i].bufnum = -1;
+		mydata->fatcache[i].lastuse = 0;
+		mydata->fatcache[i].dirty = 0;
+	}
+	mydata->fatcacheuse = 0;
+}
+
+#ifdef CONFIG_FAT_WRITE
+static int flush_fat_window(fsdata *mydata, fat_window *win);
+#endif
+
+/*
+ * Return the cached FAT window 'bufnum', reading it from disk into the least
+ * recently used window if needed. A modified window is written back before
+ * it is reused.
+ * On failure NULL is returned.
+ */
+static fat_window *fat_cache_get(fsdata *mydata, __u32 bufnum)
+{
+	fat_window *win, *victim = &mydata->fatcache[0];
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i;
+
+	for (i = 0; i < FATCACHEWINDOWS; i++) {
+		win = &mydata->fatcache[i];
+		if (win->bufnum == bufnum) {
+			win->lastuse = ++mydata->fatcacheuse;
+			return win;
+		}
+		if (win->lastuse < victim->lastuse)
+			victim = win;
+	}
+
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+#ifdef CONFIG_FAT_WRITE
+	if (victim->dirty && flush_fat_window(mydata, victim) < 0)
+		return NULL;
+#endif
+	victim->bufnum = -1;
+	if (disk_read(startblock, getsize, victim->buf) < 0) {
+		debug("Error reading FAT blocks\n");
+		return NULL;
+	}
+	victim->bufnum = bufnum;
+	victim->lastuse = ++mydata->fatcacheuse;
+
+	return victim;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -164,6 +228,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 off16, offset;
 	__u32 ret = 0x00;
 	__u16 val1, val2;
+	fat_window *win;
+	__u8 *fatbuf;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -187,57 +253,46 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%04x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Find the block of FAT entries in the cache. */
+	if (bufnum * FATBUFBLOCKS >= mydata->fatlength)
+		return ret;
+	win = fat_cache_get(mydata, bufnum);
+	if (!win)
+		return ret;
+	fatbuf = win->buf;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *) fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *) fatbuf)[offset]);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
 
 		switch (offset & 0x3) {
 		case 0:
-			ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *) fatbuf)[off16]);
 			ret &= 0xfff;
 			break;
 		case 1:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xf000;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x00ff;
 			ret = (val2 << 4) | (val1 >> 12);
 			break;
 		case 2:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xff00;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x000f;
 			ret = (val2 << 8) | (val1 >> 8);
 			break;
 		case 3:
-			ret = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			ret = (ret & 0xfff0) >> 4;
 			break;
 		default:
@@ -314,6 +369,55 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Resolve the cluster chain starting at 'clust' into runs of contiguous
+ * clusters, until 'size' bytes are covered or the chain ends. The run list is
+ * returned in '*runsp' and must be freed by the caller.
+ * Return the number of runs, or -1 on failure.
+ */
+static int get_cluster_runs(fsdata *mydata, __u32 clust, unsigned long size,
+			    fat_run **runsp)
+{
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	unsigned long covered = 0;
+	fat_run *runs = NULL, *tmp;
+	int nruns = 0, maxruns = 0;
+
+	while (covered < size) {
+		if (nruns &&
+		    runs[nruns - 1].start + runs[nruns - 1].count == clust) {
+			runs[nruns - 1].count++;
+		} else {
+			if (nruns == maxruns) {
+				maxruns = maxruns ? maxruns * 2 : 16;
+				tmp = realloc(runs, maxruns * sizeof(fat_run));
+				if (!tmp) {
+					free(runs);
+					return -1;
+				}
+				runs = tmp;
+			}
+			runs[nruns].start = clust;
+			runs[nruns].count = 1;
+			nruns++;
+		}
+
+		covered += bytesperclust;
+		if (covered >= size)
+			break;
+
+		clust = get_fatent(mydata, clust);
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			break;
+		}
+	}
+
+	*runsp = runs;
+	return nruns;
+}
+
 /*
  * Read at most 'maxsize' bytes from 'pos' in the file associated with 'dentptr'
  * into 'buffer'.
@@ -329,8 +433,9 @@ get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 	unsigned long filesize = FAT2CPU32(dentptr->size), gotsize = 0;
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
 	unsigned long actsize;
+	fat_run *runs;
+	int nruns, i;
 
 	debug("Filesize: %ld bytes\n", filesize);
 
@@ -386,50 +491,28 @@ get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 		}
 	}
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return gotsize;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
+	nruns = get_cluster_runs(mydata, curclust, filesize, &runs);
+	if (nruns < 0) {
+		debug("Error: allocating memory\n");
+		return -1;
+	}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+	/* each run of contiguous clusters is a single read */
+	for (i = 0; i < nruns && filesize; i++) {
+		actsize = min(filesize,
+			      (unsigned long)runs[i].count * bytesperclust);
+		if (get_cluster(mydata, runs[i].start, buffer, actsize) != 0) {
 			printf("Error reading cluster\n");
+			free(runs);
 			return -1;
 		}
 		gotsize += actsize;
-		return gotsize;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+	}
+	free(runs);
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return gotsize;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return gotsize;
 }
 
 /*
@@ -865,12 +948,13 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 					(mydata->clust_size * 2);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN,
+				  FATBUFSIZE * FATCACHEWINDOWS);
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
+	fat_cache_init(mydata);
 
 	if (vfat_enabled)
 		debug("VFAT Support enabled\n");
@@ -1251,7 +1335,9 @@ int fat_size(const char *filename)
 long file_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 		      unsigned long maxsize)
 {
-	printf("reading %s\n", filename);
+	/* Only once when a file is read in pieces */
+	if (!pos)
+		printf("reading %s\n", filename);
 	return do_fat_read_at(filename, pos, buffer, maxsize, LS_NO, 0);
 }
 
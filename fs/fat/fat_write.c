@@ -95,33 +95,43 @@ static void set_name(dir_entry *dirent, const char *filename)
 
 static __u8 num_of_fats;
 /*
- * Write fat buffer into block device
+ * Write a modified FAT window into every FAT on the block device
  */
-static int flush_fat_buffer(fsdata *mydata)
+static int flush_fat_window(fsdata *mydata, fat_window *win)
 {
-	int getsize = FATBUFBLOCKS;
-	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock = win->bufnum * FATBUFBLOCKS;
+	int i;
 
-	startblock += mydata->fat_sect;
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
 
-	if (getsize > fatlength)
-		getsize = fatlength;
+	startblock += mydata->fat_sect;
 
-	/* Write FAT buf */
-	if (disk_write(startblock, getsize, bufptr) < 0) {
-		debug("error: writing FAT blocks\n");
-		return -1;
+	for (i = 0; i < num_of_fats; i++) {
+		if (disk_write(startblock, getsize, win->buf) < 0) {
+			debug("error: writing FAT blocks\n");
+			return -1;
+		}
+		startblock += mydata->fatlength;
 	}
+	win->dirty = 0;
 
-	if (num_of_fats == 2) {
-		/* Update corresponding second FAT blocks */
-		startblock += mydata->fatlength;
-		if (disk_write(startblock, getsize, bufptr) < 0) {
-			debug("error: writing second FAT blocks\n");
+	return 0;
+}
+
+/*
+ * Write all modified FAT windows into block device
+ */
+static int flush_fat_buffer(fsdata *mydata)
+{
+	int i;
+
+	for (i = 0; i < FATCACHEWINDOWS; i++) {
+		fat_window *win = &mydata->fatcache[i];
+
+		if (win->dirty && flush_fat_window(mydata, win) < 0)
 			return -1;
-		}
 	}
 
 	return 0;
@@ -130,111 +140,15 @@ static int flush_fat_buffer(fsdata *mydata)
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
- * When bufnum is changed, write back the previous fatbuf to the disk.
  */
 static __u32 get_fatent_value(fsdata *mydata, __u32 entry)
 {
-	__u32 bufnum;
-	__u32 off16, offset;
-	__u32 ret = 0x00;
-	__u16 val1, val2;
-
 	if (CHECK_CLUST(entry, mydata->fatsize)) {
 		printf("Error: Invalid FAT entry: 0x%08x\n", entry);
-		return ret;
-	}
-
-	switch (mydata->fatsize) {
-	case 32:
-		bufnum = entry / FAT32BUFSIZE;
-		offset = entry - bufnum * FAT32BUFSIZE;
-		break;
-	case 16:
-		bufnum = entry / FAT16BUFSIZE;
-		offset = entry - bufnum * FAT16BUFSIZE;
-		break;
-	case 12:
-		bufnum = entry / FAT12BUFSIZE;
-		offset = entry - bufnum * FAT12BUFSIZE;
-		break;
-
-	default:
-		/* Unsupported FAT size */
-		return ret;
-	}
-
-	debug("FAT%d: entry: 0x%04x = %d, offset: 0x%04x = %d\n",
-	       mydata->fatsize, entry, entry, offset, offset);
-
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		if (getsize > fatlength)
-			getsize = fatlength;
-
-		fatlength *= mydata->sect_size;	/* We want it in bytes now */
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (mydata->fatbufnum != -1) {
-			if (flush_fat_buffer(mydata) < 0)
-				return -1;
-		}
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
-
-	/* Get the actual entry from the table */
-	switch (mydata->fatsize) {
-	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
-		break;
-	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
-		break;
-	case 12:
-		off16 = (offset * 3) / 4;
-
-		switch (offset & 0x3) {
-		case 0:
-			ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[off16]);
-			ret &= 0xfff;
-			break;
-		case 1:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
-			val1 &= 0xf000;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
-			val2 &= 0x00ff;
-			ret = (val2 << 4) | (val1 >> 12);
-			break;
-		case 2:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
-			val1 &= 0xff00;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
-			val2 &= 0x000f;
-			ret = (val2 << 8) | (val1 >> 8);
-			break;
-		case 3:
-			ret = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
-			ret = (ret & 0xfff0) >> 4;
-			break;
-		default:
-			break;
-		}
-		break;
+		return 0x00;
 	}
-	debug("FAT%d: ret: %08x, entry: %08x, offset: %04x\n",
-	       mydata->fatsize, ret, entry, offset);
 
-	return ret;
+	return get_fatent(mydata, entry);
 }
 
 /*
@@ -456,12 +370,34 @@ get_long_file_name(fsdata *mydata, int curclust, __u8 *cluster,
 	return 0;
 }
 
+/*
+ * Note whether cluster 'clust' is in use in mydata->usedmap
+ */
+static void mark_cluster(fsdata *mydata, __u32 clust, int used)
+{
+	__u32 *word, bit = 1U << (clust % 32);
+
+	if (!mydata->usedmap || clust >= mydata->clust_count)
+		return;
+
+	word = &mydata->usedmap[clust / 32];
+	if (used && !(*word & bit)) {
+		*word |= bit;
+		mydata->free_count--;
+	} else if (!used && (*word & bit)) {
+		*word &= ~bit;
+		mydata->free_count++;
+	}
+}
+
 /*
  * Set the entry at index 'entry' in a FAT (16/32) table.
+ * The change stays in the FAT window cache until flush_fat_buffer().
  */
 static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
 	__u32 bufnum, offset;
+	fat_window *win;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -477,67 +413,30 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		return -1;
 	}
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		fatlength *= mydata->sect_size;
-		startblock += mydata->fat_sect;
-
-		if (getsize > fatlength)
-			getsize = fatlength;
-
-		if (mydata->fatbufnum != -1) {
-			if (flush_fat_buffer(mydata) < 0)
-				return -1;
-		}
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Find the block of FAT entries in the cache. */
+	if (bufnum * FATBUFBLOCKS >= mydata->fatlength)
+		return -1;
+	win = fat_cache_get(mydata, bufnum);
+	if (!win)
+		return -1;
 
 	/* Set the actual entry */
 	switch (mydata->fatsize) {
 	case 32:
-		((__u32 *) mydata->fatbuf)[offset] = cpu_to_le32(entry_value);
+		((__u32 *) win->buf)[offset] = cpu_to_le32(entry_value);
 		break;
 	case 16:
-		((__u16 *) mydata->fatbuf)[offset] = cpu_to_le16(entry_value);
+		((__u16 *) win->buf)[offset] = cpu_to_le16(entry_value);
 		break;
 	default:
 		return -1;
 	}
+	win->dirty = 1;
+	mark_cluster(mydata, entry, entry_value != 0);
 
 	return 0;
 }
 
-/*
- * Determine the entry value at index 'entry' in a FAT (16/32) table
- */
-static __u32 determine_fatent(fsdata *mydata, __u32 entry)
-{
-	__u32 next_fat, next_entry = entry + 1;
-
-	while (1) {
-		next_fat = get_fatent_value(mydata, next_entry);
-		if (next_fat == 0) {
-			set_fatent_value(mydata, entry, next_entry);
-			break;
-		}
-		next_entry++;
-	}
-	debug("FAT%d: entry: %08x, entry_value: %04x\n",
-	       mydata->fatsize, entry, next_entry);
-
-	return next_entry;
-}
-
 /*
  * Write at most 'size' bytes from 'buffer' into the specified cluster.
  * Return 0 on success, -1 otherwise.
@@ -583,20 +482,75 @@ set_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer,
 }
 
 /*
- * Find the first empty cluster
+ * Find the first free cluster in the range ['from', 'to')
+ * Return 0 if there is none.
  */
-static int find_empty_cluster(fsdata *mydata)
+static __u32 find_free_cluster(fsdata *mydata, __u32 from, __u32 to)
 {
-	__u32 fat_val, entry = 3;
+	__u32 clust;
 
-	while (1) {
-		fat_val = get_fatent_value(mydata, entry);
-		if (fat_val == 0)
-			break;
-		entry++;
+	for (clust = from; clust < to; clust++) {
+		if (!mydata->usedmap) {
+			if (get_fatent_value(mydata, clust) == 0)
+				return clust;
+			continue;
+		}
+
+		/* Skip 32 clusters in use at once */
+		if (mydata->usedmap[clust / 32] == 0xffffffff) {
+			clust |= 31;
+			continue;
+		}
+		if (!(mydata->usedmap[clust / 32] & (1U << (clust % 32))))
+			return clust;
+	}
+
+	return 0;
+}
+
+static int is_free_cluster(fsdata *mydata, __u32 clust)
+{
+	if (clust >= mydata->clust_count)
+		return 0;
+	if (mydata->usedmap)
+		return !(mydata->usedmap[clust / 32] & (1U << (clust % 32)));
+
+	return get_fatent_value(mydata, clust) == 0;
+}
+
+/*
+ * Allocate a run of at most 'max' contiguous free clusters, looking from
+ * mydata->next_free onwards first. The clusters of the run are chained
+ * together and the last one is marked as end of file.
+ * Return the first cluster of the run and its length in 'count', or -1 if
+ * the file system is full.
+ */
+static int find_empty_run(fsdata *mydata, __u32 max, __u32 *count)
+{
+	__u32 start, clust, n;
+
+	start = find_free_cluster(mydata, mydata->next_free,
+				  mydata->clust_count);
+	if (!start)
+		start = find_free_cluster(mydata, 2, mydata->next_free);
+	if (!start)
+		return -1;
+
+	for (n = 1; n < max && is_free_cluster(mydata, start + n); n++)
+		;
+
+	for (clust = start; clust < start + n - 1; clust++) {
+		if (set_fatent_value(mydata, clust, clust + 1))
+			return -1;
 	}
+	if (set_fatent_value(mydata, clust,
+			     mydata->fatsize == 32 ? 0xfffffff : 0xffff))
+		return -1;
 
-	return entry;
+	mydata->next_free = start + n;
+	*count = n;
+
+	return start;
 }
 
 /*
@@ -605,6 +559,7 @@ static int find_empty_cluster(fsdata *mydata)
 static void flush_dir_table(fsdata *mydata, dir_entry **dentptr)
 {
 	int dir_newclust = 0;
+	__u32 count;
 
 	if (set_cluster(mydata, dir_curclust,
 		    get_dentfromdir_block,
@@ -612,18 +567,15 @@ static void flush_dir_table(fsdata *mydata, dir_entry **dentptr)
 		printf("error: wrinting directory entry\n");
 		return;
 	}
-	dir_newclust = find_empty_cluster(mydata);
+	dir_newclust = find_empty_run(mydata, 1, &count);
+	if (dir_newclust < 0) {
+		printf("error: no free cluster for directory\n");
+		return;
+	}
 	set_fatent_value(mydata, dir_curclust, dir_newclust);
-	if (mydata->fatsize == 32)
-		set_fatent_value(mydata, dir_newclust, 0xffffff8);
-	else if (mydata->fatsize == 16)
-		set_fatent_value(mydata, dir_newclust, 0xfff8);
 
 	dir_curclust = dir_newclust;
 
-	if (flush_fat_buffer(mydata) < 0)
-		return;
-
 	memset(get_dentfromdir_block, 0x00,
 		mydata->clust_size * mydata->sect_size);
 
@@ -637,30 +589,37 @@ static int clear_fatent(fsdata *mydata, __u32 entry)
 {
 	__u32 fat_val;
 
-	while (1) {
+	while (!CHECK_CLUST(entry, mydata->fatsize)) {
 		fat_val = get_fatent_value(mydata, entry);
-		if (fat_val != 0)
-			set_fatent_value(mydata, entry, 0);
-		else
+		if (fat_val == 0)
 			break;
 
-		if (fat_val == 0xfffffff || fat_val == 0xffff)
-			break;
+		if (set_fatent_value(mydata, entry, 0))
+			return -1;
 
 		entry = fat_val;
 	}
 
-	/* Flush fat buffer */
-	if (flush_fat_buffer(mydata) < 0)
-		return -1;
-
 	return 0;
 }
 
 /*
- * Write at most 'maxsize' bytes from 'buffer' into
- * the file associated with 'dentptr'
- * Return the number of bytes read or -1 on fatal errors.
+ * Set the first cluster of the file associated with 'dentptr'
+ */
+static void set_start_cluster(fsdata *mydata, dir_entry *dentptr,
+	__u32 start_cluster)
+{
+	if (mydata->fatsize == 32)
+		dentptr->starthi =
+			cpu_to_le16((start_cluster & 0xffff0000) >> 16);
+	dentptr->start = cpu_to_le16(start_cluster & 0xffff);
+}
+
+/*
+ * Write at most 'maxsize' bytes from 'buffer' into newly allocated clusters
+ * and make them the file associated with 'dentptr'. Clusters are allocated
+ * in contiguous runs and each run is written at once.
+ * Return the number of bytes written or -1 on fatal errors.
  */
 static int
 set_contents(fsdata *mydata, dir_entry *dentptr, __u8 *buffer,
@@ -668,9 +627,9 @@ set_contents(fsdata *mydata, dir_entry *dentptr, __u8 *buffer,
 {
 	unsigned long filesize = FAT2CPU32(dentptr->size), gotsize = 0;
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust = 0, newclust = 0;
+	__u32 clusters, count, endclust = 0;
 	unsigned long actsize;
+	int clust;
 
 	debug("Filesize: %ld bytes\n", filesize);
 
@@ -679,69 +638,46 @@ set_contents(fsdata *mydata, dir_entry *dentptr, __u8 *buffer,
 
 	debug("%ld bytes\n", filesize);
 
-	actsize = bytesperclust;
-	endclust = curclust;
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = determine_fatent(mydata, endclust);
+	/* Even an empty file gets one cluster */
+	clusters = DIV_ROUND_UP(filesize, bytesperclust);
+	if (clusters == 0)
+		clusters = 1;
 
-			if ((newclust - 1) != endclust)
-				goto getit;
+	if (mydata->usedmap && clusters > mydata->free_count) {
+		printf("Error: %ld bytes do not fit, %u clusters free\n",
+		       filesize, mydata->free_count);
+		return -1;
+	}
 
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return gotsize;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
-		/* actsize >= file size */
-		actsize -= bytesperclust;
-		/* set remaining clusters */
-		if (set_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			debug("error: writing cluster\n");
+	do {
+		clust = find_empty_run(mydata, clusters, &count);
+		if (clust < 0) {
+			debug("Error: no free clusters\n");
 			return -1;
 		}
+		debug("clusters 0x%x-0x%x\n", clust, clust + count - 1);
 
-		/* set remaining bytes */
-		gotsize += (int)actsize;
-		filesize -= actsize;
-		buffer += actsize;
-		actsize = filesize;
-
-		if (set_cluster(mydata, endclust, buffer, (int)actsize) != 0) {
-			debug("error: writing cluster\n");
-			return -1;
+		if (endclust) {
+			if (set_fatent_value(mydata, endclust, clust))
+				return -1;
+		} else {
+			set_start_cluster(mydata, dentptr, clust);
 		}
-		gotsize += actsize;
 
-		/* Mark end of file in FAT */
-		if (mydata->fatsize == 16)
-			newclust = 0xffff;
-		else if (mydata->fatsize == 32)
-			newclust = 0xfffffff;
-		set_fatent_value(mydata, endclust, newclust);
-
-		return gotsize;
-getit:
-		if (set_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		actsize = min((unsigned long)count * bytesperclust,
+			      filesize - gotsize);
+		if (set_cluster(mydata, clust, buffer, actsize) != 0) {
 			debug("error: writing cluster\n");
 			return -1;
 		}
-		gotsize += (int)actsize;
-		filesize -= actsize;
+		gotsize += actsize;
 		buffer += actsize;
 
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return gotsize;
-		}
-		actsize = bytesperclust;
-		curclust = endclust = newclust;
-	} while (1);
+		clusters -= count;
+		endclust = clust + count - 1;
+	} while (clusters);
+
+	return gotsize;
 }
 
 /*
@@ -750,10 +686,7 @@ getit:
 static void fill_dentry(fsdata *mydata, dir_entry *dentptr,
 	const char *filename, __u32 start_cluster, __u32 size, __u8 attr)
 {
-	if (mydata->fatsize == 32)
-		dentptr->starthi =
-			cpu_to_le16((start_cluster & 0xffff0000) >> 16);
-	dentptr->start = cpu_to_le16(start_cluster & 0xffff);
+	set_start_cluster(mydata, dentptr, start_cluster);
 	dentptr->size = cpu_to_le32(size);
 
 	dentptr->attr = attr;
@@ -761,32 +694,6 @@ static void fill_dentry(fsdata *mydata, dir_entry *dentptr,
 	set_name(dentptr, filename);
 }
 
-/*
- * Check whether adding a file makes the file system to
- * exceed the size of the block device
- * Return -1 when overflow occurs, otherwise return 0
- */
-static int check_overflow(fsdata *mydata, __u32 clustnum, unsigned long size)
-{
-	__u32 startsect, sect_num;
-
-	if (clustnum > 0) {
-		startsect = mydata->data_begin +
-				clustnum * mydata->clust_size;
-	} else {
-		startsect = mydata->rootdir_sect;
-	}
-
-	sect_num = size / mydata->sect_size;
-	if (size % mydata->sect_size)
-		sect_num++;
-
-	if (startsect + sect_num > cur_part_info.start + total_sector)
-		return -1;
-
-	return 0;
-}
-
 /*
  * Check if adding several entries exceed one cluster boundary
  */
@@ -923,6 +830,116 @@ static dir_entry *find_directory_entry(fsdata *mydata, int startsect,
 	return NULL;
 }
 
+/* Sectors of the FAT read at once by fat_build_usedmap() */
+#define FATSCANBLOCKS	128
+
+/*
+ * Read the whole FAT once and note in mydata->usedmap which clusters are in
+ * use, so that free clusters can be found without going through the FAT
+ * entry by entry. Without the memory for it, or on FAT12, usedmap is left
+ * NULL and the FAT is searched instead.
+ */
+static void fat_build_usedmap(fsdata *mydata)
+{
+	__u32 perblock = mydata->sect_size * 8 / mydata->fatsize;
+	__u32 *usedmap;
+	__u32 block, nr_blocks, clust = 0, val, i;
+	__u8 *buf;
+
+	mydata->usedmap = NULL;
+	if (mydata->fatsize == 12)
+		return;
+
+	usedmap = calloc(DIV_ROUND_UP(mydata->clust_count, 32),
+			 sizeof(*usedmap));
+	buf = memalign(ARCH_DMA_MINALIGN, FATSCANBLOCKS * mydata->sect_size);
+	if (!usedmap || !buf) {
+		debug("Not enough memory for the cluster map\n");
+		goto out;
+	}
+
+	mydata->free_count = 0;
+	for (block = 0; clust < mydata->clust_count; block += nr_blocks) {
+		nr_blocks = min((__u32)FATSCANBLOCKS,
+				mydata->fatlength - block);
+		if (disk_read(mydata->fat_sect + block, nr_blocks, buf) < 0) {
+			debug("Error reading FAT blocks\n");
+			goto out;
+		}
+
+		for (i = 0; i < nr_blocks * perblock &&
+		     clust < mydata->clust_count; i++, clust++) {
+			if (mydata->fatsize == 32)
+				val = FAT2CPU32(((__u32 *)buf)[i]) & 0xfffffff;
+			else
+				val = FAT2CPU16(((__u16 *)buf)[i]);
+
+			if (val || clust < 2)
+				usedmap[clust / 32] |= 1U << (clust % 32);
+			else
+				mydata->free_count++;
+		}
+	}
+	mydata->usedmap = usedmap;
+	usedmap = NULL;
+	debug("%u of %u clusters free\n", mydata->free_count,
+	      mydata->clust_count - 2);
+out:
+	free(usedmap);
+	free(buf);
+}
+
+static __u16 fsinfo_sect;
+/*
+ * Start looking for free clusters where the FAT32 FSInfo sector suggests,
+ * if there is one.
+ */
+static void fat_read_fsinfo(fsdata *mydata, boot_sector *bs)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(__u8, buf, mydata->sect_size);
+	fsinfo_sector *info = (fsinfo_sector *)buf;
+	__u32 next_free;
+
+	fsinfo_sect = 0;
+	if (mydata->fatsize != 32 || bs->info_sector == 0 ||
+	    bs->info_sector >= bs->reserved)
+		return;
+
+	if (disk_read(bs->info_sector, 1, buf) < 0 ||
+	    FAT2CPU32(info->signature1) != FSINFO_SIGNATURE1 ||
+	    FAT2CPU32(info->signature2) != FSINFO_SIGNATURE2) {
+		debug("No valid FSInfo sector\n");
+		return;
+	}
+	fsinfo_sect = bs->info_sector;
+
+	next_free = FAT2CPU32(info->next_free);
+	if (next_free >= 2 && next_free < mydata->clust_count)
+		mydata->next_free = next_free;
+}
+
+/*
+ * Update the free cluster count and the next free cluster hint in the FAT32
+ * FSInfo sector. The count is only known when the cluster map was built.
+ */
+static int fat_write_fsinfo(fsdata *mydata)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(__u8, buf, mydata->sect_size);
+	fsinfo_sector *info = (fsinfo_sector *)buf;
+
+	if (!fsinfo_sect)
+		return 0;
+
+	if (disk_read(fsinfo_sect, 1, buf) < 0)
+		return -1;
+
+	info->free_count = cpu_to_le32(mydata->usedmap ? mydata->free_count :
+				       FSINFO_UNKNOWN);
+	info->next_free = cpu_to_le32(mydata->next_free);
+
+	return disk_write(fsinfo_sect, 1, buf) < 0 ? -1 : 0;
+}
+
 static int do_fat_write(const char *filename, void *buffer,
 	unsigned long size)
 {
@@ -978,12 +995,27 @@ static int do_fat_write(const char *filename, void *buffer,
 					(mydata->clust_size * 2);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN,
+				  FATBUFSIZE * FATCACHEWINDOWS);
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
+	fat_cache_init(mydata);
+
+	mydata->clust_count = (total_sector - mydata->data_begin) /
+				mydata->clust_size;
+	if (mydata->clust_count > mydata->fatlength * mydata->sect_size * 8 /
+				  mydata->fatsize)
+		mydata->clust_count = mydata->fatlength * mydata->sect_size *
+					8 / mydata->fatsize;
+	if (CHECK_CLUST(mydata->clust_count, mydata->fatsize))
+		mydata->clust_count = mydata->fatsize == 32 ? 0xffffff0 :
+					0xfff0;
+
+	mydata->next_free = 2;
+	fat_read_fsinfo(mydata, &bs);
+	fat_build_usedmap(mydata);
 
 	if (disk_read(cursect,
 		(mydata->fatsize == 32) ?
@@ -1013,18 +1045,16 @@ static int do_fat_write(const char *filename, void *buffer,
 			start_cluster |=
 				(FAT2CPU16(retdent->starthi) << 16);
 
-		ret = check_overflow(mydata, start_cluster, size);
-		if (ret) {
-			printf("Error: %ld overflow\n", size);
-			goto exit;
-		}
-
 		ret = clear_fatent(mydata, start_cluster);
 		if (ret) {
 			printf("Error: clearing FAT entries\n");
 			goto exit;
 		}
 
+		/* Rewrite the file in place if its clusters allow */
+		if (start_cluster >= 2 && start_cluster < mydata->clust_count)
+			mydata->next_free = start_cluster;
+
 		ret = set_contents(mydata, retdent, buffer, size);
 		if (ret < 0) {
 			printf("Error: writing contents\n");
@@ -1040,6 +1070,12 @@ static int do_fat_write(const char *filename, void *buffer,
 			goto exit;
 		}
 
+		ret = fat_write_fsinfo(mydata);
+		if (ret) {
+			printf("Error: writing FSInfo sector\n");
+			goto exit;
+		}
+
 		/* Write directory table to device */
 		ret = set_cluster(mydata, dir_curclust,
 			    get_dentfromdir_block,
@@ -1053,21 +1089,8 @@ static int do_fat_write(const char *filename, void *buffer,
 		set_name(empty_dentptr, filename);
 		fill_dir_slot(mydata, &empty_dentptr, filename);
 
-		ret = start_cluster = find_empty_cluster(mydata);
-		if (ret < 0) {
-			printf("Error: finding empty cluster\n");
-			goto exit;
-		}
-
-		ret = check_overflow(mydata, start_cluster, size);
-		if (ret) {
-			printf("Error: %ld overflow\n", size);
-			goto exit;
-		}
-
 		/* Set attribute as archieve for regular file */
-		fill_dentry(mydata, empty_dentptr, filename,
-			start_cluster, size, 0x20);
+		fill_dentry(mydata, empty_dentptr, filename, 0, size, 0x20);
 
 		ret = set_contents(mydata, empty_dentptr, buffer, size);
 		if (ret < 0) {
@@ -1084,6 +1107,12 @@ static int do_fat_write(const char *filename, void *buffer,
 			goto exit;
 		}
 
+		ret = fat_write_fsinfo(mydata);
+		if (ret) {
+			printf("Error: writing FSInfo sector\n");
+			goto exit;
+		}
+
 		/* Write directory table to device */
 		ret = set_cluster(mydata, dir_curclust,
 			    get_dentfromdir_block,
@@ -1095,6 +1124,7 @@ static int do_fat_write(const char *filename, void *buffer,
 	}
 
 exit:
+	free(mydata->usedmap);
 	free(mydata->fatbuf);
 	return ret < 0 ? ret : write_size;
 }
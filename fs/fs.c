@@ -16,12 +16,15 @@
 
 #include <config.h>
 #include <common.h>
+#include <errno.h>
 #include <part.h>
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
 #include <sandboxfs.h>
 #include <asm/io.h>
+#include <decompress.h>
+#include <malloc.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -377,6 +380,161 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	return 0;
 }
 
+#ifdef CONFIG_CMD_ZLOAD
+#ifndef CONFIG_ZLOAD_CHUNK_SIZE
+#define CONFIG_ZLOAD_CHUNK_SIZE	(256 << 10)
+#endif
+
+/* Same default limit as bootm uses for uncompressed images */
+#ifndef CONFIG_SYS_BOOTM_LEN
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
+/*
+ * Read the file a chunk at a time and decompress each chunk while it is
+ * still in the cache. Only one chunk of compressed data is ever in memory.
+ */
+static int fs_read_decomp(const char *filename, ulong addr, ulong max_bytes,
+			  ulong *len_read, ulong *len_out)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct decomp_stream ds;
+	unsigned char *chunk;
+	int size, pos, len, comp;
+	void *out;
+	int ret;
+
+	size = info->size(filename);
+	if (size <= 0) {
+		printf("** Unable to read file %s **\n", filename);
+		goto err_close;
+	}
+	chunk = malloc(CONFIG_ZLOAD_CHUNK_SIZE);
+	if (!chunk) {
+		puts("** Out of memory **\n");
+		goto err_close;
+	}
+
+	/* The first chunk says how the file is compressed */
+	len = min(size, CONFIG_ZLOAD_CHUNK_SIZE);
+	if (info->read(filename, chunk, 0, len) != len)
+		goto err_read;
+	comp = decomp_stream_detect(chunk, len);
+	out = map_sysmem(addr, max_bytes);
+	if (decomp_stream_init(&ds, comp, out, max_bytes))
+		goto err_unmap;
+
+	printf("   Loading %s data ... ", genimg_get_comp_name(comp));
+	for (pos = 0;;) {
+		ret = decomp_stream_feed(&ds, chunk, len);
+		pos += len;
+		if (ret || pos == size)
+			break;
+		len = min(size - pos, CONFIG_ZLOAD_CHUNK_SIZE);
+		if (info->read(filename, chunk, pos, len) != len) {
+			ret = -EIO;
+			break;
+		}
+	}
+	*len_read = pos;
+	*len_out = ds.out_len;
+	decomp_stream_end(&ds);
+
+	/* Compressed data must run to its end marker */
+	if (!ret && comp != IH_COMP_NONE)
+		ret = -EIO;
+	if (ret < 0) {
+		if (ret == -ENOSPC)
+			printf("Error: uncompressed size exceeds %#lx bytes\n",
+			       max_bytes);
+		else
+			puts("Error: truncated or corrupt data\n");
+		goto err_unmap;
+	}
+	puts("OK\n");
+	unmap_sysmem(out);
+	free(chunk);
+	fs_close();
+
+	return 0;
+
+err_read:
+	printf("** Unable to read file %s **\n", filename);
+	goto err_free;
+err_unmap:
+	unmap_sysmem(out);
+err_free:
+	free(chunk);
+err_close:
+	fs_close();
+
+	return -1;
+}
+
+int do_zload(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+		int fstype)
+{
+	unsigned long addr;
+	const char *addr_str;
+	const char *filename;
+	unsigned long max_bytes;
+	unsigned long len_read, len_out;
+	unsigned long time;
+	char *ep;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+	if (argc > 6)
+		return CMD_RET_USAGE;
+
+	if (fs_set_blk_dev(argv[1], (argc >= 3) ? argv[2] : NULL, fstype))
+		return 1;
+
+	if (argc >= 4) {
+		addr = simple_strtoul(argv[3], &ep, 16);
+		if (ep == argv[3] || *ep != '\0')
+			return CMD_RET_USAGE;
+	} else {
+		addr_str = getenv("loadaddr");
+		if (addr_str != NULL)
+			addr = simple_strtoul(addr_str, NULL, 16);
+		else
+			addr = CONFIG_SYS_LOAD_ADDR;
+	}
+	if (argc >= 5) {
+		filename = argv[4];
+	} else {
+		filename = getenv("bootfile");
+		if (!filename) {
+			puts("** No boot file defined **\n");
+			return 1;
+		}
+	}
+	if (argc >= 6)
+		max_bytes = simple_strtoul(argv[5], NULL, 16);
+	else
+		max_bytes = CONFIG_SYS_BOOTM_LEN;
+
+	time = get_timer(0);
+	if (fs_read_decomp(filename, addr, max_bytes, &len_read, &len_out))
+		return 1;
+	time = get_timer(time);
+
+	printf("%lu bytes read, %lu bytes uncompressed in %lu ms", len_read,
+	       len_out, time);
+	if (time > 0) {
+		puts(" (");
+		print_size(len_out / time * 1000, "/s");
+		puts(")");
+	}
+	puts("\n");
+
+	setenv_hex("filesize", len_out);
+
+	return 0;
+}
+#endif /* CONFIG_CMD_ZLOAD */
+
 int do_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	int fstype)
 {
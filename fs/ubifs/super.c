@@ -1272,6 +1272,44 @@ static void destroy_journal(struct ubifs_info *c)
 	ubifs_tnc_close(c);
 	free_buds(c);
 }
+#else
+/**
+ * ubifs_parse_options - parse mount parameters.
+ * @c: UBIFS file-system description object
+ * @options: parameters to parse
+ * @is_remount: non-zero if this is FS re-mount
+ *
+ * Only the bulk-read options are known in U-Boot. Files are always loaded
+ * whole here, so bulk-read is on unless "no_bulk_read" is given.
+ */
+static int ubifs_parse_options(struct ubifs_info *c, char *options,
+			       int is_remount)
+{
+	char *p;
+
+	c->mount_opts.bulk_read = 2;
+	c->bulk_read = 1;
+	if (!options)
+		return 0;
+
+	while ((p = strsep(&options, ","))) {
+		if (!*p)
+			continue;
+
+		if (!strcmp(p, "bulk_read")) {
+			c->mount_opts.bulk_read = 2;
+			c->bulk_read = 1;
+		} else if (!strcmp(p, "no_bulk_read")) {
+			c->mount_opts.bulk_read = 1;
+			c->bulk_read = 0;
+		} else {
+			ubifs_err("unrecognized mount option \"%s\"", p);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
 #endif
 
 /**
@@ -2278,6 +2316,10 @@ static int ubifs_fill_super(struct super_block *sb, void *data, int silent)
 		goto out_bdi;
 
 	sb->s_bdi = &c->bdi;
+#else
+	err = ubifs_parse_options(c, data, 0);
+	if (err)
+		goto out_close;
 #endif
 	sb->s_fs_info = c;
 	sb->s_magic = UBIFS_SUPER_MAGIC;
@@ -2322,8 +2364,8 @@ out_unlock:
 #ifndef __UBOOT__
 out_bdi:
 	bdi_destroy(&c->bdi);
-out_close:
 #endif
+out_close:
 	ubi_close_volume(c->ubi);
 out:
 	return err;
@@ -2671,7 +2713,7 @@ MODULE_VERSION(__stringify(UBIFS_VERSION));
 MODULE_AUTHOR("Artem Bityutskiy, Adrian Hunter");
 MODULE_DESCRIPTION("UBIFS - UBI File System");
 #else
-int uboot_ubifs_mount(char *vol_name)
+int uboot_ubifs_mount(char *vol_name, char *options)
 {
 	struct dentry *ret;
 	int flags;
@@ -2686,7 +2728,7 @@ int uboot_ubifs_mount(char *vol_name)
 	 * Mount in read-only mode
 	 */
 	flags = MS_RDONLY;
-	ret = ubifs_mount(&ubifs_fs_type, flags, vol_name, NULL);
+	ret = ubifs_mount(&ubifs_fs_type, flags, vol_name, options);
 	if (IS_ERR(ret)) {
 		printf("Error reading superblock on volume '%s' " \
 			"errno=%d!\n", vol_name, (int)PTR_ERR(ret));
@@ -28,6 +28,7 @@
 
 #include <linux/err.h>
 #include <linux/lzo.h>
+#include <asm/io.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -133,6 +134,7 @@ static inline int crypto_comp_decompress(struct crypto_comp *tfm,
 				u8 *dst, unsigned int *dlen)
 {
 	struct ubifs_compressor *compr = ubifs_compressors[tfm->compressor];
+	size_t len = *dlen;
 	int err;
 
 	if (compr->compr_type == UBIFS_COMPR_NONE) {
@@ -141,7 +143,9 @@ static inline int crypto_comp_decompress(struct crypto_comp *tfm,
 		return 0;
 	}
 
-	err = compr->decompress(src, slen, dst, (size_t *)dlen);
+	/* The decompressors take a size_t, which may be wider than *dlen */
+	err = compr->decompress(src, slen, dst, &len);
+	*dlen = len;
 	if (err)
 		ubifs_err("cannot decompress %d bytes, compressor %s, "
 			  "error %d", slen, compr->name, err);
@@ -621,23 +625,17 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+/*
+ * Check data node @dn for @block of @inode and decompress it to @addr,
+ * zero-filling the rest of the block
+ */
+static int read_data_node(struct inode *inode, void *addr, unsigned int block,
+			  struct ubifs_data_node *dn)
 {
 	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -668,6 +666,73 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	int err;
+	union ubifs_key key;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return read_data_node(inode, addr, block, dn);
+}
+
+/*
+ * Bulk-read: find the data nodes of up to @max blocks from @block which lie
+ * one after the other in the same LEB, fetch them with a single UBI read and
+ * decompress each to its place at @addr. This saves a TNC lookup and a
+ * flash read per block. Holes in between are zero-filled.
+ *
+ * Returns the number of blocks read, 0 if the caller should read @block on
+ * its own, or a negative error code.
+ */
+static int read_bulk(struct ubifs_info *c, struct inode *inode, void *addr,
+		     unsigned int block, unsigned int max)
+{
+	struct bu_info *bu = &c->bu;
+	unsigned int i, n, blk;
+	void *buf;
+	int err;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+	if (!bu->cnt || key_block(c, &bu->zbranch[0].key) >= block + max)
+		return 0;
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err)
+		return err;
+
+	n = min_t(unsigned int, bu->blk_cnt, max);
+	buf = bu->buf;
+	for (i = 0, blk = block; blk < block + n; blk++) {
+		void *dst = addr + (blk - block) * UBIFS_BLOCK_SIZE;
+
+		if (i < bu->cnt && key_block(c, &bu->zbranch[i].key) == blk) {
+			err = read_data_node(inode, dst, blk, buf);
+			if (err)
+				return err;
+			buf += ALIGN(bu->zbranch[i].len, 8);
+			i++;
+		} else {
+			memset(dst, 0, UBIFS_BLOCK_SIZE);
+		}
+	}
+
+	return n;
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -786,7 +851,7 @@ int ubifs_load(char *filename, u32 addr, u32 size)
 	struct inode *inode;
 	struct page page;
 	int err = 0;
-	int i;
+	int i, n;
 	int count;
 	int last_block_size = 0;
 
@@ -820,10 +885,27 @@ int ubifs_load(char *filename, u32 addr, u32 size)
 	printf("Loading file '%s' to addr 0x%08x with size %d (0x%08x)...\n",
 	       filename, addr, size, size);
 
-	page.addr = (void *)addr;
+	page.addr = map_sysmem(addr, size);
 	page.index = 0;
 	page.inode = inode;
 	for (i = 0; i < count; i++) {
+		/*
+		 * The last block may be partial, leave that to do_readpage()
+		 */
+		if (c->bulk_read && i + 1 < count) {
+			n = read_bulk(c, inode, page.addr, i, count - i - 1);
+			if (n < 0) {
+				err = n;
+				break;
+			}
+			if (n) {
+				page.addr += n * PAGE_SIZE;
+				page.index += n;
+				i += n - 1;
+				continue;
+			}
+		}
+
 		/*
 		 * Make sure to not read beyond the requested size
 		 */
@@ -2393,7 +2393,7 @@ int ubifs_decompress(const void *buf, int len, void *out, int *out_len,
 #ifdef __UBOOT__
 /* these are used in cmd_ubifs.c */
 int ubifs_init(void);
-int uboot_ubifs_mount(char *vol_name);
+int uboot_ubifs_mount(char *vol_name, char *options);
 void ubifs_umount(struct ubifs_info *c);
 int ubifs_ls(char *dir_name);
 int ubifs_load(char *filename, u32 addr, u32 size);
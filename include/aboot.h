@@ -23,6 +23,55 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/* What struct sparse_stream expects next */
+enum sparse_stream_state {
+	SPARSE_HEADER,		/* The sparse image header */
+	SPARSE_CHUNK_HEADER,	/* A chunk header */
+	SPARSE_CHUNK_RAW,	/* Data of a raw chunk, or of a raw image */
+	SPARSE_CHUNK_FILL,	/* The value of a fill chunk */
+	SPARSE_DONE,		/* Nothing, the image is complete */
+	SPARSE_ERROR,		/* Nothing, writing failed */
+};
+
+/*
+ * An image written to a partition as it arrives, in pieces of any size.
+ * Sparse images are parsed a chunk at a time, a raw image is written like
+ * one raw chunk.
+ */
+struct sparse_stream {
+	block_dev_desc_t *dev_desc;
+	disk_partition_t *info;
+	const char *part_name;
+	int sparse;			/* Sparse image, else raw */
+	enum sparse_stream_state state;
+	sparse_header_t sparse_header;
+	chunk_header_t chunk_header;
+	unsigned int hdr_bytes;		/* Bytes of the header gathered yet */
+	unsigned int skip;		/* Bytes to skip before going on */
+	unsigned int chunk;		/* Current chunk number */
+	uint64_t data_left;		/* Bytes left in the current chunk */
+	uint32_t fill_val;		/* Value of the current fill chunk */
+	lbaint_t blk;			/* Next block to write */
+	uint32_t total_blocks;		/* Blocks of the sparse image so far */
+	uint64_t bytes_written;
+	void *blkbuf;			/* Partial block of raw data */
+	unsigned int blkbuf_len;	/* Bytes in blkbuf */
+};
+
+/*
+ * Start writing a sparse image, or a raw image of 'raw_size' bytes, to
+ * partition 'info' of 'dev_desc'. Then pass the image in pieces to
+ * sparse_stream_write() and call sparse_stream_finish() at the end, which
+ * sets the fastboot response. On failure the response is set and -1 is
+ * returned.
+ */
+int sparse_stream_init(struct sparse_stream *s, block_dev_desc_t *dev_desc,
+		       disk_partition_t *info, const char *part_name,
+		       int sparse, uint64_t raw_size);
+int sparse_stream_write(struct sparse_stream *s, const void *data,
+			unsigned int len);
+int sparse_stream_finish(struct sparse_stream *s);
+
 void write_sparse_image(block_dev_desc_t *dev_desc,
 		disk_partition_t *info, const char *part_name,
 		void *data, unsigned sz);
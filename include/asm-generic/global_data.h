@@ -68,6 +68,8 @@ typedef struct global_data {
 	struct udevice	*dm_root;	/* Root instance for Driver Model */
 	struct udevice	*dm_root_f;	/* Pre-relocation root instance */
 	struct list_head uclass_root;	/* Head of core tree */
+	struct uclass	**uclass_table;	/* Each uclass, indexed by id */
+	struct dm_compat_index *dm_compat;	/* Driver compatible strings */
 #endif
 
 	const void *fdt_blob;	/* Our device tree, NULL if none */
@@ -48,6 +48,7 @@
 #define CONFIG_ANDROID_BOOT_IMAGE
 
 #define CONFIG_FS_FAT
+#define CONFIG_FAT_WRITE
 #define CONFIG_FS_EXT4
 #define CONFIG_EXT4_WRITE
 #define CONFIG_CMD_FAT
@@ -58,8 +59,27 @@
 #define CONFIG_HOST_MAX_DEVICES 4
 #define CONFIG_CMD_FS_GENERIC
 
+#define CONFIG_MMC
+#define CONFIG_GENERIC_MMC
+#define CONFIG_CMD_MMC
+#define CONFIG_SANDBOX_MMC
+/* Build the fastboot eMMC writer, tested by test_sparse */
+#define CONFIG_FASTBOOT_FLASH_MMC_DEV	0
+
 #define CONFIG_SYS_VSNPRINTF
 
+/* Emulated NAND flash with UBI and UBIFS, see test/fs/test-ubifs-read.py */
+#define CONFIG_CMD_NAND
+#define CONFIG_NAND_SANDBOX
+#define CONFIG_SYS_MAX_NAND_DEVICE	1
+#define CONFIG_SYS_NAND_BASE		0
+#define CONFIG_MTD_DEVICE
+#define CONFIG_MTD_PARTITIONS
+#define CONFIG_CMD_MTDPARTS
+#define CONFIG_RBTREE
+#define CONFIG_CMD_UBI
+#define CONFIG_CMD_UBIFS
+
 #define CONFIG_CMD_GPIO
 #define CONFIG_SANDBOX_GPIO
 #define CONFIG_SANDBOX_GPIO_COUNT	128
@@ -76,6 +96,7 @@
 #define CONFIG_SYS_MALLOC_LEN		(32 << 20)	/* 32MB  */
 
 #define CONFIG_SYS_HUSH_PARSER
+#define CONFIG_HUSH_PARSE_CACHE
 #define CONFIG_SYS_LONGHELP			/* #undef to save memory */
 #define CONFIG_SYS_CBSIZE		1024	/* Console I/O Buffer Size */
 
@@ -90,7 +111,14 @@
 #define CONFIG_BOOTDELAY	3
 
 #define CONFIG_ENV_SIZE		8192
+#ifdef CONFIG_SANDBOX_ENV_IN_MMC
+/* Keep the environment on the emulated eMMC, used by test/env */
+#define CONFIG_ENV_IS_IN_MMC
+#define CONFIG_SYS_MMC_ENV_DEV		0
+#define CONFIG_ENV_OFFSET		0x100000
+#else
 #define CONFIG_ENV_IS_NOWHERE
+#endif
 
 /* SPI - enable all SPI flash types for testing purposes */
 #define CONFIG_SANDBOX_SPI
@@ -135,15 +163,22 @@
 /* include default commands */
 #include <config_cmd_default.h>
 
-/* We don't have networking support yet */
-#undef CONFIG_CMD_NET
-#undef CONFIG_CMD_NFS
+/* Networking goes through a host tap interface, see --tap */
+#define CONFIG_ETH_SANDBOX
+#define CONFIG_ETHADDR			02:00:11:22:33:44
+#define CONFIG_IP_DEFRAG
+#define CONFIG_CMD_WGET
+#define CONFIG_CMD_ETHSTATS
+
+#define CONFIG_BCH
 
 #define CONFIG_CMD_HASH
 #define CONFIG_HASH_VERIFY
 #define CONFIG_SHA1
 #define CONFIG_SHA256
 
+#define CONFIG_CMD_TIME
+
 #define CONFIG_TPM_TIS_SANDBOX
 
 #define CONFIG_CMD_SANDBOX
@@ -192,9 +227,12 @@
 #define CONFIG_BZIP2
 #define CONFIG_LZO
 #define CONFIG_LZMA
+#define CONFIG_DECOMP_STREAM
+#define CONFIG_CMD_ZLOAD
 
 #define CONFIG_TPM_TIS_SANDBOX
 
 #define CONFIG_CMD_LZMADEC
+#define CONFIG_CMD_UNZIP
 
 #endif
@@ -0,0 +1,80 @@
+/*
+ * Decompression of images which arrive a piece at a time
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __DECOMPRESS_H
+#define __DECOMPRESS_H
+
+/**
+ * struct decomp_stream - Decompression of data which arrives in pieces
+ *
+ * This allows a compressed image to be decompressed while it is being read,
+ * for example from a filesystem, so that the whole compressed image never
+ * needs to be in memory. The output goes to a single buffer.
+ *
+ * @comp:	Compression type (IH_COMP_...)
+ * @out:	Output buffer
+ * @out_size:	Size of output buffer in bytes
+ * @out_len:	Number of bytes decompressed so far
+ * @priv:	Private state of the decompressor
+ */
+struct decomp_stream {
+	int comp;
+	unsigned char *out;
+	ulong out_size;
+	ulong out_len;
+	void *priv;
+};
+
+/**
+ * decomp_stream_detect() - Work out the compression type of some data
+ *
+ * This looks at the magic number at the start of a gzip, lzma or lzop
+ * file. Only types which are enabled in U-Boot are detected.
+ *
+ * @buf:	Start of the data
+ * @len:	Number of bytes available at buf
+ * @return compression type (IH_COMP_...), IH_COMP_NONE if not recognised
+ */
+int decomp_stream_detect(const void *buf, ulong len);
+
+/**
+ * decomp_stream_init() - Start decompressing
+ *
+ * @ds:		Stream to set up
+ * @comp:	Compression type (IH_COMP_...). IH_COMP_NONE copies the data.
+ * @out:	Output buffer
+ * @out_size:	Size of output buffer in bytes
+ * @return 0 if OK, -EPROTONOSUPPORT if the type is not supported, -ENOMEM
+ * if out of memory
+ */
+int decomp_stream_init(struct decomp_stream *ds, int comp, void *out,
+		       ulong out_size);
+
+/**
+ * decomp_stream_feed() - Decompress the next piece of input
+ *
+ * Pieces can be any size, down to a single byte. Once the end of the
+ * compressed data is found, any further input is ignored.
+ *
+ * @ds:		Stream to use
+ * @in:		Next piece of input
+ * @len:	Size of piece in bytes
+ * @return 0 if more input is needed, 1 if the end of the compressed data
+ * was reached, -ENOSPC if the output buffer is full, other -ve value on
+ * error
+ */
+int decomp_stream_feed(struct decomp_stream *ds, const void *in, ulong len);
+
+/**
+ * decomp_stream_end() - Finish decompressing and free the stream's state
+ *
+ * The output (ds->out_len bytes) remains in the output buffer.
+ *
+ * @ds:		Stream to finish
+ */
+void decomp_stream_end(struct decomp_stream *ds);
+
+#endif
@@ -85,6 +85,12 @@ struct sf_internal_data {
 #ifndef CONFIG_SYS_DFU_DATA_BUF_SIZE
 #define CONFIG_SYS_DFU_DATA_BUF_SIZE		(1024*1024*8)	/* 8 MiB */
 #endif
+#ifndef CONFIG_SYS_DFU_DATA_BUF_COUNT
+#define CONFIG_SYS_DFU_DATA_BUF_COUNT		2
+#endif
+#ifndef CONFIG_SYS_DFU_WRITE_SIZE
+#define CONFIG_SYS_DFU_WRITE_SIZE		(128 * 1024)	/* 128 KiB */
+#endif
 #ifndef CONFIG_SYS_DFU_MAX_FILE_SIZE
 #define CONFIG_SYS_DFU_MAX_FILE_SIZE CONFIG_SYS_DFU_DATA_BUF_SIZE
 #endif
@@ -102,6 +108,7 @@ struct dfu_entity {
 	enum dfu_device_type    dev_type;
 	enum dfu_layout         layout;
 	unsigned long           max_buf_size;
+	unsigned long           write_size;	/* per background write, 0: all */
 
 	union {
 		struct mmc_internal_data mmc;
@@ -137,6 +144,11 @@ struct dfu_entity {
 
 	u32 bad_skip;	/* for nand use */
 
+	/* download statistics */
+	u64 received;
+	ulong start_time;
+	ulong write_time;	/* ms spent in write_medium() */
+
 	unsigned int inited:1;
 };
 
@@ -157,6 +169,8 @@ int dfu_init_env_entities(char *interface, char *devstr);
 unsigned char *dfu_get_buf(struct dfu_entity *dfu);
 unsigned char *dfu_free_buf(void);
 unsigned long dfu_get_buf_size(void);
+void dfu_set_write_behind(bool enable);
+int dfu_write_pending(void);
 bool dfu_usb_get_reset(void);
 
 int dfu_read(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
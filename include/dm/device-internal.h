@@ -102,5 +102,7 @@ int device_unbind(struct udevice *dev);
 /* Cast away any volatile pointer */
 #define DM_ROOT_NON_CONST		(((gd_t *)gd)->dm_root)
 #define DM_UCLASS_ROOT_NON_CONST	(((gd_t *)gd)->uclass_root)
+#define DM_UCLASS_TABLE_NON_CONST	(((gd_t *)gd)->uclass_table)
+#define DM_COMPAT_NON_CONST		(((gd_t *)gd)->dm_compat)
 
 #endif
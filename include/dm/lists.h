@@ -12,6 +12,24 @@
 
 #include <dm/uclass-id.h>
 
+/**
+ * lists_init() - Set up the lookup index for driver compatible strings
+ *
+ * This hashes the compatible strings of all drivers, so that
+ * lists_bind_fdt() can find the driver for a node without checking it
+ * against every driver. Driver addresses change on relocation, so this is
+ * called by dm_init() each time.
+ *
+ * If there is not enough memory for the index, lists_bind_fdt() falls back
+ * to checking each driver in turn.
+ */
+void lists_init(void);
+
+/**
+ * lists_uninit() - Free the index set up by lists_init()
+ */
+void lists_uninit(void);
+
 /**
  * lists_driver_lookup_name() - Return u_boot_driver corresponding to name
  *
@@ -30,6 +30,8 @@
 
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_MAX_EXTENT_DEPTH		5
+#define EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER	0x0001
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_INDIRECT_BLOCKS		12
@@ -97,16 +99,19 @@ struct ext_filesystem {
 	struct ext2_block_group *bgd;
 	char *gdtable;
 
-	/* Block Bitmap Related */
+	/* Block Bitmap Related, bitmaps are read when first used */
 	unsigned char **blk_bmaps;
 	long int curr_blkno;
 	uint16_t first_pass_bbmap;
 
-	/* Inode Bitmap Related */
+	/* Inode Bitmap Related, bitmaps are read when first used */
 	unsigned char **inode_bmaps;
 	int curr_inode_no;
 	uint16_t first_pass_ibmap;
 
+	/* Per block group, which bitmaps to write back */
+	unsigned char *bg_dirty;
+
 	/* Journal Related */
 
 	/* Block Device Descriptor */
@@ -141,6 +146,8 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot);
 int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(block_dev_desc_t *rbdd, disk_partition_t *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock);
+long int ext4fs_map_extent(struct ext2_inode *inode, uint32_t fileblock,
+			   uint32_t *count);
 int ext4fs_probe(block_dev_desc_t *fs_dev_desc,
 		 disk_partition_t *fs_partition);
 int ext4_read_file(const char *filename, void *buf, int offset, int len);
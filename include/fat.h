@@ -33,6 +33,12 @@
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
 
+/* Number of FATBUFBLOCKS windows of the FAT cached while reading */
+#ifndef CONFIG_FS_FAT_CACHE_WINDOWS
+#define CONFIG_FS_FAT_CACHE_WINDOWS	8
+#endif
+#define FATCACHEWINDOWS	CONFIG_FS_FAT_CACHE_WINDOWS
+
 
 /* Filesystem identifiers */
 #define FAT12_SIGN	"FAT12   "
@@ -122,6 +128,22 @@ typedef struct boot_sector {
 	__u16	reserved2[6];	/* Unused */
 } boot_sector;
 
+/* FAT32 FSInfo sector, found at boot_sector.info_sector */
+typedef struct fsinfo_sector {
+	__u32	signature1;	/* FSINFO_SIGNATURE1 */
+	__u8	reserved1[480];	/* Unused */
+	__u32	signature2;	/* FSINFO_SIGNATURE2 */
+	__u32	free_count;	/* Free clusters, 0xffffffff if unknown */
+	__u32	next_free;	/* Hint for the next free cluster */
+	__u8	reserved2[12];	/* Unused */
+	__u32	signature3;	/* FSINFO_SIGNATURE3 */
+} fsinfo_sector;
+
+#define FSINFO_SIGNATURE1	0x41615252
+#define FSINFO_SIGNATURE2	0x61417272
+#define FSINFO_SIGNATURE3	0xaa550000
+#define FSINFO_UNKNOWN		0xffffffff
+
 typedef struct volume_info
 {
 	__u8 drive_number;	/* BIOS drive number */
@@ -158,6 +180,20 @@ typedef struct dir_slot {
 	__u8	name11_12[4];	/* Last 2 characters in name */
 } dir_slot;
 
+/* A cached window of FATBUFBLOCKS sectors of the FAT */
+typedef struct {
+	__u8	*buf;		/* Window contents, part of fsdata.fatbuf */
+	int	bufnum;		/* Window number, -1 if unused */
+	__u32	lastuse;	/* Value of fsdata.fatcacheuse on last access */
+	int	dirty;		/* Modified since read, used when writing */
+} fat_window;
+
+/* A run of contiguous clusters of a cluster chain */
+typedef struct {
+	__u32	start;		/* First cluster of the run */
+	__u32	count;		/* Number of clusters in the run */
+} fat_run;
+
 /*
  * Private filesystem parameters
  *
@@ -173,7 +209,13 @@ typedef struct {
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	fat_window fatcache[FATCACHEWINDOWS];	/* Used by get_fatent */
+	__u32	fatcacheuse;	/* LRU clock of fatcache */
+	__u32	*usedmap;	/* Used when writing: one bit per cluster, */
+				/* set if in use, NULL if not available */
+	__u32	clust_count;	/* Number of clusters, including 0 and 1 */
+	__u32	free_count;	/* Number of free clusters */
+	__u32	next_free;	/* Where to start looking for free clusters */
 } fsdata;
 
 typedef int	(file_detectfs_func)(void);
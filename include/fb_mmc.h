@@ -6,3 +6,22 @@
 
 void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 			unsigned int download_bytes, char *response);
+
+/*
+ * Streaming: after fb_mmc_stream_prepare() names a partition, the next
+ * download of at most fb_mmc_stream_max_size() bytes is written to it as it
+ * arrives. Call fb_mmc_stream_start() when that download starts,
+ * fb_mmc_stream_write() for each piece of it in order and
+ * fb_mmc_stream_end() once all of it is there. fb_mmc_flash_streamed() then
+ * gives the response to the flash command, which must name the same
+ * partition. fb_mmc_stream_max_size() is 0 again as soon as the download
+ * starts. An empty partition name, or fb_mmc_stream_cancel(), stops
+ * streaming before that.
+ */
+void fb_mmc_stream_prepare(const char *cmd, char *response);
+void fb_mmc_stream_cancel(void);
+unsigned int fb_mmc_stream_max_size(void);
+void fb_mmc_stream_start(unsigned int size);
+void fb_mmc_stream_write(const void *buf, unsigned int len);
+void fb_mmc_stream_end(void);
+int fb_mmc_flash_streamed(const char *cmd, char *response);
@@ -175,6 +175,24 @@ struct jr_regs {
 	u32 jrcr;
 };
 
+/*
+ * Scatter/gather table entry
+ */
+struct sg_entry {
+#ifdef CONFIG_SYS_FSL_SEC_LE
+	u32 addr_lo;	/* Memory Address - lo */
+	u32 addr_hi;	/* Memory Address - hi, in the low 16 bits */
+#else
+	u32 addr_hi;	/* Memory Address - hi, in the low 16 bits */
+	u32 addr_lo;	/* Memory Address - lo */
+#endif
+	u32 len_flag;	/* Length of the data in the frame */
+#define SG_ENTRY_LENGTH_MASK	0x3FFFFFFF
+#define SG_ENTRY_EXTENSION_BIT	0x80000000
+#define SG_ENTRY_FINAL_BIT	0x40000000
+	u32 bpid_offset;
+};
+
 int sec_init(void);
 #endif
 
@@ -127,6 +127,21 @@ int hash_block(const char *algo_name, const void *data, unsigned int len,
  */
 int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
 
+/**
+ * hash_progressive_lookup_algo() - Look up an algorithm for progressive use
+ *
+ * This is like hash_lookup_algo() but only finds algorithms which provide
+ * hash_init(), hash_update() and hash_finish(), so that data can be hashed
+ * a piece at a time.
+ *
+ * @algo_name: Hash algorithm to look up
+ * @algop: Pointer to the hash_algo struct if found
+ *
+ * @return 0 if ok, -EPROTONOSUPPORT for an unknown algorithm.
+ */
+int hash_progressive_lookup_algo(const char *algo_name,
+				 struct hash_algo **algop);
+
 /**
  * hash_show() - Print out a hash algorithm and value
  *
@@ -815,11 +815,13 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp);
  * Adds hash values for all component images in the FIT blob.
  * Hashes are calculated for all component images which have hash subnodes
  * with algorithm property set to one of the supported hash algorithms.
+ * They are all calculated before any is stored, spread over the CPUs.
  *
  * Also add signatures if signature nodes are present.
  *
  * returns
  *     0, on success
+ *     -ENOSPC, if the FIT or keydest blob needs more room
  *     libfdt error code, on failure
  */
 int fit_add_verification_data(const char *keydir, void *keydest, void *fit,
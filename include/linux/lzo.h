@@ -31,6 +31,13 @@ int lzo1x_decompress_safe(const unsigned char *src, size_t src_len,
 int lzop_decompress(const unsigned char *src, size_t src_len,
 		    unsigned char *dst, size_t *dst_len);
 
+/*
+ * Work out the length of the lzop header at src, given len bytes.
+ * Returns the length, 0 if more bytes are needed or -1 if this is not
+ * an lzop file.
+ */
+int lzop_header_len(const unsigned char *src, size_t len);
+
 /*
  * Return values (< 0 = Error)
  */
@@ -272,6 +272,10 @@ struct mtd_info {
 	struct device dev;
 #endif
 	int usecount;
+#ifdef __UBOOT__
+	/* Bumped by every write, erase or bad block marking through mtd_*() */
+	unsigned int write_gen;
+#endif
 };
 
 int mtd_erase(struct mtd_info *mtd, struct erase_info *instr);
@@ -299,6 +303,9 @@ static inline int mtd_write_oob(struct mtd_info *mtd, loff_t to,
 		return -EOPNOTSUPP;
 	if (!(mtd->flags & MTD_WRITEABLE))
 		return -EROFS;
+#ifdef __UBOOT__
+	mtd->write_gen++;
+#endif
 	return mtd->_write_oob(mtd, to, ops);
 }
 
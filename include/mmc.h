@@ -39,8 +39,10 @@
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_HC		(1 << 5)
 #define MMC_MODE_DDR_52MHz	(1 << 6)
+#define MMC_MODE_CMD23		(1 << 7)	/* Set block count for reads */
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_CMD23_SUPPORT	0x00000002
 
 #define IS_SD(x) (x->version & SD_VERSION_SD)
 
@@ -257,6 +259,19 @@ struct mmc_data {
 	uint blocksize;
 };
 
+/*
+ * A block read. For multi-block reads with MMC_MODE_CMD23, sbc is sent first
+ * to set the block count and no stop command is needed afterwards.
+ */
+struct mmc_read_req {
+	struct mmc_cmd sbc;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+};
+
+/* Number of reads the core keeps queued with a host that supports it */
+#define MMC_READ_QUEUE_DEPTH	2
+
 /* forward decl. */
 struct mmc;
 
@@ -267,6 +282,16 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	/*
+	 * Optional queued reads, used with cards which support CMD23.
+	 * queue_read() takes a read and may return before it is sent, so that
+	 * the host can prepare the next read while the current transfer is
+	 * still running. wait_read() waits for the oldest queued read and
+	 * returns its result. At most MMC_READ_QUEUE_DEPTH reads are queued,
+	 * and each request stays valid until wait_read() has returned for it.
+	 */
+	int (*queue_read)(struct mmc *mmc, struct mmc_read_req *req);
+	int (*wait_read)(struct mmc *mmc);
 };
 
 struct mmc_config {
@@ -304,6 +329,7 @@ struct mmc {
 	uint read_bl_len;
 	uint write_bl_len;
 	uint erase_grp_size;
+	uint blocklen;		/* Last length set by CMD16, 0 if unknown */
 	u64 capacity;
 	u64 capacity_user;
 	u64 capacity_boot;
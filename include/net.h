@@ -67,6 +67,16 @@ typedef void rxhand_f(uchar *pkt, unsigned dport,
 typedef void rxhand_icmp_f(unsigned type, unsigned code, unsigned dport,
 		IPaddr_t sip, unsigned sport, uchar *pkt, unsigned len);
 
+/**
+ * An incoming TCP segment handler.
+ * @param pkt	pointer to the TCP header
+ * @param sip	source IP address
+ * @param dip	destination IP address
+ * @param len	segment length, TCP header included
+ */
+typedef void rxhand_tcp_f(uchar *pkt, IPaddr_t sip, IPaddr_t dip,
+		unsigned len);
+
 /*
  *	A timeout handler.  Called after time interval has expired.
  */
@@ -78,11 +88,24 @@ enum eth_state_t {
 	ETH_STATE_ACTIVE
 };
 
+/*
+ * Receive statistics, kept for each device and shown by "ethstats"
+ */
+struct eth_rx_stats {
+	ulong packets;		/* Frames passed to NetReceive() */
+	ulong bytes;
+	ulong errors;		/* Frames the MAC flagged as bad */
+	ulong dropped;		/* Frames the MAC or driver had to discard */
+	ulong overruns;		/* Polls which found the whole ring full */
+	ulong max_batch;	/* Most frames handled in one poll */
+};
+
 struct eth_device {
 	char name[16];
 	unsigned char enetaddr[6];
 	int iobase;
 	int state;
+	struct eth_rx_stats rx_stats;
 
 	int  (*init) (struct eth_device *, bd_t *);
 	int  (*send) (struct eth_device *, void *packet, int length);
@@ -139,6 +162,47 @@ extern int eth_receive(void *packet, int length); /* Receive a packet*/
 extern void (*push_packet)(void *packet, int length);
 #endif
 extern int eth_rx(void);			/* Check for received packets */
+
+/*
+ * Number of receive descriptors for drivers using struct eth_rx_ring.
+ * CONFIG_ETH_RX_RING_SIZE overrides the driver's own default.
+ */
+#ifdef CONFIG_ETH_RX_RING_SIZE
+#define ETH_RX_RING_SIZE(def)	CONFIG_ETH_RX_RING_SIZE
+#else
+#define ETH_RX_RING_SIZE(def)	(def)
+#endif
+
+/*
+ * Receive descriptor ring bookkeeping shared by DMA drivers. The driver
+ * keeps its own descriptors and buffers and supplies two callbacks;
+ * eth_rx_ring_poll() then hands every completed descriptor to NetReceive()
+ * in one call, so frames which arrived since the last poll do not have to
+ * wait one NetLoop() iteration each while the MAC runs out of buffers. It
+ * stops early, leaving the rest on the ring, once a handler has ended or
+ * restarted the loop.
+ */
+struct eth_rx_ring {
+	unsigned int size;	/* Number of descriptors */
+	unsigned int head;	/* Next descriptor to look at */
+	/*
+	 * Check descriptor @idx. Returns the frame length and sets *pkt if
+	 * it holds a good frame, 0 if the MAC still owns it, or -ve if it
+	 * completed with an error.
+	 */
+	int (*check)(struct eth_device *dev, unsigned int idx, uchar **pkt);
+	/* Hand descriptor @idx back to the MAC */
+	void (*release)(struct eth_device *dev, unsigned int idx);
+};
+
+/**
+ * eth_rx_ring_poll() - Process all completed receive descriptors
+ *
+ * @dev:	Device the ring belongs to, for the statistics
+ * @ring:	Ring to poll
+ * @return number of bytes received
+ */
+int eth_rx_ring_poll(struct eth_device *dev, struct eth_rx_ring *ring);
 extern void eth_halt(void);			/* stop SCC */
 extern char *eth_get_name(void);		/* get name of current device */
 
@@ -227,6 +291,7 @@ struct vlan_ethernet_hdr {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -366,6 +431,11 @@ struct icmp_hdr {
 #define PKTSIZE_ALIGN		1536
 /*#define PKTSIZE		608*/
 
+/* Largest UDP payload (beyond protocol headers) rebuilt by CONFIG_IP_DEFRAG */
+#ifndef CONFIG_NET_MAXDEFRAG
+#define CONFIG_NET_MAXDEFRAG	16384
+#endif
+
 /*
  * Maximum receive ring size; that is, the number of packets
  * we can buffer before overflow happens. Basically, this just
@@ -420,7 +490,7 @@ extern int		NetRestartWrap;		/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL
+	TFTPSRV, TFTPPUT, LINKLOCAL, WGET
 };
 
 /* from net/net.c */
@@ -492,6 +562,7 @@ extern void net_set_udp_handler(rxhand_f *);	/* Set UDP RX packet handler */
 extern rxhand_f *net_get_arp_handler(void);	/* Get ARP RX packet handler */
 extern void net_set_arp_handler(rxhand_f *);	/* Set ARP RX packet handler */
 extern void net_set_icmp_handler(rxhand_icmp_f *f); /* Set ICMP RX handler */
+extern void net_set_tcp_handler(rxhand_tcp_f *f); /* Set TCP RX handler */
 extern void	NetSetTimeout(ulong, thand_f *);/* Set timeout handler */
 
 /* Network loop state */
@@ -528,6 +599,16 @@ static inline void NetSendPacket(uchar *pkt, int len)
 extern int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport,
 			int sport, int payload_len);
 
+/*
+ * Transmit the IP packet already built in "NetTxPacket", performing an
+ * ARP request first if the destination MAC address is not known yet.
+ *
+ * @param ether Destination MAC address, filled in once ARP resolves it
+ * @param dest IP address to send the packet to
+ * @param len Length of the packet, Ethernet header included
+ */
+extern int net_send_ip_packet(uchar *ether, IPaddr_t dest, int len);
+
 /* Processes a received packet */
 extern void NetReceive(uchar *, int);
 
@@ -276,4 +276,17 @@ int os_read_ram_buf(const char *fname);
  */
 int os_jump_to_image(const void *dest, int size);
 
+/**
+ * Attach to a host tap network interface
+ *
+ * The interface must already exist (e.g. 'ip tuntap add dev tap0 mode tap')
+ * and be accessible by the user running U-Boot. Each read() or write() on
+ * the returned descriptor transfers a single Ethernet frame. Reads do not
+ * block.
+ *
+ * @param ifname	Name of the host interface
+ * @return file descriptor, or -1 on error
+ */
+int os_tap_open(const char *ifname);
+
 #endif
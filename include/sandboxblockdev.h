@@ -11,6 +11,11 @@ struct host_block_dev {
 	block_dev_desc_t blk_dev;
 	char *filename;
 	int fd;
+	/* I/O statistics since the device was bound */
+	unsigned long read_calls;
+	unsigned long read_blocks;
+	unsigned long write_calls;
+	unsigned long write_blocks;
 };
 
 int host_dev_bind(int dev, char *filename);
@@ -0,0 +1,31 @@
+/*
+ * Emulated eMMC card for sandbox
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __SANDBOX_MMC_H
+#define __SANDBOX_MMC_H
+
+/* What the emulated host controller offers, see sandbox_mmc_set_mode() */
+enum sandbox_mmc_mode {
+	SANDBOX_MMC_STOP,	/* Multi-block reads end with CMD12 */
+	SANDBOX_MMC_CMD23,	/* Reads set the block count with CMD23 */
+	SANDBOX_MMC_QUEUE,	/* As CMD23, with queued reads */
+};
+
+/* Card statistics since the last sandbox_mmc_reset_stats() */
+struct sandbox_mmc_stats {
+	unsigned long cmds[64];		/* Commands received, by index */
+	unsigned long busy;		/* Commands with a busy response */
+	unsigned long queued;		/* Reads queued by the host */
+	unsigned long blocks_read;
+	unsigned long blocks_written;
+};
+
+int sandbox_mmc_init(void);
+void sandbox_mmc_set_mode(enum sandbox_mmc_mode mode);
+const struct sandbox_mmc_stats *sandbox_mmc_get_stats(void);
+void sandbox_mmc_reset_stats(void);
+
+#endif
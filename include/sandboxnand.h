@@ -0,0 +1,22 @@
+/*
+ * Emulated NAND flash chip for sandbox
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __SANDBOX_NAND_H
+#define __SANDBOX_NAND_H
+
+/* Chip statistics since the last sandbox_nand_reset_stats() */
+struct sandbox_nand_stats {
+	unsigned long cmds;		/* Commands received */
+	unsigned long page_reads;	/* Pages loaded into the page register */
+	unsigned long bytes_read;	/* Bytes read out of the page register */
+	unsigned long page_programs;
+	unsigned long block_erases;
+};
+
+const struct sandbox_nand_stats *sandbox_nand_get_stats(void);
+void sandbox_nand_reset_stats(void);
+
+#endif
@@ -39,8 +39,10 @@ typedef struct entry {
 	int flags;
 } ENTRY;
 
-/* Opaque type for internal use.  */
+/* Opaque types for internal use.  */
 struct _ENTRY;
+struct _HSLOT;
+struct _HARENA;
 
 /*
  * Family of hash table handling functions.  The functions also
@@ -50,9 +52,13 @@ struct _ENTRY;
 
 /* Data type for reentrant functions.  */
 struct hsearch_data {
-	struct _ENTRY *table;
+	struct _HSLOT *table;		/* index, a power of two in size */
 	unsigned int size;
-	unsigned int filled;
+	unsigned int filled;		/* number of entries */
+	struct _ENTRY **order;		/* the entries sorted by key */
+	unsigned int order_size;
+	unsigned int sorted;		/* entries merged into key order */
+	struct _HARENA *arena;		/* holds the entries and strings */
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -64,7 +70,10 @@ struct hsearch_data {
 		int flag);
 };
 
-/* Create a new hashing table which will at most contain NEL elements.  */
+/*
+ * Create a new hashing table sized for NEL elements. It grows if more
+ * are entered.
+ */
 extern int hcreate_r(size_t __nel, struct hsearch_data *__htab);
 
 /* Destroy current internal hashing table.  */
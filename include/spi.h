@@ -245,6 +245,49 @@ int spi_set_wordlen(struct spi_slave *slave, unsigned int wordlen);
 int  spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 		void *din, unsigned long flags);
 
+/**
+ * struct spi_flash_read_msg - A complete read from a SPI flash
+ *
+ * This describes a flash read as a whole, so that a controller with a
+ * memory-mapped window or DMA engine for flash can do it in one go.
+ *
+ * @from:		Offset in the flash to read from
+ * @len:		Number of bytes to read
+ * @buf:		Buffer to read into
+ * @read_opcode:	Read command
+ * @addr_width:		Number of address bytes
+ * @dummy_bytes:	Number of dummy bytes after the address, sent on
+ *			@addr_nbits lines
+ * @opcode_nbits:	Number of data lines for the command (1, 2 or 4)
+ * @addr_nbits:		Number of data lines for the address
+ * @data_nbits:		Number of data lines for the data
+ */
+struct spi_flash_read_msg {
+	u32 from;
+	size_t len;
+	void *buf;
+	u8 read_opcode;
+	u8 addr_width;
+	u8 dummy_bytes;
+	u8 opcode_nbits;
+	u8 addr_nbits;
+	u8 data_nbits;
+};
+
+/**
+ * Read from a SPI flash with the controller's flash read engine
+ *
+ * The bus must already be claimed. Callers fall back to spi_xfer() when
+ * this returns -ENOSYS.
+ *
+ * @slave:	The SPI slave (the flash)
+ * @msg:	The read to do
+ *
+ * Returns: 0 on success, -ENOSYS if the controller has no flash read
+ * engine or cannot do this read with it, other -ve value on failure
+ */
+int spi_read_flash(struct spi_slave *slave, struct spi_flash_read_msg *msg);
+
 /**
  * Determine if a SPI chipselect is valid.
  * This function is provided by the board if the low-level SPI driver
@@ -418,6 +461,20 @@ struct dm_spi_ops {
 	int (*xfer)(struct udevice *dev, unsigned int bitlen, const void *dout,
 		    void *din, unsigned long flags);
 
+	/**
+	 * Read from a SPI flash in one operation (optional)
+	 *
+	 * Controllers with a memory-mapped window or DMA engine for SPI
+	 * flash can provide this, so that reads need no CPU-driven
+	 * transfers. See spi_read_flash().
+	 *
+	 * @dev:	The slave device (the flash)
+	 * @msg:	The read to do
+	 * @return 0 if OK, -ENOSYS if this read cannot be done (the caller
+	 *	   then uses xfer()), other -ve value on error
+	 */
+	int (*read_flash)(struct udevice *dev, struct spi_flash_read_msg *msg);
+
 	/**
 	 * Set transfer speed.
 	 * This sets a new speed to be applied for next spi_xfer().
@@ -483,6 +540,19 @@ struct dm_spi_emul_ops {
 	 */
 	int (*xfer)(struct udevice *slave, unsigned int bitlen,
 		    const void *dout, void *din, unsigned long flags);
+
+	/**
+	 * Read from a SPI flash in one operation (optional)
+	 *
+	 * This emulates a controller's flash read engine, see
+	 * dm_spi_ops.read_flash().
+	 *
+	 * @slave:	The SPI slave (the flash emulation)
+	 * @msg:	The read to do
+	 * @return 0 if OK, -ENOSYS if not supported, other -ve on error
+	 */
+	int (*read_flash)(struct udevice *slave,
+			  struct spi_flash_read_msg *msg);
 };
 
 /**
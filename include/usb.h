@@ -162,6 +162,26 @@ int submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 int submit_int_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 			int transfer_len, int interval);
 
+/*
+ * Optional host controller functions. Controllers which do not provide these
+ * get the defaults in common/usb.c.
+ */
+
+/* Largest bulk transfer the controller can take in one go, in bytes */
+size_t usb_max_xfer_size(struct usb_device *dev);
+
+/*
+ * Submit two bulk-in transfers on the same pipe as a single queue, so that
+ * the controller moves straight on to the second one (even after a short
+ * packet in the first). This suits a data phase followed by a status phase,
+ * as in bulk-only mass storage. dev->act_len is the length of the first
+ * transfer and *actual_len2 that of the second. Returns -ENOSYS if the
+ * controller cannot do this, in which case nothing was submitted.
+ */
+int submit_bulk_msg_pair(struct usb_device *dev, unsigned long pipe,
+			void *buffer, int transfer_len, void *buffer2,
+			int transfer_len2, int *actual_len2);
+
 /* Defines */
 #define USB_UHCI_VEND_ID	0x8086
 #define USB_UHCI_DEV_ID		0x7112
@@ -234,6 +254,9 @@ int usb_control_msg(struct usb_device *dev, unsigned int pipe,
 			void *data, unsigned short size, int timeout);
 int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 			void *data, int len, int *actual_length, int timeout);
+int usb_bulk_msg_pair(struct usb_device *dev, unsigned int pipe,
+			void *data, int len, int *actual_length,
+			void *data2, int len2, int *actual_length2, int timeout);
 int usb_submit_int_msg(struct usb_device *dev, unsigned long pipe,
 			void *buffer, int transfer_len, int interval);
 int usb_disable_asynch(int disable);
@@ -43,10 +43,11 @@
  * Algorithmic details:
  *
  * Encoding is performed by processing 32 input bits in parallel, using 4
- * remainder lookup tables.
+ * remainder lookup tables; 64-bit builds process 64 input bits in parallel,
+ * using 8 remainder lookup tables of 64-bit words.
  *
  * The final stage of decoding involves the following internal steps:
- * a. Syndrome computation
+ * a. Syndrome computation (one ecc byte at a time, using lookup tables)
  * b. Error locator polynomial computation using Berlekamp-Massey algorithm
  * c. Error locator root finding (by far the most expensive step)
  *
@@ -83,8 +84,12 @@
 #endif
 
 #define BCH_ECC_WORDS(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 32)
+#define BCH_ECC_LONGS(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 64)
 #define BCH_ECC_BYTES(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 8)
 
+/* syn_tab entry for a byte polynomial which vanishes, as it has no log */
+#define BCH_NO_LOG             0xffff
+
 #ifndef dbg
 #define dbg(_fmt, args...)     do {} while (0)
 #endif
@@ -165,6 +170,68 @@ static void store_ecc8(struct bch_control *bch, uint8_t *dst,
 	memcpy(dst, pad, BCH_ECC_BYTES(bch)-4*nwords);
 }
 
+#if BITS_PER_LONG == 64
+#define BCH_ALIGN	8
+
+/*
+ * same as the 32-bit loop of encode_bch(), but process 64 input bits at a
+ * time using 8 remainder lookup tables of 64-bit words: this halves the
+ * number of table words loaded per input byte
+ */
+static void encode_bch64(struct bch_control *bch, const uint64_t *pdata,
+			 unsigned int mlen, uint32_t *ecc)
+{
+	const unsigned int l = BCH_ECC_LONGS(bch)-1;
+	const unsigned int nwords = BCH_ECC_WORDS(bch);
+	unsigned int i;
+	uint64_t w, r[l+1];
+	const uint64_t * const tab0 = bch->mod8_tab64;
+	const uint64_t * const tab1 = tab0 + 256*(l+1);
+	const uint64_t * const tab2 = tab1 + 256*(l+1);
+	const uint64_t * const tab3 = tab2 + 256*(l+1);
+	const uint64_t * const tab4 = tab3 + 256*(l+1);
+	const uint64_t * const tab5 = tab4 + 256*(l+1);
+	const uint64_t * const tab6 = tab5 + 256*(l+1);
+	const uint64_t * const tab7 = tab6 + 256*(l+1);
+	const uint64_t *p0, *p1, *p2, *p3, *p4, *p5, *p6, *p7;
+
+	if (!mlen)
+		return;
+
+	/* pack the 32-bit ecc words in pairs, zero padding the last one */
+	for (i = 0; i <= l; i++)
+		r[i] = ((uint64_t)ecc[2*i] << 32) |
+			((2*i+1 < nwords) ? ecc[2*i+1] : 0);
+
+	while (mlen--) {
+		/* input data is read in big-endian format */
+		w = r[0]^cpu_to_be64(*pdata++);
+		p0 = tab0 + (l+1)*((w >>  0) & 0xff);
+		p1 = tab1 + (l+1)*((w >>  8) & 0xff);
+		p2 = tab2 + (l+1)*((w >> 16) & 0xff);
+		p3 = tab3 + (l+1)*((w >> 24) & 0xff);
+		p4 = tab4 + (l+1)*((w >> 32) & 0xff);
+		p5 = tab5 + (l+1)*((w >> 40) & 0xff);
+		p6 = tab6 + (l+1)*((w >> 48) & 0xff);
+		p7 = tab7 + (l+1)*((w >> 56) & 0xff);
+
+		for (i = 0; i < l; i++)
+			r[i] = r[i+1]^p0[i]^p1[i]^p2[i]^p3[i]^
+				p4[i]^p5[i]^p6[i]^p7[i];
+
+		r[l] = p0[l]^p1[l]^p2[l]^p3[l]^p4[l]^p5[l]^p6[l]^p7[l];
+	}
+
+	for (i = 0; i <= l; i++) {
+		ecc[2*i] = r[i] >> 32;
+		if (2*i+1 < nwords)
+			ecc[2*i+1] = r[i];
+	}
+}
+#else
+#define BCH_ALIGN	4
+#endif
+
 /**
  * encode_bch - calculate BCH ecc parity of data
  * @bch:   BCH control structure
@@ -200,14 +267,20 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
 	}
 
 	/* process first unaligned data bytes */
-	m = ((unsigned long)data) & 3;
+	m = ((unsigned long)data) & (BCH_ALIGN-1);
 	if (m) {
-		mlen = (len < (4-m)) ? len : 4-m;
+		mlen = (len < (BCH_ALIGN-m)) ? len : BCH_ALIGN-m;
 		encode_bch_unaligned(bch, data, mlen, bch->ecc_buf);
 		data += mlen;
 		len  -= mlen;
 	}
 
+#if BITS_PER_LONG == 64
+	encode_bch64(bch, (const uint64_t *)data, len/8, bch->ecc_buf);
+	data += len & ~7;
+	len  &= 7;
+#endif
+
 	/* process 32-bit aligned data words */
 	pdata = (uint32_t *)data;
 	mlen  = len/4;
@@ -335,9 +408,11 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 			      unsigned int *syn)
 {
 	int i, j, s;
-	unsigned int m;
+	unsigned int m, e, step;
 	uint32_t poly;
+	const uint16_t *tab;
 	const int t = GF_T(bch);
+	const int n = GF_N(bch);
 
 	s = bch->ecc_bits;
 
@@ -347,16 +422,27 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 		ecc[s/32] &= ~((1u << (32-m))-1);
 	memset(syn, 0, 2*t*sizeof(*syn));
 
-	/* compute v(a^j) for j=1 .. 2t-1 */
+	/* compute v(a^j) for j=1 .. 2t-1, one ecc byte at a time */
 	do {
 		poly = *ecc++;
 		s -= 32;
-		while (poly) {
-			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
-
-			poly ^= (1 << i);
+		for (i = 0; poly; i += 8, poly >>= 8) {
+			if (!(poly & 0xff))
+				continue;
+			/*
+			 * the byte p(X) at bit i adds a^(j*(i+s)).p(a^j) to
+			 * syndrome j; log p(a^j) is looked up in syn_tab, and
+			 * the exponents j*(i+s) for odd j grow by 2*(i+s)
+			 */
+			e = (i+s < 0) ? i+s+n : i+s;
+			step = mod_s(bch, 2*e);
+			tab = bch->syn_tab + (poly & 0xff);
+			for (j = 0; j < 2*t; j += 2, tab += 256) {
+				if (*tab != BCH_NO_LOG)
+					syn[j] ^= bch->a_pow_tab[mod_s(bch,
+								       e+*tab)];
+				e = mod_s(bch, e+step);
+			}
 		}
 	} while (s > 0);
 
@@ -1103,6 +1189,67 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 	}
 }
 
+#if BITS_PER_LONG == 64
+/*
+ * compute the 64-bit remainder tables of encode_bch64() from the 32-bit ones:
+ * tables 0-3 are the same, and table b+4 is table b multiplied by X^32, i.e.
+ * table b followed by one word of zero input bits
+ */
+static void build_mod8_tables64(struct bch_control *bch)
+{
+	int i, j, b;
+	uint32_t w, *r;
+	uint64_t *tab;
+	const int l = BCH_ECC_WORDS(bch);
+	const int l64 = BCH_ECC_LONGS(bch);
+	const uint32_t *p0, *p1, *p2, *p3, *src;
+
+	r = bch->ecc_buf;
+	for (b = 0; b < 8; b++) {
+		for (i = 0; i < 256; i++) {
+			src = bch->mod8_tab + ((b & 3)*256+i)*l;
+			memcpy(r, src, l*sizeof(*r));
+			if (b >= 4) {
+				w = r[0];
+				p0 = bch->mod8_tab + (  0+((w >>  0) & 0xff))*l;
+				p1 = bch->mod8_tab + (256+((w >>  8) & 0xff))*l;
+				p2 = bch->mod8_tab + (512+((w >> 16) & 0xff))*l;
+				p3 = bch->mod8_tab + (768+((w >> 24) & 0xff))*l;
+				for (j = 0; j < l; j++)
+					r[j] = ((j+1 < l) ? r[j+1] : 0)^
+						p0[j]^p1[j]^p2[j]^p3[j];
+			}
+			tab = bch->mod8_tab64 + (b*256+i)*l64;
+			for (j = 0; j < l64; j++)
+				tab[j] = ((uint64_t)r[2*j] << 32) |
+					((2*j+1 < l) ? r[2*j+1] : 0);
+		}
+	}
+}
+#endif
+
+/*
+ * compute the logs of p(a^j) for odd j=1..2t-1 and every polynomial p(X) of
+ * degree < 8, used to compute syndromes one ecc byte at a time
+ */
+static void build_syn_tables(struct bch_control *bch)
+{
+	unsigned int i, j, b, x;
+	uint16_t *tab = bch->syn_tab;
+	const unsigned int t = GF_T(bch);
+
+	for (j = 1; j < 2*t; j += 2, tab += 256) {
+		tab[0] = BCH_NO_LOG;
+		for (i = 1; i < 256; i++) {
+			x = 0;
+			for (b = 0; b < 8; b++)
+				if (i & (1 << b))
+					x ^= a_pow(bch, j*b);
+			tab[i] = x ? a_log(bch, x) : BCH_NO_LOG;
+		}
+	}
+}
+
 /*
  * build a base for factoring degree 2 polynomials
  */
@@ -1295,10 +1442,15 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	bch->a_pow_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_pow_tab), &err);
 	bch->a_log_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_log_tab), &err);
 	bch->mod8_tab  = bch_alloc(words*1024*sizeof(*bch->mod8_tab), &err);
+#if BITS_PER_LONG == 64
+	bch->mod8_tab64 = bch_alloc(BCH_ECC_LONGS(bch)*2048*
+				    sizeof(*bch->mod8_tab64), &err);
+#endif
 	bch->ecc_buf   = bch_alloc(words*sizeof(*bch->ecc_buf), &err);
 	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
 	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
 	bch->syn       = bch_alloc(2*t*sizeof(*bch->syn), &err);
+	bch->syn_tab   = bch_alloc(t*256*sizeof(*bch->syn_tab), &err);
 	bch->cache     = bch_alloc(2*t*sizeof(*bch->cache), &err);
 	bch->elp       = bch_alloc((t+1)*sizeof(struct gf_poly_deg1), &err);
 
@@ -1319,6 +1471,10 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 
 	build_mod8_tables(bch, genpoly);
 	kfree(genpoly);
+#if BITS_PER_LONG == 64
+	build_mod8_tables64(bch);
+#endif
+	build_syn_tables(bch);
 
 	err = build_deg2_base(bch);
 	if (err)
@@ -1343,10 +1499,14 @@ void free_bch(struct bch_control *bch)
 		kfree(bch->a_pow_tab);
 		kfree(bch->a_log_tab);
 		kfree(bch->mod8_tab);
+#if BITS_PER_LONG == 64
+		kfree(bch->mod8_tab64);
+#endif
 		kfree(bch->ecc_buf);
 		kfree(bch->ecc_buf2);
 		kfree(bch->xi_tab);
 		kfree(bch->syn);
+		kfree(bch->syn_tab);
 		kfree(bch->cache);
 		kfree(bch->elp);
 
@@ -151,6 +151,10 @@ tole(0xb40bbe37L), tole(0xc30c8ea1L), tole(0x5a05df1bL), tole(0x2d02ef8dL)
 };
 #endif
 
+#ifdef CONFIG_CRC32_SLICE_BY_8
+#include "crc32table.h"
+#endif
+
 #if 0
 /* =========================================================================
  * This function can be used by asm versions of crc32()
@@ -173,6 +177,47 @@ const uint32_t * ZEXPORT get_crc_table()
 
 /* ========================================================================= */
 
+#ifdef CONFIG_CRC32_SLICE_BY_8
+/*
+ * Bytes of a word loaded from memory, in memory order. The CRC is kept in
+ * little-endian order so it can be xor'ed straight into the data.
+ */
+# if __BYTE_ORDER == __LITTLE_ENDIAN
+#  define BYTE0(x) ((x) & 255)
+#  define BYTE1(x) (((x) >> 8) & 255)
+#  define BYTE2(x) (((x) >> 16) & 255)
+#  define BYTE3(x) ((x) >> 24)
+# else
+#  define BYTE0(x) ((x) >> 24)
+#  define BYTE1(x) (((x) >> 16) & 255)
+#  define BYTE2(x) (((x) >> 8) & 255)
+#  define BYTE3(x) ((x) & 255)
+# endif
+#endif
+
+#ifdef CONFIG_ARM64_CRC32
+/*
+ * The ARMv8 CRC32 instructions use the same polynomial and bit order as
+ * crc_table, with no ones complement, so they do all of the work here.
+ */
+#define CRC32B(crc, val) \
+	asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (val))
+#define CRC32X(crc, val) \
+	asm("crc32x %w0, %w0, %x1" : "+r" (crc) : "r" (val))
+
+uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+{
+	/* Align it, then 8 bytes at a time */
+	for (; len && ((long)buf & 7); len--)
+		CRC32B(crc, *buf++);
+	for (; len >= 8; len -= 8, buf += 8)
+		CRC32X(crc, *(const uint64_t *)buf);
+	for (; len; len--)
+		CRC32B(crc, *buf++);
+
+	return crc;
+}
+#else
 /* No ones complement version. JFFS2 (and other things ?)
  * don't use ones compliment in their CRC calculations.
  */
@@ -195,6 +240,20 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#ifdef CONFIG_CRC32_SLICE_BY_8
+    /* Eight bytes per step, looking each one up in its own table */
+    for (; len >= 8; len -= 8) {
+	 const uint32_t (*t)[256] = crc_table_slice;
+	 uint32_t q1 = *b++ ^ crc;
+	 uint32_t q2 = *b++;
+
+	 crc = t[6][BYTE0(q1)] ^ t[5][BYTE1(q1)] ^
+	       t[4][BYTE2(q1)] ^ t[3][BYTE3(q1)] ^
+	       t[2][BYTE0(q2)] ^ t[1][BYTE1(q2)] ^
+	       t[0][BYTE2(q2)] ^ tab[BYTE3(q2)];
+    }
+#endif
+
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
@@ -216,6 +275,7 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 
     return le32_to_cpu(crc);
 }
+#endif /* CONFIG_ARM64_CRC32 */
 #undef DO_CRC
 
 uint32_t ZEXPORT crc32 (uint32_t crc, const Bytef *p, uInt len)
@@ -0,0 +1,437 @@
+/*
+ * Decompression of images which arrive a piece at a time
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <decompress.h>
+#include <errno.h>
+#include <image.h>
+#include <malloc.h>
+#include <watchdog.h>
+#include <asm/unaligned.h>
+#include <linux/lzo.h>
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#include <u-boot/zlib.h>
+
+struct decomp_ops {
+	int comp;
+	int (*init)(struct decomp_stream *ds);
+	int (*feed)(struct decomp_stream *ds, const unsigned char *in,
+		    ulong len);
+	void (*end)(struct decomp_stream *ds);
+};
+
+static int copy_feed(struct decomp_stream *ds, const unsigned char *in,
+		     ulong len)
+{
+	if (len > ds->out_size - ds->out_len)
+		return -ENOSPC;
+	memcpy(ds->out + ds->out_len, in, len);
+	ds->out_len += len;
+
+	return 0;
+}
+
+#ifdef CONFIG_GZIP
+static int gzip_init(struct decomp_stream *ds)
+{
+	z_stream *s;
+	int r;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->zalloc = gzalloc;
+	s->zfree = gzfree;
+
+	/* Let zlib parse the gzip header, and check the CRC at the end */
+	r = inflateInit2(s, 16 + MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		free(s);
+		return -ENOMEM;
+	}
+	ds->priv = s;
+
+	return 0;
+}
+
+static int gzip_feed(struct decomp_stream *ds, const unsigned char *in,
+		     ulong len)
+{
+	z_stream *s = ds->priv;
+	int r;
+
+	s->next_in = (unsigned char *)in;
+	s->avail_in = len;
+	s->next_out = ds->out + ds->out_len;
+	s->avail_out = ds->out_size - ds->out_len;
+	r = inflate(s, Z_NO_FLUSH);
+	ds->out_len = s->next_out - ds->out;
+
+	if (r == Z_STREAM_END)
+		return 1;
+	if (r != Z_OK && r != Z_BUF_ERROR) {
+		printf("Error: inflate() returned %d\n", r);
+		return -EIO;
+	}
+
+	/* Input left over means that the output buffer is full */
+	return s->avail_in ? -ENOSPC : 0;
+}
+
+static void gzip_end(struct decomp_stream *ds)
+{
+	inflateEnd(ds->priv);
+	free(ds->priv);
+}
+#endif /* CONFIG_GZIP */
+
+#ifdef CONFIG_LZMA
+/* The .lzma header is the properties then a 64-bit uncompressed size */
+#define LZMA_HEADER_SIZE	(LZMA_PROPS_SIZE + 8)
+
+struct lzma_state {
+	CLzmaDec dec;
+	ISzAlloc alloc;
+	unsigned char header[LZMA_HEADER_SIZE];
+	int header_len;
+	SizeT limit;		/* Uncompressed size, or size of output */
+	bool size_known;
+};
+
+static void *lzma_alloc(void *p, size_t size) { return malloc(size); }
+static void lzma_free(void *p, void *address) { free(address); }
+
+static int lzma_init(struct decomp_stream *ds)
+{
+	struct lzma_state *lz;
+
+	lz = calloc(1, sizeof(*lz));
+	if (!lz)
+		return -ENOMEM;
+	LzmaDec_Construct(&lz->dec);
+	lz->alloc.Alloc = lzma_alloc;
+	lz->alloc.Free = lzma_free;
+	ds->priv = lz;
+
+	return 0;
+}
+
+static int lzma_start(struct decomp_stream *ds, struct lzma_state *lz)
+{
+	u64 size = get_unaligned_le64(lz->header + LZMA_PROPS_SIZE);
+
+	/* All ones means that the size is unknown */
+	lz->limit = ds->out_size;
+	if (size != ~0ULL) {
+		if (size > ds->out_size)
+			return -ENOSPC;
+		lz->limit = size;
+		lz->size_known = true;
+	}
+
+	if (LzmaDec_AllocateProbs(&lz->dec, lz->header, LZMA_PROPS_SIZE,
+				  &lz->alloc) != SZ_OK)
+		return -ENOMEM;
+
+	/* Decompress straight into the output buffer */
+	lz->dec.dic = ds->out;
+	lz->dec.dicBufSize = ds->out_size;
+	LzmaDec_Init(&lz->dec);
+
+	return 0;
+}
+
+static int lzma_feed(struct decomp_stream *ds, const unsigned char *in,
+		     ulong len)
+{
+	struct lzma_state *lz = ds->priv;
+	ELzmaStatus status;
+	SizeT in_len;
+	int ret;
+
+	if (lz->header_len < LZMA_HEADER_SIZE) {
+		in_len = min(len, (ulong)(LZMA_HEADER_SIZE - lz->header_len));
+		memcpy(lz->header + lz->header_len, in, in_len);
+		lz->header_len += in_len;
+		in += in_len;
+		len -= in_len;
+		if (lz->header_len < LZMA_HEADER_SIZE)
+			return 0;
+		ret = lzma_start(ds, lz);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * Without a size the data must end with a marker. Asking for the end
+	 * makes the decoder look for it once the output buffer is full.
+	 */
+	in_len = len;
+	ret = LzmaDec_DecodeToDic(&lz->dec, lz->limit, in, &in_len,
+				  lz->size_known ? LZMA_FINISH_ANY :
+				  LZMA_FINISH_END, &status);
+	ds->out_len = lz->dec.dicPos;
+	if (status == LZMA_STATUS_FINISHED_WITH_MARK)
+		return 1;
+	if (lz->size_known && lz->dec.dicPos == lz->limit)
+		return 1;
+	if (ret != SZ_OK) {
+		/* Something other than the marker came after a full buffer */
+		if (lz->dec.dicPos == lz->limit)
+			return -ENOSPC;
+		printf("Error: LZMA decompression returned %d\n", ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static void lzma_end(struct decomp_stream *ds)
+{
+	struct lzma_state *lz = ds->priv;
+
+	LzmaDec_FreeProbs(&lz->dec, &lz->alloc);
+	free(lz);
+}
+#endif /* CONFIG_LZMA */
+
+#ifdef CONFIG_LZO
+/* An lzop header is at most this long, with a 255-character file name */
+#define LZOP_MAX_HEADER	512
+
+enum lzop_state {
+	LZOP_HEADER,
+	LZOP_DLEN,	/* Uncompressed size of the next block, 0 at the end */
+	LZOP_SLEN,	/* Compressed size of the block and its checksum */
+	LZOP_DATA,
+};
+
+/*
+ * lzop files are a header then a series of blocks, each decompressed in one
+ * go. Whatever is needed next is used directly from the input if it is all
+ * there, otherwise it is gathered in a buffer over several pieces.
+ */
+struct lzop_state_info {
+	enum lzop_state state;
+	unsigned char *buf;
+	ulong buf_size;
+	ulong buf_len;
+	u32 dlen;
+	u32 slen;
+};
+
+static int lzop_init(struct decomp_stream *ds)
+{
+	struct lzop_state_info *lzop;
+
+	lzop = calloc(1, sizeof(*lzop));
+	if (!lzop)
+		return -ENOMEM;
+	lzop->buf_size = LZOP_MAX_HEADER;
+	lzop->buf = malloc(lzop->buf_size);
+	if (!lzop->buf) {
+		free(lzop);
+		return -ENOMEM;
+	}
+	ds->priv = lzop;
+
+	return 0;
+}
+
+/**
+ * lzop_gather() - Get the next 'need' bytes of input in one place
+ *
+ * @return pointer to the bytes, or NULL if the input ran out first
+ */
+static const unsigned char *lzop_gather(struct lzop_state_info *lzop,
+					const unsigned char **inp, ulong *lenp,
+					ulong need)
+{
+	const unsigned char *ptr;
+	ulong copy;
+
+	if (!lzop->buf_len && *lenp >= need) {
+		ptr = *inp;
+		*inp += need;
+		*lenp -= need;
+		return ptr;
+	}
+
+	if (need > lzop->buf_size) {
+		ptr = realloc(lzop->buf, need);
+		if (!ptr)
+			return NULL;
+		lzop->buf = (unsigned char *)ptr;
+		lzop->buf_size = need;
+	}
+	copy = min(need - lzop->buf_len, *lenp);
+	memcpy(lzop->buf + lzop->buf_len, *inp, copy);
+	lzop->buf_len += copy;
+	*inp += copy;
+	*lenp -= copy;
+	if (lzop->buf_len < need)
+		return NULL;
+	lzop->buf_len = 0;
+
+	return lzop->buf;
+}
+
+static int lzop_feed(struct decomp_stream *ds, const unsigned char *in,
+		     ulong len)
+{
+	struct lzop_state_info *lzop = ds->priv;
+	const unsigned char *ptr;
+	size_t out_len;
+	ulong copy;
+	int ret;
+
+	if (lzop->state == LZOP_HEADER) {
+		copy = min(lzop->buf_size - lzop->buf_len, len);
+		memcpy(lzop->buf + lzop->buf_len, in, copy);
+		lzop->buf_len += copy;
+		ret = lzop_header_len(lzop->buf, lzop->buf_len);
+		if (ret < 0 || (!ret && lzop->buf_len == lzop->buf_size))
+			return -EIO;
+		if (!ret)
+			return 0;
+		/* Go back to the first byte after the header */
+		in += copy - (lzop->buf_len - ret);
+		len -= copy - (lzop->buf_len - ret);
+		lzop->buf_len = 0;
+		lzop->state = LZOP_DLEN;
+	}
+
+	for (;;) {
+		switch (lzop->state) {
+		case LZOP_DLEN:
+			ptr = lzop_gather(lzop, &in, &len, 4);
+			if (!ptr)
+				return len ? -ENOMEM : 0;
+			lzop->dlen = get_unaligned_be32(ptr);
+			if (!lzop->dlen)
+				return 1;
+			if (lzop->dlen > ds->out_size - ds->out_len)
+				return -ENOSPC;
+			lzop->state = LZOP_SLEN;
+			break;
+		case LZOP_SLEN:
+			/* The block checksum is not checked */
+			ptr = lzop_gather(lzop, &in, &len, 8);
+			if (!ptr)
+				return len ? -ENOMEM : 0;
+			lzop->slen = get_unaligned_be32(ptr);
+			if (!lzop->slen || lzop->slen > lzop->dlen)
+				return -EIO;
+			lzop->state = LZOP_DATA;
+			break;
+		case LZOP_DATA:
+			ptr = lzop_gather(lzop, &in, &len, lzop->slen);
+			if (!ptr)
+				return len ? -ENOMEM : 0;
+			out_len = lzop->dlen;
+			ret = lzo1x_decompress_safe(ptr, lzop->slen,
+						    ds->out + ds->out_len,
+						    &out_len);
+			if (ret != LZO_E_OK || out_len != lzop->dlen) {
+				printf("Error: LZO decompression returned %d\n",
+				       ret);
+				return -EIO;
+			}
+			ds->out_len += out_len;
+			lzop->state = LZOP_DLEN;
+			break;
+		default:
+			return -EIO;
+		}
+	}
+}
+
+static void lzop_end(struct decomp_stream *ds)
+{
+	struct lzop_state_info *lzop = ds->priv;
+
+	free(lzop->buf);
+	free(lzop);
+}
+#endif /* CONFIG_LZO */
+
+static const struct decomp_ops decomp_ops[] = {
+	{ IH_COMP_NONE, NULL, copy_feed, NULL },
+#ifdef CONFIG_GZIP
+	{ IH_COMP_GZIP, gzip_init, gzip_feed, gzip_end },
+#endif
+#ifdef CONFIG_LZMA
+	{ IH_COMP_LZMA, lzma_init, lzma_feed, lzma_end },
+#endif
+#ifdef CONFIG_LZO
+	{ IH_COMP_LZO, lzop_init, lzop_feed, lzop_end },
+#endif
+};
+
+static const struct decomp_ops *decomp_get_ops(int comp)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(decomp_ops); i++) {
+		if (decomp_ops[i].comp == comp)
+			return &decomp_ops[i];
+	}
+
+	return NULL;
+}
+
+int decomp_stream_detect(const void *buf, ulong len)
+{
+	const unsigned char *magic = buf;
+	int comp = IH_COMP_NONE;
+
+	if (len >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+		comp = IH_COMP_GZIP;
+	else if (len >= 3 && magic[0] == 0x5d && !magic[1] && !magic[2])
+		comp = IH_COMP_LZMA;	/* The usual properties */
+	else if (len >= 4 && magic[0] == 0x89 && magic[1] == 'L' &&
+		 magic[2] == 'Z' && magic[3] == 'O')
+		comp = IH_COMP_LZO;
+
+	return decomp_get_ops(comp) ? comp : IH_COMP_NONE;
+}
+
+int decomp_stream_init(struct decomp_stream *ds, int comp, void *out,
+		       ulong out_size)
+{
+	const struct decomp_ops *ops = decomp_get_ops(comp);
+
+	if (!ops)
+		return -EPROTONOSUPPORT;
+	memset(ds, '\0', sizeof(*ds));
+	ds->comp = comp;
+	ds->out = out;
+	ds->out_size = out_size;
+
+	return ops->init ? ops->init(ds) : 0;
+}
+
+int decomp_stream_feed(struct decomp_stream *ds, const void *in, ulong len)
+{
+	const struct decomp_ops *ops = decomp_get_ops(ds->comp);
+	int ret;
+
+	ret = ops->feed(ds, in, len);
+	WATCHDOG_RESET();
+
+	return ret;
+}
+
+void decomp_stream_end(struct decomp_stream *ds)
+{
+	const struct decomp_ops *ops = decomp_get_ops(ds->comp);
+
+	if (ops->end)
+		ops->end(ds);
+	ds->priv = NULL;
+}
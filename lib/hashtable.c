@@ -55,50 +55,148 @@
  * The reentrant version has no static variables to maintain the state.
  * Instead the interface of all functions is extended to take an argument
  * which describes the current status.
+ *
+ * The table is made of three parts:
+ *
+ * - The entries themselves, each one allocated from a string arena
+ *   together with its key. Entries never move, so ENTRY pointers handed
+ *   out stay valid until the variable is deleted.
+ * - An open addressing index (htab->table) of hash values and entry
+ *   pointers, probed linearly. Most probes are answered from the hash
+ *   values alone, without touching the entries.
+ * - The list of entries sorted by key (htab->order). This is the
+ *   iteration order of hexport_r(), hmatch_r() and hwalk_r(), so an
+ *   export does not need to sort anything. New entries are added at the
+ *   end and only merged into place when the list is walked, so that
+ *   importing many variables in no particular order stays cheap.
  */
 
 typedef struct _ENTRY {
-	int used;
 	ENTRY entry;
+	unsigned int hval;	/* hash value of the key */
+	unsigned int cap;	/* size of the arena block holding the data */
+	int stale;		/* not seen yet by a replacing himport_r() */
+	/* the key follows */
 } _ENTRY;
 
-
-static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
-	int idx);
+typedef struct _HSLOT {
+	unsigned int hval;	/* zero for an empty slot */
+	_ENTRY *ep;
+} _HSLOT;
 
 /*
- * hcreate()
+ * String arena
+ *
+ * Keys and values are allocated from a few large chunks instead of
+ * calling malloc() for each of them, which fragments the heap when
+ * scripts set variables in loops. Blocks are powers of two in size and
+ * freed blocks are kept on a list per size for reuse. Nothing in the
+ * arena ever moves; the chunks are only given back by hdestroy_r().
  */
 
-/*
- * For the used double hash method the table size has to be a prime. To
- * correct the user given table size we need a prime test.  This trivial
- * algorithm is adequate because
- * a)  the code is (most probably) called a few times per program run and
- * b)  the number is small because the table must fit in the core
- * */
-static int isprime(unsigned int number)
+#define ARENA_CHUNK	4096	/* usual size of a chunk */
+#define ARENA_MIN_SHIFT	4	/* smallest block is 16 bytes */
+#define ARENA_CLASSES	24
+
+struct arena_chunk {
+	struct arena_chunk *next;
+};
+
+typedef struct _HARENA {
+	struct arena_chunk *chunks;
+	char *free_ptr;		/* unused end of the newest chunk */
+	size_t free_len;
+	void *free_list[ARENA_CLASSES];
+} _HARENA;
+
+static int arena_class(size_t len)
+{
+	int class = 0;
+
+	while ((size_t)1 << (class + ARENA_MIN_SHIFT) < len)
+		class++;
+
+	return class;
+}
+
+static void arena_free(_HARENA *arena, void *ptr, size_t len)
+{
+	int class = arena_class(len);
+
+	*(void **)ptr = arena->free_list[class];
+	arena->free_list[class] = ptr;
+}
+
+static void *arena_alloc(_HARENA *arena, size_t len)
 {
-	/* no even number will be passed */
-	unsigned int div = 3;
+	int class = arena_class(len);
+	size_t bsize = (size_t)1 << (class + ARENA_MIN_SHIFT);
+	void *ptr;
+
+	if (class >= ARENA_CLASSES)
+		return NULL;
+
+	ptr = arena->free_list[class];
+	if (ptr) {
+		arena->free_list[class] = *(void **)ptr;
+		return ptr;
+	}
+
+	if (arena->free_len < bsize) {
+		size_t csize = bsize > ARENA_CHUNK ? bsize : ARENA_CHUNK;
+		struct arena_chunk *chunk;
+
+		chunk = malloc(sizeof(*chunk) + csize);
+		if (chunk == NULL)
+			return NULL;
+
+		/* Keep what is left of the old chunk as free blocks */
+		while (arena->free_len >= 1 << ARENA_MIN_SHIFT) {
+			size_t piece = (size_t)1 << (ARENA_MIN_SHIFT +
+				arena_class(arena->free_len + 1) - 1);
 
-	while (div * div < number && number % div != 0)
-		div += 2;
+			arena_free(arena, arena->free_ptr, piece);
+			arena->free_ptr += piece;
+			arena->free_len -= piece;
+		}
+
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->free_ptr = (char *)(chunk + 1);
+		arena->free_len = csize;
+	}
+
+	ptr = arena->free_ptr;
+	arena->free_ptr += bsize;
+	arena->free_len -= bsize;
 
-	return number % div != 0;
+	return ptr;
 }
 
+static size_t arena_size(size_t len)
+{
+	return (size_t)1 << (arena_class(len) + ARENA_MIN_SHIFT);
+}
+
+static size_t entry_size(const char *key)
+{
+	return sizeof(_ENTRY) + strlen(key) + 1;
+}
+
+/*
+ * hcreate()
+ */
+
 /*
- * Before using the hash table we must allocate memory for it.
- * Test for an existing table are done. We allocate one element
- * more as the found prime number says. This is done for more effective
- * indexing as explained in the comment for the hsearch function.
- * The contents of the table is zeroed, especially the field used
- * becomes zero.
+ * Before using the hash table we must allocate memory for it. The
+ * index is a power of two in size and is kept at most 3/4 full, growing
+ * as needed, so "nel" is only a hint of the number of entries to expect.
  */
 
 int hcreate_r(size_t nel, struct hsearch_data *htab)
 {
+	unsigned int size = 16;
+
 	/* Test for correct arguments.  */
 	if (htab == NULL) {
 		__set_errno(EINVAL);
@@ -109,18 +207,29 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 	if (htab->table != NULL)
 		return 0;
 
-	/* Change nel to the first prime number not smaller as nel. */
-	nel |= 1;		/* make odd */
-	while (!isprime(nel))
-		nel += 2;
+	while (size < nel + nel / 3)
+		size <<= 1;
 
-	htab->size = nel;
+	htab->size = size;
 	htab->filled = 0;
+	htab->sorted = 0;
+	htab->order_size = nel ? nel : 1;
 
 	/* allocate memory and zero out */
-	htab->table = (_ENTRY *) calloc(htab->size + 1, sizeof(_ENTRY));
-	if (htab->table == NULL)
+	htab->table = calloc(htab->size, sizeof(_HSLOT));
+	htab->order = malloc(htab->order_size * sizeof(_ENTRY *));
+	htab->arena = calloc(1, sizeof(_HARENA));
+	if (htab->table == NULL || htab->order == NULL ||
+	    htab->arena == NULL) {
+		free(htab->table);
+		free(htab->order);
+		free(htab->arena);
+		htab->table = NULL;
+		htab->order = NULL;
+		htab->arena = NULL;
+		__set_errno(ENOMEM);
 		return 0;
+	}
 
 	/* everything went alright */
 	return 1;
@@ -132,13 +241,13 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
  */
 
 /*
- * After using the hash table it has to be destroyed. The used memory can
- * be freed and the local static variable can be marked as not used.
+ * After using the hash table it has to be destroyed. All of the entries
+ * live in the arena, so this just frees its chunks.
  */
 
 void hdestroy_r(struct hsearch_data *htab)
 {
-	int i;
+	struct arena_chunk *chunk, *next;
 
 	/* Test for correct arguments.  */
 	if (htab == NULL) {
@@ -146,19 +255,24 @@ void hdestroy_r(struct hsearch_data *htab)
 		return;
 	}
 
-	/* free used memory */
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
+	if (htab->table == NULL)
+		return;
 
-			free((void *)ep->key);
-			free(ep->data);
-		}
+	/* free used memory */
+	for (chunk = htab->arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
 	}
+	free(htab->arena);
+	free(htab->order);
 	free(htab->table);
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	htab->order = NULL;
+	htab->arena = NULL;
+	htab->filled = 0;
+	htab->sorted = 0;
 }
 
 /*
@@ -166,19 +280,14 @@ void hdestroy_r(struct hsearch_data *htab)
  */
 
 /*
- * This is the search function. It uses double hashing with open addressing.
+ * This is the search function. It uses linear probing over the index,
+ * which keeps a search within one or two cache lines most of the time.
  * The argument item.key has to be a pointer to an zero terminated, most
- * probably strings of chars. The function for generating a number of the
- * strings is simple but fast. It can be replaced by a more complex function
- * like ajw (see [Aho,Sethi,Ullman]) if the needs are shown.
- *
- * We use an trick to speed up the lookup. The table is created by hcreate
- * with one more element available. This enables us to use the index zero
- * special. This index will never be used because we store the first hash
- * index in the field used where zero means not used. Every other value
- * means used. The used field can be used as a first fast comparison for
- * equality of the stored and the parameter value. This helps to prevent
- * unnecessary expensive calls of strcmp.
+ * probably strings of chars. The hash value (FNV-1a) is stored in the
+ * index next to the entry pointer, where zero means not used. This is
+ * used as a first fast comparison for equality of the stored and the
+ * parameter value, and helps to prevent unnecessary expensive calls of
+ * strcmp.
  *
  * This implementation differs from the standard library version of
  * this function in a number of ways:
@@ -192,24 +301,206 @@ void hdestroy_r(struct hsearch_data *htab)
  * - The standard implementation does not provide a way to update an
  *   existing entry.  This version will create a new entry or update an
  *   existing one when both "action == ENTER" and "item.data != NULL".
- * - Instead of returning 1 on success, we return the index into the
- *   internal hash table, which is also guaranteed to be positive.
- *   This allows us direct access to the found hash table slot for
- *   example for functions like hdelete().
+ *   A new value is stored in place of the old one when it fits.
  */
 
+static unsigned int hhash(const char *key)
+{
+	unsigned int hval = 2166136261u;
+
+	while (*key) {
+		hval ^= (unsigned char)*key++;
+		hval *= 16777619;
+	}
+
+	/* Zero marks an empty slot */
+	return hval ? hval : 1;
+}
+
+/* Index of the slot holding "key", or of the empty slot it would go to */
+static unsigned int hslot_find(struct hsearch_data *htab, const char *key,
+	unsigned int hval)
+{
+	unsigned int mask = htab->size - 1;
+	unsigned int idx = hval & mask;
+
+	while (htab->table[idx].hval) {
+		if (htab->table[idx].hval == hval &&
+		    strcmp(key, htab->table[idx].ep->entry.key) == 0)
+			break;
+		idx = (idx + 1) & mask;
+	}
+
+	return idx;
+}
+
+/*
+ * Empty a slot, moving later entries of the same probe sequence back so
+ * that no "deleted" markers are needed
+ */
+static void hslot_remove(struct hsearch_data *htab, unsigned int idx)
+{
+	unsigned int mask = htab->size - 1;
+	unsigned int next = idx;
+	unsigned int home;
+
+	for (;;) {
+		next = (next + 1) & mask;
+		if (!htab->table[next].hval)
+			break;
+		home = htab->table[next].hval & mask;
+		if (((next - home) & mask) >= ((next - idx) & mask)) {
+			htab->table[idx] = htab->table[next];
+			idx = next;
+		}
+	}
+	htab->table[idx].hval = 0;
+	htab->table[idx].ep = NULL;
+}
+
+/* Double the size of the index */
+static int hgrow(struct hsearch_data *htab)
+{
+	_HSLOT *table = calloc(htab->size * 2, sizeof(_HSLOT));
+	unsigned int i, idx;
+
+	if (table == NULL)
+		return -ENOMEM;
+
+	free(htab->table);
+	htab->table = table;
+	htab->size *= 2;
+
+	for (i = 0; i < htab->filled; i++) {
+		_ENTRY *e = htab->order[i];
+
+		idx = hslot_find(htab, e->entry.key, e->hval);
+		htab->table[idx].hval = e->hval;
+		htab->table[idx].ep = e;
+	}
+
+	return 0;
+}
+
+/* Position of the entry for "key" in htab->order */
+static unsigned int horder_find(struct hsearch_data *htab, const char *key)
+{
+	unsigned int lo = 0, hi = htab->sorted, mid;
+	int cmp;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		cmp = strcmp(htab->order[mid]->entry.key, key);
+		if (cmp == 0)
+			return mid;
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Not merged yet */
+	for (lo = htab->sorted; lo < htab->filled; lo++)
+		if (strcmp(htab->order[lo]->entry.key, key) == 0)
+			break;
+
+	return lo;
+}
+
+static int cmpkey(const void *p1, const void *p2)
+{
+	_ENTRY *e1 = *(_ENTRY **) p1;
+	_ENTRY *e2 = *(_ENTRY **) p2;
+
+	return (strcmp(e1->entry.key, e2->entry.key));
+}
+
+/* Merge the entries added since the last walk into the sorted list */
+static void horder_sort(struct hsearch_data *htab)
+{
+	unsigned int i = htab->sorted, j, k = htab->filled;
+	_ENTRY **tail = htab->order + i;
+
+	if (i == k)
+		return;
+
+	j = k - i;
+	qsort(tail, j, sizeof(_ENTRY *), cmpkey);
+	if (i && cmpkey(&tail[-1], &tail[0]) > 0) {
+		_ENTRY **added = malloc(j * sizeof(_ENTRY *));
+
+		if (added == NULL) {
+			qsort(htab->order, k, sizeof(_ENTRY *), cmpkey);
+			htab->sorted = k;
+			return;
+		}
+		memcpy(added, tail, j * sizeof(_ENTRY *));
+
+		/* Merge from the end, where there is room */
+		while (j > 0) {
+			if (i > 0 && cmpkey(&htab->order[i - 1],
+					    &added[j - 1]) > 0)
+				htab->order[--k] = htab->order[--i];
+			else
+				htab->order[--k] = added[--j];
+		}
+		free(added);
+	}
+	htab->sorted = htab->filled;
+}
+
+/*
+ * Store a new value, in place if it fits in the current block and does
+ * not waste most of it. The value may point into the old one.
+ */
+static int hset_data(struct hsearch_data *htab, _ENTRY *e, const char *data)
+{
+	size_t len = strlen(data) + 1;
+	char *p;
+
+	if (len <= e->cap && len > e->cap / 4) {
+		memmove(e->entry.data, data, len);
+		return 0;
+	}
+
+	p = arena_alloc(htab->arena, len);
+	if (p == NULL)
+		return -ENOMEM;
+	memcpy(p, data, len);
+
+	if (e->entry.data)
+		arena_free(htab->arena, e->entry.data, e->cap);
+	e->entry.data = p;
+	e->cap = arena_size(len);
+
+	return 0;
+}
+
+/* Take an entry out of the index and free it, but leave htab->order */
+static void hremove(struct hsearch_data *htab, _ENTRY *e)
+{
+	unsigned int idx = hslot_find(htab, e->entry.key, e->hval);
+
+	hslot_remove(htab, idx);
+	arena_free(htab->arena, e->entry.data, e->cap);
+	arena_free(htab->arena, e, entry_size(e->entry.key));
+}
+
 int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 	     struct hsearch_data *htab)
 {
 	unsigned int idx;
 	size_t key_len = strlen(match);
 
-	for (idx = last_idx + 1; idx < htab->size; ++idx) {
-		if (htab->table[idx].used <= 0)
-			continue;
-		if (!strncmp(match, htab->table[idx].entry.key, key_len)) {
-			*retval = &htab->table[idx].entry;
-			return idx;
+	horder_sort(htab);
+
+	/* The index returned is one more than the position in key order */
+	for (idx = last_idx; idx < htab->filled; ++idx) {
+		ENTRY *ep = &htab->order[idx]->entry;
+
+		if (!strncmp(match, ep->key, key_len)) {
+			*retval = ep;
+			return idx + 1;
 		}
 	}
 
@@ -218,200 +509,170 @@ int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 	return 0;
 }
 
+static void _hdelete(const char *key, struct hsearch_data *htab,
+	_ENTRY *e);
+static int hcreated(ENTRY item, ENTRY **retval, struct hsearch_data *htab,
+	int flag, _ENTRY *e);
+
 /*
- * Compare an existing entry with the desired key, and overwrite if the action
- * is ENTER.  This is simply a helper function for hsearch_r().
+ * Create a new entry, once we know that there is none for the key and
+ * that slot "idx" of the index is free for it
  */
-static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
-	ENTRY **retval, struct hsearch_data *htab, int flag,
-	unsigned int hval, unsigned int idx)
-{
-	if (htab->table[idx].used == hval
-	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
-		/* Overwrite existing value? */
-		if ((action == ENTER) && (item.data != NULL)) {
-			/* check for permission */
-			if (htab->change_ok != NULL && htab->change_ok(
-			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
-				debug("change_ok() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EPERM);
-				*retval = NULL;
-				return 0;
-			}
-
-			/* If there is a callback, call it */
-			if (htab->table[idx].entry.callback &&
-			    htab->table[idx].entry.callback(item.key,
-			    item.data, env_op_overwrite, flag)) {
-				debug("callback() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EINVAL);
-				*retval = NULL;
-				return 0;
-			}
+static int hinsert(ENTRY item, ENTRY **retval, struct hsearch_data *htab,
+	int flag, unsigned int hval, unsigned int idx)
+{
+	unsigned int pos;
+	_ENTRY *e;
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
-				__set_errno(ENOMEM);
-				*retval = NULL;
-				return 0;
-			}
-		}
-		/* return found entry */
-		*retval = &htab->table[idx].entry;
-		return idx;
+	if ((htab->filled + 1) * 4 > htab->size * 3) {
+		if (hgrow(htab))
+			goto nomem;
+		idx = hslot_find(htab, item.key, hval);
 	}
-	/* keep searching */
-	return -1;
-}
 
-int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
-	      struct hsearch_data *htab, int flag)
-{
-	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
-	unsigned int idx;
-	unsigned int first_deleted = 0;
-	int ret;
+	if (htab->filled == htab->order_size) {
+		_ENTRY **order = realloc(htab->order,
+			2 * htab->order_size * sizeof(_ENTRY *));
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
+		if (order == NULL)
+			goto nomem;
+		htab->order = order;
+		htab->order_size *= 2;
 	}
 
 	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
+	 * Create new entry;
+	 * create copies of item.key and item.data
 	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+	e = arena_alloc(htab->arena, entry_size(item.key));
+	if (e == NULL)
+		goto nomem;
+	memset(e, '\0', sizeof(*e));
+	strcpy((char *)(e + 1), item.key);
+	e->entry.key = (char *)(e + 1);
+	e->hval = hval;
+	if (hset_data(htab, e, item.data)) {
+		arena_free(htab->arena, e, entry_size(item.key));
+		goto nomem;
+	}
 
-	/* The first index tried. */
-	idx = hval;
+	htab->table[idx].hval = hval;
+	htab->table[idx].ep = e;
 
-	if (htab->table[idx].used) {
-		/*
-		 * Further action might be required according to the
-		 * action value.
-		 */
-		unsigned hval2;
+	/* Sorted input, such as a saved environment, stays sorted */
+	pos = htab->filled;
+	htab->order[pos] = e;
+	if (htab->sorted == pos && (pos == 0 ||
+	    strcmp(htab->order[pos - 1]->entry.key, item.key) < 0))
+		htab->sorted++;
 
-		if (htab->table[idx].used == -1
-		    && !first_deleted)
-			first_deleted = idx;
+	++htab->filled;
 
-		ret = _compare_and_overwrite_entry(item, action, retval, htab,
-			flag, hval, idx);
-		if (ret != -1)
-			return ret;
+	return hcreated(item, retval, htab, flag, e);
 
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
-		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
-
-			/*
-			 * If we visited all entries leave the loop
-			 * unsuccessfully.
-			 */
-			if (idx == hval)
-				break;
-
-			/* If entry is found use it. */
-			ret = _compare_and_overwrite_entry(item, action, retval,
-				htab, flag, hval, idx);
-			if (ret != -1)
-				return ret;
-		}
-		while (htab->table[idx].used);
+nomem:
+	__set_errno(ENOMEM);
+	*retval = NULL;
+	return 0;
+}
+
+/*
+ * Set up the callback and flags of a new entry and ask whether it may be
+ * created. A rejected entry is deleted again.
+ */
+static int hcreated(ENTRY item, ENTRY **retval, struct hsearch_data *htab,
+	int flag, _ENTRY *e)
+{
+	/* This is a new entry, so look up a possible callback */
+	env_callback_init(&e->entry);
+	/* Also look for flags */
+	env_flags_init(&e->entry);
+
+	/* check for permission */
+	if (htab->change_ok != NULL && htab->change_ok(
+	    &e->entry, item.data, env_op_create, flag)) {
+		debug("change_ok() rejected setting variable "
+			"%s, skipping it!\n", item.key);
+		_hdelete(item.key, htab, e);
+		__set_errno(EPERM);
+		*retval = NULL;
+		return 0;
 	}
 
-	/* An empty bucket has been found. */
-	if (action == ENTER) {
-		/*
-		 * If table is full and another entry should be
-		 * entered return with error.
-		 */
-		if (htab->filled == htab->size) {
-			__set_errno(ENOMEM);
-			*retval = NULL;
-			return 0;
-		}
+	/* If there is a callback, call it */
+	if (e->entry.callback &&
+	    e->entry.callback(item.key, item.data, env_op_create, flag)) {
+		debug("callback() rejected setting variable "
+			"%s, skipping it!\n", item.key);
+		_hdelete(item.key, htab, e);
+		__set_errno(EINVAL);
+		*retval = NULL;
+		return 0;
+	}
 
-		/*
-		 * Create new entry;
-		 * create copies of item.key and item.data
-		 */
-		if (first_deleted)
-			idx = first_deleted;
-
-		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
-		if (!htab->table[idx].entry.key ||
-		    !htab->table[idx].entry.data) {
-			__set_errno(ENOMEM);
-			*retval = NULL;
-			return 0;
-		}
+	/* return new entry */
+	*retval = &e->entry;
+	return 1;
+}
 
-		++htab->filled;
+int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
+	      struct hsearch_data *htab, int flag)
+{
+	unsigned int hval = hhash(item.key);
+	unsigned int idx;
+	_ENTRY *e;
 
-		/* This is a new entry, so look up a possible callback */
-		env_callback_init(&htab->table[idx].entry);
-		/* Also look for flags */
-		env_flags_init(&htab->table[idx].entry);
+	if (htab->table == NULL) {
+		__set_errno(ESRCH);
+		*retval = NULL;
+		return 0;
+	}
+
+	idx = hslot_find(htab, item.key, hval);
+	e = htab->table[idx].ep;
+	if (e == NULL) {
+		if (action == ENTER)
+			return hinsert(item, retval, htab, flag, hval, idx);
+
+		__set_errno(ESRCH);
+		*retval = NULL;
+		return 0;
+	}
 
+	/* Overwrite existing value? */
+	if ((action == ENTER) && (item.data != NULL)) {
 		/* check for permission */
 		if (htab->change_ok != NULL && htab->change_ok(
-		    &htab->table[idx].entry, item.data, env_op_create, flag)) {
+		    &e->entry, item.data, env_op_overwrite, flag)) {
 			debug("change_ok() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
 			__set_errno(EPERM);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* If there is a callback, call it */
-		if (htab->table[idx].entry.callback &&
-		    htab->table[idx].entry.callback(item.key, item.data,
-		    env_op_create, flag)) {
+		if (e->entry.callback &&
+		    e->entry.callback(item.key, item.data, env_op_overwrite,
+		    flag)) {
 			debug("callback() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
 			__set_errno(EINVAL);
 			*retval = NULL;
 			return 0;
 		}
 
-		/* return new entry */
-		*retval = &htab->table[idx].entry;
-		return 1;
+		if (hset_data(htab, e, item.data)) {
+			__set_errno(ENOMEM);
+			*retval = NULL;
+			return 0;
+		}
+		e->stale = 0;
 	}
 
-	__set_errno(ESRCH);
-	*retval = NULL;
-	return 0;
+	/* return found entry */
+	*retval = &e->entry;
+	return 1;
 }
 
 
@@ -425,38 +686,41 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
  * do that.
  */
 
-static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
-	int idx)
+static void _hdelete(const char *key, struct hsearch_data *htab,
+	_ENTRY *e)
 {
-	/* free used ENTRY */
+	unsigned int pos = horder_find(htab, key);
+
 	debug("hdelete: DELETING key \"%s\"\n", key);
-	free((void *)ep->key);
-	free(ep->data);
-	ep->callback = NULL;
-	ep->flags = 0;
-	htab->table[idx].used = -1;
+	memmove(&htab->order[pos], &htab->order[pos + 1],
+		(htab->filled - pos - 1) * sizeof(_ENTRY *));
+	if (pos < htab->sorted)
+		--htab->sorted;
+	hremove(htab, e);
 
 	--htab->filled;
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 {
-	ENTRY e, *ep;
-	int idx;
+	_ENTRY *e;
 
 	debug("hdelete: DELETE key \"%s\"\n", key);
 
-	e.key = (char *)key;
+	if (htab->table == NULL) {
+		__set_errno(ESRCH);
+		return 0;
+	}
 
-	idx = hsearch_r(e, FIND, &ep, htab, 0);
-	if (idx == 0) {
+	e = htab->table[hslot_find(htab, key, hhash(key))].ep;
+	if (e == NULL) {
 		__set_errno(ESRCH);
 		return 0;	/* not found */
 	}
 
 	/* Check for permission */
 	if (htab->change_ok != NULL &&
-	    htab->change_ok(ep, NULL, env_op_delete, flag)) {
+	    htab->change_ok(&e->entry, NULL, env_op_delete, flag)) {
 		debug("change_ok() rejected deleting variable "
 			"%s, skipping it!\n", key);
 		__set_errno(EPERM);
@@ -464,15 +728,15 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	}
 
 	/* If there is a callback, call it */
-	if (htab->table[idx].entry.callback &&
-	    htab->table[idx].entry.callback(key, NULL, env_op_delete, flag)) {
+	if (e->entry.callback &&
+	    e->entry.callback(key, NULL, env_op_delete, flag)) {
 		debug("callback() rejected deleting variable "
 			"%s, skipping it!\n", key);
 		__set_errno(EINVAL);
 		return 0;
 	}
 
-	_hdelete(key, htab, ep, idx);
+	_hdelete(key, htab, e);
 
 	return 1;
 }
@@ -495,7 +759,7 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  * for later re-import.
  *
  * The entries in the result list will be sorted by ascending key
- * values.
+ * values, which is the order in which the table keeps them.
  *
  * If the separator character is different from NUL, then any
  * separator characters and backslash characters in the values will
@@ -520,14 +784,6 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  *		bytes in the string will be '\0'-padded.
  */
 
-static int cmpkey(const void *p1, const void *p2)
-{
-	ENTRY *e1 = *(ENTRY **) p1;
-	ENTRY *e2 = *(ENTRY **) p2;
-
-	return (strcmp(e1->key, e2->key));
-}
-
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -587,14 +843,25 @@ static int match_entry(ENTRY *ep, int flag,
 	return 0;
 }
 
+/* Whether hexport_r() shall include an entry */
+static int export_entry(ENTRY *ep, int flag, int argc, char * const argv[])
+{
+	if ((argc > 0) && !match_entry(ep, flag, argc, argv))
+		return 0;
+
+	if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+		return 0;
+
+	return 1;
+}
+
 ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char * const argv[])
 {
-	ENTRY *list[htab->size];
 	char *res, *p;
 	size_t totlen;
-	int i, n;
+	int i;
 
 	/* Test for correct arguments.  */
 	if ((resp == NULL) || (htab == NULL)) {
@@ -604,56 +871,36 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, "
 		"size = %zu\n", htab, htab->size, htab->filled, size);
+
+	horder_sort(htab);
 	/*
 	 * Pass 1:
-	 * search used entries,
-	 * save addresses and compute total length
+	 * search used entries and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
+	for (i = 0, totlen = 0; i < htab->filled; ++i) {
+		ENTRY *ep = &htab->order[i]->entry;
 
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
-
-			if ((argc > 0) && (found == 0))
-				continue;
-
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
-
-			list[n++] = ep;
+		if (!export_entry(ep, flag, argc, argv))
+			continue;
 
-			totlen += strlen(ep->key) + 2;
+		totlen += strlen(ep->key) + 2;
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
-#ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
-	for (i = 0; i < n; ++i) {
-		printf("\t%3d: %p ==> %-10s => %s\n",
-		       i, list[i], list[i]->key, list[i]->data);
-	}
-#endif
-
-	/* Sort list by keys */
-	qsort(list, n, sizeof(ENTRY *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
@@ -681,17 +928,21 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	}
 	/*
 	 * Pass 2:
-	 * export sorted list of result data
+	 * export the same entries, in key order
 	 */
-	for (i = 0, p = res; i < n; ++i) {
+	for (i = 0, p = res; i < htab->filled; ++i) {
+		ENTRY *ep = &htab->order[i]->entry;
 		const char *s;
 
-		s = list[i]->key;
+		if (!export_entry(ep, flag, argc, argv))
+			continue;
+
+		s = ep->key;
 		while (*s)
 			*p++ = *s++;
 		*p++ = '=';
 
-		s = list[i]->data;
+		s = ep->data;
 
 		while (*s) {
 			if ((*s == sep) || (*s == '\\'))
@@ -739,6 +990,57 @@ static int drop_var_from_set(const char *name, int nvars, char * vars[])
 	return res;
 }
 
+/* Find the entry for "name" if it is still stale */
+static _ENTRY *hfind_stale(struct hsearch_data *htab, const char *name)
+{
+	_ENTRY *e = htab->table[hslot_find(htab, name, hhash(name))].ep;
+
+	return e && e->stale ? e : NULL;
+}
+
+/*
+ * Give a stale entry a new value, as if the table had been destroyed and
+ * the variable was created again
+ */
+static int hrecreate(ENTRY item, ENTRY **retval, struct hsearch_data *htab,
+	int flag, _ENTRY *e)
+{
+	if (hset_data(htab, e, item.data)) {
+		__set_errno(ENOMEM);
+		*retval = NULL;
+		return 0;
+	}
+	e->stale = 0;
+	e->entry.callback = NULL;
+	e->entry.flags = 0;
+
+	return hcreated(item, retval, htab, flag, e);
+}
+
+/*
+ * Drop the variables which a replacing import did not bring back. As
+ * with hdestroy_r(), neither change_ok() nor the callbacks are asked.
+ */
+static void hdrop_stale(struct hsearch_data *htab)
+{
+	unsigned int i, n, sorted = 0;
+
+	for (i = 0, n = 0; i < htab->filled; i++) {
+		_ENTRY *e = htab->order[i];
+
+		if (e->stale) {
+			debug("hdelete: DELETING key \"%s\"\n", e->entry.key);
+			hremove(htab, e);
+		} else {
+			if (i < htab->sorted)
+				sorted++;
+			htab->order[n++] = e;
+		}
+	}
+	htab->filled = n;
+	htab->sorted = sorted;
+}
+
 /*
  * Import linearized data into hash table.
  *
@@ -751,7 +1053,11 @@ static int drop_var_from_set(const char *name, int nvars, char * vars[])
  * The "flag" argument can be used to control the behaviour: when the
  * H_NOCLEAR bit is set, then an existing hash table will kept, i. e.
  * new data will be added to an existing hash table; otherwise, old
- * data will be discarded and a new hash table will be created.
+ * data will be discarded. An existing table is then merged with the
+ * imported data rather than rebuilt: variables with an unchanged value
+ * are kept as they are (their callbacks are not called again), changed
+ * ones are replaced as if newly created and the variables which are not
+ * imported are dropped. The result is the same as with a new table.
  *
  * The separator character for the "name=value" pairs can be selected,
  * so we both support importing from externally stored environment
@@ -780,6 +1086,8 @@ int himport_r(struct hsearch_data *htab,
 {
 	char *data, *sp, *dp, *name, *value;
 	char *localvars[nvars];
+	int replace = 0;
+	_ENTRY *old;
 	int i;
 
 	/* Test for correct arguments.  */
@@ -801,12 +1109,13 @@ int himport_r(struct hsearch_data *htab,
 	if (nvars)
 		memcpy(localvars, vars, sizeof(vars[0]) * nvars);
 
-	if ((flag & H_NOCLEAR) == 0) {
-		/* Destroy old hash table if one exists */
-		debug("Destroy Hash Table: %p table = %p\n", htab,
+	if ((flag & H_NOCLEAR) == 0 && htab->table) {
+		/* Mark the old entries, to drop the ones not imported again */
+		debug("Merge into Hash Table: %p table = %p\n", htab,
 		       htab->table);
-		if (htab->table)
-			hdestroy_r(htab);
+		for (i = 0; i < htab->filled; i++)
+			htab->order[i]->stale = 1;
+		replace = 1;
 	}
 
 	/*
@@ -821,7 +1130,8 @@ int himport_r(struct hsearch_data *htab,
 	 * (CONFIG_ENV_SIZE).  This heuristics will result in
 	 * unreasonably large numbers (and thus memory footprint) for
 	 * big flash environments (>8,000 entries for 64 KB
-	 * envrionment size), so we clip it to a reasonable value.
+	 * envrionment size), so we clip it to a reasonable value; the
+	 * table grows later on if more entries are needed.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
 	 * be overwritten in the board config file if needed.
@@ -841,8 +1151,12 @@ int himport_r(struct hsearch_data *htab,
 		}
 	}
 
-	if(!size)
+	if(!size) {
+		free(data);
+		if (replace)
+			hdrop_stale(htab);
 		return 1;		/* everything OK */
+	}
 	if(crlf_is_lf) {
 		/* Remove Carriage Returns in front of Line Feeds */
 		unsigned ignored_crs = 0;
@@ -887,6 +1201,10 @@ int himport_r(struct hsearch_data *htab,
 			if (!drop_var_from_set(name, nvars, localvars))
 				continue;
 
+			/* An old variable goes away at the end anyway */
+			if (replace && hfind_stale(htab, name))
+				continue;
+
 			if (hdelete_r(name, htab, flag) == 0)
 				debug("DELETE ERROR ##############################\n");
 
@@ -905,6 +1223,9 @@ int himport_r(struct hsearch_data *htab,
 
 		if (*name == 0) {
 			debug("INSERT: unable to use an empty key\n");
+			free(data);
+			if (replace)
+				hdrop_stale(htab);
 			__set_errno(EINVAL);
 			return 0;
 		}
@@ -913,11 +1234,21 @@ int himport_r(struct hsearch_data *htab,
 		if (!drop_var_from_set(name, nvars, localvars))
 			continue;
 
+		/* Keep unchanged variables when replacing the table */
+		old = replace ? hfind_stale(htab, name) : NULL;
+		if (old && strcmp(old->entry.data, value) == 0) {
+			old->stale = 0;
+			continue;
+		}
+
 		/* enter into hash table */
 		e.key = name;
 		e.data = value;
 
-		hsearch_r(e, ENTER, &rv, htab, flag);
+		if (old)
+			hrecreate(e, &rv, htab, flag, old);
+		else
+			hsearch_r(e, ENTER, &rv, htab, flag);
 		if (rv == NULL)
 			printf("himport_r: can't insert \"%s=%s\" into hash table\n",
 				name, value);
@@ -930,6 +1261,9 @@ int himport_r(struct hsearch_data *htab,
 	debug("INSERT: free(data = %p)\n", data);
 	free(data);
 
+	if (replace)
+		hdrop_stale(htab);
+
 	/* process variables which were not considered */
 	for (i = 0; i < nvars; i++) {
 		if (localvars[i] == NULL)
@@ -959,18 +1293,18 @@ int himport_r(struct hsearch_data *htab,
 /*
  * Walk all of the entries in the hash, calling the callback for each one.
  * this allows some generic operation to be performed on each element.
+ * The entries are visited in key order.
  */
 int hwalk_r(struct hsearch_data *htab, int (*callback)(ENTRY *))
 {
 	int i;
 	int retval;
 
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			retval = callback(&htab->table[i].entry);
-			if (retval)
-				return retval;
-		}
+	horder_sort(htab);
+	for (i = 0; i < htab->filled; ++i) {
+		retval = callback(&htab->order[i]->entry);
+		if (retval)
+			return retval;
 	}
 
 	return 0;
@@ -30,36 +30,44 @@ static const unsigned char lzop_magic[] = {
 
 #define HEADER_HAS_FILTER	0x00000800L
 
-static inline const unsigned char *parse_header(const unsigned char *src)
+int lzop_header_len(const unsigned char *src, size_t len)
 {
 	u16 version;
+	size_t pos;
 	int i;
 
 	/* read magic: 9 first bytes */
+	if (len < ARRAY_SIZE(lzop_magic) + 2)
+		return 0;
 	for (i = 0; i < ARRAY_SIZE(lzop_magic); i++) {
-		if (*src++ != lzop_magic[i])
-			return NULL;
+		if (src[i] != lzop_magic[i])
+			return -1;
 	}
 	/* get version (2bytes), skip library version (2),
 	 * 'need to be extracted' version (2) and
 	 * method (1) */
-	version = get_unaligned_be16(src);
-	src += 7;
+	version = get_unaligned_be16(src + i);
+	pos = i + 7;
 	if (version >= 0x0940)
-		src++;
-	if (get_unaligned_be32(src) & HEADER_HAS_FILTER)
-		src += 4; /* filter info */
+		pos++;
+	if (len < pos + 4)
+		return 0;
+	if (get_unaligned_be32(src + pos) & HEADER_HAS_FILTER)
+		pos += 4; /* filter info */
 
 	/* skip flags, mode and mtime_low */
-	src += 12;
+	pos += 12;
 	if (version >= 0x0940)
-		src += 4;	/* skip mtime_high */
+		pos += 4;	/* skip mtime_high */
 
-	i = *src++;
+	if (len < pos + 1)
+		return 0;
 	/* don't care about the file name, and skip checksum */
-	src += i + 4;
+	pos += 1 + src[pos] + 4;
+	if (len < pos)
+		return 0;
 
-	return src;
+	return pos;
 }
 
 int lzop_decompress(const unsigned char *src, size_t src_len,
@@ -71,9 +79,10 @@ int lzop_decompress(const unsigned char *src, size_t src_len,
 	size_t tmp, remaining;
 	int r;
 
-	src = parse_header(src);
-	if (!src)
+	r = lzop_header_len(src, src_len);
+	if (r <= 0)
 		return LZO_E_ERROR;
+	src += r;
 
 	remaining = *dst_len;
 	while (src < send) {
@@ -440,6 +440,40 @@ int eth_rx(void)
 	return eth_current->recv(eth_current);
 }
 
+int eth_rx_ring_poll(struct eth_device *dev, struct eth_rx_ring *ring)
+{
+	unsigned int count;
+	uchar *pkt;
+	int len, total = 0;
+
+	for (count = 0; count < ring->size; count++) {
+		len = ring->check(dev, ring->head, &pkt);
+		if (!len)
+			break;
+		if (len > 0) {
+			NetReceive(pkt, len);
+			total += len;
+		} else {
+			dev->rx_stats.errors++;
+		}
+		ring->release(dev, ring->head);
+		if (++ring->head == ring->size)
+			ring->head = 0;
+		/* Leave the rest for the next poll if the loop has ended */
+		if (net_state != NETLOOP_CONTINUE)
+			return total;
+	}
+
+	/*
+	 * Every buffer was full (or all but the one some MACs keep back), so
+	 * the MAC may have had to drop frames
+	 */
+	if (count >= ring->size - 1)
+		dev->rx_stats.overruns++;
+
+	return total;
+}
+
 #ifdef CONFIG_API
 static void eth_save_packet(void *packet, int length)
 {
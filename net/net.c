@@ -105,6 +105,9 @@
 #include "sntp.h"
 #endif
 #include "tftp.h"
+#if defined(CONFIG_CMD_WGET)
+#include "wget.h"
+#endif
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -195,6 +198,10 @@ static rxhand_f *arp_packet_handler;
 /* Current ICMP rx handler */
 static rxhand_icmp_f *packet_icmp_handler;
 #endif
+#ifdef CONFIG_CMD_WGET
+/* Current TCP rx handler */
+static rxhand_tcp_f *tcp_packet_handler;
+#endif
 /* Current timeout handler */
 static thand_f *timeHandler;
 /* Time base value */
@@ -208,6 +215,9 @@ static int net_check_prereq(enum proto_t protocol);
 
 static int NetTryCount;
 
+/* Most frames taken from the device per pass round NetLoop() */
+#define NET_RX_BUDGET	64
+
 int __maybe_unused net_busy_flag;
 
 /**********************************************************************/
@@ -284,6 +294,9 @@ static void net_clear_handlers(void)
 {
 	net_set_udp_handler(NULL);
 	net_set_arp_handler(NULL);
+#ifdef CONFIG_CMD_WGET
+	net_set_tcp_handler(NULL);
+#endif
 	NetSetTimeout(0, NULL);
 }
 
@@ -317,6 +330,37 @@ void net_init(void)
 	NetInitLoop();
 }
 
+/*
+ * Take in whatever the current device has received. Drivers which hand
+ * over one frame per call are called again as long as they produce frames,
+ * so that a burst is not left in the MAC's buffers while we go round the
+ * loop (and possibly overflow them).
+ */
+static void net_rx_poll(void)
+{
+	struct eth_device *dev = eth_get_dev();
+	struct eth_rx_stats *stats;
+	ulong start, last;
+	int i;
+
+	if (!dev) {
+		eth_rx();
+		return;
+	}
+
+	stats = &dev->rx_stats;
+	start = stats->packets;
+	for (i = 0; i < NET_RX_BUDGET; i++) {
+		last = stats->packets;
+		eth_rx();
+		/* Stop once a handler has ended or restarted the loop */
+		if (stats->packets == last || net_state != NETLOOP_CONTINUE)
+			break;
+	}
+	if (stats->packets - start > stats->max_batch)
+		stats->max_batch = stats->packets - start;
+}
+
 /**********************************************************************/
 /*
  *	Main network processing loop.
@@ -415,6 +459,11 @@ restart:
 			NfsStart();
 			break;
 #endif
+#if defined(CONFIG_CMD_WGET)
+		case WGET:
+			wget_start();
+			break;
+#endif
 #if defined(CONFIG_CMD_CDP)
 		case CDP:
 			CDPStart();
@@ -474,10 +523,10 @@ restart:
 		show_activity(1);
 #endif
 		/*
-		 *	Check the ethernet for a new packet.  The ethernet
-		 *	receive routine will process it.
+		 *	Check the ethernet for new packets.  The ethernet
+		 *	receive routine will process them.
 		 */
-		eth_rx();
+		net_rx_poll();
 
 		/*
 		 *	Abort if ctrl-c was pressed.
@@ -678,6 +727,14 @@ void net_set_icmp_handler(rxhand_icmp_f *f)
 }
 #endif
 
+#ifdef CONFIG_CMD_WGET
+void net_set_tcp_handler(rxhand_tcp_f *f)
+{
+	debug_cond(DEBUG_INT_STATE, "--- NetLoop TCP handler set (%p)\n", f);
+	tcp_packet_handler = f;
+}
+#endif
+
 void
 NetSetTimeout(ulong iv, thand_f *f)
 {
@@ -721,6 +778,11 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 	net_set_udp_header(pkt, dest, dport, sport, payload_len);
 	pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
 
+	return net_send_ip_packet(ether, dest, pkt_hdr_size + payload_len);
+}
+
+int net_send_ip_packet(uchar *ether, IPaddr_t dest, int len)
+{
 	/* if MAC address was not discovered yet, do an ARP request */
 	if (memcmp(ether, NetEtherNullAddr, 6) == 0) {
 		debug_cond(DEBUG_DEV_PKT, "sending ARP for %pI4\n", &dest);
@@ -730,7 +792,7 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 		NetArpWaitPacketMAC = ether;
 
 		/* size of the waiting packet */
-		NetArpWaitTxPacketSize = pkt_hdr_size + payload_len;
+		NetArpWaitTxPacketSize = len;
 
 		/* and do the ARP request */
 		NetArpWaitTry = 1;
@@ -738,9 +800,9 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 		ArpRequest();
 		return 1;	/* waiting */
 	} else {
-		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
+		debug_cond(DEBUG_DEV_PKT, "sending IP packet to %pI4/%pM\n",
 			&dest, ether);
-		NetSendPacket(NetTxPacket, pkt_hdr_size + payload_len);
+		NetSendPacket(NetTxPacket, len);
 		return 0;	/* transmitted */
 	}
 }
@@ -751,18 +813,12 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
  * to the algorithm in RFC815. It returns NULL or the pointer to
  * a complete packet, in static storage
  */
-#ifndef CONFIG_NET_MAXDEFRAG
-#define CONFIG_NET_MAXDEFRAG 16384
-#endif
 /*
- * MAXDEFRAG, above, is chosen in the config file and  is real data
- * so we need to add the NFS overhead, which is more than TFTP.
- * To use sizeof in the internal unnamed structures, we need a real
- * instance (can't do "sizeof(struct rpc_t.u.reply))", unfortunately).
- * The compiler doesn't complain nor allocates the actual structure
+ * CONFIG_NET_MAXDEFRAG is chosen in the config file and is real data
+ * so we need to add the headers and the NFS overhead, which is more than
+ * TFTP.
  */
-static struct rpc_t rpc_specimen;
-#define IP_PKTSIZE (CONFIG_NET_MAXDEFRAG + sizeof(rpc_specimen.u.reply))
+#define IP_PKTSIZE (CONFIG_NET_MAXDEFRAG + IP_UDP_HDR_SIZE + NFS_READ_HDR_MAX)
 
 #define IP_MAXUDP (IP_PKTSIZE - IP_HDR_SIZE)
 
@@ -968,6 +1024,11 @@ NetReceive(uchar *inpkt, int len)
 	NetRxPacketLen = len;
 	et = (struct ethernet_hdr *)inpkt;
 
+	if (eth_get_dev()) {
+		eth_get_dev()->rx_stats.packets++;
+		eth_get_dev()->rx_stats.bytes += len;
+	}
+
 	/* too small packet? */
 	if (len < ETHER_HDR_SIZE)
 		return;
@@ -1132,6 +1193,14 @@ NetReceive(uchar *inpkt, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#ifdef CONFIG_CMD_WGET
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			if (tcp_packet_handler)
+				tcp_packet_handler((uchar *)ip + IP_HDR_SIZE,
+						   src_ip, dst_ip,
+						   len - IP_HDR_SIZE);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
 			return;
 		}
@@ -1235,6 +1304,9 @@ static int net_check_prereq(enum proto_t protocol)
 #endif
 #if defined(CONFIG_CMD_NFS)
 	case NFS:
+#endif
+#if defined(CONFIG_CMD_WGET)
+	case WGET:
 #endif
 	case TFTPGET:
 	case TFTPPUT:
@@ -1432,7 +1504,8 @@ void copy_filename(char *dst, const char *src, int size)
 
 #if	defined(CONFIG_CMD_NFS)		|| \
 	defined(CONFIG_CMD_SNTP)	|| \
-	defined(CONFIG_CMD_DNS)
+	defined(CONFIG_CMD_DNS)		|| \
+	defined(CONFIG_CMD_WGET)
 /*
  * make port a little random (1024-17407)
  * This keeps the math somewhat trivial to compute, and seems to work with
@@ -26,10 +26,12 @@
 #include <command.h>
 #include <net.h>
 #include <malloc.h>
+#include <asm/io.h>
 #include "nfs.h"
 #include "bootp.h"
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
+#define HASH_BYTES (NFS_READ_SIZE / 2 * 10) /* Bytes loaded per hash */
 #define NFS_RETRY_COUNT 30
 #ifndef CONFIG_NFS_TIMEOUT
 # define NFS_TIMEOUT 2000UL
@@ -42,12 +44,31 @@
 
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
-
-static char dirfh[NFS_FHSIZE];	/* file handle of directory */
-static char filefh[NFS_FHSIZE]; /* file handle of kernel image */
+static ulong time_start;	/* Record time we started NFS */
+
+static int nfs_version;		/* NFS protocol version in use, 2 or 3 */
+static int nfs_rsize;		/* Bytes asked for by each READ */
+static int nfs_window;		/* Number of READs kept in flight */
+
+/* A READ which has been sent and not answered yet */
+struct nfs_read_slot {
+	unsigned long id;	/* RPC id, or 0 if the slot is free */
+	unsigned int offset;
+	unsigned int len;
+};
+
+static struct nfs_read_slot nfs_read_slots[NFS_READ_WINDOW_MAX];
+static unsigned int nfs_read_next;	/* offset of the next READ to send */
+static unsigned int nfs_read_end;	/* file size, once nfs_read_eof */
+static int nfs_read_eof;
+static unsigned int nfs_read_bytes;	/* bytes received, for the hashes */
+static int nfs_hashes;
+
+static char dirfh[NFS3_FHSIZE];	/* file handle of directory */
+static int dirfh_len;
+static char filefh[NFS3_FHSIZE]; /* file handle of kernel image */
+static int filefh_len;
 
 static enum net_loop_state nfs_download_state;
 static IPaddr_t NfsServerIP;
@@ -63,6 +84,7 @@ static int	NfsState;
 #define STATE_LOOKUP_REQ		5
 #define STATE_READ_REQ			6
 #define STATE_READLINK_REQ		7
+#define STATE_FSINFO_REQ		8
 
 static char default_filename[64];
 static char *nfs_filename;
@@ -93,7 +115,10 @@ store_block(uchar *src, unsigned offset, unsigned len)
 	} else
 #endif /* CONFIG_SYS_DIRECT_FLASH_NFS */
 	{
-		(void)memcpy((void *)(load_addr + offset), src, len);
+		void *ptr = map_sysmem(load_addr + offset, len);
+
+		memcpy(ptr, src, len);
+		unmap_sysmem(ptr);
 	}
 
 	if (NetBootFileXferSize < (offset+len))
@@ -131,7 +156,7 @@ dirname(char *path)
 /**************************************************************************
 RPC_ADD_CREDENTIALS - Add RPC authentication/verifier entries
 **************************************************************************/
-static long *rpc_add_credentials(long *p)
+static uint32_t *rpc_add_credentials(uint32_t *p)
 {
 	int hl;
 	int hostnamelen;
@@ -171,10 +196,31 @@ static long *rpc_add_credentials(long *p)
 	return p;
 }
 
+/* Add a file handle, which has a length in front of it in NFSv3 */
+static uint32_t *rpc_add_fh(uint32_t *p, const char *fh, int fh_len)
+{
+	if (nfs_version == 3)
+		*p++ = htonl(fh_len);
+	if (fh_len & 3)
+		*(p + fh_len / 4) = 0;
+	memcpy(p, fh, fh_len);
+
+	return p + (fh_len + 3) / 4;
+}
+
+/* Find the start of the results in a reply, skipping any NFSv3 attributes */
+static uint32_t *rpc_skip_attr(uint32_t *p)
+{
+	if (nfs_version == 3 && ntohl(*p++))
+		p += NFS3_FATTR_WORDS;
+
+	return p;
+}
+
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
-static void
+static unsigned long
 rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 {
 	struct rpc_t pkt;
@@ -182,13 +228,21 @@ rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 	uint32_t *p;
 	int pktlen;
 	int sport;
+	int vers;
+
+	if (rpc_prog == PROG_NFS)
+		vers = nfs_version;
+	else if (rpc_prog == PROG_MOUNT && nfs_version == 3)
+		vers = 3;
+	else
+		vers = 2;	/* portmapper is version 2 */
 
 	id = ++rpc_id;
 	pkt.u.call.id = htonl(id);
 	pkt.u.call.type = htonl(MSG_CALL);
 	pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
 	pkt.u.call.prog = htonl(rpc_prog);
-	pkt.u.call.vers = htonl(2);	/* portmapper is version 2 */
+	pkt.u.call.vers = htonl(vers);
 	pkt.u.call.proc = htonl(rpc_proc);
 	p = (uint32_t *)&(pkt.u.call.data);
 
@@ -209,6 +263,8 @@ rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 
 	NetSendUDPPacket(NetServerEther, NfsServerIP, sport, NfsOurPort,
 		pktlen);
+
+	return id;
 }
 
 /**************************************************************************
@@ -243,7 +299,7 @@ nfs_mount_req(char *path)
 	pathlen = strlen(path);
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
 	*p++ = htonl(pathlen);
 	if (pathlen & 3)
@@ -271,7 +327,7 @@ nfs_umountall_req(void)
 		return;
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
@@ -293,14 +349,14 @@ nfs_readlink_req(void)
 	int len;
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
-	memcpy(p, filefh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, filefh, filefh_len);
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READLINK, data, len);
+	rpc_req(PROG_NFS, nfs_version == 3 ? NFS3PROC_READLINK : NFS_READLINK,
+		data, len);
 }
 
 /**************************************************************************
@@ -317,10 +373,9 @@ nfs_lookup_req(char *fname)
 	fnamelen = strlen(fname);
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
-	memcpy(p, dirfh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, dirfh, dirfh_len);
 	*p++ = htonl(fnamelen);
 	if (fnamelen & 3)
 		*(p + fnamelen / 4) = 0;
@@ -329,31 +384,117 @@ nfs_lookup_req(char *fname)
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_LOOKUP, data, len);
+	rpc_req(PROG_NFS, nfs_version == 3 ? NFS3PROC_LOOKUP : NFS_LOOKUP,
+		data, len);
+}
+
+/**************************************************************************
+NFS_FSINFO - Ask an NFSv3 server for its largest read size
+**************************************************************************/
+static void
+nfs_fsinfo_req(void)
+{
+	uint32_t data[1024];
+	uint32_t *p;
+	int len;
+
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = rpc_add_fh(p, dirfh, dirfh_len);
+
+	len = (uint32_t *)p - (uint32_t *)&(data[0]);
+
+	rpc_req(PROG_NFS, NFS3PROC_FSINFO, data, len);
 }
 
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
 static void
-nfs_read_req(int offset, int readlen)
+nfs_read_req(struct nfs_read_slot *slot)
 {
 	uint32_t data[1024];
 	uint32_t *p;
 	int len;
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
-	memcpy(p, filefh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
-	*p++ = htonl(offset);
-	*p++ = htonl(readlen);
-	*p++ = 0;
+	p = rpc_add_fh(p, filefh, filefh_len);
+	if (nfs_version == 3) {
+		*p++ = 0;			/* offset, upper 32 bits */
+		*p++ = htonl(slot->offset);
+		*p++ = htonl(slot->len);
+	} else {
+		*p++ = htonl(slot->offset);
+		*p++ = htonl(slot->len);
+		*p++ = 0;			/* totalcount, unused */
+	}
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	slot->id = rpc_req(PROG_NFS, nfs_version == 3 ? NFS3PROC_READ :
+			   NFS_READ, data, len);
+}
+
+/* Send READs for the rest of the file until the window is full */
+static void
+nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_read_slots; slot < nfs_read_slots + nfs_window;
+	     slot++) {
+		if (slot->id)
+			continue;
+		if (nfs_read_eof && nfs_read_next >= nfs_read_end)
+			break;
+		slot->offset = nfs_read_next;
+		slot->len = nfs_rsize;
+		nfs_read_next += nfs_rsize;
+		nfs_read_req(slot);
+	}
+}
+
+/* Send the READs which are in flight again, after a timeout */
+static void
+nfs_read_resend(void)
+{
+	struct nfs_read_slot *slot;
+
+	for (slot = nfs_read_slots; slot < nfs_read_slots + nfs_window;
+	     slot++) {
+		if (slot->id)
+			nfs_read_req(slot);
+	}
+}
+
+/* Forget about any READs in flight; their replies will be dropped */
+static void
+nfs_read_reset(void)
+{
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+	nfs_read_next = 0;
+	nfs_read_end = 0;
+	nfs_read_eof = 0;
+}
+
+/* Check whether all of the file up to its end has arrived */
+static int
+nfs_read_complete(void)
+{
+	struct nfs_read_slot *slot;
+
+	if (!nfs_read_eof)
+		return 0;
+	for (slot = nfs_read_slots; slot < nfs_read_slots + nfs_window;
+	     slot++) {
+		if (slot->id && slot->offset < nfs_read_end)
+			return 0;
+	}
+
+	return 1;
 }
 
 /**************************************************************************
@@ -367,10 +508,10 @@ NfsSend(void)
 
 	switch (NfsState) {
 	case STATE_PRCLOOKUP_PROG_MOUNT_REQ:
-		rpc_lookup_req(PROG_MOUNT, 1);
+		rpc_lookup_req(PROG_MOUNT, nfs_version == 3 ? 3 : 1);
 		break;
 	case STATE_PRCLOOKUP_PROG_NFS_REQ:
-		rpc_lookup_req(PROG_NFS, 2);
+		rpc_lookup_req(PROG_NFS, nfs_version);
 		break;
 	case STATE_MOUNT_REQ:
 		nfs_mount_req(nfs_path);
@@ -381,8 +522,11 @@ NfsSend(void)
 	case STATE_LOOKUP_REQ:
 		nfs_lookup_req(nfs_filename);
 		break;
+	case STATE_FSINFO_REQ:
+		nfs_fsinfo_req();
+		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -445,8 +589,16 @@ nfs_mount_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
+	if (nfs_version == 3) {
+		dirfh_len = ntohl(rpc_pkt.u.reply.data[1]);
+		if (dirfh_len > NFS3_FHSIZE)
+			return -1;
+		memcpy(dirfh, rpc_pkt.u.reply.data + 2, dirfh_len);
+	} else {
+		dirfh_len = NFS_FHSIZE;
+		memcpy(dirfh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
+	}
 	fs_mounted = 1;
-	memcpy(dirfh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
 
 	return 0;
 }
@@ -496,7 +648,46 @@ nfs_lookup_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
-	memcpy(filefh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
+	if (nfs_version == 3) {
+		filefh_len = ntohl(rpc_pkt.u.reply.data[1]);
+		if (filefh_len > NFS3_FHSIZE)
+			return -1;
+		memcpy(filefh, rpc_pkt.u.reply.data + 2, filefh_len);
+	} else {
+		filefh_len = NFS_FHSIZE;
+		memcpy(filefh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
+	}
+
+	return 0;
+}
+
+static int
+nfs_fsinfo_reply(uchar *pkt, unsigned len)
+{
+	struct rpc_t rpc_pkt;
+	uint32_t *data;
+	int rtmax;
+
+	debug("%s\n", __func__);
+
+	memcpy((unsigned char *)&rpc_pkt, pkt, len);
+
+	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
+		return -NFS_RPC_ERR;
+	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+		return -NFS_RPC_DROP;
+
+	if (rpc_pkt.u.reply.rstatus  ||
+	    rpc_pkt.u.reply.verifier ||
+	    rpc_pkt.u.reply.astatus  ||
+	    rpc_pkt.u.reply.data[0])
+		return -1;
+
+	data = rpc_skip_attr(rpc_pkt.u.reply.data + 1);
+	rtmax = ntohl(data[0]);
+	nfs_rsize = NFS3_READ_SIZE;
+	if (rtmax > 0 && rtmax < nfs_rsize)
+		nfs_rsize = rtmax;
 
 	return 0;
 }
@@ -505,6 +696,7 @@ static int
 nfs_readlink_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	uint32_t *data;
 	int rlen;
 
 	debug("%s\n", __func__);
@@ -522,35 +714,57 @@ nfs_readlink_reply(uchar *pkt, unsigned len)
 	    rpc_pkt.u.reply.data[0])
 		return -1;
 
-	rlen = ntohl(rpc_pkt.u.reply.data[1]); /* new path length */
+	data = rpc_skip_attr(rpc_pkt.u.reply.data + 1);
+	rlen = ntohl(data[0]); /* new path length */
 
-	if (*((char *)&(rpc_pkt.u.reply.data[2])) != '/') {
+	if (*((char *)&(data[1])) != '/') {
 		int pathlen;
 		strcat(nfs_path, "/");
 		pathlen = strlen(nfs_path);
-		memcpy(nfs_path + pathlen, (uchar *)&(rpc_pkt.u.reply.data[2]),
-			rlen);
+		memcpy(nfs_path + pathlen, (uchar *)&(data[1]), rlen);
 		nfs_path[pathlen + rlen] = 0;
 	} else {
-		memcpy(nfs_path, (uchar *)&(rpc_pkt.u.reply.data[2]), rlen);
+		memcpy(nfs_path, (uchar *)&(data[1]), rlen);
 		nfs_path[rlen] = 0;
 	}
 	return 0;
 }
 
+static void
+nfs_show_progress(int rlen)
+{
+	nfs_read_bytes += rlen;
+	while (nfs_hashes < nfs_read_bytes / HASH_BYTES) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_hashes++;
+	}
+}
+
+/*
+ * Handle the reply to one of the READs in flight. Replies can come in any
+ * order, so each is matched to its request by the RPC id.
+ */
 static int
 nfs_read_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
+	struct nfs_read_slot *slot;
+	unsigned long id;
+	uint32_t *data;
+	int rlen, hlen;
+	int eof = 0;
 
 	debug("%s\n", __func__);
 
-	memcpy((uchar *)&rpc_pkt, pkt, sizeof(rpc_pkt.u.reply));
+	memcpy((uchar *)&rpc_pkt, pkt, NFS_READ_HDR_MAX);
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	id = ntohl(rpc_pkt.u.reply.id);
+	for (slot = nfs_read_slots; slot < nfs_read_slots + nfs_window; slot++)
+		if (slot->id && slot->id == id)
+			break;
+	if (slot == nfs_read_slots + nfs_window)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -564,16 +778,37 @@ nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
+	if (nfs_version == 3) {
+		data = rpc_skip_attr(rpc_pkt.u.reply.data + 1);
+		data++;				/* count */
+		eof = ntohl(*data++);
+	} else {
+		data = rpc_pkt.u.reply.data + 1 + NFS_FATTR_WORDS;
+	}
+	rlen = ntohl(*data++);
+	hlen = (uchar *)data - (uchar *)&rpc_pkt;
+	if (rlen < 0 || rlen > slot->len || hlen + rlen > len)
+		return -NFS_RPC_DROP;
 
-	rlen = ntohl(rpc_pkt.u.reply.data[18]);
-	if (store_block((uchar *)pkt + sizeof(rpc_pkt.u.reply),
-			nfs_offset, rlen))
+	/* READs past the end of the file come back empty */
+	if (rlen && store_block(pkt + hlen, slot->offset, rlen))
 		return -9999;
+	nfs_show_progress(rlen);
+
+	if (rlen && rlen < slot->len && !eof) {
+		/* Short read: ask for the rest of this part again */
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_req(slot);
+	} else {
+		/* NFSv2 has no end-of-file flag, only an empty reply */
+		if ((eof || !rlen) &&
+		    (!nfs_read_eof || slot->offset + rlen < nfs_read_end)) {
+			nfs_read_eof = 1;
+			nfs_read_end = slot->offset + rlen;
+		}
+		slot->id = 0;
+	}
 
 	return rlen;
 }
@@ -611,14 +846,24 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 	case STATE_PRCLOOKUP_PROG_MOUNT_REQ:
 		if (rpc_lookup_reply(PROG_MOUNT, pkt, len) == -NFS_RPC_DROP)
 			break;
-		NfsState = STATE_PRCLOOKUP_PROG_NFS_REQ;
+		if (nfs_version == 3 && !NfsSrvMountPort) {
+			/* No MOUNT v3, so no NFSv3 either */
+			nfs_version = 2;
+		} else {
+			NfsState = STATE_PRCLOOKUP_PROG_NFS_REQ;
+		}
 		NfsSend();
 		break;
 
 	case STATE_PRCLOOKUP_PROG_NFS_REQ:
 		if (rpc_lookup_reply(PROG_NFS, pkt, len) == -NFS_RPC_DROP)
 			break;
-		NfsState = STATE_MOUNT_REQ;
+		if (nfs_version == 3 && !NfsSrvNfsPort) {
+			nfs_version = 2;
+			NfsState = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+		} else {
+			NfsState = STATE_MOUNT_REQ;
+		}
 		NfsSend();
 		break;
 
@@ -632,11 +877,22 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 			NfsState = STATE_UMOUNT_REQ;
 			NfsSend();
 		} else {
-			NfsState = STATE_LOOKUP_REQ;
+			if (nfs_version == 3)
+				NfsState = STATE_FSINFO_REQ;
+			else
+				NfsState = STATE_LOOKUP_REQ;
 			NfsSend();
 		}
 		break;
 
+	case STATE_FSINFO_REQ:
+		if (nfs_fsinfo_reply(pkt, len) == -NFS_RPC_DROP)
+			break;
+		/* If FSINFO fails we just keep the NFSv2 read size */
+		NfsState = STATE_LOOKUP_REQ;
+		NfsSend();
+		break;
+
 	case STATE_UMOUNT_REQ:
 		reply = nfs_umountall_reply(pkt, len);
 		if (reply == -NFS_RPC_DROP)
@@ -645,6 +901,13 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 			puts("*** ERROR: Cannot umount\n");
 			net_set_state(NETLOOP_FAIL);
 		} else {
+			time_start = get_timer(time_start);
+			if (nfs_download_state == NETLOOP_SUCCESS &&
+			    time_start > 0) {
+				puts("\n\t ");	/* Line up with "Loading: " */
+				print_size(NetBootFileXferSize /
+					time_start * 1000, "/s");
+			}
 			puts("\ndone\n");
 			net_set_state(nfs_download_state);
 		}
@@ -659,10 +922,11 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 			NfsState = STATE_UMOUNT_REQ;
 			NfsSend();
 		} else {
+			debug("NFSv%d, rsize %d, window %d\n", nfs_version,
+			      nfs_rsize, nfs_window);
 			NfsState = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			NfsSend();
+			nfs_read_reset();
+			nfs_read_fill();
 		}
 		break;
 
@@ -686,17 +950,25 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 
 	case STATE_READ_REQ:
 		rlen = nfs_read_reply(pkt, len);
+		if (rlen == -NFS_RPC_DROP)
+			break;
 		NetSetTimeout(nfs_timeout, NfsTimeout);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			NfsSend();
+		if (rlen >= 0) {
+			if (nfs_read_complete()) {
+				nfs_download_state = NETLOOP_SUCCESS;
+				nfs_read_reset();
+				NfsState = STATE_UMOUNT_REQ;
+				NfsSend();
+			} else {
+				nfs_read_fill();
+			}
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
+			nfs_read_reset();
 			NfsState = STATE_READLINK_REQ;
 			NfsSend();
 		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
+			nfs_read_reset();
 			NfsState = STATE_UMOUNT_REQ;
 			NfsSend();
 		}
@@ -708,9 +980,26 @@ NfsHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src, unsigned len)
 void
 NfsStart(void)
 {
+	char *ep;
+
 	debug("%s\n", __func__);
 	nfs_download_state = NETLOOP_FAIL;
 
+	/* Try NFSv3 first, falling back to v2 if the server lacks it */
+	nfs_version = 3;
+	nfs_rsize = NFS_READ_SIZE;
+	nfs_window = NFS_READ_WINDOW;
+	ep = getenv("nfswindowsize");
+	if (ep != NULL)
+		nfs_window = simple_strtol(ep, NULL, 10);
+	if (nfs_window < 1)
+		nfs_window = 1;
+	else if (nfs_window > NFS_READ_WINDOW_MAX)
+		nfs_window = NFS_READ_WINDOW_MAX;
+	nfs_read_reset();
+	nfs_read_bytes = 0;
+	nfs_hashes = 0;
+
 	NfsServerIP = NetServerIP;
 	nfs_path = (char *)nfs_path_buff;
 
@@ -770,6 +1059,7 @@ NfsStart(void)
 	printf("\nLoad address: 0x%lx\n"
 		"Loading: *\b", load_addr);
 
+	time_start = get_timer(0);
 	NetSetTimeout(nfs_timeout, NfsTimeout);
 	net_set_udp_handler(NfsHandler);
 
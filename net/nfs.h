@@ -25,7 +25,17 @@
 #define NFS_READLINK    5
 #define NFS_READ        6
 
+#define NFS3PROC_LOOKUP		3
+#define NFS3PROC_READLINK	5
+#define NFS3PROC_READ		6
+#define NFS3PROC_FSINFO		19
+
 #define NFS_FHSIZE      32
+#define NFS3_FHSIZE	64
+
+/* Size in 32-bit words of the file attributes in NFSv2 and NFSv3 replies */
+#define NFS_FATTR_WORDS		17
+#define NFS3_FATTR_WORDS	21
 
 #define NFSERR_PERM     1
 #define NFSERR_NOENT    2
@@ -44,6 +54,33 @@
 #define NFS_READ_SIZE 1024 /* biggest power of two that fits Ether frame */
 #endif
 
+/*
+ * Largest NFSv3 read size we ask for. The server may lower it (FSINFO
+ * rtmax). Without CONFIG_IP_DEFRAG a reply must fit in a single frame.
+ */
+#ifdef CONFIG_IP_DEFRAG
+#define NFS3_READ_SIZE CONFIG_NET_MAXDEFRAG
+#else
+#define NFS3_READ_SIZE NFS_READ_SIZE
+#endif
+
+/*
+ * Space taken by the RPC reply header and NFS READ result in front of the
+ * data: an NFSv3 reply with file attributes is the biggest
+ */
+#define NFS_READ_HDR_MAX	((6 + 5 + NFS3_FATTR_WORDS) * 4)
+
+/*
+ * Number of READ requests kept in flight. Each one is tracked by its RPC
+ * id, so replies may arrive in any order.
+ */
+#ifdef CONFIG_NFS_READ_WINDOW
+#define NFS_READ_WINDOW CONFIG_NFS_READ_WINDOW
+#else
+#define NFS_READ_WINDOW 1
+#endif
+#define NFS_READ_WINDOW_MAX 16
+
 #define NFS_MAXLINKDEPTH 16
 
 struct rpc_t {
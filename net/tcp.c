@@ -0,0 +1,589 @@
+/*
+ * Minimal TCP client for the network boot protocols
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+/*
+ * One connection at a time, driven from NetLoop() like the UDP protocols.
+ * The client sends little (a request of at most one segment) and receives
+ * a lot, so the receive side is what matters:
+ *
+ * - segments are handed to the protocol as they arrive, which copies them
+ *   once, straight to their final place (normally the load buffer)
+ * - out-of-order segments are kept the same way and remembered in a small
+ *   range table, so a lost segment costs one retransmission and not the
+ *   whole window behind it
+ * - every out-of-order segment is answered at once with a duplicate ACK,
+ *   which makes the server retransmit the hole after three of them (fast
+ *   retransmit) without needing SACK
+ * - in-order data is acknowledged every second segment, on PSH, or after
+ *   TCP_DELACK_MS
+ * - window scaling lets the server keep TCP_WINDOW bytes in flight
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <net.h>
+#include <asm/unaligned.h>
+#include "tcp.h"
+
+#define TCP_TICK_MS		10	/* Timer resolution */
+#define TCP_DELACK_MS		20	/* Longest we hold back an ACK */
+#define TCP_RTO_INIT		500	/* First retransmission timeout */
+#define TCP_RTO_MAX		4000
+#define TCP_RETRIES		8
+#define TCP_IDLE_TIMEOUT	30000	/* Give up on a silent server */
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+};
+
+static enum tcp_state tcp_state;
+static tcp_rx_f *tcp_rx_handler;
+static tcp_event_f *tcp_event_handler;
+
+static IPaddr_t tcp_remote_ip;
+static uchar tcp_remote_ether[6];
+static unsigned tcp_remote_port;
+static unsigned tcp_local_port;
+
+/* Send side, in sequence numbers */
+static u32 tcp_iss;		/* Our initial sequence number */
+static u32 tcp_snd_una;		/* Oldest byte not acknowledged */
+static u32 tcp_snd_nxt;		/* Next byte to send */
+static uchar tcp_tx_buf[TCP_MSS];	/* Data from tcp_snd_una on */
+static unsigned tcp_tx_len;
+static int tcp_fin_sent;
+static unsigned tcp_peer_mss;
+static ulong tcp_rto;
+static ulong tcp_rtx_start;
+static int tcp_retries;
+
+/* Receive side, in stream offsets from the server's SYN */
+static u32 tcp_irs;		/* Server's initial sequence number */
+static u32 tcp_rcv_nxt;		/* Next offset expected in order */
+static u32 tcp_fin_off;		/* Offset of the server's FIN */
+static int tcp_fin_seen;
+static int tcp_fin_done;	/* All data before the FIN arrived */
+static int tcp_rcv_wscale;	/* Window scale we announced, if agreed */
+static int tcp_ack_pending;	/* Segments received but not acknowledged */
+static ulong tcp_ack_start;
+static ulong tcp_last_rx;
+
+/* Data taken out of order, sorted, not overlapping, all past tcp_rcv_nxt */
+static struct tcp_range {
+	u32 start;
+	u32 end;
+} tcp_ooo[TCP_OOO_MAX];
+static int tcp_ooo_count;
+
+static inline int tcp_before(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static inline int tcp_after(u32 a, u32 b)
+{
+	return (s32)(a - b) > 0;
+}
+
+/* One's complement sum in memory byte order, as NetCksum() does */
+static ulong tcp_sum(const void *ptr, unsigned len, ulong sum)
+{
+	const ushort *p = ptr;
+
+	while (len > 1) {
+		sum += *p++;
+		len -= 2;
+	}
+	if (len) {
+		ushort last = 0;
+
+		memcpy(&last, p, 1);
+		sum += last;
+	}
+
+	return sum;
+}
+
+static ushort tcp_cksum(IPaddr_t src, IPaddr_t dst, uchar *seg,
+			unsigned len)
+{
+	struct {
+		IPaddr_t src;
+		IPaddr_t dst;
+		uchar zero;
+		uchar proto;
+		ushort len;
+	} pseudo;
+	ulong sum;
+
+	pseudo.src = src;
+	pseudo.dst = dst;
+	pseudo.zero = 0;
+	pseudo.proto = IPPROTO_TCP;
+	pseudo.len = htons(len);
+
+	sum = tcp_sum(&pseudo, 12, 0);
+	sum = tcp_sum(seg, len, sum);
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return sum;
+}
+
+static unsigned tcp_window(void)
+{
+	unsigned win = TCP_WINDOW >> tcp_rcv_wscale;
+
+	return win > 0xffff ? 0xffff : win;
+}
+
+static void tcp_send_segment(uchar flags, u32 seq, const void *data,
+			     unsigned len)
+{
+	uchar *pkt = NetTxPacket;
+	struct ip_hdr *ip;
+	struct tcp_hdr *tcp;
+	unsigned hlen = TCP_HDR_SIZE;
+	int eth_hdr_size;
+
+	eth_hdr_size = NetSetEther(pkt, tcp_remote_ether, PROT_IP);
+	ip = (struct ip_hdr *)(pkt + eth_hdr_size);
+	tcp = (struct tcp_hdr *)((uchar *)ip + IP_HDR_SIZE);
+
+	if (flags & TCP_SYN) {
+		uchar *opt = (uchar *)tcp + TCP_HDR_SIZE;
+
+		/* Maximum segment size, then window scale */
+		opt[0] = 2;
+		opt[1] = 4;
+		opt[2] = TCP_MSS >> 8;
+		opt[3] = TCP_MSS & 0xff;
+		opt[4] = 1;
+		opt[5] = 3;
+		opt[6] = 3;
+		opt[7] = tcp_rcv_wscale;
+		hlen += 8;
+	}
+	if (len)
+		memcpy((uchar *)tcp + hlen, data, len);
+
+	tcp->tcp_src = htons(tcp_local_port);
+	tcp->tcp_dst = htons(tcp_remote_port);
+	put_unaligned_be32(seq, &tcp->tcp_seq);
+	put_unaligned_be32(flags & TCP_ACK ?
+			   tcp_irs + 1 + tcp_rcv_nxt + tcp_fin_done : 0,
+			   &tcp->tcp_ack);
+	tcp->tcp_hlen = (hlen / 4) << 4;
+	tcp->tcp_flags = flags;
+	/* The SYN window is never scaled */
+	tcp->tcp_win = htons(flags & TCP_SYN ? 0xffff : tcp_window());
+	tcp->tcp_xsum = 0;
+	tcp->tcp_urg = 0;
+	tcp->tcp_xsum = ~tcp_cksum(NetOurIP, tcp_remote_ip, (uchar *)tcp,
+				   hlen + len);
+
+	net_set_ip_header((uchar *)ip, tcp_remote_ip, NetOurIP);
+	ip->ip_len = htons(IP_HDR_SIZE + hlen + len);
+	ip->ip_p = IPPROTO_TCP;
+	ip->ip_sum = ~NetCksum((uchar *)ip, IP_HDR_SIZE >> 1);
+
+	if (flags & TCP_ACK)
+		tcp_ack_pending = 0;
+
+	net_send_ip_packet(tcp_remote_ether, tcp_remote_ip,
+			   eth_hdr_size + IP_HDR_SIZE + hlen + len);
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(TCP_ACK, tcp_snd_nxt, NULL, 0);
+}
+
+/* Send whatever is not acknowledged yet again */
+static void tcp_retransmit(void)
+{
+	uchar flags = TCP_ACK;
+
+	if (tcp_state == TCP_SYN_SENT) {
+		tcp_send_segment(TCP_SYN, tcp_iss, NULL, 0);
+		return;
+	}
+
+	if (tcp_tx_len)
+		flags |= TCP_PSH;
+	if (tcp_fin_sent)
+		flags |= TCP_FIN;
+	tcp_send_segment(flags, tcp_snd_una, tcp_tx_buf, tcp_tx_len);
+}
+
+static void tcp_finish(enum tcp_event event)
+{
+	tcp_state = TCP_CLOSED;
+	NetSetTimeout(0, NULL);
+	tcp_event_handler(event);
+}
+
+static void tcp_tick(void)
+{
+	ulong now = get_timer(0);
+
+	if (tcp_state == TCP_CLOSED)
+		return;
+
+	if (tcp_ack_pending && now - tcp_ack_start >= TCP_DELACK_MS)
+		tcp_send_ack();
+
+	if (tcp_snd_una != tcp_snd_nxt && now - tcp_rtx_start >= tcp_rto) {
+		if (++tcp_retries > TCP_RETRIES) {
+			tcp_finish(TCP_EV_TIMEOUT);
+			return;
+		}
+		tcp_rto = min(tcp_rto * 2, (ulong)TCP_RTO_MAX);
+		tcp_rtx_start = now;
+		tcp_retransmit();
+	}
+
+	if (now - tcp_last_rx >= TCP_IDLE_TIMEOUT) {
+		tcp_finish(TCP_EV_TIMEOUT);
+		return;
+	}
+
+	NetSetTimeout(TCP_TICK_MS, tcp_tick);
+}
+
+/* Pick up the options of the server's SYN we care about */
+static void tcp_parse_syn_options(uchar *opt, unsigned len)
+{
+	int wscale_ok = 0;
+
+	tcp_peer_mss = 536;
+	while (len > 0) {
+		unsigned olen;
+
+		if (opt[0] == 0)		/* End of options */
+			break;
+		if (opt[0] == 1) {		/* No-op */
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+		olen = opt[1];
+		if (opt[0] == 2 && olen == 4)
+			tcp_peer_mss = (opt[2] << 8) | opt[3];
+		else if (opt[0] == 3 && olen == 3)
+			wscale_ok = 1;
+		opt += olen;
+		len -= olen;
+	}
+
+	/* Our window is only scaled if the server scales too */
+	if (!wscale_ok)
+		tcp_rcv_wscale = 0;
+	if (tcp_peer_mss > TCP_MSS)
+		tcp_peer_mss = TCP_MSS;
+}
+
+static void tcp_process_ack(u32 ack)
+{
+	u32 acked;
+
+	/* Ignore duplicate and old ACKs, and ACKs for data never sent */
+	if (!tcp_after(ack, tcp_snd_una) || tcp_after(ack, tcp_snd_nxt))
+		return;
+
+	acked = ack - tcp_snd_una;
+
+	if (acked >= tcp_tx_len) {
+		tcp_tx_len = 0;
+	} else {
+		memmove(tcp_tx_buf, tcp_tx_buf + acked, tcp_tx_len - acked);
+		tcp_tx_len -= acked;
+	}
+	tcp_snd_una = ack;
+	tcp_retries = 0;
+	tcp_rto = TCP_RTO_INIT;
+	tcp_rtx_start = get_timer(0);
+}
+
+/*
+ * Find where [start, end) goes in the out-of-order table: *first is the
+ * first range it touches or the insertion point, *last is one past the
+ * last range it touches.
+ */
+static void tcp_ooo_find(u32 start, u32 end, int *first, int *last)
+{
+	int i, j;
+
+	for (i = 0; i < tcp_ooo_count; i++)
+		if (!tcp_before(tcp_ooo[i].end, start))
+			break;
+	for (j = i; j < tcp_ooo_count; j++)
+		if (tcp_after(tcp_ooo[j].start, end))
+			break;
+	*first = i;
+	*last = j;
+}
+
+static void tcp_ooo_add(u32 start, u32 end)
+{
+	int i, j;
+
+	tcp_ooo_find(start, end, &i, &j);
+	if (i == j) {
+		memmove(&tcp_ooo[i + 1], &tcp_ooo[i],
+			(tcp_ooo_count - i) * sizeof(*tcp_ooo));
+		tcp_ooo_count++;
+	} else {
+		/* Fold the ranges it touches into the first of them */
+		if (tcp_before(tcp_ooo[i].start, start))
+			start = tcp_ooo[i].start;
+		if (tcp_after(tcp_ooo[j - 1].end, end))
+			end = tcp_ooo[j - 1].end;
+		memmove(&tcp_ooo[i + 1], &tcp_ooo[j],
+			(tcp_ooo_count - j) * sizeof(*tcp_ooo));
+		tcp_ooo_count -= j - i - 1;
+	}
+	tcp_ooo[i].start = start;
+	tcp_ooo[i].end = end;
+}
+
+/* Move tcp_rcv_nxt past whatever was already received out of order */
+static void tcp_ooo_merge(void)
+{
+	int i;
+
+	for (i = 0; i < tcp_ooo_count; i++) {
+		if (tcp_after(tcp_ooo[i].start, tcp_rcv_nxt))
+			break;
+		if (tcp_after(tcp_ooo[i].end, tcp_rcv_nxt))
+			tcp_rcv_nxt = tcp_ooo[i].end;
+	}
+	memmove(&tcp_ooo[0], &tcp_ooo[i],
+		(tcp_ooo_count - i) * sizeof(*tcp_ooo));
+	tcp_ooo_count -= i;
+}
+
+/* Returns 1 if the data must be acknowledged right away */
+static int tcp_receive_data(u32 off, uchar *data, unsigned len,
+			    uchar flags)
+{
+	u32 old_nxt = tcp_rcv_nxt;
+	int i, j;
+
+	/* Drop what we already have; a pure duplicate means our ACK got lost */
+	if (tcp_before(off, tcp_rcv_nxt)) {
+		u32 skip = tcp_rcv_nxt - off;
+
+		if (skip >= len)
+			return 1;
+		off += skip;
+		data += skip;
+		len -= skip;
+	}
+	/* ...and anything past the window */
+	if (off - tcp_rcv_nxt >= TCP_WINDOW)
+		return 1;
+	if (len > TCP_WINDOW - (off - tcp_rcv_nxt))
+		len = TCP_WINDOW - (off - tcp_rcv_nxt);
+
+	if (off != tcp_rcv_nxt) {
+		/* Keep it if there is room to remember it */
+		tcp_ooo_find(off, off + len, &i, &j);
+		if (i == j && tcp_ooo_count == TCP_OOO_MAX)
+			return 1;
+		if (tcp_rx_handler(off, data, len) == 0)
+			tcp_ooo_add(off, off + len);
+		/* Duplicate ACK, so the server resends the hole */
+		return 1;
+	}
+
+	if (tcp_rx_handler(off, data, len))
+		return 1;
+	tcp_rcv_nxt += len;
+	if (tcp_ooo_count) {
+		tcp_ooo_merge();
+		if (tcp_rcv_nxt != old_nxt + len)
+			flags |= TCP_PSH;	/* A hole was filled */
+	}
+
+	if (!tcp_ack_pending++)
+		tcp_ack_start = get_timer(0);
+
+	return (flags & TCP_PSH) || tcp_ack_pending >= 2;
+}
+
+static void tcp_receive(uchar *pkt, IPaddr_t sip, IPaddr_t dip,
+			unsigned len)
+{
+	struct tcp_hdr *tcp = (struct tcp_hdr *)pkt;
+	unsigned hlen, dlen;
+	u32 seq, ack, nxt;
+	uchar flags;
+	int ack_now = 0;
+
+	if (tcp_state == TCP_CLOSED || len < TCP_HDR_SIZE)
+		return;
+	if (sip != tcp_remote_ip ||
+	    ntohs(tcp->tcp_src) != tcp_remote_port ||
+	    ntohs(tcp->tcp_dst) != tcp_local_port)
+		return;
+	if (tcp_cksum(sip, dip, pkt, len) != 0xffff) {
+		debug("TCP: bad checksum\n");
+		return;
+	}
+	hlen = (tcp->tcp_hlen >> 4) * 4;
+	if (hlen < TCP_HDR_SIZE || hlen > len)
+		return;
+
+	flags = tcp->tcp_flags;
+	seq = get_unaligned_be32(&tcp->tcp_seq);
+	ack = get_unaligned_be32(&tcp->tcp_ack);
+	tcp_last_rx = get_timer(0);
+
+	if (tcp_state == TCP_SYN_SENT) {
+		if (!(flags & TCP_ACK) || ack != tcp_snd_nxt)
+			return;
+		if (flags & TCP_RST) {
+			tcp_finish(TCP_EV_RESET);
+			return;
+		}
+		if (!(flags & TCP_SYN))
+			return;
+
+		tcp_irs = seq;
+		tcp_snd_una = ack;
+		tcp_parse_syn_options(pkt + TCP_HDR_SIZE, hlen - TCP_HDR_SIZE);
+		tcp_state = TCP_ESTABLISHED;
+		tcp_retries = 0;
+		tcp_rto = TCP_RTO_INIT;
+		tcp_send_ack();
+		tcp_event_handler(TCP_EV_CONNECTED);
+		return;
+	}
+
+	if (flags & TCP_RST) {
+		/* Only believe a reset which falls in our window */
+		if (seq - (tcp_irs + 1 + tcp_rcv_nxt) < TCP_WINDOW) {
+			tcp_finish(TCP_EV_RESET);
+			return;
+		}
+	}
+	if (!(flags & TCP_ACK))
+		return;
+	tcp_process_ack(ack);
+
+	/* A repeated SYN means the server did not get our ACK */
+	if (flags & TCP_SYN) {
+		tcp_send_ack();
+		return;
+	}
+
+	nxt = tcp_rcv_nxt;
+	dlen = len - hlen;
+	if (dlen)
+		ack_now = tcp_receive_data(seq - tcp_irs - 1, pkt + hlen,
+					   dlen, flags);
+	if (tcp_state == TCP_CLOSED)
+		return;
+
+	if (flags & TCP_FIN) {
+		tcp_fin_off = seq - tcp_irs - 1 + dlen;
+		tcp_fin_seen = 1;
+		ack_now = 1;
+	}
+	if (tcp_fin_seen && !tcp_fin_done && tcp_rcv_nxt == tcp_fin_off) {
+		/* Everything arrived: acknowledge the FIN with our own */
+		tcp_fin_done = 1;
+		if (!tcp_fin_sent) {
+			tcp_close();
+			ack_now = 0;
+		}
+	}
+	if (ack_now)
+		tcp_send_ack();
+
+	if (tcp_rcv_nxt != nxt)
+		tcp_event_handler(TCP_EV_DATA);
+	if (tcp_fin_done && tcp_state != TCP_CLOSED)
+		tcp_finish(TCP_EV_CLOSED);
+}
+
+void tcp_connect(IPaddr_t dest, unsigned dport, tcp_rx_f *rx,
+		 tcp_event_f *event)
+{
+	tcp_rx_handler = rx;
+	tcp_event_handler = event;
+	tcp_remote_ip = dest;
+	memset(tcp_remote_ether, 0, sizeof(tcp_remote_ether));
+	tcp_remote_port = dport;
+	tcp_local_port = random_port();
+
+	tcp_iss = (u32)get_ticks() ^ (tcp_local_port << 16);
+	tcp_snd_una = tcp_iss;
+	tcp_snd_nxt = tcp_iss + 1;
+	tcp_tx_len = 0;
+	tcp_fin_sent = 0;
+	tcp_peer_mss = TCP_MSS;
+	tcp_rto = TCP_RTO_INIT;
+	tcp_retries = 0;
+
+	tcp_irs = 0;
+	tcp_rcv_nxt = 0;
+	tcp_fin_seen = 0;
+	tcp_fin_done = 0;
+	tcp_ooo_count = 0;
+	tcp_ack_pending = 0;
+	tcp_rcv_wscale = 0;
+	while ((TCP_WINDOW >> tcp_rcv_wscale) > 0xffff && tcp_rcv_wscale < 14)
+		tcp_rcv_wscale++;
+
+	tcp_state = TCP_SYN_SENT;
+	net_set_tcp_handler(tcp_receive);
+	tcp_last_rx = get_timer(0);
+	tcp_rtx_start = tcp_last_rx;
+	tcp_send_segment(TCP_SYN, tcp_iss, NULL, 0);
+	NetSetTimeout(TCP_TICK_MS, tcp_tick);
+}
+
+int tcp_send(const void *data, unsigned len)
+{
+	if (tcp_state != TCP_ESTABLISHED || tcp_fin_sent)
+		return -ENOTCONN;
+	if (tcp_tx_len)
+		return -EBUSY;
+	if (len > tcp_peer_mss)
+		return -EMSGSIZE;
+
+	memcpy(tcp_tx_buf, data, len);
+	tcp_tx_len = len;
+	tcp_send_segment(TCP_PSH | TCP_ACK, tcp_snd_nxt, tcp_tx_buf, len);
+	if (tcp_snd_una == tcp_snd_nxt)
+		tcp_rtx_start = get_timer(0);
+	tcp_snd_nxt += len;
+
+	return 0;
+}
+
+u32 tcp_received(void)
+{
+	return tcp_rcv_nxt;
+}
+
+void tcp_close(void)
+{
+	if (tcp_state != TCP_ESTABLISHED || tcp_fin_sent)
+		return;
+
+	tcp_fin_sent = 1;
+	tcp_send_segment(TCP_FIN | TCP_ACK, tcp_snd_nxt, NULL, 0);
+	if (tcp_snd_una == tcp_snd_nxt)
+		tcp_rtx_start = get_timer(0);
+	tcp_snd_nxt++;
+}
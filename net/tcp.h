@@ -0,0 +1,108 @@
+/*
+ * Minimal TCP client for the network boot protocols
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+/*
+ *	TCP header, options follow when the header is longer than 20 bytes.
+ *	The sequence numbers are not aligned in a received frame, use
+ *	get_unaligned_be32() to read them.
+ */
+struct tcp_hdr {
+	ushort		tcp_src;	/* Source port			*/
+	ushort		tcp_dst;	/* Destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgement number	*/
+	uchar		tcp_hlen;	/* Header length, upper 4 bits	*/
+	uchar		tcp_flags;	/* Flags			*/
+	ushort		tcp_win;	/* Window			*/
+	ushort		tcp_xsum;	/* Checksum			*/
+	ushort		tcp_urg;	/* Urgent pointer		*/
+};
+
+#define TCP_HDR_SIZE	(sizeof(struct tcp_hdr))
+
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+
+/* Largest segment we send or ask for, an Ethernet frame's worth */
+#define TCP_MSS		(1500 - IP_HDR_SIZE - TCP_HDR_SIZE)
+
+/*
+ * Receive window offered to the server. Received data is copied straight
+ * to its final place by the protocol, so this only bounds how much the
+ * server may have in flight; window scaling is used above 64KiB.
+ */
+#ifdef CONFIG_NET_TCP_WINDOW
+#define TCP_WINDOW	CONFIG_NET_TCP_WINDOW
+#else
+#define TCP_WINDOW	(256 << 10)
+#endif
+
+/* Number of out-of-order byte ranges remembered while waiting for a hole */
+#define TCP_OOO_MAX	8
+
+enum tcp_event {
+	TCP_EV_CONNECTED,	/* Handshake done, tcp_send() may be used */
+	TCP_EV_DATA,		/* More in-order data, see tcp_received() */
+	TCP_EV_CLOSED,		/* Server sent FIN after all its data */
+	TCP_EV_RESET,		/* Server reset the connection */
+	TCP_EV_TIMEOUT,		/* Server stopped answering */
+};
+
+/**
+ * Data handler, called for each new piece of the server's byte stream.
+ * Pieces may arrive out of order, but never overlap what was already
+ * passed in order.
+ *
+ * @param offset	Stream offset of the first byte (0 is the first byte
+ *			the server sends)
+ * @param data		Segment payload
+ * @param len		Payload length
+ * @return 0 if the data was taken, -ve to drop it; the server will then
+ * send it again
+ */
+typedef int tcp_rx_f(u32 offset, uchar *data, unsigned len);
+
+/**
+ * Connection event handler
+ *
+ * @param event		What happened
+ */
+typedef void tcp_event_f(enum tcp_event event);
+
+/**
+ * Open a connection, reporting progress to the handlers from NetLoop()
+ *
+ * @param dest		Server IP address
+ * @param dport		Server TCP port
+ * @param rx		Data handler
+ * @param event		Event handler
+ */
+void tcp_connect(IPaddr_t dest, unsigned dport, tcp_rx_f *rx,
+		 tcp_event_f *event);
+
+/**
+ * Send data to the server. Only one segment may be outstanding.
+ *
+ * @param data		Data to send
+ * @param len		Length, at most one segment
+ * @return 0 if sent, -EBUSY if the previous data is not acknowledged yet,
+ * -EMSGSIZE if it does not fit a segment, -ENOTCONN if not connected
+ */
+int tcp_send(const void *data, unsigned len);
+
+/* Number of bytes of the server's stream received in order so far */
+u32 tcp_received(void);
+
+/* Send our FIN; the handlers stay active until NetLoop() ends */
+void tcp_close(void);
+
+#endif /* __TCP_H__ */
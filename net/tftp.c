@@ -9,6 +9,7 @@
 #include <common.h>
 #include <command.h>
 #include <net.h>
+#include <asm/io.h>
 #include "tftp.h"
 #include "bootp.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
@@ -130,6 +131,24 @@ static char tftp_filename[MAX_LEN];
 static unsigned short TftpBlkSize = TFTP_BLOCK_SIZE;
 static unsigned short TftpBlkSizeOption = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 windowsize: the server sends this many blocks before waiting for
+ * an ACK. 1 is the lock-step transfer of RFC 1350, in which case the option
+ * is not requested at all.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short TftpWindowSize = 1;
+static unsigned short TftpWindowSizeOption = TFTP_WINDOWSIZE;
+/* block number after which the next ACK is due */
+static ulong	TftpNextAck;
+/* last in-order block we re-ACKed after a loss, to ACK each loss once */
+static ulong	TftpLastNack;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -184,7 +203,10 @@ store_block(int block, uchar *src, unsigned len)
 	} else
 #endif /* CONFIG_SYS_DIRECT_FLASH_TFTP */
 	{
-		(void)memcpy((void *)(load_addr + offset), src, len);
+		void *ptr = map_sysmem(load_addr + offset, len);
+
+		memcpy(ptr, src, len);
+		unmap_sysmem(ptr);
 	}
 #ifdef CONFIG_MCAST_TFTP
 	if (Multicast)
@@ -201,6 +223,8 @@ static void new_transfer(void)
 	TftpLastBlock = 0;
 	TftpBlockWrap = 0;
 	TftpBlockWrapOffset = 0;
+	TftpNextAck = TftpWindowSize;
+	TftpLastNack = TFTP_SEQUENCE_SIZE;
 #ifdef CONFIG_CMD_TFTPPUT
 	TftpFinalBlock = 0;
 #endif
@@ -220,9 +244,12 @@ static int load_block(unsigned block, uchar *dst, unsigned len)
 	/* We may want to get the final block from the previous set */
 	ulong offset = ((int)block - 1) * len + TftpBlockWrapOffset;
 	ulong tosend = len;
+	void *ptr;
 
 	tosend = min(NetBootFileXferSize - offset, tosend);
-	(void)memcpy(dst, (void *)(save_addr + offset), tosend);
+	ptr = map_sysmem(save_addr + offset, tosend);
+	memcpy(dst, ptr, tosend);
+	unmap_sysmem(ptr);
 	debug("%s: block=%d, offset=%ld, len=%d, tosend=%ld\n", __func__,
 		block, offset, len, tosend);
 	return tosend;
@@ -361,6 +388,10 @@ TftpSend(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, TftpBlkSizeOption, 0);
+		/* and for several blocks per ACK */
+		if (TftpState == STATE_SEND_RRQ && TftpWindowSizeOption > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, TftpWindowSizeOption, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!ProhibitMcast) {
@@ -450,6 +481,7 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 {
 	__be16 proto;
 	__be16 *s;
+	int block;
 	int i;
 
 	if (dest != TftpOurPort) {
@@ -530,6 +562,15 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				debug("Blocksize ack: %s, %d\n",
 					(char *)pkt+i+8, TftpBlkSize);
 			}
+			if (strcmp((char *)pkt+i, "windowsize") == 0) {
+				TftpWindowSize = (unsigned short)
+					simple_strtoul((char *)pkt+i+11, NULL,
+						       10);
+				if (!TftpWindowSize)
+					TftpWindowSize = 1;
+				debug("Windowsize ack: %s, %d\n",
+					(char *)pkt+i+11, TftpWindowSize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				TftpTsize = simple_strtoul((char *)pkt+i+6,
@@ -558,7 +599,28 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		if (len < 2)
 			return;
 		len -= 2;
-		TftpBlock = ntohs(*(__be16 *)pkt);
+
+		/*
+		 * With a window of blocks in flight, only accept the next
+		 * block in sequence. After a loss, ACK the last block we got
+		 * in order (once) so the server resends the window from there.
+		 */
+		block = ntohs(*(__be16 *)pkt);
+		if (TftpState == STATE_DATA && TftpWindowSize > 1 &&
+		    block != (TftpLastBlock + 1) % TFTP_SEQUENCE_SIZE) {
+			debug("Unexpected block %d, expected %ld\n", block,
+			      (TftpLastBlock + 1) % TFTP_SEQUENCE_SIZE);
+			if (block != TftpLastBlock &&
+			    TftpLastNack != TftpLastBlock) {
+				TftpBlock = TftpLastBlock;
+				TftpSend();
+				TftpLastNack = TftpLastBlock;
+				TftpNextAck = (TftpLastBlock + TftpWindowSize) %
+					TFTP_SEQUENCE_SIZE;
+			}
+			break;
+		}
+		TftpBlock = block;
 
 		update_block_number();
 
@@ -627,19 +689,22 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				}
 				TftpLastBlock = TftpBlock;
 			}
-		}
-#endif
-		TftpSend();
-
-#ifdef CONFIG_MCAST_TFTP
-		if (Multicast) {
+			TftpSend();
 			if (MasterClient && (TftpBlock >= TftpEndingBlock)) {
 				puts("\nMulticast tftp done\n");
 				mcast_cleanup();
 				net_set_state(NETLOOP_SUCCESS);
 			}
-		} else
+			break;
+		}
 #endif
+		/* only the last block of each window is acknowledged */
+		if (len < TftpBlkSize || TftpBlock == TftpNextAck) {
+			TftpSend();
+			TftpNextAck = (TftpBlock + TftpWindowSize) %
+				TFTP_SEQUENCE_SIZE;
+		}
+
 		if (len < TftpBlkSize)
 			tftp_complete();
 		break;
@@ -683,6 +748,10 @@ TftpTimeout(void)
 		NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 		if (TftpState != STATE_RECV_WRQ)
 			TftpSend();
+		/* the server restarts its window after the ACK we just sent */
+		if (TftpState == STATE_DATA && !TftpWriting)
+			TftpNextAck = (TftpBlock + TftpWindowSize) %
+				TFTP_SEQUENCE_SIZE;
 	}
 }
 
@@ -703,6 +772,10 @@ void TftpStart(enum proto_t protocol)
 	if (ep != NULL)
 		TftpTimeoutMSecs = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		TftpWindowSizeOption = simple_strtol(ep, NULL, 10);
+
 	if (TftpTimeoutMSecs < 1000) {
 		printf("TFTP timeout (%ld ms) too low, "
 			"set minimum = 1000 ms\n",
@@ -710,8 +783,8 @@ void TftpStart(enum proto_t protocol)
 		TftpTimeoutMSecs = 1000;
 	}
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-		TftpBlkSizeOption, TftpTimeoutMSecs);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+		TftpBlkSizeOption, TftpWindowSizeOption, TftpTimeoutMSecs);
 
 	TftpRemoteIP = NetServerIP;
 	if (BootFile[0] == '\0') {
@@ -809,8 +882,9 @@ void TftpStart(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(NetServerEther, 0, 6);
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -839,8 +913,9 @@ TftpStartServer(void)
 	TftpTimeoutMSecs = TIMEOUT;
 	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 	TftpBlock = 0;
 	TftpOurPort = WELL_KNOWN_PORT;
 
@@ -0,0 +1,283 @@
+/*
+ * HTTP download over the minimal TCP client
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+/*
+ * Sends a single "GET" and stores the response body at load_addr. The
+ * body is copied from each received segment straight to its place in
+ * memory, including segments which arrive out of order, so there is no
+ * intermediate buffer. Only the response headers have to arrive in order.
+ * Chunked transfer encoding and redirects are not supported.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <net.h>
+#include <asm/io.h>
+#include "tcp.h"
+#include "wget.h"
+
+#define HASHES_PER_LINE	65
+#define HASH_BYTES	(64 << 10)	/* Bytes loaded per hash, no length */
+
+static IPaddr_t wget_server_ip;
+static unsigned wget_server_port;
+static char wget_path[128];
+
+static char wget_hdr[WGET_HDR_MAX + 1];
+static unsigned wget_hdr_len;		/* Header bytes collected so far */
+static int wget_hdr_done;
+static u32 wget_body_off;		/* Stream offset of the body */
+static ulong wget_content_len;
+static int wget_content_len_known;
+static int wget_done;
+
+static ulong wget_hashes;		/* Hashes printed so far */
+static ulong time_start;
+
+static void wget_fail(const char *msg)
+{
+	printf("\n%s\n", msg);
+	wget_done = 1;
+	tcp_close();
+	net_set_state(NETLOOP_FAIL);
+}
+
+/* Check the status line and pick up the headers we need */
+static int wget_parse_header(void)
+{
+	char *line, *next;
+	ulong status;
+
+	if (strncmp(wget_hdr, "HTTP/1.", 7) || !strchr(wget_hdr, ' ')) {
+		wget_fail("Not an HTTP response");
+		return -EINVAL;
+	}
+	status = simple_strtoul(strchr(wget_hdr, ' ') + 1, NULL, 10);
+	if (status != 200) {
+		*strchr(wget_hdr, '\r') = '\0';
+		printf("\nServer replied '%s'\n", wget_hdr);
+		wget_fail("Download failed");
+		return -ENOENT;
+	}
+
+	for (line = strstr(wget_hdr, "\r\n") + 2; *line; line = next + 2) {
+		next = strstr(line, "\r\n");
+		*next = '\0';
+		if (!strncasecmp(line, "Content-Length:", 15)) {
+			for (line += 15; *line == ' '; line++)
+				;
+			wget_content_len = simple_strtoul(line, NULL, 10);
+			wget_content_len_known = 1;
+		} else if (!strncasecmp(line, "Transfer-Encoding:", 18) &&
+			   strstr(line, "chunked")) {
+			wget_fail("Chunked transfer encoding not supported");
+			return -ENOSYS;
+		}
+	}
+
+	return 0;
+}
+
+static int wget_rx(u32 offset, uchar *data, unsigned len)
+{
+	ulong pos;
+	void *ptr;
+
+	if (wget_done)
+		return -EINVAL;
+
+	if (!wget_hdr_done) {
+		char *end;
+		unsigned n, skip;
+
+		/* Headers are parsed as they come, so they must be in order */
+		if (offset != wget_hdr_len)
+			return -EAGAIN;
+		n = min(len, (unsigned)(WGET_HDR_MAX - wget_hdr_len));
+		memcpy(wget_hdr + wget_hdr_len, data, n);
+		wget_hdr_len += n;
+		wget_hdr[wget_hdr_len] = '\0';
+
+		end = strstr(wget_hdr, "\r\n\r\n");
+		if (!end) {
+			if (wget_hdr_len == WGET_HDR_MAX)
+				wget_fail("HTTP response header too long");
+			return 0;
+		}
+		wget_body_off = end + 4 - wget_hdr;
+		end[2] = '\0';
+		if (wget_parse_header())
+			return 0;
+		wget_hdr_done = 1;
+
+		/* The rest of this segment is the start of the body */
+		skip = wget_body_off - offset;
+		offset += skip;
+		data += skip;
+		len -= skip;
+	}
+
+	pos = offset - wget_body_off;
+	if (wget_content_len_known) {
+		if (pos >= wget_content_len)
+			return 0;
+		if (len > wget_content_len - pos)
+			len = wget_content_len - pos;
+	}
+	if (!len)
+		return 0;
+
+	ptr = map_sysmem(load_addr + pos, len);
+	memcpy(ptr, data, len);
+	unmap_sysmem(ptr);
+
+	return 0;
+}
+
+/* Number of body bytes received in order */
+static ulong wget_body_received(void)
+{
+	ulong size;
+
+	if (!wget_hdr_done)
+		return 0;
+	size = tcp_received() - wget_body_off;
+	if (wget_content_len_known && size > wget_content_len)
+		size = wget_content_len;
+
+	return size;
+}
+
+static void show_progress(ulong size)
+{
+	if (wget_content_len_known) {
+		while (wget_content_len && wget_hashes < size * 50 /
+		       wget_content_len) {
+			putc('#');
+			wget_hashes++;
+		}
+		return;
+	}
+
+	while (wget_hashes < size / HASH_BYTES) {
+		putc('#');
+		if (++wget_hashes % HASHES_PER_LINE == 0)
+			puts("\n\t ");
+	}
+}
+
+static void wget_complete(void)
+{
+	NetBootFileXferSize = wget_body_received();
+	show_progress(NetBootFileXferSize);
+	puts("  ");
+	print_size(NetBootFileXferSize, "");
+
+	time_start = get_timer(time_start);
+	if (time_start > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(NetBootFileXferSize / time_start * 1000, "/s");
+	}
+	puts("\ndone\n");
+	wget_done = 1;
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+static void wget_send_request(void)
+{
+	char req[sizeof(wget_path) + 128];
+	int len;
+
+	len = sprintf(req, "GET %s HTTP/1.1\r\nHost: %pI4", wget_path,
+		      &wget_server_ip);
+	if (wget_server_port != WGET_PORT)
+		len += sprintf(req + len, ":%u", wget_server_port);
+	len += sprintf(req + len,
+		       "\r\nUser-Agent: U-Boot\r\nConnection: close\r\n\r\n");
+
+	if (tcp_send(req, len))
+		wget_fail("Cannot send HTTP request");
+}
+
+static void wget_event(enum tcp_event event)
+{
+	if (wget_done)
+		return;
+
+	switch (event) {
+	case TCP_EV_CONNECTED:
+		wget_send_request();
+		break;
+	case TCP_EV_DATA:
+		show_progress(wget_body_received());
+		/* The server may keep the connection open once done */
+		if (wget_content_len_known &&
+		    wget_body_received() == wget_content_len) {
+			tcp_close();
+			wget_complete();
+		}
+		break;
+	case TCP_EV_CLOSED:
+		if (!wget_hdr_done)
+			wget_fail("Connection closed without a response");
+		else if (wget_content_len_known &&
+			 wget_body_received() < wget_content_len)
+			wget_fail("Connection closed before the end of the file");
+		else
+			wget_complete();
+		break;
+	case TCP_EV_RESET:
+		wget_fail("Connection reset by server");
+		break;
+	case TCP_EV_TIMEOUT:
+		wget_fail("Server not responding");
+		break;
+	}
+}
+
+void wget_start(void)
+{
+	char *s, *p;
+
+	wget_server_ip = NetServerIP;
+	p = strchr(BootFile, ':');
+	if (p) {
+		wget_server_ip = string_to_ip(BootFile);
+		p++;
+	} else {
+		p = BootFile;
+	}
+	if (*p == '\0') {
+		puts("*** ERROR: no file name given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	snprintf(wget_path, sizeof(wget_path), "%s%s", *p == '/' ? "" : "/",
+		 p);
+
+	s = getenv("httpdstport");
+	wget_server_port = s ? simple_strtoul(s, NULL, 10) : WGET_PORT;
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4; our IP address is %pI4\n",
+	       &wget_server_ip, &NetOurIP);
+	printf("Filename '%s'.\n", wget_path);
+	printf("Load address: 0x%lx\n", load_addr);
+	puts("Loading: *\b");
+
+	wget_hdr_len = 0;
+	wget_hdr_done = 0;
+	wget_body_off = 0;
+	wget_content_len = 0;
+	wget_content_len_known = 0;
+	wget_done = 0;
+	wget_hashes = 0;
+	NetBootFileXferSize = 0;
+	time_start = get_timer(0);
+
+	tcp_connect(wget_server_ip, wget_server_port, wget_rx, wget_event);
+}
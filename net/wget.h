@@ -0,0 +1,17 @@
+/*
+ * HTTP download over the minimal TCP client
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+#define WGET_PORT	80	/* Default HTTP server port */
+
+/* Largest response header we accept */
+#define WGET_HDR_MAX	1024
+
+void wget_start(void);	/* Begin an HTTP download to load_addr */
+
+#endif /* __WGET_H__ */
@@ -0,0 +1,248 @@
+/*
+ * Correctness test and benchmark for the BCH library used for NAND ECC
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <linux/bch.h>
+
+#define TEST_MAX_ECC	64
+
+/* The codes used with NAND: m, t and the ECC step size in bytes */
+struct bch_test {
+	int m;
+	int t;
+	uint len;
+	/* ECC of fill_buffer(len) as produced by the original encoder */
+	uint8_t ecc[TEST_MAX_ECC];
+};
+
+static const struct bch_test bch_tests[] = {
+	{ 13, 4, 512, {
+		0x9e, 0xd3, 0x7f, 0xa3, 0x3b, 0xbe, 0x50 },
+	},
+	{ 13, 8, 512, {
+		0x50, 0xb0, 0x85, 0x32, 0xcc, 0x13, 0x74, 0xb8, 0x44, 0x41,
+		0x50, 0x51, 0xdd },
+	},
+	{ 14, 16, 1024, {
+		0xca, 0xa8, 0xb5, 0xd8, 0xbb, 0x37, 0xc8, 0xda, 0x69, 0x31,
+		0xb0, 0x40, 0xaa, 0x1a, 0x34, 0x6e, 0x00, 0x4d, 0x9c, 0x34,
+		0xc0, 0x71, 0x9d, 0xcd, 0x5f, 0x9f, 0x43, 0xff },
+	},
+	{ 14, 24, 1024, {
+		0x0d, 0x4e, 0x3e, 0x40, 0x78, 0x5c, 0x8e, 0x16, 0xa0, 0x29,
+		0x5e, 0x09, 0x6a, 0x71, 0x07, 0xb2, 0xe3, 0x7e, 0x3b, 0x49,
+		0x17, 0x51, 0xc1, 0x9e, 0xb6, 0xab, 0x99, 0x0c, 0xe4, 0x9c,
+		0xe2, 0x74, 0xb8, 0xa0, 0xc7, 0xa6, 0xf3, 0x38, 0x5f, 0x24,
+		0x5c, 0x3f },
+	},
+};
+
+static uint32_t seed;
+
+static uint32_t next_rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+
+	return seed >> 8;
+}
+
+static void fill_buffer(unsigned char *buf, uint len)
+{
+	seed = 0x12345678;
+	while (len--)
+		*buf++ = next_rand();
+}
+
+static void flip_bit(uint8_t *data, uint len, uint8_t *ecc, uint bit)
+{
+	if (bit < 8 * len)
+		data[bit / 8] ^= 1 << (bit % 8);
+	else
+		ecc[(bit - 8 * len) / 8] ^= 1 << (bit % 8);
+}
+
+#define errcheck(statement) if (!(statement)) { \
+	printf("\tFailed: %s (m %d, t %d)\n", #statement, test->m, test->t); \
+	ret = 1; \
+	goto out; \
+}
+
+static int run_test(const struct bch_test *test)
+{
+	struct bch_control *bch;
+	uint8_t *buf, *data, ecc[TEST_MAX_ECC], ecc2[TEST_MAX_ECC];
+	uint errloc[TEST_MAX_ECC], bits[TEST_MAX_ECC];
+	uint len = test->len, nbits, align, split, i;
+	int nerr, trial, n;
+	int ret = 0;
+
+	printf(" BCH m=%d t=%d, %u byte steps ...\n", test->m, test->t, len);
+
+	bch = init_bch(test->m, test->t, 0);
+	buf = malloc(len + 8);
+	if (!bch || !buf) {
+		printf("\tOut of memory\n");
+		free(buf);
+		if (bch)
+			free_bch(bch);
+		return 1;
+	}
+	nbits = 8 * len + bch->ecc_bits;
+
+	/* The known vector, at every alignment */
+	for (align = 0; align < 8; align++) {
+		data = buf + align;
+		fill_buffer(data, len);
+		memset(ecc, 0, sizeof(ecc));
+		encode_bch(bch, data, len, ecc);
+		errcheck(!memcmp(ecc, test->ecc, bch->ecc_bytes));
+	}
+
+	/* Encoding in pieces of any size gives the same result */
+	for (split = 1; split < len; split = split * 3 + 1) {
+		memset(ecc, 0, sizeof(ecc));
+		encode_bch(bch, data, split, ecc);
+		encode_bch(bch, data + split, len - split, ecc);
+		errcheck(!memcmp(ecc, test->ecc, bch->ecc_bytes));
+	}
+
+	/* Up to t errors anywhere in data and ECC are found */
+	seed = 1;
+	for (nerr = 0; nerr <= test->t; nerr++) {
+		for (trial = 0; trial < 20; trial++) {
+			fill_buffer(data, len);
+			memcpy(ecc, test->ecc, bch->ecc_bytes);
+			seed += trial * 7919 + nerr;
+			for (i = 0; i < nerr; i++) {
+				uint j;
+
+				do {
+					bits[i] = next_rand() % nbits;
+					for (j = 0; j < i; j++)
+						if (bits[j] == bits[i])
+							break;
+				} while (j < i);
+				flip_bit(data, len, ecc, bits[i]);
+			}
+
+			/* Received data and ECC */
+			n = decode_bch(bch, data, len, ecc, NULL, NULL, errloc);
+			errcheck(n == nerr);
+
+			/* ECC calculated by the caller, as nand_bch does */
+			memset(ecc2, 0, sizeof(ecc2));
+			encode_bch(bch, data, len, ecc2);
+			n = decode_bch(bch, NULL, len, ecc, ecc2, NULL, errloc);
+			errcheck(n == nerr);
+
+			for (i = 0; i < n; i++) {
+				if (errloc[i] < 8 * len)
+					data[errloc[i] / 8] ^= 1 << (errloc[i] % 8);
+				else
+					ecc[(errloc[i] - 8 * len) / 8] ^=
+						1 << (errloc[i] % 8);
+			}
+			errcheck(!memcmp(ecc, test->ecc, bch->ecc_bytes));
+			encode_bch(bch, data, len, memset(ecc2, 0, sizeof(ecc2)));
+			errcheck(!memcmp(ecc2, test->ecc, bch->ecc_bytes));
+		}
+	}
+
+out:
+	free(buf);
+	free_bch(bch);
+
+	return ret;
+}
+
+static int run_bench(const struct bch_test *test, uint size_mb)
+{
+	struct bch_control *bch;
+	uint size = size_mb << 20, len = test->len, off, i;
+	uint8_t *buf, *ecc;
+	uint errloc[TEST_MAX_ECC];
+	ulong start, msecs;
+	int ret = 1;
+
+	bch = init_bch(test->m, test->t, 0);
+	buf = malloc(size);
+	ecc = malloc((size / len) * TEST_MAX_ECC);
+	if (!bch || !buf || !ecc) {
+		printf("\tOut of memory\n");
+		goto out;
+	}
+	fill_buffer(buf, size);
+
+	/* Encoding, which nand_bch does for every step read or written */
+	start = get_timer(0);
+	for (off = 0; off < size; off += len) {
+		uint8_t *p = ecc + (off / len) * bch->ecc_bytes;
+
+		memset(p, 0, bch->ecc_bytes);
+		encode_bch(bch, buf + off, len, p);
+	}
+	msecs = max(get_timer(start), 1UL);
+	printf(" BCH m=%d t=%d encode: %u MiB in %lu ms, %lu MiB/s\n",
+	       test->m, test->t, size_mb, msecs, size_mb * 1000 / msecs);
+
+	/* Decoding steps with t/2 bit errors each, a worn-out page */
+	seed = 1;
+	for (off = 0; off < size; off += len)
+		for (i = 0; i < test->t / 2; i++)
+			buf[off + next_rand() % len] ^= 1 << (next_rand() % 8);
+	start = get_timer(0);
+	for (off = 0; off < size; off += len) {
+		uint8_t *p = ecc + (off / len) * bch->ecc_bytes;
+
+		if (decode_bch(bch, buf + off, len, p, NULL, NULL, errloc) < 0) {
+			printf("\tdecode failed at offset %#x\n", off);
+			goto out;
+		}
+	}
+	msecs = max(get_timer(start), 1UL);
+	printf(" BCH m=%d t=%d decode (%d errors per step): %lu MiB/s\n",
+	       test->m, test->t, test->t / 2, size_mb * 1000 / msecs);
+	ret = 0;
+
+out:
+	free(ecc);
+	free(buf);
+	if (bch)
+		free_bch(bch);
+
+	return ret;
+}
+
+static int do_test_bch(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char * const argv[])
+{
+	uint size_mb = 4;
+	int err = 0, i;
+
+	if (argc > 1)
+		size_mb = simple_strtoul(argv[1], NULL, 10);
+
+	for (i = 0; i < ARRAY_SIZE(bch_tests) && !err; i++)
+		err = run_test(&bch_tests[i]);
+	for (i = 0; i < ARRAY_SIZE(bch_tests) && !err && size_mb; i++)
+		err = run_bench(&bch_tests[i], size_mb);
+
+	printf("test_bch %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err;
+}
+
+U_BOOT_CMD(
+	test_bch,	2,	1,	do_test_bch,
+	"Check and benchmark BCH encoding and decoding",
+	"[size_mb]\n"
+	"    - check the BCH codes used for NAND ECC against known vectors and\n"
+	"      with injected bit errors, then time them on size_mb MiB\n"
+	"      (default 4, 0 to skip)"
+);
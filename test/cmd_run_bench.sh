@@ -0,0 +1,43 @@
+#!/bin/sh
+
+# Benchmark for scripted boots: a boot script which calls the same
+# environment variables with 'run' over and over from loops, timed with the
+# 'time' command. Pass a sandbox u-boot binary to skip the build.
+
+BASE="$(dirname $0)"
+. $BASE/common.sh
+
+UBOOT=$1
+
+run_test() {
+	${UBOOT} <<'END'
+setenv ctrlc_ignore y
+setenv bootpart 2
+setenv n
+setenv set_args 'setenv bootargs console=ttyS0,115200 root=/dev/mmcblk0p${bootpart} rw ${extra}'
+setenv check_part 'if test -n "${bootpart}" && test ${bootpart} -gt 0; then setenv found 1; else setenv found 0; fi'
+setenv try_part 'run check_part; if test ${found} = 1; then run set_args; else echo none; fi; setenv n ${n}.'
+setenv scan 'for dev in 0 1 2 3 4 5 6 7 8 9; do run try_part; done'
+setenv boot_all 'for i in 0 1 2 3 4 5 6 7 8 9; do run scan; done'
+time run boot_all boot_all boot_all boot_all boot_all boot_all boot_all boot_all boot_all boot_all
+printenv n
+reset
+END
+}
+
+check_results() {
+	grep -q "n=\.\{1000\}" ${tmp} || fail "Script did not run 1000 times"
+	grep "time:" ${tmp}
+}
+
+echo "Benchmark repeated 'run' of hush scripts"
+echo
+tmp="$(tempfile)"
+if [ -z "${UBOOT}" ]; then
+	build_uboot
+	UBOOT=./${OUTPUT_DIR}/u-boot
+fi
+run_test >${tmp}
+check_results ${tmp}
+rm ${tmp}
+echo "Test passed"
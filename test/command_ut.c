@@ -66,6 +66,33 @@ static int do_ut_cmd(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	assert(run_command_list("false", -1, 0) == 1);
 	assert(run_command_list("echo", -1, 0) == 0);
 
+	/* command lookup by name, abbreviation and with a size suffix */
+	assert(find_cmd("?") && !strcmp(find_cmd("?")->name, "?"));
+	assert(find_cmd("setenv") && !strcmp(find_cmd("setenv")->name,
+					       "setenv"));
+	assert(find_cmd("md.b") == find_cmd("md"));
+	assert(!find_cmd("s"));
+	assert(!find_cmd("no_such_command"));
+
+#ifdef CONFIG_CMD_RUN
+	/* running a variable again, also after it has changed */
+	run_command("setenv list; setenv script setenv list \\${list}1", 0);
+	run_command("run script; run script", 0);
+	assert(!strcmp("11", getenv("list")));
+	setenv("script", "setenv list ${list}2");
+	run_command("run script", 0);
+	assert(!strcmp("112", getenv("list")));
+#ifdef CONFIG_SYS_HUSH_PARSER
+	/* a for loop left with exit runs from the start next time */
+	run_command("setenv list; setenv script 'for i in 1 2 3; do "
+		    "setenv list ${list}${i}; if test $i = 2; then exit; fi; "
+		    "done'", 0);
+	run_command("run script; run script", 0);
+	assert(!strcmp("1212", getenv("list")));
+#endif
+	setenv("script", NULL);
+#endif
+
 #ifdef CONFIG_SYS_HUSH_PARSER
 	/* Test the 'test' command */
 
@@ -8,6 +8,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <decompress.h>
 #include <malloc.h>
 
 #include <u-boot/zlib.h>
@@ -224,6 +225,57 @@ static int uncompress_using_lzo(void *in, unsigned long in_size,
 	return (ret != LZO_E_OK);
 }
 
+#ifdef CONFIG_DECOMP_STREAM
+/* Feed the input in small odd-sized pieces, to hit every boundary case */
+#define STREAM_PIECE_SIZE	7
+
+static int uncompress_using_stream(int comp, void *in, unsigned long in_size,
+				   void *out, unsigned long out_max,
+				   unsigned long *out_size)
+{
+	struct decomp_stream ds;
+	unsigned long pos, len;
+	int ret;
+
+	ret = decomp_stream_init(&ds, comp, out, out_max);
+	if (ret)
+		return ret;
+	for (pos = 0, ret = 0; !ret && pos < in_size; pos += len) {
+		len = min(in_size - pos, (unsigned long)STREAM_PIECE_SIZE);
+		ret = decomp_stream_feed(&ds, in + pos, len);
+	}
+	if (out_size)
+		*out_size = ds.out_len;
+	decomp_stream_end(&ds);
+
+	return ret == 1 ? 0 : -1;
+}
+
+static int uncompress_using_gzip_stream(void *in, unsigned long in_size,
+					void *out, unsigned long out_max,
+					unsigned long *out_size)
+{
+	return uncompress_using_stream(IH_COMP_GZIP, in, in_size, out, out_max,
+				       out_size);
+}
+
+static int uncompress_using_lzma_stream(void *in, unsigned long in_size,
+					void *out, unsigned long out_max,
+					unsigned long *out_size)
+{
+	return uncompress_using_stream(IH_COMP_LZMA, in, in_size, out, out_max,
+				       out_size);
+}
+
+static int uncompress_using_lzo_stream(void *in, unsigned long in_size,
+				       void *out, unsigned long out_max,
+				       unsigned long *out_size)
+{
+	return uncompress_using_stream(IH_COMP_LZO, in, in_size, out, out_max,
+				       out_size);
+}
+#endif
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -323,6 +375,14 @@ static int do_test_compression(cmd_tbl_t *cmdtp, int flag, int argc,
 	err += run_test("bzip2", compress_using_bzip2, uncompress_using_bzip2);
 	err += run_test("lzma", compress_using_lzma, uncompress_using_lzma);
 	err += run_test("lzo", compress_using_lzo, uncompress_using_lzo);
+#ifdef CONFIG_DECOMP_STREAM
+	err += run_test("gzip stream", compress_using_gzip,
+			uncompress_using_gzip_stream);
+	err += run_test("lzma stream", compress_using_lzma,
+			uncompress_using_lzma_stream);
+	err += run_test("lzo stream", compress_using_lzo,
+			uncompress_using_lzo_stream);
+#endif
 
 	printf("test_compression %s\n", err == 0 ? "ok" : "FAILED");
 
@@ -0,0 +1,159 @@
+/*
+ * Correctness test and benchmark for crc32
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <u-boot/crc.h>
+
+#define TEST_BUFFER_SIZE	4096
+#define TEST_MAX_ALIGN		8
+#define TEST_MAX_LEN		300
+
+#if defined(CONFIG_ARM64_CRC32)
+#define CRC32_IMPL	"ARMv8 instructions"
+#elif defined(CONFIG_CRC32_SLICE_BY_8)
+#define CRC32_IMPL	"slice-by-8"
+#else
+#define CRC32_IMPL	"byte at a time"
+#endif
+
+/* Bit at a time CRC32 to check the table-driven versions against */
+static uint32_t crc32_ref(uint32_t crc, const unsigned char *buf, uint len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+	}
+
+	return crc;
+}
+
+static void fill_buffer(unsigned char *buf, uint len)
+{
+	uint32_t seed = 0x12345678;
+
+	while (len--) {
+		seed = seed * 1103515245 + 12345;
+		*buf++ = seed >> 16;
+	}
+}
+
+#define errcheck(statement) if (!(statement)) { \
+	printf("\tFailed: %s (align %d, len %d)\n", #statement, align, len); \
+	ret = 1; \
+	goto out; \
+}
+
+static int run_test(void)
+{
+	static const unsigned char check[] = "123456789";
+	unsigned char *buf;
+	uint32_t crc, ref;
+	int align = 0, len = 0, split;
+	int ret;
+
+	printf(" testing %s ...\n", CRC32_IMPL);
+
+	buf = malloc(TEST_BUFFER_SIZE);
+	if (!buf) {
+		printf("\tOut of memory\n");
+		return 1;
+	}
+	fill_buffer(buf, TEST_BUFFER_SIZE);
+
+	/* The standard check value */
+	errcheck(crc32(0, check, 9) == 0xcbf43926);
+	errcheck(crc32_no_comp(~0, check, 9) == ~0xcbf43926);
+
+	/* Every alignment and all short lengths, which hit each tail case */
+	for (align = 0; align < TEST_MAX_ALIGN; align++) {
+		for (len = 0; len <= TEST_MAX_LEN; len++) {
+			ref = crc32_ref(0x5a5a5a5a, buf + align, len);
+			errcheck(crc32_no_comp(0x5a5a5a5a, buf + align, len) ==
+				 ref);
+			ref = ~crc32_ref(~0x1234, buf + align, len);
+			errcheck(crc32(0x1234, buf + align, len) == ref);
+		}
+	}
+
+	/* Calculating in pieces gives the same result */
+	align = 0;
+	len = TEST_BUFFER_SIZE;
+	ref = crc32(0, buf, len);
+	for (split = 1; split < len; split = split * 3 + 1) {
+		crc = crc32(0, buf, split);
+		crc = crc32(crc, buf + split, len - split);
+		errcheck(crc == ref);
+	}
+	errcheck(crc32_wd(0, buf, len, 7) == ref);
+
+	/* Got here, everything is fine. */
+	ret = 0;
+
+out:
+	printf(" %s: %s\n", CRC32_IMPL, ret == 0 ? "ok" : "FAILED");
+	free(buf);
+
+	return ret;
+}
+
+static int run_bench(uint size_mb)
+{
+	uint size = size_mb << 20;
+	unsigned char *buf;
+	ulong start, msecs;
+	uint32_t crc = 0;
+	int i;
+
+	buf = malloc(size);
+	if (!buf) {
+		printf("\tOut of memory\n");
+		return 1;
+	}
+	fill_buffer(buf, size);
+
+	/* Once to warm the cache and page in the buffer */
+	crc32(0, buf, size);
+	start = get_timer(0);
+	for (i = 0; i < 8; i++)
+		crc = crc32(crc, buf, size);
+	msecs = max(get_timer(start), 1UL);
+	printf(" %s: 8 x %u MiB in %lu ms, %lu MiB/s\n", CRC32_IMPL, size_mb,
+	       msecs, 8 * size_mb * 1000 / msecs);
+	free(buf);
+
+	return 0;
+}
+
+static int do_test_crc32(cmd_tbl_t *cmdtp, int flag, int argc,
+			 char * const argv[])
+{
+	uint size_mb = 4;
+	int err;
+
+	if (argc > 1)
+		size_mb = simple_strtoul(argv[1], NULL, 10);
+
+	err = run_test();
+	if (!err && size_mb)
+		err = run_bench(size_mb);
+
+	printf("test_crc32 %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err;
+}
+
+U_BOOT_CMD(
+	test_crc32,	2,	1,	do_test_crc32,
+	"Check and benchmark crc32",
+	"[size_mb]\n"
+	"    - check crc32 against a reference, then time it on size_mb MiB\n"
+	"      (default 4, 0 to skip)"
+);
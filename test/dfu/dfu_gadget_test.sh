@@ -35,6 +35,19 @@ die () {
 	exit 1
 }
 
+TX_BYTES=0
+TX_MS=0
+
+# Print the download rate of file $1 which took from $2 to $3 (ns)
+print_rate () {
+    SIZE=`stat -c %s $1`
+    MS=$(( ($3 - $2) / 1000000 ))
+    [ $MS -gt 0 ] || MS=1
+    echo "TX: $SIZE bytes in $MS ms, $(( SIZE * 1000 / 1024 / MS )) KiB/s"
+    TX_BYTES=$(( TX_BYTES + SIZE ))
+    TX_MS=$(( TX_MS + MS ))
+}
+
 calculate_md5sum () {
     MD5SUM=`md5sum $1`
     MD5SUM=`echo $MD5SUM | cut -d ' ' -f1`
@@ -45,7 +58,9 @@ dfu_test_file () {
     printf "$COLOUR_GREEN ========================================================================================= $COLOUR_DEFAULT\n"
     printf "File:$COLOUR_GREEN %s $COLOUR_DEFAULT\n" $1
 
+    START=`date +%s%N`
     dfu-util -D $1 -a $TARGET_ALT_SETTING >> $LOG_FILE 2>&1 || die $?
+    print_rate $1 $START `date +%s%N`
 
     echo -n "TX: "
     calculate_md5sum $1
@@ -99,6 +114,12 @@ else
 	done
 fi
 
+if [ $TX_MS -gt 0 ]; then
+    printf "$COLOUR_GREEN========================================================================================= $COLOUR_DEFAULT\n"
+    echo "Downloads: $TX_BYTES bytes in $TX_MS ms," \
+	 "$(( TX_BYTES * 1000 / 1024 / TX_MS )) KiB/s"
+fi
+
 cleanup
 
 exit 0
@@ -587,12 +587,16 @@ DM_TEST(dm_test_pre_reloc, 0);
 
 static int dm_test_uclass_before_ready(struct dm_test_state *dms)
 {
+	struct global_data gd_backup;
 	struct uclass *uc;
 
 	ut_assertok(uclass_get(UCLASS_TEST, &uc));
 
+	/* Put gd back afterwards, since malloc() and the console need it */
+	gd_backup = *gd;
 	memset(gd, '\0', sizeof(*gd));
 	ut_asserteq_ptr(NULL, uclass_find(UCLASS_TEST));
+	*gd = gd_backup;
 
 	return 0;
 }
@@ -41,3 +41,24 @@ static int dm_test_spi_flash(struct dm_test_state *dms)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test that a flash wired for quad I/O is read and written that way */
+static int dm_test_spi_flash_quad(struct dm_test_state *dms)
+{
+	struct spi_flash *flash;
+	struct udevice *dev;
+
+	ut_assertok(spi_flash_probe_bus_cs(0, 2, 1000000, 0, &dev));
+	flash = dev->uclass_priv;
+	ut_asserteq(0xeb, flash->read_cmd);	/* quad I/O fast read */
+	ut_asserteq(0x32, flash->write_cmd);	/* quad page program */
+
+	ut_asserteq(0, run_command_list(
+		"sb save hostfs - spi.bin 0 200000;"
+		"sf probe 2;"
+		"sf test 0 10000", -1,  0));
+	sandbox_sf_unbind_emul(state_get_current(), 0, 2);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_quad, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -258,3 +258,100 @@ static int dm_test_fdt_offset(struct dm_test_state *dms)
 	return 0;
 }
 DM_TEST(dm_test_fdt_offset, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/*
+ * Create a device tree with @num_nodes top-level nodes. Every fourth one is
+ * for testfdt_drv, through the second string of its compatible list; the
+ * others match no driver. As in real trees, /aliases comes first.
+ */
+static void *dm_test_create_big_fdt(int num_nodes)
+{
+	const int size = num_nodes * 96 + 256;
+	char compat[64];
+	char name[20];
+	void *blob;
+	int len;
+	int i;
+
+	blob = malloc(size);
+	if (!blob || fdt_create(blob, size) ||
+	    fdt_finish_reservemap(blob) || fdt_begin_node(blob, "") ||
+	    fdt_begin_node(blob, "aliases") ||
+	    fdt_property_string(blob, "testfdt1", "/node@4") ||
+	    fdt_end_node(blob))
+		goto err;
+	for (i = 0; i < num_nodes; i++) {
+		snprintf(name, sizeof(name), "node@%d", i);
+		len = snprintf(compat, sizeof(compat), "vendor,dev%d", i) + 1;
+		if (!(i % 4)) {
+			strcpy(compat + len, "google,another-fdt-test");
+			len += strlen(compat + len) + 1;
+		}
+		if (fdt_begin_node(blob, name) ||
+		    fdt_property(blob, "compatible", compat, len) ||
+		    fdt_end_node(blob))
+			goto err;
+	}
+	if (fdt_end_node(blob) || fdt_finish(blob))
+		goto err;
+
+	return blob;
+err:
+	free(blob);
+	return NULL;
+}
+
+/* Bind all nodes of @blob, returning the time taken in @timep */
+static int dm_test_bind_big_fdt(struct dm_test_state *dms, const void *blob,
+				int num_nodes, ulong *timep)
+{
+	const void *fdt_blob = gd->fdt_blob;
+	struct uclass *uc;
+	ulong start;
+	int ret;
+
+	/* device_bind() reads the device tree from gd->fdt_blob */
+	gd->fdt_blob = blob;
+	start = timer_get_us();
+	ret = dm_scan_fdt(blob, false);
+	*timep = timer_get_us() - start;
+	gd->fdt_blob = fdt_blob;
+	ut_assertok(ret);
+
+	ut_assertok(uclass_get(UCLASS_TEST_FDT, &uc));
+	ut_asserteq(num_nodes / 4, list_count_items(&uc->dev_head));
+
+	/* Device names point into the blob, so unbind before it goes away */
+	ut_assertok(uclass_destroy(uc));
+
+	return 0;
+}
+
+/* Test binding a large device tree, with and without the driver index */
+static int dm_test_fdt_bind_many(struct dm_test_state *dms)
+{
+	struct dm_compat_index *idx = gd->dm_compat;
+	const int num_nodes = 4000;
+	ulong index_time, scan_time;
+	void *blob;
+	int ret;
+
+	blob = dm_test_create_big_fdt(num_nodes);
+	ut_assert(blob);
+
+	ut_assert(idx);
+	ret = dm_test_bind_big_fdt(dms, blob, num_nodes, &index_time);
+	if (!ret) {
+		gd->dm_compat = NULL;
+		ret = dm_test_bind_big_fdt(dms, blob, num_nodes, &scan_time);
+		gd->dm_compat = idx;
+	}
+	free(blob);
+	ut_assertok(ret);
+
+	printf("Bound %d nodes in %lu us with driver index, %lu us without\n",
+	       num_nodes, index_time, scan_time);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_bind_many, 0);
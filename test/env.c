@@ -0,0 +1,197 @@
+/*
+ * Correctness test and benchmark for the environment hash table
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <search.h>
+
+#define TEST_VAL_MAX	64
+
+/* Variable i in the test environment, in key order */
+static int make_var(char *buf, uint i, int sep)
+{
+	return sprintf(buf, "var%05u=value %u %.*s%c", i, i * 7,
+		       (int)(i % TEST_VAL_MAX), "................................"
+		       "................................", sep);
+}
+
+/* The test environment with the variables in key order or shuffled */
+static char *make_env(uint count, int shuffle, size_t *sizep)
+{
+	char *env, *p;
+	uint i;
+
+	env = malloc(count * (TEST_VAL_MAX + 32) + 1);
+	if (!env)
+		return NULL;
+
+	for (i = 0, p = env; i < count; i++)
+		p += make_var(p, shuffle ? (i * 7919) % count : i, '\n');
+	*p = '\0';
+	*sizep = p - env;
+
+	return env;
+}
+
+static ulong time_since(ulong start)
+{
+	return max(timer_get_us() - start, 1UL);
+}
+
+#define errcheck(statement) if (!(statement)) { \
+	printf("\tFailed: %s\n", #statement); \
+	ret = 1; \
+	goto out; \
+}
+
+static int run_test(uint count)
+{
+	struct hsearch_data htab = { };
+	static const char * const values[] = {
+		"1", "0x81000000", "console=ttyS0,115200 root=/dev/mmcblk0p2 rw",
+		"", "run load_kernel; run load_fdt; bootz ${kernel_addr_r} - "
+		"${fdt_addr_r}",
+	};
+	char *sorted, *shuffled, *names, *res = NULL;
+	char name[16], val[TEST_VAL_MAX + 32];
+	size_t size, half;
+	ENTRY e, *ep;
+	ulong start;
+	int ret = 0;
+	uint i;
+
+	printf(" %u variables\n", count);
+	sorted = make_env(count, 0, &size);
+	shuffled = make_env(count, 1, &size);
+	names = malloc(count * 16);
+	errcheck(sorted && shuffled && names);
+
+	/* Import in any order, export in key order */
+	start = timer_get_us();
+	errcheck(himport_r(&htab, shuffled, size, '\n', 0, 0, 0, NULL));
+	printf(" import (shuffled): %lu us\n", time_since(start));
+	hdestroy_r(&htab);
+
+	start = timer_get_us();
+	errcheck(himport_r(&htab, sorted, size, '\n', 0, 0, 0, NULL));
+	printf(" import (sorted):   %lu us\n", time_since(start));
+	errcheck(htab.filled == count);
+
+	start = timer_get_us();
+	errcheck(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	printf(" export:            %lu us\n", time_since(start));
+	errcheck(!strcmp(res, sorted));
+
+	/* Look up every variable, in a different order than inserted */
+	for (i = 0; i < count; i++)
+		sprintf(names + i * 16, "var%05u", (i * 7919) % count);
+	start = timer_get_us();
+	for (i = 0; i < count; i++) {
+		e.key = names + i * 16;
+		e.data = NULL;
+		errcheck(hsearch_r(e, FIND, &ep, &htab, 0));
+	}
+	printf(" lookup:            %lu ns each\n",
+	       time_since(start) * 1000 / count);
+	for (i = 0; i < count; i++) {
+		e.key = names + i * 16;
+		errcheck(hsearch_r(e, FIND, &ep, &htab, 0));
+		make_var(val, (i * 7919) % count, '\0');
+		errcheck(!strcmp(ep->data, val + 9));
+	}
+	e.key = "var";
+	errcheck(!hsearch_r(e, FIND, &ep, &htab, 0));
+
+	/* Variables set again out of order are merged back into key order */
+	for (i = 0; i < count; i += 3) {
+		sprintf(name, "var%05u", i);
+		errcheck(hdelete_r(name, &htab, 0));
+	}
+	for (i = 0; i < count; i += 3) {
+		sprintf(name, "var%05u", (count - 1) / 3 * 3 - i);
+		make_var(val, (count - 1) / 3 * 3 - i, '\0');
+		e.key = name;
+		e.data = val + 9;
+		errcheck(hsearch_r(e, ENTER, &ep, &htab, 0));
+	}
+	free(res);
+	res = NULL;
+	errcheck(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	errcheck(!strcmp(res, sorted));
+
+	/* Scripts which set variables in loops, to values of any length */
+	start = timer_get_us();
+	for (i = 0; i < 10 * count; i++) {
+		e.key = names + (i % count) * 16;
+		e.data = (char *)values[i % ARRAY_SIZE(values)];
+		errcheck(hsearch_r(e, ENTER, &ep, &htab, 0));
+	}
+	printf(" overwrite:         %lu ns each\n",
+	       time_since(start) * 100 / count);
+
+	/* Importing the old environment again puts back all of it */
+	start = timer_get_us();
+	errcheck(himport_r(&htab, sorted, size, '\n', 0, 0, 0, NULL));
+	printf(" import (changed):  %lu us\n", time_since(start));
+	start = timer_get_us();
+	errcheck(himport_r(&htab, sorted, size, '\n', 0, 0, 0, NULL));
+	printf(" import (same):     %lu us\n", time_since(start));
+	free(res);
+	res = NULL;
+	errcheck(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	errcheck(!strcmp(res, sorted));
+
+	/* ...and nothing else */
+	for (i = 0; i < count; i += 2) {
+		sprintf(name, "var%05u", i);
+		errcheck(hdelete_r(name, &htab, 0));
+	}
+	e.key = "extra";
+	e.data = "1";
+	errcheck(hsearch_r(e, ENTER, &ep, &htab, 0));
+	half = strchr(sorted + size / 2, '\n') + 1 - sorted;
+	errcheck(himport_r(&htab, sorted, half, '\n', 0, 0, 0, NULL));
+	free(res);
+	res = NULL;
+	errcheck(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	errcheck(strlen(res) == half && !strncmp(res, sorted, half));
+	e.key = "extra";
+	errcheck(!hsearch_r(e, FIND, &ep, &htab, 0));
+
+out:
+	hdestroy_r(&htab);
+	free(res);
+	free(names);
+	free(shuffled);
+	free(sorted);
+
+	return ret;
+}
+
+static int do_test_env(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char * const argv[])
+{
+	uint count = 5000;
+	int err;
+
+	if (argc > 1)
+		count = simple_strtoul(argv[1], NULL, 10);
+
+	err = run_test(count);
+
+	printf("test_env %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err;
+}
+
+U_BOOT_CMD(
+	test_env,	2,	1,	do_test_env,
+	"Check and benchmark the environment hash table",
+	"[count]\n"
+	"    - import, export, look up and overwrite count variables\n"
+	"      (default 5000) in a table of their own and time it"
+);
@@ -0,0 +1,111 @@
+#!/usr/bin/python
+#
+# saveenv test using an environment on the sandbox emulated eMMC card
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# saveenv only writes the blocks which differ from what is on the card. This
+# checks that nothing is written when the stored copy is already current,
+# and that the environment is written again after the stored copy has been
+# overwritten behind saveenv's back, in full or in one block. After each
+# save the stored copy is read back and compared with 'env export -c'.
+#
+# To run this:
+#
+# make O=sandbox sandbox_defconfig
+# echo 'CONFIG_SYS_EXTRA_OPTIONS="SANDBOX_ENV_IN_MMC"' >> sandbox/.config
+# make O=sandbox oldconfig
+# make O=sandbox
+# ./test/env/test-env-save.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import os
+import re
+import subprocess
+import sys
+
+ENV_BLOCK = 0x800
+ENV_SIZE = 0x2000
+BLOCK_SIZE = 512
+READ_ADDR = 0x1000000
+EXPORT_ADDR = 0x2000000
+PATTERN_ADDR = 0x3000000
+
+def run_u_boot(u_boot, cmds):
+    proc = subprocess.Popen([u_boot, '-c', '; '.join(cmds)],
+                            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    return out.decode('utf-8', 'replace')
+
+def save_and_check(name):
+    """Save the environment and compare the card with an export of it"""
+    blocks = ENV_SIZE // BLOCK_SIZE
+    # 'env export' sets filesize, which would change the environment
+    return ['echo "=== %s"' % name,
+            'setenv filesize',
+            'env export -c -s %x %x' % (ENV_SIZE, EXPORT_ADDR),
+            'setenv filesize',
+            'saveenv',
+            'mmc read %x %x %x' % (READ_ADDR, ENV_BLOCK, blocks),
+            'cmp.b %x %x %x' % (READ_ADDR, EXPORT_ADDR, ENV_SIZE)]
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    (options, args) = parser.parse_args()
+
+    blocks = ENV_SIZE // BLOCK_SIZE
+    cmds = ['mw.b %x 5a %x' % (PATTERN_ADDR, ENV_SIZE),
+            'setenv test_var 1']
+    cmds += save_and_check('first save')
+    cmds += save_and_check('unchanged')
+    cmds += ['setenv test_var 2']
+    cmds += save_and_check('one variable changed')
+    cmds += ['mmc write %x %x %x' % (PATTERN_ADDR, ENV_BLOCK, blocks)]
+    cmds += save_and_check('stored copy overwritten')
+    cmds += ['mmc write %x %x 1' % (PATTERN_ADDR, ENV_BLOCK + blocks - 1)]
+    cmds += save_and_check('last block overwritten')
+    out = run_u_boot(options.u_boot, cmds)
+
+    # name, minimum and maximum number of bytes written
+    tests = [('first save', 1, ENV_SIZE),
+             ('unchanged', 0, 0),
+             ('one variable changed', 1, ENV_SIZE - 1),
+             ('stored copy overwritten', ENV_SIZE, ENV_SIZE),
+             ('last block overwritten', BLOCK_SIZE, BLOCK_SIZE)]
+    results = []
+    for section in out.split('=== ')[1:]:
+        name = section.split('\n', 1)[0]
+        written = re.search(r'done, (\d+) bytes written', section)
+        same = re.search(r'Total of (\d+) byte\(s\) were the same', section)
+        if written and same:
+            results.append((name, written.group(1), same.group(1)))
+    failed = len(results) != len(tests)
+    if failed:
+        print('Test failed: missing saveenv results')
+        print(out)
+        return 1
+
+    for (name, low, high), (got, written, same) in zip(tests, results):
+        written = int(written)
+        print('%-24s %5d bytes written' % (name, written))
+        if got != name or not low <= written <= high:
+            print('Test failed: %s: expected %d to %d bytes written' %
+                  (name, low, high))
+            failed = True
+        if int(same) != ENV_SIZE:
+            print('Test failed: %s: stored environment differs' % name)
+            failed = True
+
+    if failed:
+        print(out)
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
@@ -0,0 +1,86 @@
+#!/bin/bash
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Read benchmark for ext4 using the sandbox "host" block device
+#
+# A large file is placed on an ext4 image and loaded several times with
+# ext4load. The load time and the number of block device reads are printed
+# and the loaded data is checked against the original file.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/fs/test-ext4-read.sh [size_in_MiB]
+
+BASEDIR=sandbox
+UBOOT=${BASEDIR}/u-boot
+SIZE_MB=${1:-32}
+LOAD_ADDR=1000000
+LOOPS=3
+
+tmpdir="$(mktemp -d)"
+IMAGE=${tmpdir}/ext4.img
+SRCDIR=${tmpdir}/root
+OUT=${tmpdir}/out
+
+cleanup() {
+	rm -rf ${tmpdir}
+}
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+# CRC32 as printed by the U-Boot crc32 command, from the gzip trailer
+host_crc32() {
+	gzip -c $1 | tail -c8 | od -An -tx4 -N4 | tr -d ' '
+}
+
+create_image() {
+	mkdir -p ${SRCDIR}
+	dd if=/dev/urandom of=${SRCDIR}/big.bin bs=1M count=${SIZE_MB} \
+		2>/dev/null
+	# 1KiB blocks give the deepest extent trees for a given file size
+	mkfs.ext4 -q -b 1024 -d ${SRCDIR} ${IMAGE} $((SIZE_MB * 2 + 16))M ||
+		fail "cannot create ext4 image (needs mkfs.ext4 with -d)"
+}
+
+run_bench() {
+	local size=$(printf "%x" $((SIZE_MB << 20)))
+	local i
+
+	(
+	echo "sb bind 0 ${IMAGE}"
+	for i in $(seq ${LOOPS}); do
+		echo "ext4load host 0 ${LOAD_ADDR} big.bin"
+	done
+	echo "sb info 0"
+	echo "crc32 ${LOAD_ADDR} ${size}"
+	echo "reset"
+	) | ${UBOOT} >${OUT} 2>&1
+}
+
+check_results() {
+	local crc=$(host_crc32 ${SRCDIR}/big.bin)
+
+	grep "bytes read in" ${OUT}
+	grep "reads:" ${OUT}
+	if [ $(grep -c "$((SIZE_MB << 20)) bytes read" ${OUT}) -ne ${LOOPS} ]
+	then
+		fail "ext4load error"
+	fi
+	grep -q "==> ${crc}" ${OUT} || fail "data mismatch (expected ${crc})"
+}
+
+[ -x ${UBOOT} ] || fail "${UBOOT} not found, build sandbox first"
+
+echo "ext4 read benchmark, ${SIZE_MB} MiB file, ${LOOPS} loads"
+create_image
+run_bench
+check_results
+cleanup
+echo "Test passed"
@@ -0,0 +1,80 @@
+#!/bin/bash
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Write benchmark for ext4 using the sandbox "host" block device
+#
+# A large file is loaded from an ext4 image and written back to it twice
+# with ext4write, the second time replacing the first copy. The time and the
+# number of block device reads and writes are printed, then the image is
+# checked with e2fsck and the copy against the original file.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/fs/test-ext4-write.sh [size_in_MiB]
+
+BASEDIR=sandbox
+UBOOT=${BASEDIR}/u-boot
+SIZE_MB=${1:-32}
+LOAD_ADDR=1000000
+
+tmpdir="$(mktemp -d)"
+IMAGE=${tmpdir}/ext4.img
+SRCDIR=${tmpdir}/root
+OUT=${tmpdir}/out
+
+cleanup() {
+	rm -rf ${tmpdir}
+}
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+create_image() {
+	mkdir -p ${SRCDIR}
+	dd if=/dev/urandom of=${SRCDIR}/big.bin bs=1M count=${SIZE_MB} \
+		2>/dev/null
+	# 1KiB blocks give the most block groups for a given size, and the
+	# group descriptors must be the 32 byte ones which U-Boot supports
+	mkfs.ext4 -q -b 1024 -O ^64bit,^metadata_csum,uninit_bg \
+		-d ${SRCDIR} ${IMAGE} $((SIZE_MB * 4 + 64))M ||
+		fail "cannot create ext4 image (needs mkfs.ext4 with -d)"
+}
+
+run_bench() {
+	local size=$(printf "%x" $((SIZE_MB << 20)))
+
+	(
+	echo "sb bind 0 ${IMAGE}"
+	echo "ext4load host 0 ${LOAD_ADDR} big.bin"
+	echo "sb info 0"
+	echo "time ext4write host 0 ${LOAD_ADDR} /copy.bin ${size}"
+	echo "sb info 0"
+	echo "time ext4write host 0 ${LOAD_ADDR} /copy.bin ${size}"
+	echo "sb info 0"
+	echo "reset"
+	) | ${UBOOT} >${OUT} 2>&1
+}
+
+check_results() {
+	grep "time:" ${OUT}
+	grep "reads:" ${OUT}
+	grep -q "Error ext4fs_write" ${OUT} && fail "ext4write error"
+	e2fsck -fn ${IMAGE} >/dev/null 2>&1 || fail "e2fsck found errors"
+	debugfs -R "dump /copy.bin ${tmpdir}/copy.bin" ${IMAGE} 2>/dev/null
+	cmp -s ${SRCDIR}/big.bin ${tmpdir}/copy.bin || fail "data mismatch"
+}
+
+[ -x ${UBOOT} ] || fail "${UBOOT} not found, build sandbox first"
+
+echo "ext4 write benchmark, ${SIZE_MB} MiB file, written twice"
+create_image
+run_bench
+check_results
+cleanup
+echo "Test passed"
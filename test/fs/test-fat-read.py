@@ -0,0 +1,166 @@
+#!/usr/bin/python
+#
+# Read benchmark for FAT using the sandbox "host" block device
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# A FAT32 image is built with one deliberately fragmented file whose
+# cluster chain keeps jumping between several areas of the disk, as happens
+# when files grow while other files are being written. The file is loaded
+# several times with fatload; load time and block device reads are printed
+# and the loaded data is checked against the original.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/fs/test-fat-read.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+SECTOR_SIZE = 512
+RESERVED_SECTORS = 32
+NUM_FATS = 2
+ROOT_CLUSTER = 2
+FAT_EOC = 0x0fffffff
+
+def fat_layout(total_sectors):
+    """Work out the layout of a FAT32 image with one sector per cluster
+
+    Returns:
+        Tuple (sectors per FAT, first data sector, last valid cluster)
+    """
+    clusters = total_sectors - RESERVED_SECTORS
+    fat_sectors = ((clusters + 2) * 4 + SECTOR_SIZE - 1) // SECTOR_SIZE
+    data_start = RESERVED_SECTORS + NUM_FATS * fat_sectors
+    return fat_sectors, data_start, total_sectors - data_start + 1
+
+def make_fat32(fname, total_sectors, files):
+    """Create a FAT32 image with one sector per cluster
+
+    Args:
+        fname: Image filename
+        total_sectors: Size of image in sectors
+        files: List of (8.3 name, data, list of clusters)
+    """
+    fat_sectors, data_start, last = fat_layout(total_sectors)
+
+    fat = [0] * (fat_sectors * SECTOR_SIZE // 4)
+    fat[0] = 0x0ffffff8
+    fat[1] = FAT_EOC
+    fat[ROOT_CLUSTER] = FAT_EOC
+
+    boot = bytearray(SECTOR_SIZE)
+    struct.pack_into('<3s8sHBHBHHBHHHIIIHHIHH12sBBBI11s8s', boot, 0,
+                     b'\xeb\x58\x90', b'MSWIN4.1', SECTOR_SIZE, 1,
+                     RESERVED_SECTORS, NUM_FATS, 0, 0, 0xf8, 0, 32, 64, 0,
+                     total_sectors, fat_sectors, 0, 0, ROOT_CLUSTER, 1, 6,
+                     b'\0' * 12, 0x80, 0, 0x29, 0x12345678, b'NO NAME    ',
+                     b'FAT32   ')
+    boot[510:512] = b'\x55\xaa'
+
+    root = bytearray(SECTOR_SIZE)
+    with open(fname, 'wb') as fd:
+        fd.truncate(total_sectors * SECTOR_SIZE)
+        for index, (name, data, chain) in enumerate(files):
+            for pos, clust in enumerate(chain):
+                fat[clust] = chain[pos + 1] if pos + 1 < len(chain) else \
+                    FAT_EOC
+                fd.seek((data_start + clust - 2) * SECTOR_SIZE)
+                fd.write(data[pos * SECTOR_SIZE:(pos + 1) * SECTOR_SIZE])
+            struct.pack_into('<11sBBBHHHHHHHI', root, index * 32,
+                             name.encode(), 0x20, 0, 0, 0, 0, 0,
+                             chain[0] >> 16, 0, 0, chain[0] & 0xffff,
+                             len(data))
+
+        fd.seek(0)
+        fd.write(boot)
+        fatdata = struct.pack('<%dI' % len(fat), *fat)
+        for i in range(NUM_FATS):
+            fd.seek((RESERVED_SECTORS + i * fat_sectors) * SECTOR_SIZE)
+            fd.write(fatdata)
+        fd.seek(data_start * SECTOR_SIZE)
+        fd.write(root)
+
+def fragmented_chain(nclusters, first, last, zones, chunk):
+    """Spread a file round-robin over 'zones' areas, 'chunk' clusters at once
+
+    Returns:
+        List of clusters in file order
+    """
+    zone_size = (last - first) // zones
+    next_free = [first + i * zone_size for i in range(zones)]
+    chain = []
+    zone = 0
+    while len(chain) < nclusters:
+        count = min(chunk, nclusters - len(chain))
+        chain += range(next_free[zone], next_free[zone] + count)
+        next_free[zone] += count
+        zone = (zone + 1) % zones
+    return chain
+
+def run_bench(u_boot, image, size, loops):
+    cmds = ['sb bind 0 %s' % image]
+    cmds += ['fatload host 0:0 1000000 big.bin'] * loops
+    cmds += ['sb info 0', 'crc32 1000000 %x' % size, 'reset']
+    proc = subprocess.Popen([u_boot], stdin=subprocess.PIPE,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    out = proc.communicate(('\n'.join(cmds) + '\n').encode())[0]
+    return out.decode('utf-8', 'replace')
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-s', '--size', type='int', default=16,
+            help='Size of the fragmented file in MiB')
+    parser.add_option('-z', '--zones', type='int', default=4,
+            help='Number of disk areas the file is spread over')
+    parser.add_option('-l', '--loops', type='int', default=3,
+            help='Number of times the file is loaded')
+    (options, args) = parser.parse_args()
+
+    size = options.size << 20
+    nclusters = size // SECTOR_SIZE
+    total_sectors = RESERVED_SECTORS + 4 * nclusters
+    data = bytearray(random.getrandbits(8) for i in range(size))
+    chain = fragmented_chain(nclusters, ROOT_CLUSTER + 1,
+                             fat_layout(total_sectors)[2], options.zones, 8)
+
+    tmpdir = tempfile.mkdtemp()
+    image = os.path.join(tmpdir, 'fat32.img')
+    try:
+        make_fat32(image, total_sectors, [('BIG     BIN', data, chain)])
+        out = run_bench(options.u_boot, image, size, options.loops)
+    finally:
+        shutil.rmtree(tmpdir)
+
+    print('FAT32 read benchmark, %d MiB file in %d areas, %d loads' %
+          (options.size, options.zones, options.loops))
+    for line in out.splitlines():
+        if 'bytes read in' in line or 'reads:' in line:
+            print(line.strip())
+
+    crc = '%08x' % (zlib.crc32(bytes(data)) & 0xffffffff)
+    if out.count('%d bytes read' % size) != options.loops:
+        print('Test failed: fatload error')
+        print(out)
+        return 1
+    if '==> %s' % crc not in out:
+        print('Test failed: data mismatch (expected %s)' % crc)
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
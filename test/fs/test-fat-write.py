@@ -0,0 +1,260 @@
+#!/usr/bin/python
+#
+# Write benchmark for FAT using the sandbox "host" block device
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# A 1 GiB FAT32 image is built whose first clusters are taken by a large
+# file with small holes in it, as left behind by deleted files, followed by
+# a source file with random data. The source file is loaded and written
+# back twice with fatwrite, first as a new file and then over itself. The
+# time and the number of block device reads and writes of each write are
+# printed. The image is then checked: both FATs must match, the copy must
+# have a valid cluster chain sharing no cluster with other files and holding
+# the original data, and the FSInfo free cluster count must be right.
+#
+# The file written is limited by the size of the sandbox RAM, not by the
+# image.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/fs/test-fat-write.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import os
+import random
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+SECTOR_SIZE = 512
+CLUST_SECTORS = 8
+CLUST_SIZE = SECTOR_SIZE * CLUST_SECTORS
+RESERVED_SECTORS = 32
+FSINFO_SECTOR = 1
+NUM_FATS = 2
+ROOT_CLUSTER = 2
+FAT_EOC = 0x0fffffff
+LOAD_ADDR = 0x1000000
+
+def fat_layout(total_sectors):
+    """Work out the layout of a FAT32 image
+
+    Returns:
+        Tuple (sectors per FAT, first data sector, number of clusters)
+    """
+    clusters = (total_sectors - RESERVED_SECTORS) // CLUST_SECTORS
+    fat_sectors = ((clusters + 2) * 4 + SECTOR_SIZE - 1) // SECTOR_SIZE
+    data_start = RESERVED_SECTORS + NUM_FATS * fat_sectors
+    return (fat_sectors, data_start,
+            (total_sectors - data_start) // CLUST_SECTORS + 2)
+
+def clust_offset(data_start, clust):
+    return (data_start + (clust - 2) * CLUST_SECTORS) * SECTOR_SIZE
+
+def make_fat32(fname, total_sectors, files):
+    """Create a FAT32 image
+
+    Args:
+        fname: Image filename
+        total_sectors: Size of image in sectors
+        files: List of (8.3 name, size, data or None, list of clusters)
+    """
+    fat_sectors, data_start, nclusters = fat_layout(total_sectors)
+
+    fat = [0] * (fat_sectors * SECTOR_SIZE // 4)
+    fat[0] = 0x0ffffff8
+    fat[1] = FAT_EOC
+    fat[ROOT_CLUSTER] = FAT_EOC
+
+    boot = bytearray(SECTOR_SIZE)
+    struct.pack_into('<3s8sHBHBHHBHHHIIIHHIHH12sBBBI11s8s', boot, 0,
+                     b'\xeb\x58\x90', b'MSWIN4.1', SECTOR_SIZE,
+                     CLUST_SECTORS, RESERVED_SECTORS, NUM_FATS, 0, 0, 0xf8,
+                     0, 32, 64, 0, total_sectors, fat_sectors, 0, 0,
+                     ROOT_CLUSTER, FSINFO_SECTOR, 6, b'\0' * 12, 0x80, 0,
+                     0x29, 0x12345678, b'NO NAME    ', b'FAT32   ')
+    boot[510:512] = b'\x55\xaa'
+
+    root = bytearray(CLUST_SIZE)
+    with open(fname, 'wb') as fd:
+        fd.truncate(total_sectors * SECTOR_SIZE)
+        for index, (name, size, data, chain) in enumerate(files):
+            for pos, clust in enumerate(chain):
+                fat[clust] = chain[pos + 1] if pos + 1 < len(chain) else \
+                    FAT_EOC
+            if data:
+                for pos, clust in enumerate(chain):
+                    fd.seek(clust_offset(data_start, clust))
+                    fd.write(data[pos * CLUST_SIZE:(pos + 1) * CLUST_SIZE])
+            struct.pack_into('<11sBBBHHHHHHHI', root, index * 32,
+                             name.encode(), 0x20, 0, 0, 0, 0, 0,
+                             chain[0] >> 16, 0, 0, chain[0] & 0xffff, size)
+
+        free = fat[2:nclusters].count(0)
+        info = bytearray(SECTOR_SIZE)
+        struct.pack_into('<I480xIII12xI', info, 0, 0x41615252, 0x61417272,
+                         free, ROOT_CLUSTER + 1, 0xaa550000)
+
+        fd.seek(0)
+        fd.write(boot)
+        fd.seek(FSINFO_SECTOR * SECTOR_SIZE)
+        fd.write(info)
+        fatdata = struct.pack('<%dI' % len(fat), *fat)
+        for i in range(NUM_FATS):
+            fd.seek((RESERVED_SECTORS + i * fat_sectors) * SECTOR_SIZE)
+            fd.write(fatdata)
+        fd.seek(clust_offset(data_start, ROOT_CLUSTER))
+        fd.write(root)
+
+def holey_chain(first, count, every, hole):
+    """Return 'count' clusters from 'first' on, leaving a hole of 'hole'
+    clusters after every 'every' clusters
+    """
+    chain = []
+    clust = first
+    while len(chain) < count:
+        chain.append(clust)
+        clust += 1
+        if (clust - first) % (every + hole) == every:
+            clust += hole
+    return chain
+
+def check_image(fname, total_sectors, data, others):
+    """Check the image after writing 'data' to COPY.BIN
+
+    Returns:
+        Error message or None if all is well
+    """
+    fat_sectors, data_start, nclusters = fat_layout(total_sectors)
+    with open(fname, 'rb') as fd:
+        fd.seek(FSINFO_SECTOR * SECTOR_SIZE + 488)
+        info_free = struct.unpack('<I', fd.read(4))[0]
+        fd.seek(RESERVED_SECTORS * SECTOR_SIZE)
+        fatdata = fd.read(fat_sectors * SECTOR_SIZE)
+        if fd.read(fat_sectors * SECTOR_SIZE) != fatdata:
+            return 'FATs differ'
+        fat = struct.unpack('<%dI' % (len(fatdata) // 4), fatdata)
+
+        fd.seek(clust_offset(data_start, ROOT_CLUSTER))
+        root = fd.read(CLUST_SIZE)
+        start = None
+        for pos in range(0, len(root), 32):
+            name, starthi, startlo, size = struct.unpack_from(
+                '<11s9xH4xHI', root, pos)
+            if name == b'COPY    BIN':
+                start = (starthi << 16) | startlo
+                break
+        if start is None:
+            return 'COPY.BIN not found'
+        if size != len(data):
+            return 'COPY.BIN has size %d' % size
+
+        chain = []
+        clust = start
+        while clust < 0x0ffffff8:
+            if clust < 2 or clust >= nclusters or len(chain) > nclusters:
+                return 'bad cluster chain'
+            chain.append(clust)
+            clust = fat[clust] & 0x0fffffff
+        if len(chain) != (len(data) + CLUST_SIZE - 1) // CLUST_SIZE:
+            return 'chain has %d clusters' % len(chain)
+        if set(chain) & others:
+            return 'COPY.BIN shares clusters with other files'
+
+        copy = bytearray()
+        for clust in chain:
+            fd.seek(clust_offset(data_start, clust))
+            copy += fd.read(CLUST_SIZE)
+        if copy[:len(data)] != data:
+            return 'data mismatch'
+
+    free = fat[2:nclusters].count(0)
+    if info_free != free:
+        return 'FSInfo free count %d, should be %d' % (info_free, free)
+    return None
+
+def run_bench(u_boot, image, size):
+    cmds = ['sb bind 0 %s' % image,
+            'fatload host 0:0 %x src.bin' % LOAD_ADDR, 'sb info 0']
+    cmds += ['time fatwrite host 0:0 %x copy.bin %x' % (LOAD_ADDR, size),
+             'sb info 0'] * 2
+    cmds += ['reset']
+    proc = subprocess.Popen([u_boot], stdin=subprocess.PIPE,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    out = proc.communicate(('\n'.join(cmds) + '\n').encode())[0]
+    return out.decode('utf-8', 'replace')
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-i', '--image-size', type='int', default=1024,
+            help='Size of the FAT32 image in MiB')
+    parser.add_option('-s', '--size', type='int', default=64,
+            help='Size of the file written in MiB')
+    parser.add_option('-f', '--fill', type='int', default=85,
+            help='Percentage of the image filled before writing')
+    (options, args) = parser.parse_args()
+
+    size = options.size << 20
+    total_sectors = (options.image_size << 20) // SECTOR_SIZE
+    nclusters = fat_layout(total_sectors)[2]
+    data = bytearray(random.getrandbits(8) for i in range(size))
+
+    fill = max(1, nclusters * options.fill // 100)
+    fill_chain = holey_chain(ROOT_CLUSTER + 1, fill, 1000, 24)
+    src_first = fill_chain[-1] + 1
+    src_chain = list(range(src_first,
+                           src_first + (size + CLUST_SIZE - 1) // CLUST_SIZE))
+    if src_chain[-1] >= nclusters:
+        print('Test failed: image too small')
+        return 1
+
+    tmpdir = tempfile.mkdtemp()
+    image = os.path.join(tmpdir, 'fat32.img')
+    try:
+        make_fat32(image, total_sectors,
+                   [('FILL    BIN', len(fill_chain) * CLUST_SIZE, None,
+                     fill_chain),
+                    ('SRC     BIN', size, data, src_chain)])
+        out = run_bench(options.u_boot, image, size)
+        error = check_image(image, total_sectors, data,
+                            set(fill_chain) | set(src_chain))
+    finally:
+        shutil.rmtree(tmpdir)
+
+    print('FAT32 write benchmark, %d MiB file to a %d MiB image %d%% full' %
+          (options.size, options.image_size, options.fill))
+    prev = None
+    for line in out.splitlines():
+        if 'time:' in line:
+            print(line.strip())
+        match = re.search(r'reads: (\d+) \((\d+) blocks\), '
+                          r'writes: (\d+) \((\d+) blocks\)', line)
+        if match:
+            counts = [int(x) for x in match.groups()]
+            if prev:
+                print('    reads: %d (%d blocks), writes: %d (%d blocks)' %
+                      tuple(c - p for c, p in zip(counts, prev)))
+            prev = counts
+
+    if out.count('%d bytes written' % size) != 2:
+        print('Test failed: fatwrite error')
+        print(out)
+        return 1
+    if error:
+        print('Test failed: %s' % error)
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
@@ -0,0 +1,642 @@
+#!/usr/bin/python
+#
+# UBIFS read test using the sandbox emulated NAND flash
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# A UBIFS image with one large file and some small ones is written to a UBI
+# volume on the emulated NAND chip. The files are then read with ubifsload,
+# with the volume mounted with bulk-read and with 'no_bulk_read'. The NAND
+# commands, the pages loaded into the chip's page register and the bytes read
+# out of it are printed for each, and the data is checked with crc32.
+#
+# There is no mkfs.ubifs here, so the image is made by this script. It has
+# the layout of a freshly formatted file system (see
+# create_default_filesystem() and ubifs_create_dflt_lpt()), with the files
+# put in the main area as a commit would leave them: the data nodes of a
+# file one after the other, blocks of zeroes left out as holes and blocks
+# that compress well stored with zlib.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/fs/test-ubifs-read.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import os
+import random
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+IMAGE_ADDR = 0x1000000
+LOAD_ADDR = 0x4000000
+
+# UBI on the emulated chip: 128KiB blocks of 2KiB pages
+LEB_SIZE = 129024
+MIN_IO_SIZE = 2048
+
+UBIFS_NODE_MAGIC = 0x06101831
+UBIFS_FORMAT_VERSION = 4
+UBIFS_BLOCK_SIZE = 4096
+UBIFS_MIN_COMPR_LEN = 128
+UBIFS_MIN_COMPRESS_DIFF = 64
+UBIFS_ROOT_INO = 1
+UBIFS_FIRST_INO = 64
+
+UBIFS_INO_NODE, UBIFS_DATA_NODE, UBIFS_DENT_NODE = 0, 1, 2
+UBIFS_PAD_NODE, UBIFS_SB_NODE, UBIFS_MST_NODE = 5, 6, 7
+UBIFS_IDX_NODE, UBIFS_CS_NODE = 9, 10
+UBIFS_INO_KEY, UBIFS_DATA_KEY, UBIFS_DENT_KEY = 0, 1, 2
+UBIFS_COMPR_NONE, UBIFS_COMPR_ZLIB = 0, 2
+UBIFS_ITYPE_REG = 0
+UBIFS_COMPR_FL = 0x01
+UBIFS_MST_NO_ORPHS = 2
+UBIFS_FLG_BIGLPT = 0x02
+
+UBIFS_CH_SZ = 24
+UBIFS_INO_NODE_SZ = 160
+UBIFS_DENT_NODE_SZ = 56
+UBIFS_PAD_NODE_SZ = 28
+UBIFS_REF_NODE_SZ = 64
+UBIFS_MAX_NODE_SZ = UBIFS_INO_NODE_SZ + UBIFS_BLOCK_SIZE
+MIN_WRITE_SZ = 48 + 8
+UBIFS_PADDING_BYTE = 0xce
+
+UBIFS_SB_LEBS = 1
+UBIFS_MST_LEBS = 2
+UBIFS_MST_LNUM = 1
+UBIFS_LOG_LNUM = 3
+UBIFS_MIN_BUD_LEBS = 3
+UBIFS_MIN_JNL_LEBS = 2 + UBIFS_MIN_BUD_LEBS
+UBIFS_MIN_LPT_LEBS = 2
+UBIFS_MIN_ORPH_LEBS = 1
+UBIFS_MIN_LEB_CNT = 1 + 2 + 2 + 2 + 1 + UBIFS_MIN_BUD_LEBS + 6
+
+UBIFS_LPT_FANOUT = 4
+UBIFS_LPT_PNODE, UBIFS_LPT_NNODE, UBIFS_LPT_LTAB, UBIFS_LPT_LSAVE = range(4)
+
+# Defaults of create_default_filesystem()
+DEFAULT_JNL_PERCENT = 5
+DEFAULT_MAX_JNL = 32 << 20
+DEFAULT_FANOUT = 8
+DEFAULT_JHEADS_CNT = 1
+DEFAULT_LSAVE_CNT = 256
+DEFAULT_RP_PERCENT = 5
+DEFAULT_MAX_RP_SIZE = 5 << 20
+DEFAULT_TIME_GRAN = 1000000000
+
+def align(n, a):
+    return (n + a - 1) // a * a
+
+def div_round_up(n, d):
+    return (n + d - 1) // d
+
+def fls(n):
+    return n.bit_length()
+
+def crc32(data):
+    # The kernel's crc32() as UBIFS uses it, without the final inversion
+    return (zlib.crc32(bytes(data)) & 0xffffffff) ^ 0xffffffff
+
+def crc16(data):
+    crc = 0xffff
+    for b in bytearray(data):
+        crc ^= b
+        for i in range(8):
+            crc = (crc >> 1) ^ 0xa001 if crc & 1 else crc >> 1
+    return crc
+
+def r5_hash(name):
+    a = 0
+    for c in bytearray(name):
+        if c >= 0x80:
+            c -= 0x100
+        a = (a + (c << 4)) & 0xffffffff
+        a = (a + (c >> 4)) & 0xffffffff
+        a = (a * 11) & 0xffffffff
+    a &= 0x1fffffff
+    if a <= 2:
+        a += 3
+    return a
+
+def key(inum, key_type, val=0):
+    return (inum, key_type << 29 | val)
+
+def pack_key(k, size=16):
+    return struct.pack('<II', *k) + bytearray(size - 8)
+
+def pad(length):
+    """Return padding as ubifs_pad() writes it"""
+    if length < UBIFS_PAD_NODE_SZ:
+        return bytearray([UBIFS_PADDING_BYTE] * length)
+    node = bytearray(struct.pack('<IIQIBB2xI', UBIFS_NODE_MAGIC, 0, 0,
+                                 UBIFS_PAD_NODE_SZ, UBIFS_PAD_NODE, 0,
+                                 length - UBIFS_PAD_NODE_SZ))
+    struct.pack_into('<I', node, 4, crc32(node[8:]))
+    return node + bytearray(length - UBIFS_PAD_NODE_SZ)
+
+class Leb(object):
+    """A LEB being filled with nodes, 8-byte aligned"""
+    def __init__(self, lnum=None):
+        self.lnum = lnum
+        self.data = bytearray()
+        self.used = 0
+
+    def fits(self, length):
+        return align(len(self.data), 8) + length <= LEB_SIZE
+
+    def add(self, node):
+        offs = align(len(self.data), 8)
+        self.data += bytearray(offs - len(self.data)) + node
+        self.used += align(len(node), 8)
+        return offs
+
+    def finish(self):
+        """Pad to a min. I/O unit, return the free and dirty space"""
+        end = align(len(self.data), 8)
+        self.data += bytearray(end - len(self.data))
+        iopos = align(end, MIN_IO_SIZE)
+        self.data += pad(iopos - end)
+        return LEB_SIZE - iopos, iopos - self.used
+
+class Geometry(object):
+    pass
+
+def do_calc_lpt_geom(g):
+    n = g.main_lebs + g.max_leb_cnt - g.leb_cnt
+    max_pnode_cnt = div_round_up(n, UBIFS_LPT_FANOUT)
+    g.lpt_hght = 1
+    n = UBIFS_LPT_FANOUT
+    while n < max_pnode_cnt:
+        g.lpt_hght += 1
+        n *= UBIFS_LPT_FANOUT
+
+    g.pnode_cnt = div_round_up(g.main_lebs, UBIFS_LPT_FANOUT)
+    n = div_round_up(g.pnode_cnt, UBIFS_LPT_FANOUT)
+    g.nnode_cnt = n
+    for i in range(1, g.lpt_hght):
+        n = div_round_up(n, UBIFS_LPT_FANOUT)
+        g.nnode_cnt += n
+
+    g.space_bits = fls(LEB_SIZE) - 3
+    g.lpt_lnum_bits = fls(g.lpt_lebs)
+    g.lpt_offs_bits = fls(LEB_SIZE - 1)
+    g.lpt_spc_bits = fls(LEB_SIZE)
+    g.pcnt_bits = fls(div_round_up(g.max_leb_cnt, UBIFS_LPT_FANOUT) - 1)
+    g.lnum_bits = fls(g.max_leb_cnt - 1)
+
+    hdr = 16 + 4
+    num = g.pcnt_bits if g.big_lpt else 0
+    g.pnode_sz = (hdr + num + (g.space_bits * 2 + 1) * UBIFS_LPT_FANOUT +
+                  7) // 8
+    g.nnode_sz = (hdr + num + (g.lpt_lnum_bits + g.lpt_offs_bits) *
+                  UBIFS_LPT_FANOUT + 7) // 8
+    g.ltab_sz = (hdr + g.lpt_lebs * g.lpt_spc_bits * 2 + 7) // 8
+    g.lsave_sz = (hdr + g.lnum_bits * g.lsave_cnt + 7) // 8
+
+    g.lpt_sz = g.pnode_cnt * g.pnode_sz + g.nnode_cnt * g.nnode_sz
+    g.lpt_sz += g.ltab_sz
+    if g.big_lpt:
+        g.lpt_sz += g.lsave_sz
+
+    sz = g.lpt_sz
+    per_leb_wastage = max(g.pnode_sz, g.nnode_sz)
+    sz += per_leb_wastage
+    tot_wastage = per_leb_wastage
+    while sz > LEB_SIZE:
+        sz += per_leb_wastage
+        sz -= LEB_SIZE
+        tot_wastage += per_leb_wastage
+    tot_wastage += align(sz, MIN_IO_SIZE) - sz
+    g.lpt_sz += tot_wastage
+
+def calc_dflt_lpt_geom(g, main_lebs):
+    g.lpt_lebs = UBIFS_MIN_LPT_LEBS
+    g.main_lebs = main_lebs - g.lpt_lebs
+    g.big_lpt = 0
+    do_calc_lpt_geom(g)
+    if g.lpt_sz > LEB_SIZE:
+        g.big_lpt = 1
+        do_calc_lpt_geom(g)
+    while div_round_up(g.lpt_sz * 4, LEB_SIZE) > g.lpt_lebs:
+        g.lpt_lebs = div_round_up(g.lpt_sz * 4, LEB_SIZE)
+        g.main_lebs = main_lebs - g.lpt_lebs
+        do_calc_lpt_geom(g)
+
+def calc_geometry(leb_cnt):
+    """The geometry create_default_filesystem() gives a volume"""
+    g = Geometry()
+    g.leb_cnt = g.max_leb_cnt = leb_cnt
+    g.lsave_cnt = DEFAULT_LSAVE_CNT
+
+    jnl_lebs = max(leb_cnt * DEFAULT_JNL_PERCENT // 100, UBIFS_MIN_JNL_LEBS)
+    if jnl_lebs * LEB_SIZE > DEFAULT_MAX_JNL:
+        jnl_lebs = DEFAULT_MAX_JNL // LEB_SIZE
+    ref_node_alsz = align(UBIFS_REF_NODE_SZ, MIN_IO_SIZE)
+    g.log_lebs = (2 * ref_node_alsz * jnl_lebs + LEB_SIZE - 1) // LEB_SIZE
+    g.log_lebs += 1
+    min_leb_cnt = UBIFS_MIN_LEB_CNT
+    if leb_cnt - min_leb_cnt > 8:
+        g.log_lebs += 1
+        min_leb_cnt += 1
+    g.max_buds = max(jnl_lebs - g.log_lebs, UBIFS_MIN_BUD_LEBS)
+    g.orph_lebs = UBIFS_MIN_ORPH_LEBS
+    if leb_cnt - min_leb_cnt > 1:
+        g.orph_lebs += 1
+
+    calc_dflt_lpt_geom(g, leb_cnt - UBIFS_SB_LEBS - UBIFS_MST_LEBS -
+                       g.log_lebs - g.orph_lebs)
+    g.lpt_first = UBIFS_LOG_LNUM + g.log_lebs
+    g.lpt_last = g.lpt_first + g.lpt_lebs - 1
+    g.main_first = leb_cnt - g.main_lebs
+    return g
+
+def lpt_node(g, size, node_type, fields):
+    """Pack an LPT node as ubifs_pack_pnode() and friends do"""
+    bits, pos = node_type, 4
+    for val, nbits in fields:
+        bits |= val << pos
+        pos += nbits
+    body = bytearray((bits >> (8 * i)) & 0xff for i in range(size - 2))
+    return bytearray(struct.pack('<H', crc16(body))) + body
+
+def calc_nnode_num(row, col):
+    num = 1
+    while row:
+        num = num << 2 | col & (UBIFS_LPT_FANOUT - 1)
+        col >>= 2
+        row -= 1
+    return num
+
+def create_lpt(g, lprops, lebs):
+    """Write the LPT for 'lprops', as ubifs_create_dflt_lpt() does"""
+    ltab = [[LEB_SIZE, 0] for i in range(g.lpt_lebs)]
+    state = {'lnum': g.lpt_first, 'buf': bytearray()}
+
+    def write_leb():
+        buf = state['buf']
+        alen = align(len(buf), MIN_IO_SIZE)
+        ltab[state['lnum'] - g.lpt_first] = [LEB_SIZE - alen, alen - len(buf)]
+        lebs[state['lnum']] = buf + bytearray([0xff] * (alen - len(buf)))
+
+    def add(node):
+        if len(state['buf']) + len(node) > LEB_SIZE:
+            write_leb()
+            state['lnum'] += 1
+            state['buf'] = bytearray()
+        offs = len(state['buf'])
+        state['buf'] += node
+        return state['lnum'], offs
+
+    below = []
+    for num in range(g.pnode_cnt):
+        fields = [(num, g.pcnt_bits)] if g.big_lpt else []
+        for i in range(UBIFS_LPT_FANOUT):
+            free, dirty, index = (lprops + [(LEB_SIZE, 0, 0)] * 4)[
+                num * UBIFS_LPT_FANOUT + i]
+            fields += [(free >> 3, g.space_bits), (dirty >> 3, g.space_bits),
+                       (index, 1)]
+        below.append(add(lpt_node(g, g.pnode_sz, UBIFS_LPT_PNODE, fields)))
+
+    row = 0
+    i = UBIFS_LPT_FANOUT
+    while g.pnode_cnt > i:
+        row += 1
+        i *= UBIFS_LPT_FANOUT
+    while True:
+        level = []
+        cnt = div_round_up(len(below), UBIFS_LPT_FANOUT)
+        for i in range(cnt):
+            fields = [(calc_nnode_num(row, i), g.pcnt_bits)] if g.big_lpt \
+                else []
+            for j in range(UBIFS_LPT_FANOUT):
+                n = i * UBIFS_LPT_FANOUT + j
+                lnum, offs = below[n] if n < len(below) else \
+                    (g.lpt_last + 1, 0)
+                fields += [(lnum - g.lpt_first, g.lpt_lnum_bits),
+                           (offs, g.lpt_offs_bits)]
+            level.append(add(lpt_node(g, g.nnode_sz, UBIFS_LPT_NNODE,
+                                      fields)))
+        below = level
+        row -= 1
+        if cnt == 1:
+            g.lpt_lnum, g.lpt_offs = level[0]
+            break
+
+    g.lsave_lnum, g.lsave_offs = 0, 0
+    if g.big_lpt:
+        lsave = [g.main_first + (i if i < g.main_lebs else 0)
+                 for i in range(g.lsave_cnt)]
+        node = lpt_node(g, g.lsave_sz, UBIFS_LPT_LSAVE,
+                        [(lnum, g.lnum_bits) for lnum in lsave])
+        g.lsave_lnum, g.lsave_offs = add(node)
+
+    # The LPT's own LEB properties include the LEB they are written to
+    if len(state['buf']) + g.ltab_sz > LEB_SIZE:
+        write_leb()
+        state['lnum'] += 1
+        state['buf'] = bytearray()
+    g.ltab_lnum, g.ltab_offs = state['lnum'], len(state['buf'])
+    end = len(state['buf']) + g.ltab_sz
+    ltab[state['lnum'] - g.lpt_first] = [LEB_SIZE - align(end, MIN_IO_SIZE),
+                                         align(end, MIN_IO_SIZE) - end]
+    fields = []
+    for free, dirty in ltab:
+        fields += [(free, g.lpt_spc_bits), (dirty, g.lpt_spc_bits)]
+    add(lpt_node(g, g.ltab_sz, UBIFS_LPT_LTAB, fields))
+    write_leb()
+    g.nhead_lnum = state['lnum']
+    g.nhead_offs = align(end, MIN_IO_SIZE)
+
+class Ubifs(object):
+    """Nodes with the sequence numbers they would get in this order"""
+    def __init__(self):
+        self.sqnum = 0
+
+    def node(self, node_type, body):
+        self.sqnum += 1
+        node = bytearray(struct.pack('<IIQIBB2x', UBIFS_NODE_MAGIC, 0,
+                                     self.sqnum, UBIFS_CH_SZ + len(body),
+                                     node_type, 0)) + body
+        struct.pack_into('<I', node, 4, crc32(node[8:]))
+        return node
+
+    def ino_node(self, inum, creat_sqnum, size, nlink, mode):
+        return self.node(UBIFS_INO_NODE, struct.pack('<16sQQQQQIIIIIIIIIII4xIH26x',
+                bytes(pack_key(key(inum, UBIFS_INO_KEY))), creat_sqnum, size,
+                0, 0, 0, 0, 0, 0, nlink, 0, 0, mode, UBIFS_COMPR_FL, 0, 0, 0,
+                0, UBIFS_COMPR_ZLIB))
+
+    def dent_node(self, k, inum, name):
+        return self.node(UBIFS_DENT_NODE, struct.pack('<16sQxBH4x',
+                bytes(pack_key(k)), inum, UBIFS_ITYPE_REG, len(name)) +
+                name + b'\0')
+
+    def data_node(self, k, data):
+        compr_type = UBIFS_COMPR_NONE
+        payload = data
+        if len(data) >= UBIFS_MIN_COMPR_LEN:
+            comp = zlib.compressobj(9, zlib.DEFLATED, -zlib.MAX_WBITS)
+            out = comp.compress(data) + comp.flush()
+            if len(data) - len(out) >= UBIFS_MIN_COMPRESS_DIFF:
+                compr_type = UBIFS_COMPR_ZLIB
+                payload = out
+        return self.node(UBIFS_DATA_NODE, struct.pack('<16sIH2x',
+                bytes(pack_key(k)), len(data), compr_type) + payload)
+
+def add_index(fs, leaves, idx):
+    """Build the index over 'leaves' in the LEBs 'idx', return its root"""
+    level = 0
+    while True:
+        above = []
+        for i in range(0, len(leaves), DEFAULT_FANOUT):
+            branches = leaves[i:i + DEFAULT_FANOUT]
+            body = struct.pack('<HH', len(branches), level)
+            for k, lnum, offs, length in branches:
+                body += struct.pack('<III', lnum, offs, length)
+                body += bytes(pack_key(k, 8))
+            node = fs.node(UBIFS_IDX_NODE, body)
+            if not idx[-1].fits(len(node)):
+                idx.append(Leb(idx[-1].lnum + 1))
+            above.append((branches[0][0], idx[-1].lnum, idx[-1].add(node),
+                          len(node)))
+        if len(above) == 1:
+            return above[0]
+        leaves = above
+        level += 1
+
+def make_image(files):
+    """Return a UBIFS volume image holding 'files', and its LEB count"""
+    fs = Ubifs()
+    main = [Leb()]
+    leaves = []
+
+    def add(k, node):
+        if not main[-1].fits(len(node)):
+            main.append(Leb())
+        leaves.append((k, len(main) - 1, main[-1].add(node), len(node)))
+
+    inums = {}
+    dir_size = UBIFS_INO_NODE_SZ
+    hashes = set()
+    root_creat = fs.sqnum
+    for i, name in enumerate(sorted(files)):
+        inums[name] = UBIFS_FIRST_INO + i
+        hashes.add(r5_hash(name))
+        dir_size += align(UBIFS_DENT_NODE_SZ + len(name) + 1, 8)
+    if len(hashes) != len(files):
+        raise ValueError('file names with the same hash')
+    add(key(UBIFS_ROOT_INO, UBIFS_INO_KEY),
+        fs.ino_node(UBIFS_ROOT_INO, root_creat, dir_size, 2, 0o40755))
+    for name in sorted(files):
+        inum = inums[name]
+        creat_sqnum = fs.sqnum
+        data = files[name]
+        for blk in range(div_round_up(len(data), UBIFS_BLOCK_SIZE)):
+            block = data[blk * UBIFS_BLOCK_SIZE:(blk + 1) * UBIFS_BLOCK_SIZE]
+            if block.count(b'\0') == len(block):
+                continue
+            k = key(inum, UBIFS_DATA_KEY, blk)
+            add(k, fs.data_node(k, block))
+        k = key(UBIFS_ROOT_INO, UBIFS_DENT_KEY, r5_hash(name))
+        add(k, fs.dent_node(k, inum, name))
+        add(key(inum, UBIFS_INO_KEY),
+            fs.ino_node(inum, creat_sqnum, len(data), 1, 0o100644))
+    leaves.sort()
+
+    # Room for the index after the data, the GC LEB and a journal
+    g = calc_geometry(max(len(main) + div_round_up(len(leaves) * 28,
+                                                   LEB_SIZE) + 24, 64))
+    for n, leb in enumerate(main):
+        leb.lnum = g.main_first + n
+    leaves = [(k, main[n].lnum, offs, length)
+              for k, n, offs, length in leaves]
+    idx = [Leb(g.main_first + len(main))]
+    root = add_index(fs, leaves, idx)
+    index_size = sum(leb.used for leb in idx)
+    gc_lnum = idx[-1].lnum + 1
+
+    lebs = {}
+    lprops = []
+    total_free = total_dirty = total_used = total_dead = total_dark = 0
+    dead_wm = align(MIN_WRITE_SZ, MIN_IO_SIZE)
+    dark_wm = align(UBIFS_MAX_NODE_SZ, MIN_IO_SIZE)
+    for leb in main + idx:
+        lebs[leb.lnum] = leb
+    for lnum in range(g.main_first, g.leb_cnt):
+        index = lnum >= idx[0].lnum and lnum <= idx[-1].lnum
+        if lnum in lebs:
+            used = lebs[lnum].used
+            free, dirty = lebs[lnum].finish()
+            lebs[lnum] = lebs[lnum].data
+        else:
+            used, free, dirty = 0, LEB_SIZE, 0
+        lprops.append((free, dirty, 1 if index else 0))
+        total_free += free
+        total_dirty += dirty
+        if index:
+            continue
+        total_used += used
+        spc = free + dirty
+        if spc < dead_wm:
+            total_dead += spc
+        elif spc < dark_wm:
+            total_dark += spc
+        elif spc - dark_wm < MIN_WRITE_SZ:
+            total_dark += spc - MIN_WRITE_SZ
+        else:
+            total_dark += dark_wm
+    empty_lebs = g.leb_cnt - gc_lnum
+
+    create_lpt(g, lprops, lebs)
+
+    main_bytes = g.main_lebs * LEB_SIZE
+    sup = fs.node(UBIFS_SB_NODE, struct.pack(
+            '<2xBBIIIIIQIIIIIIIH2xIIQI16sI3968x', 0, 0,
+            UBIFS_FLG_BIGLPT if g.big_lpt else 0, MIN_IO_SIZE, LEB_SIZE,
+            g.leb_cnt, g.max_leb_cnt, g.max_buds * LEB_SIZE, g.log_lebs,
+            g.lpt_lebs, g.orph_lebs, DEFAULT_JHEADS_CNT, DEFAULT_FANOUT,
+            g.lsave_cnt, UBIFS_FORMAT_VERSION, UBIFS_COMPR_ZLIB, 0, 0,
+            min(main_bytes * DEFAULT_RP_PERCENT // 100, DEFAULT_MAX_RP_SIZE),
+            DEFAULT_TIME_GRAN, bytes(bytearray(range(16))), 0))
+    lebs[0] = sup
+    cs = fs.node(UBIFS_CS_NODE, struct.pack('<Q', 0))
+    lebs[UBIFS_LOG_LNUM] = cs + pad(align(len(cs), MIN_IO_SIZE) - len(cs))
+    mst = fs.node(UBIFS_MST_NODE, struct.pack(
+            '<QQIIIIIIIIQQQQQQIIIIIIIIIIII344x',
+            UBIFS_FIRST_INO + len(files) - 1, 0, UBIFS_MST_NO_ORPHS,
+            UBIFS_LOG_LNUM, root[1], root[2], root[3], gc_lnum,
+            idx[-1].lnum, LEB_SIZE - lprops[idx[-1].lnum - g.main_first][0],
+            index_size, total_free, total_dirty, total_used, total_dead,
+            total_dark, g.lpt_lnum, g.lpt_offs, g.nhead_lnum, g.nhead_offs,
+            g.ltab_lnum, g.ltab_offs, g.lsave_lnum, g.lsave_offs,
+            g.main_first, empty_lebs, len(idx), g.leb_cnt))
+    mst += pad(align(len(mst), MIN_IO_SIZE) - len(mst))
+    lebs[UBIFS_MST_LNUM] = lebs[UBIFS_MST_LNUM + 1] = mst
+
+    image = bytearray([0xff] * (g.leb_cnt * LEB_SIZE))
+    for lnum, data in lebs.items():
+        image[lnum * LEB_SIZE:lnum * LEB_SIZE + len(data)] = data
+    return image, g.leb_cnt
+
+def run_u_boot(u_boot, cmds):
+    proc = subprocess.Popen([u_boot, '-c', '; '.join(cmds)],
+                            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    return out.decode('utf-8', 'replace')
+
+def make_files(size):
+    """One large file of random, compressible and zero data, small ones"""
+    rand = random.Random(size)
+    text = b''.join(b'%d: the quick brown fox jumps over the lazy dog\n' % i
+                    for i in range(20000))
+    chunks = []
+    for i in range(size * 16):
+        part = i % 4
+        if part == 3 and i % 8 == 7:
+            chunks.append(bytearray(64 << 10))
+        elif part == 1:
+            chunks.append(text[i << 10:(i + 64) << 10])
+        else:
+            chunks.append(os.urandom(64 << 10))
+    files = {b'big.bin': b''.join(bytes(c) for c in chunks) +
+             os.urandom(1234)}
+    for i in range(16):
+        files[b'small%d.bin' % i] = os.urandom(rand.randint(1, 12000))
+    return files
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-s', '--size', type='int', default=8,
+            help='Size of the large file in MiB')
+    (options, args) = parser.parse_args()
+
+    files = make_files(options.size)
+    image, leb_cnt = make_image(files)
+
+    tmpdir = tempfile.mkdtemp()
+    try:
+        fname = os.path.join(tmpdir, 'ubifs.img')
+        with open(fname, 'wb') as fd:
+            fd.write(image)
+
+        cmds = ['sb load hostfs - %x %s' % (IMAGE_ADDR, fname),
+                'setenv mtdids nand0=sandbox-nand',
+                'setenv mtdparts mtdparts=sandbox-nand:-(ubi)',
+                'ubi part ubi',
+                'ubi create ubifs %x' % len(image),
+                'ubi write %x ubifs %x' % (IMAGE_ADDR, len(image))]
+        names = sorted(files)
+        modes = ['bulk_read', 'no_bulk_read']
+        for mode in modes:
+            cmds.append('ubifsmount ubi0:ubifs %s' % mode)
+            for name in names:
+                cmds += ['sb nand reset',
+                         'ubifsload %x %s' % (LOAD_ADDR, name.decode()),
+                         'sb nand',
+                         'crc32 %x %x' % (LOAD_ADDR, len(files[name]))]
+            cmds.append('ubifsumount')
+        out = run_u_boot(options.u_boot, cmds)
+    finally:
+        shutil.rmtree(tmpdir)
+
+    counts = re.findall(r'commands: (\d+), pages read: (\d+) \((\d+) bytes\)',
+                        out)
+    crcs = re.findall(r'==> ([0-9a-f]{8})', out)
+    failed = len(counts) != len(modes) * len(names) or \
+        len(crcs) != len(counts)
+    if failed:
+        print('Test failed: missing output')
+        print(out)
+        return 1
+
+    # Each row: the large file, then the small files together
+    print('NAND reads of a %d-LEB UBIFS volume: commands, pages, KiB' %
+          leb_cnt)
+    print('%-24s %s' % ('', ''.join('%26s' % mode for mode in modes)))
+    totals = {}
+    for j, mode in enumerate(modes):
+        for i, name in enumerate(names):
+            row = 'big.bin' if name == b'big.bin' else 'small files'
+            total = totals.setdefault((row, mode), [0, 0, 0])
+            for k, count in enumerate(counts[j * len(names) + i]):
+                total[k] += int(count)
+    for row in ['big.bin', 'small files']:
+        line = '%-24s' % row
+        for mode in modes:
+            cmds, pages, nbytes = totals[(row, mode)]
+            line += '%26s' % ('%d / %d / %d' % (cmds, pages, nbytes >> 10))
+        print(line)
+
+    for j, mode in enumerate(modes):
+        for i, name in enumerate(names):
+            crc = '%08x' % (zlib.crc32(files[name]) & 0xffffffff)
+            if crcs[j * len(names) + i] != crc:
+                print('Test failed: %s: %s: data mismatch' %
+                      (mode, name.decode()))
+                failed = True
+
+    if totals[('big.bin', 'bulk_read')][1] >= \
+            totals[('big.bin', 'no_bulk_read')][1]:
+        print('Test failed: bulk-read does not read fewer pages')
+        failed = True
+
+    if failed:
+        print(out)
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
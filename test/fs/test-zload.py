@@ -0,0 +1,142 @@
+#!/usr/bin/python
+#
+# Benchmark for zload, which uncompresses a file while reading it
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# A compressible file is written with gzip and lzma (and lzop, if it is
+# installed). Each one is read from the host filesystem by sandbox U-Boot in
+# two ways: with load followed by unzip or lzmadec, which needs the whole
+# compressed file in memory, and with zload, which reads and uncompresses a
+# chunk at a time. The times are printed and the uncompressed data is checked
+# with crc32 each time.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/fs/test-zload.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import gzip
+import lzma
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import zlib
+
+LOAD_ADDR = 0x1000000
+OUT_ADDR = 0x3000000
+OUT_MAX = 0x5000000
+
+def make_data(size):
+    """Create data which compresses roughly as well as a kernel does"""
+    words = [bytes(bytearray(random.randint(0, 255) for i in
+                             range(random.randint(2, 12))))
+             for i in range(1024)]
+    data = b''.join(random.choice(words) for i in range(size // 6))
+    return data[:size]
+
+def run_u_boot(u_boot, cmds):
+    proc = subprocess.Popen([u_boot, '-c', '; '.join(cmds)],
+                            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    return out.decode('utf-8', 'replace')
+
+def total_time(out):
+    times = re.findall(r'time: ([\d.]+) seconds', out)
+    return sum(float(t) for t in times) if times else None
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-s', '--size', type='int', default=32,
+            help='Size of the uncompressed file in MiB')
+    (options, args) = parser.parse_args()
+
+    size = options.size << 20
+    data = make_data(size)
+    crc = '%08x' % (zlib.crc32(data) & 0xffffffff)
+    check = 'crc32 %x %x' % (OUT_ADDR, size)
+
+    tmpdir = tempfile.mkdtemp()
+    failed = False
+    try:
+        cases = []
+        fname = os.path.join(tmpdir, 'test.gz')
+        with open(fname, 'wb') as fd:
+            fd.write(gzip.compress(data, 6))
+        cases.append(('gzip', fname, 'unzip %x %x' % (LOAD_ADDR, OUT_ADDR)))
+
+        fname = os.path.join(tmpdir, 'test.lzma')
+        with open(fname, 'wb') as fd:
+            fd.write(lzma.compress(data, lzma.FORMAT_ALONE))
+        cases.append(('lzma', fname, 'lzmadec %x %x %x' %
+                      (LOAD_ADDR, OUT_ADDR, OUT_MAX)))
+
+        fname = os.path.join(tmpdir, 'test.lzo')
+        with open(fname, 'wb') as fd:
+            try:
+                proc = subprocess.Popen(['lzop', '-c'], stdin=subprocess.PIPE,
+                                        stdout=fd)
+                proc.communicate(data)
+                cases.append(('lzo', fname, None))
+            except OSError:
+                print('lzop not found, skipping lzo')
+
+        print('zload benchmark, %d MiB uncompressed' % options.size)
+        print('%-6s %10s %16s %10s' % ('', 'file', 'load+uncompress',
+                                        'zload'))
+        for name, fname, uncompress in cases:
+            before = '-'
+            if uncompress:
+                out = run_u_boot(options.u_boot,
+                        ['time load hostfs - %x %s' % (LOAD_ADDR, fname),
+                         'time ' + uncompress, check])
+                before = '%.3fs' % total_time(out)
+                if '==> %s' % crc not in out:
+                    print('Test failed: %s: load and %s gave wrong data' %
+                          (name, uncompress.split()[0]))
+                    print(out)
+                    failed = True
+
+            out = run_u_boot(options.u_boot,
+                    ['time zload hostfs - %x %s %x' % (OUT_ADDR, fname,
+                                                       OUT_MAX), check])
+            after = total_time(out)
+            if '==> %s' % crc not in out or after is None:
+                print('Test failed: %s: zload gave wrong data' % name)
+                print(out)
+                failed = True
+                after = 0
+            print('%-6s %9dK %16s %9.3fs' % (name,
+                  os.path.getsize(fname) >> 10, before, after))
+
+        # A truncated file must be reported as an error
+        fname = cases[0][1]
+        with open(fname, 'rb+') as fd:
+            fd.truncate(os.path.getsize(fname) // 2)
+        out = run_u_boot(options.u_boot,
+                ['zload hostfs - %x %s %x' % (OUT_ADDR, fname, OUT_MAX)])
+        if 'truncated or corrupt' not in out:
+            print('Test failed: truncated file not detected')
+            print(out)
+            failed = True
+    finally:
+        shutil.rmtree(tmpdir)
+
+    if failed:
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
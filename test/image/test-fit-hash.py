@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+#
+# FIT hash verification benchmark using sandbox
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# FIT images holding a single kernel image of various sizes are created, each
+# with crc32, sha1 or sha256 hash nodes, or with all three. Sandbox U-Boot
+# loads each one from the host filesystem and checks it with iminfo, under
+# the 'time' command, and the verification time is printed. The images are
+# written directly by this script, so neither mkimage nor dtc is needed.
+#
+# An image with all three hashes and a corrupted byte is also checked, to
+# make sure that the error is reported.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/image/test-fit-hash.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import hashlib
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+FDT_MAGIC = 0xd00dfeed
+FDT_BEGIN_NODE = 1
+FDT_END_NODE = 2
+FDT_PROP = 3
+FDT_END = 9
+
+LOAD_ADDR = 0x1000000
+
+def pad4(data):
+    return data + b'\0' * (-len(data) % 4)
+
+def fdt_string(value):
+    return value.encode() + b'\0'
+
+def fdt_cell(value):
+    return struct.pack('>I', value)
+
+def make_fdt(root):
+    """Create a flattened device tree
+
+    Args:
+        root: Root node, as a tuple (name, list of (name, value) properties,
+            list of subnodes)
+
+    Returns:
+        FDT blob
+    """
+    strings = b''
+    offsets = {}
+    struct_data = b''
+
+    def add_node(node):
+        nonlocal strings, struct_data
+        name, props, subnodes = node
+        struct_data += fdt_cell(FDT_BEGIN_NODE) + pad4(fdt_string(name))
+        for prop, value in props:
+            if prop not in offsets:
+                offsets[prop] = len(strings)
+                strings += fdt_string(prop)
+            struct_data += struct.pack('>III', FDT_PROP, len(value),
+                                       offsets[prop]) + pad4(value)
+        for subnode in subnodes:
+            add_node(subnode)
+        struct_data += fdt_cell(FDT_END_NODE)
+
+    add_node(root)
+    struct_data += fdt_cell(FDT_END)
+
+    hdr_size = 40
+    rsvmap = b'\0' * 16
+    off_struct = hdr_size + len(rsvmap)
+    off_strings = off_struct + len(struct_data)
+    total = off_strings + len(strings)
+    hdr = struct.pack('>10I', FDT_MAGIC, total, off_struct, off_strings,
+                      hdr_size, 17, 16, 0, len(strings), len(struct_data))
+    return hdr + rsvmap + struct_data + strings
+
+def hash_value(algo, data):
+    if algo == 'crc32':
+        return struct.pack('>I', zlib.crc32(data) & 0xffffffff)
+    return hashlib.new(algo, data).digest()
+
+def make_fit(data, algos, corrupt=False):
+    """Create a FIT with one kernel image
+
+    Args:
+        data: Kernel image data
+        algos: List of hash algorithms, one hash node is added for each
+        corrupt: True to change a byte of the data after hashing it
+
+    Returns:
+        FIT blob
+    """
+    hashes = [('hash@%d' % (i + 1),
+               [('algo', fdt_string(algo)),
+                ('value', hash_value(algo, data))], [])
+              for i, algo in enumerate(algos)]
+    if corrupt:
+        pos = len(data) // 2
+        data = data[:pos] + bytes(bytearray([data[pos] ^ 1])) + \
+            data[pos + 1:]
+    kernel = ('kernel@1', [('description', fdt_string('Test kernel')),
+                           ('data', data),
+                           ('type', fdt_string('kernel')),
+                           ('arch', fdt_string('sandbox')),
+                           ('os', fdt_string('linux')),
+                           ('compression', fdt_string('none')),
+                           ('load', fdt_cell(0x40000)),
+                           ('entry', fdt_cell(0x40000))], hashes)
+    conf = ('conf@1', [('kernel', fdt_string('kernel@1'))], [])
+    return make_fdt(('', [('description', fdt_string('Hash benchmark')),
+                          ('#address-cells', fdt_cell(1))],
+                     [('images', [], [kernel]),
+                      ('configurations',
+                       [('default', fdt_string('conf@1'))], [conf])]))
+
+def run_iminfo(u_boot, fname):
+    cmds = ['sb load hostfs - %x %s' % (LOAD_ADDR, fname),
+            'time iminfo %x' % LOAD_ADDR]
+    proc = subprocess.Popen([u_boot, '-c', '; '.join(cmds)],
+                            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    return out.decode('utf-8', 'replace')
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-s', '--sizes', default='1,16,64',
+            help='Comma-separated list of image sizes in MiB')
+    (options, args) = parser.parse_args()
+
+    cases = [['crc32'], ['sha1'], ['sha256'], ['crc32', 'sha1', 'sha256']]
+    sizes = [int(size) for size in options.sizes.split(',')]
+    tmpdir = tempfile.mkdtemp()
+    fname = os.path.join(tmpdir, 'test.fit')
+    failed = False
+    try:
+        print('FIT hash verification benchmark')
+        print('%-20s %s' % ('', ''.join('%8d MiB' % size for size in sizes)))
+        data = os.urandom(max(sizes) << 20)
+        for algos in cases:
+            times = []
+            for size in sizes:
+                with open(fname, 'wb') as fd:
+                    fd.write(make_fit(data[:size << 20], algos))
+                out = run_iminfo(options.u_boot, fname)
+                result = re.search(r'time: ([\d.]+) seconds', out)
+                times.append('%10ss' % (result.group(1) if result else '?'))
+                if '%s+ \n' % algos[-1] not in out:
+                    print('Test failed: %s verification error' %
+                          '+'.join(algos))
+                    print(out)
+                    failed = True
+            print('%-20s %s' % ('+'.join(algos), ' '.join(times)))
+
+        with open(fname, 'wb') as fd:
+            fd.write(make_fit(data[:1 << 20], cases[-1], corrupt=True))
+        out = run_iminfo(options.u_boot, fname)
+        if 'Bad hash value' not in out:
+            print('Test failed: corrupted image not detected')
+            print(out)
+            failed = True
+    finally:
+        shutil.rmtree(tmpdir)
+
+    if failed:
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+#
+# Benchmark for mkimage adding hashes to a FIT with many large images
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# A FIT holding a number of large images, each with crc32, sha1 and sha256
+# hash nodes, is written directly by this script so that dtc is not needed.
+# It is padded like 'dtc -p' would, with room for the hash values.
+# 'mkimage -F' fills in the hash values and is timed, then the values which
+# 'mkimage -l' lists are checked against those calculated here.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/image/test-mkimage-fit.py -m sandbox/tools/mkimage
+
+import importlib.util
+from optparse import OptionParser
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+# Reuse the FDT writer of the FIT hash verification benchmark
+spec = importlib.util.spec_from_file_location('fit_hash',
+        os.path.join(os.path.dirname(__file__), 'test-fit-hash.py'))
+fit_hash = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(fit_hash)
+fdt_cell = fit_hash.fdt_cell
+fdt_string = fit_hash.fdt_string
+
+ALGOS = ['crc32', 'sha1', 'sha256']
+
+def make_fit(images):
+    """Create a FIT with hash nodes which have no value yet
+
+    Args:
+        images: List of image data, one kernel image is added for each
+
+    Returns:
+        FIT blob
+    """
+    nodes = []
+    for i, data in enumerate(images):
+        hashes = [('hash@%d' % (j + 1), [('algo', fdt_string(algo))], [])
+                  for j, algo in enumerate(ALGOS)]
+        nodes.append(('kernel@%d' % (i + 1),
+                      [('description', fdt_string('Test kernel %d' % i)),
+                       ('data', data),
+                       ('type', fdt_string('kernel')),
+                       ('arch', fdt_string('sandbox')),
+                       ('os', fdt_string('linux')),
+                       ('compression', fdt_string('none')),
+                       ('load', fdt_cell(0x40000)),
+                       ('entry', fdt_cell(0x40000))], hashes))
+    conf = ('conf@1', [('kernel', fdt_string('kernel@1'))], [])
+    fit = fit_hash.make_fdt(('', [('description',
+                                   fdt_string('mkimage benchmark')),
+                                  ('#address-cells', fdt_cell(1))],
+                             [('images', [], nodes),
+                              ('configurations',
+                               [('default', fdt_string('conf@1'))],
+                               [conf])]))
+    pad = 1024 + len(images) * len(ALGOS) * 64
+    return fit[:4] + struct.pack('>I', len(fit) + pad) + fit[8:] + \
+        b'\0' * pad
+
+def check_hashes(out, images):
+    """Check the hash values listed by mkimage -l
+
+    Returns:
+        Number of values which are wrong or missing
+    """
+    found = re.findall(r'Hash value:\s+([0-9a-f]+)', out)
+    expect = [''.join('%02x' % b for b in
+                      bytearray(fit_hash.hash_value(algo, data)))
+              for data in images for algo in ALGOS]
+    bad = sum(1 for value, want in zip(found, expect) if value != want)
+    return bad + abs(len(found) - len(expect))
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-m', '--mkimage',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/tools/mkimage'),
+            help='Select mkimage binary')
+    parser.add_option('-n', '--count', type='int', default=24,
+            help='Number of images in the FIT')
+    parser.add_option('-s', '--size', type='int', default=16,
+            help='Size of each image in MiB')
+    (options, args) = parser.parse_args()
+
+    tmpdir = tempfile.mkdtemp()
+    fname = os.path.join(tmpdir, 'test.fit')
+    failed = False
+    try:
+        print('mkimage FIT hash benchmark: %d images of %d MiB, %s each' %
+              (options.count, options.size, '+'.join(ALGOS)))
+        data = os.urandom(options.size << 20)
+        images = [data[i:] + data[:i] for i in range(options.count)]
+        with open(fname, 'wb') as fd:
+            fd.write(make_fit(images))
+
+        start = time.time()
+        proc = subprocess.Popen([options.mkimage, '-F', fname],
+                                stdout=subprocess.PIPE,
+                                stderr=subprocess.STDOUT)
+        out = proc.communicate()[0].decode('utf-8', 'replace')
+        print('mkimage -F: %.2f seconds' % (time.time() - start))
+        if proc.returncode:
+            print('Test failed: mkimage returned %d' % proc.returncode)
+            print(out)
+            failed = True
+
+        out = subprocess.check_output([options.mkimage, '-l', fname])
+        bad = check_hashes(out.decode('utf-8', 'replace'), images)
+        if bad:
+            print('Test failed: %d hash values wrong or missing' % bad)
+            failed = True
+    finally:
+        shutil.rmtree(tmpdir)
+
+    if failed:
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
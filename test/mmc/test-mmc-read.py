@@ -0,0 +1,123 @@
+#!/usr/bin/python
+#
+# MMC read command count test using the sandbox emulated eMMC card
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# An ext4 image with one large file and some small ones is written to the
+# emulated card. The files are then read with ext4load, and the whole card
+# with 'mmc read', with each of the emulated host's read modes: CMD12 stops,
+# CMD23 block counts and queued CMD23 reads. The number of commands the card
+# received is printed for each, and the data is checked with crc32.
+#
+# This needs mkfs.ext4 with support for the -d option.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# ./test/mmc/test-mmc-read.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import zlib
+
+IMAGE_ADDR = 0x1000000
+LOAD_ADDR = 0x4000000
+IMAGE_SIZE = 40 << 20
+BLOCK_SIZE = 512
+
+def run_u_boot(u_boot, cmds):
+    proc = subprocess.Popen([u_boot, '-c', '; '.join(cmds)],
+                            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    return out.decode('utf-8', 'replace')
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-s', '--size', type='int', default=16,
+            help='Size of the large file in MiB')
+    (options, args) = parser.parse_args()
+
+    tmpdir = tempfile.mkdtemp()
+    try:
+        files = os.path.join(tmpdir, 'files')
+        os.mkdir(files)
+        big = os.urandom(options.size << 20)
+        with open(os.path.join(files, 'big.bin'), 'wb') as fd:
+            fd.write(big)
+        for i in range(32):
+            with open(os.path.join(files, 'small%d.bin' % i), 'wb') as fd:
+                fd.write(os.urandom(8192))
+        image = os.path.join(tmpdir, 'ext4.img')
+        subprocess.check_call(['mkfs.ext4', '-q', '-F', '-d', files, image,
+                               '%dK' % (IMAGE_SIZE >> 10)])
+
+        cmds = ['sb load hostfs - %x %s' % (IMAGE_ADDR, image),
+                'mmc write %x 0 %x' % (IMAGE_ADDR, IMAGE_SIZE // BLOCK_SIZE)]
+        tests = [('ext4load, %d MiB file' % options.size,
+                  'ext4load mmc 0 %x big.bin' % LOAD_ADDR),
+                 ('ext4load, 8 KiB file', 'ext4load mmc 0 %x small7.bin' %
+                  LOAD_ADDR),
+                 ('mmc read, %d MiB' % options.size,
+                  'mmc read %x 0 %x' % (LOAD_ADDR, len(big) // BLOCK_SIZE))]
+        modes = ['stop', 'cmd23', 'queue']
+        for mode in modes:
+            cmds += ['sb mmc mode %s' % mode, 'mmc rescan']
+            for name, cmd in tests:
+                cmds += ['sb mmc reset', cmd, 'sb mmc']
+                if cmd == tests[0][1]:
+                    cmds.append('crc32 %x %x' % (LOAD_ADDR, len(big)))
+        out = run_u_boot(options.u_boot, cmds)
+    finally:
+        shutil.rmtree(tmpdir)
+
+    counts = re.findall(r'total: (\d+), busy: (\d+), queued reads: (\d+)',
+                        out)
+    failed = len(counts) != len(modes) * len(tests)
+    if failed:
+        print('Test failed: missing command counts')
+        print(out)
+        return 1
+
+    print('MMC commands received by the card (busy responses)')
+    print('%-24s %s' % ('', ''.join('%14s' % mode for mode in modes)))
+    for i, (name, cmd) in enumerate(tests):
+        line = '%-24s' % name
+        for j in range(len(modes)):
+            total, busy, queued = counts[j * len(tests) + i]
+            line += '%14s' % ('%s (%s)' % (total, busy))
+        print(line)
+
+    # Only the stop mode should need CMD12, and only queue mode queues
+    for j, mode in enumerate(modes):
+        for i in range(len(tests)):
+            total, busy, queued = [int(c) for c in counts[j * len(tests) + i]]
+            if (mode == 'stop') != (busy > 0) or \
+                    (mode == 'queue') != (queued > 0):
+                print('Test failed: %s: unexpected commands' % mode)
+                failed = True
+
+    crc = '%08x' % (zlib.crc32(big) & 0xffffffff)
+    if out.count('==> %s' % crc) != len(modes):
+        print('Test failed: data mismatch (expected %s)' % crc)
+        print(out)
+        failed = True
+
+    if failed:
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
@@ -0,0 +1,323 @@
+#!/usr/bin/python
+#
+# NFS read benchmark using the sandbox tap Ethernet driver
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# A host tap interface is created and a small NFS server (portmapper, MOUNT
+# and NFS over UDP, versions 2 and 3, read-only) is run on it. Sandbox U-Boot
+# then loads a file with the nfs command over NFSv2 and over NFSv3 with
+# several numbers of READs in flight, and the throughput is printed. The
+# server can delay each reply, with some jitter so that replies overtake
+# each other. The loaded data is checked against the original each time.
+#
+# This needs root (or CAP_NET_ADMIN) to create the tap interface and bind
+# the portmapper port.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# sudo ./test/net/test-nfs.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import heapq
+import os
+import random
+import re
+import select
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+import zlib
+
+PROG_PORTMAP = 100000
+PROG_NFS = 100003
+PROG_MOUNT = 100005
+
+NFS_PORT = 2049
+EXPORT = '/export'
+
+NFSERR_NOENT = 2
+
+class Unpacker:
+    """Reads XDR values from a packet"""
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def uint(self):
+        val = struct.unpack('>I', self.data[self.pos:self.pos + 4])[0]
+        self.pos += 4
+        return val
+
+    def hyper(self):
+        return (self.uint() << 32) | self.uint()
+
+    def opaque(self, size=None):
+        if size is None:
+            size = self.uint()
+        val = self.data[self.pos:self.pos + size]
+        self.pos += (size + 3) & ~3
+        return val
+
+def xdr_uint(*vals):
+    return b''.join(struct.pack('>I', val) for val in vals)
+
+def xdr_opaque(data):
+    return xdr_uint(len(data)) + data + b'\0' * (-len(data) & 3)
+
+def fattr(version, size, fileid, ftype=1):
+    """File attributes: a regular file (or directory if ftype is 2)"""
+    if version == 2:
+        # type, mode, nlink, uid, gid, size, blocksize, rdev, blocks, fsid,
+        # fileid, atime, mtime, ctime
+        return xdr_uint(ftype, 0o100644, 1, 0, 0, size, 4096, 0,
+                        (size + 511) // 512, 1, fileid, 0, 0, 0, 0, 0, 0)
+    # type, mode, nlink, uid, gid, size, used, rdev, fsid, fileid, times
+    return xdr_uint(ftype, 0o644, 1, 0, 0, 0, size, 0, size, 0, 0, 0, 1,
+                    0, fileid, 0, 0, 0, 0, 0, 0)
+
+class NfsServer(threading.Thread):
+    """Read-only NFS server for in-memory files in a single directory
+
+    Args:
+        addr: IP address to listen on
+        files: Dict of filename -> data
+        versions: List of NFS versions to offer (2 and/or 3); this may be
+            changed between transfers
+        latency: Time in seconds to wait before sending each reply
+        jitter: Extra random delay of up to this many seconds per reply, so
+            replies may be sent in a different order from the requests.
+            The choice is pseudo-random but repeatable.
+        rtmax: Largest NFSv3 read size to offer
+    """
+    def __init__(self, addr, files, versions, latency, jitter, rtmax):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.files = files
+        self.names = sorted(files)
+        self.versions = versions
+        self.latency = latency
+        self.jitter = jitter
+        self.rtmax = rtmax
+        self.rand = random.Random(1)
+        self.queue = []
+        self.seq = 0
+        self.reads = 0
+        self.max_in_flight = 0
+        self.pmap = self.open_socket(addr, 111)
+        self.sock = self.open_socket(addr, NFS_PORT)
+
+    def open_socket(self, addr, port):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.bind((addr, port))
+        return sock
+
+    def run(self):
+        while True:
+            timeout = None
+            if self.queue:
+                timeout = max(self.queue[0][0] - time.time(), 0)
+            ready = select.select([self.pmap, self.sock], [], [], timeout)[0]
+            for sock in ready:
+                pkt, peer = sock.recvfrom(65536)
+                reply = self.handle(pkt)
+                if reply is None:
+                    continue
+                due = time.time() + self.latency
+                if self.jitter:
+                    due += self.rand.uniform(0, self.jitter)
+                heapq.heappush(self.queue, (due, self.seq, sock, reply, peer))
+                self.seq += 1
+            self.max_in_flight = max(self.max_in_flight, len(self.queue))
+            while self.queue and self.queue[0][0] <= time.time():
+                due, seq, sock, reply, peer = heapq.heappop(self.queue)
+                sock.sendto(reply, peer)
+
+    def handle(self, pkt):
+        call = Unpacker(pkt)
+        xid, mtype, rpcvers, prog, vers, proc = [call.uint()
+                                                 for i in range(6)]
+        call.uint()
+        call.opaque()           # credentials
+        call.uint()
+        call.opaque()           # verifier
+        if prog == PROG_PORTMAP:
+            result = self.portmap(call)
+        elif prog == PROG_MOUNT:
+            result = self.mount(call, vers, proc)
+        elif prog == PROG_NFS and vers in self.versions:
+            result = self.nfs(call, vers, proc)
+        else:
+            result = None
+        if result is None:
+            return None
+        # Accepted reply with an AUTH_NONE verifier and SUCCESS
+        return xdr_uint(xid, 1, 0, 0, 0, 0) + result
+
+    def portmap(self, call):
+        prog, vers = call.uint(), call.uint()
+        if prog == PROG_MOUNT:
+            ok = vers in (1, 2) and 2 in self.versions or \
+                 vers == 3 and 3 in self.versions
+        else:
+            ok = prog == PROG_NFS and vers in self.versions
+        return xdr_uint(NFS_PORT if ok else 0)
+
+    def fh(self, vers, index):
+        # NFSv3 handles have a length, so make them shorter to check that
+        size = 32 if vers < 3 else 12
+        return struct.pack('>I', index).ljust(size, b'\xfe')
+
+    def get_fh(self, call, vers):
+        fh = call.opaque(32 if vers < 3 else None)
+        return struct.unpack('>I', fh[:4])[0]
+
+    def mount(self, call, vers, proc):
+        if proc == 1:           # MNT
+            path = call.opaque().decode()
+            if path != EXPORT:
+                return xdr_uint(NFSERR_NOENT)
+            if vers == 3:
+                return xdr_uint(0) + xdr_opaque(self.fh(3, 0)) + \
+                       xdr_uint(1, 1)
+            return xdr_uint(0) + self.fh(2, 0)
+        if proc == 4:           # UMNTALL
+            return b''
+        return None
+
+    def nfs(self, call, vers, proc):
+        lookup, read = (3, 6) if vers == 3 else (4, 6)
+        if vers == 3 and proc == 19:       # FSINFO
+            call.opaque()
+            return xdr_uint(0, 1) + fattr(3, 0, 1, 2) + \
+                   xdr_uint(self.rtmax, self.rtmax, 4096, 65536, 65536,
+                            4096, 4096, 0xffffffff, 0xffffffff, 0, 1, 0)
+        if proc == lookup:
+            self.get_fh(call, vers)
+            name = call.opaque().decode()
+            if name not in self.files:
+                return xdr_uint(NFSERR_NOENT)
+            index = self.names.index(name) + 1
+            size = len(self.files[name])
+            if vers == 3:
+                return xdr_uint(0) + xdr_opaque(self.fh(3, index)) + \
+                       xdr_uint(1) + fattr(3, size, index) + xdr_uint(0)
+            return xdr_uint(0) + self.fh(2, index) + fattr(2, size, index)
+        if proc == read:
+            index = self.get_fh(call, vers)
+            data = self.files[self.names[index - 1]]
+            if vers == 3:
+                offset, count = call.hyper(), call.uint()
+            else:
+                offset, count = call.uint(), call.uint()
+            chunk = data[offset:offset + count]
+            self.reads += 1
+            if vers == 3:
+                eof = offset + len(chunk) >= len(data)
+                return xdr_uint(0, 1) + fattr(3, len(data), index) + \
+                       xdr_uint(len(chunk), eof) + xdr_opaque(chunk)
+            return xdr_uint(0) + fattr(2, len(data), index) + \
+                   xdr_opaque(chunk)
+        return None
+
+def setup_tap(tap, host_ip):
+    subprocess.check_call(['ip', 'tuntap', 'add', 'dev', tap, 'mode', 'tap'])
+    subprocess.check_call(['ip', 'addr', 'add', '%s/24' % host_ip, 'dev',
+                           tap])
+    subprocess.check_call(['ip', 'link', 'set', tap, 'up'])
+
+def remove_tap(tap):
+    subprocess.call(['ip', 'tuntap', 'del', 'dev', tap, 'mode', 'tap'])
+
+def run_nfs(u_boot, tap, host_ip, target_ip, window, fname, size):
+    # Commands go in with -c since NetLoop() polls the console for Ctrl-C
+    # and would swallow anything queued on stdin
+    cmds = ['setenv ipaddr %s' % target_ip, 'setenv serverip %s' % host_ip,
+            'setenv nfswindowsize %d' % window,
+            'nfs 1000000 %s/%s' % (EXPORT, fname),
+            'crc32 1000000 %x' % size]
+    proc = subprocess.Popen([u_boot, '--tap', tap, '-c', '; '.join(cmds)],
+                            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    return out.decode('utf-8', 'replace')
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-s', '--size', type='int', default=16,
+            help='Size of the file to transfer in MiB')
+    parser.add_option('-w', '--windows', default='1,4,8',
+            help='Comma-separated list of NFSv3 READ windows to try')
+    parser.add_option('-l', '--latency', type='float', default=0.5,
+            help='Delay before each server reply, in ms')
+    parser.add_option('-j', '--jitter', type='float', default=0.5,
+            help='Extra random delay of up to this many ms per reply')
+    parser.add_option('-r', '--rtmax', type='int', default=16384,
+            help='Largest NFSv3 read size offered by the server')
+    parser.add_option('-t', '--tap', default='sbnfs0',
+            help='Name of host tap interface to create')
+    (options, args) = parser.parse_args()
+
+    host_ip = '192.168.78.1'
+    target_ip = '192.168.78.2'
+    size = options.size << 20
+    data = bytes(bytearray(random.getrandbits(8) for i in range(size)))
+    # An odd size checks the end of the file, where READs return less
+    odd = data[:size // 3 + 1234]
+    files = {'big.bin': data, 'odd.bin': odd}
+
+    setup_tap(options.tap, host_ip)
+    try:
+        server = NfsServer(host_ip, files, [2], options.latency / 1000.0,
+                           options.jitter / 1000.0, options.rtmax)
+        server.start()
+        print('NFS read benchmark, %d MiB file, reply delay %.1f ms + '
+              'up to %.1f ms' % (options.size, options.latency,
+                                 options.jitter))
+        cases = [(2, 1)] + [(3, int(w)) for w in options.windows.split(',')]
+        failed = False
+        for vers, window in cases:
+            # U-Boot falls back to NFSv2 if the server does not offer v3
+            server.versions = [2, 3] if vers == 3 else [2]
+            for fname, fdata in sorted(files.items()):
+                server.reads = 0
+                server.max_in_flight = 0
+                out = run_nfs(options.u_boot, options.tap, host_ip,
+                              target_ip, window, fname, len(fdata))
+                crc = '%08x' % (zlib.crc32(fdata) & 0xffffffff)
+                if 'Bytes transferred = %d' % len(fdata) not in out:
+                    print('Test failed: NFSv%d window %d: nfs error on %s' %
+                          (vers, window, fname))
+                    print(out)
+                    failed = True
+                elif '==> %s' % crc not in out:
+                    print('Test failed: NFSv%d window %d: data mismatch on '
+                          '%s (expected %s)' % (vers, window, fname, crc))
+                    failed = True
+                if fname != 'big.bin':
+                    continue
+                rate = re.search(r'^\s+([\d.]+ [KMG]?i?B/s)$', out, re.M)
+                print('NFSv%d window %2d: %12s, %5d READs, up to %d in '
+                      'flight' % (vers, window,
+                                  rate.group(1) if rate else '?',
+                                  server.reads, server.max_in_flight))
+    finally:
+        remove_tap(options.tap)
+
+    if failed:
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
@@ -0,0 +1,217 @@
+#!/usr/bin/python
+#
+# TFTP windowsize benchmark using the sandbox tap Ethernet driver
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# A host tap interface is created and a small TFTP server supporting the
+# blksize and windowsize (RFC 7440) options is run on it. Sandbox U-Boot
+# then loads a file with tftpboot using several window sizes, optionally
+# with some data packets dropped by the server, and the throughput is
+# printed. The loaded data is checked against the original each time.
+#
+# This needs root (or CAP_NET_ADMIN) to create the tap interface.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# sudo ./test/net/test-tftp.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import os
+import random
+import re
+import select
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import zlib
+
+OP_RRQ = 1
+OP_DATA = 3
+OP_ACK = 4
+OP_ERROR = 5
+OP_OACK = 6
+
+TIMEOUT = 1.0
+RETRIES = 8
+
+class TftpServer(threading.Thread):
+    """Read-only TFTP server for a single in-memory file
+
+    Args:
+        addr: IP address to listen on
+        files: Dict of filename -> data
+        drop: Drop on average one in this many DATA packets (0 for none).
+            Only first transmissions are dropped, so retransmission always
+            succeeds. The choice is pseudo-random but repeatable.
+    """
+    def __init__(self, addr, files, drop):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.files = files
+        self.drop = drop
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.bind((addr, 69))
+        self.addr = addr
+
+    def run(self):
+        while True:
+            pkt, peer = self.sock.recvfrom(65536)
+            if struct.unpack('>H', pkt[:2])[0] == OP_RRQ:
+                self.serve(pkt[2:], peer)
+
+    def serve(self, req, peer):
+        fields = req.split(b'\0')
+        name = fields[0].decode()
+        opts = dict((fields[i].decode().lower(), fields[i + 1].decode())
+                    for i in range(2, len(fields) - 1, 2) if fields[i])
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.bind((self.addr, 0))
+        sock.connect(peer)
+        if name not in self.files:
+            sock.send(struct.pack('>HH', OP_ERROR, 1) + b'Not found\0')
+            return
+        data = self.files[name]
+
+        blksize = 512
+        window = 1
+        oack = {}
+        if 'blksize' in opts:
+            blksize = min(int(opts['blksize']), 1468)
+            oack['blksize'] = blksize
+        if 'windowsize' in opts:
+            window = max(min(int(opts['windowsize']), 64), 1)
+            oack['windowsize'] = window
+        if oack:
+            pkt = struct.pack('>H', OP_OACK)
+            for key, val in oack.items():
+                pkt += ('%s\0%d\0' % (key, val)).encode()
+            if self.wait_ack(sock, pkt, 0) is None:
+                return
+
+        nblocks = len(data) // blksize + 1
+        rand = random.Random(nblocks)
+        sent = set()
+        base = 1
+        while base <= nblocks:
+            last = min(base + window - 1, nblocks)
+            for block in range(base, last + 1):
+                pkt = struct.pack('>HH', OP_DATA, block & 0xffff)
+                pkt += data[(block - 1) * blksize:block * blksize]
+                if self.drop and block not in sent and \
+                        rand.randrange(self.drop) == 0:
+                    sent.add(block)
+                    continue
+                sent.add(block)
+                sock.send(pkt)
+            acked = self.wait_ack(sock, None, base - 1, last)
+            if acked is None:
+                return
+            base = acked + 1
+
+    def wait_ack(self, sock, pkt, first, last=None):
+        """Wait for an ACK of a block from first to last
+
+        Returns:
+            Absolute block number acknowledged, or None on failure
+        """
+        if last is None:
+            last = first
+        for retry in range(RETRIES):
+            if pkt:
+                sock.send(pkt)
+            while True:
+                ready = select.select([sock], [], [], TIMEOUT)[0]
+                if not ready:
+                    break
+                reply = sock.recv(65536)
+                op, block = struct.unpack('>HH', reply[:4])
+                if op != OP_ACK:
+                    return None
+                # Map the 16-bit block number back into the window
+                for abs_block in range(last, first - 1, -1):
+                    if abs_block & 0xffff == block:
+                        return abs_block
+            if pkt is None:
+                # Go-back-N: resend the window from the start
+                return first
+        return None
+
+def setup_tap(tap, host_ip):
+    subprocess.check_call(['ip', 'tuntap', 'add', 'dev', tap, 'mode', 'tap'])
+    subprocess.check_call(['ip', 'addr', 'add', '%s/24' % host_ip, 'dev',
+                           tap])
+    subprocess.check_call(['ip', 'link', 'set', tap, 'up'])
+
+def remove_tap(tap):
+    subprocess.call(['ip', 'tuntap', 'del', 'dev', tap, 'mode', 'tap'])
+
+def run_tftp(u_boot, tap, host_ip, target_ip, window, size):
+    # Commands go in with -c since NetLoop() polls the console for Ctrl-C
+    # and would swallow anything queued on stdin
+    cmds = ['setenv ipaddr %s' % target_ip, 'setenv serverip %s' % host_ip,
+            'setenv tftpwindowsize %d' % window,
+            'tftpboot 1000000 big.bin', 'crc32 1000000 %x' % size]
+    proc = subprocess.Popen([u_boot, '--tap', tap, '-c', '; '.join(cmds)],
+                            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    return out.decode('utf-8', 'replace')
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-s', '--size', type='int', default=16,
+            help='Size of the file to transfer in MiB')
+    parser.add_option('-w', '--windows', default='1,4,16',
+            help='Comma-separated list of window sizes to try')
+    parser.add_option('-d', '--drop', type='int', default=0,
+            help='Drop on average one in this many DATA packets')
+    parser.add_option('-t', '--tap', default='sbtftp0',
+            help='Name of host tap interface to create')
+    (options, args) = parser.parse_args()
+
+    host_ip = '192.168.77.1'
+    target_ip = '192.168.77.2'
+    size = options.size << 20
+    data = bytes(bytearray(random.getrandbits(8) for i in range(size)))
+    crc = '%08x' % (zlib.crc32(data) & 0xffffffff)
+
+    setup_tap(options.tap, host_ip)
+    try:
+        TftpServer(host_ip, {'big.bin': data}, options.drop).start()
+        print('TFTP windowsize benchmark, %d MiB file, %s' %
+              (options.size, 'dropping 1/%d packets' % options.drop
+               if options.drop else 'no packet loss'))
+        failed = False
+        for window in [int(w) for w in options.windows.split(',')]:
+            out = run_tftp(options.u_boot, options.tap, host_ip, target_ip,
+                           window, size)
+            rate = re.search(r'^\s+([\d.]+ [KMG]?i?B/s)$', out, re.M)
+            print('windowsize %2d: %s' % (window,
+                                          rate.group(1) if rate else '?'))
+            if 'Bytes transferred = %d' % size not in out:
+                print('Test failed: tftpboot error')
+                print(out)
+                failed = True
+            elif '==> %s' % crc not in out:
+                print('Test failed: data mismatch (expected %s)' % crc)
+                failed = True
+    finally:
+        remove_tap(options.tap)
+
+    if failed:
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
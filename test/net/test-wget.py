@@ -0,0 +1,152 @@
+#!/usr/bin/python
+#
+# HTTP download (wget) test using the sandbox tap Ethernet driver
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# A host tap interface is created and an HTTP server is run on it. Sandbox
+# U-Boot then loads files with wget, with and without frames being lost on
+# the way in (see the sandbox --tap_drop option), and the throughput is
+# printed. The loaded data is checked against the original each time. One
+# file is sent without a Content-Length, so the end is found from the FIN.
+#
+# This needs root (or CAP_NET_ADMIN) to create the tap interface.
+#
+# To run this:
+#
+# make O=sandbox sandbox_config
+# make O=sandbox
+# sudo ./test/net/test-wget.py -u sandbox/u-boot
+
+from optparse import OptionParser
+import os
+import random
+import re
+import subprocess
+import sys
+import threading
+import zlib
+
+try:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+    from socketserver import ThreadingMixIn
+except ImportError:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+    from SocketServer import ThreadingMixIn
+
+PORT = 8080
+
+class HttpServer(ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+class Handler(BaseHTTPRequestHandler):
+    """Serves server.files; names starting with 'nolen' have no length"""
+    def do_GET(self):
+        name = self.path.lstrip('/')
+        data = self.server.files.get(name)
+        if data is None:
+            self.send_error(404)
+            return
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        if not name.startswith('nolen'):
+            self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, format, *args):
+        pass
+
+def setup_tap(tap, host_ip):
+    subprocess.check_call(['ip', 'tuntap', 'add', 'dev', tap, 'mode', 'tap'])
+    subprocess.check_call(['ip', 'addr', 'add', '%s/24' % host_ip, 'dev',
+                           tap])
+    subprocess.check_call(['ip', 'link', 'set', tap, 'up'])
+
+def remove_tap(tap):
+    subprocess.call(['ip', 'tuntap', 'del', 'dev', tap, 'mode', 'tap'])
+
+def run_wget(u_boot, tap, host_ip, target_ip, drop, fname, size):
+    # Commands go in with -c since NetLoop() polls the console for Ctrl-C
+    # and would swallow anything queued on stdin
+    cmds = ['setenv ipaddr %s' % target_ip, 'setenv serverip %s' % host_ip,
+            'setenv httpdstport %d' % PORT,
+            'wget 1000000 %s' % fname,
+            'crc32 1000000 %x' % size]
+    args = [u_boot, '--tap', tap, '-c', '; '.join(cmds)]
+    if drop:
+        args[1:1] = ['--tap_drop', str(drop)]
+    proc = subprocess.Popen(args, stdin=subprocess.PIPE,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    return out.decode('utf-8', 'replace')
+
+def run_tests():
+    parser = OptionParser()
+    parser.add_option('-u', '--u-boot',
+            default=os.path.join(os.path.dirname(__file__),
+                                 '../../sandbox/u-boot'),
+            help='Select U-Boot sandbox binary')
+    parser.add_option('-s', '--size', type='int', default=32,
+            help='Size of the file to transfer in MiB')
+    parser.add_option('-d', '--drops', default='0,1000,100',
+            help='Comma-separated list of loss rates to try: drop 1 in N '
+                 'received frames, 0 for none')
+    parser.add_option('-t', '--tap', default='sbwget0',
+            help='Name of host tap interface to create')
+    (options, args) = parser.parse_args()
+
+    host_ip = '192.168.79.1'
+    target_ip = '192.168.79.2'
+    size = options.size << 20
+    data = bytes(bytearray(random.getrandbits(8) for i in range(size)))
+    odd = data[:size // 3 + 1234]
+    files = {'big.bin': data, 'nolen.bin': odd}
+
+    setup_tap(options.tap, host_ip)
+    try:
+        server = HttpServer((host_ip, PORT), Handler)
+        server.files = files
+        thread = threading.Thread(target=server.serve_forever)
+        thread.daemon = True
+        thread.start()
+        print('HTTP download benchmark, %d MiB file' % options.size)
+        failed = False
+        for drop in [int(d) for d in options.drops.split(',')]:
+            for fname, fdata in sorted(files.items()):
+                out = run_wget(options.u_boot, options.tap, host_ip,
+                               target_ip, drop, fname, len(fdata))
+                crc = '%08x' % (zlib.crc32(fdata) & 0xffffffff)
+                if 'Bytes transferred = %d' % len(fdata) not in out:
+                    print('Test failed: drop %d: wget error on %s' %
+                          (drop, fname))
+                    print(out)
+                    failed = True
+                elif '==> %s' % crc not in out:
+                    print('Test failed: drop %d: data mismatch on %s '
+                          '(expected %s)' % (drop, fname, crc))
+                    failed = True
+                if fname != 'big.bin':
+                    continue
+                rate = re.search(r'^\s+([\d.]+ [KMG]?i?B/s)$', out, re.M)
+                print('Drop 1 in %5s: %12s' % (drop or '-',
+                                               rate.group(1) if rate else '?'))
+
+        out = run_wget(options.u_boot, options.tap, host_ip, target_ip, 0,
+                       'missing.bin', 0)
+        if 'Server replied' not in out:
+            print('Test failed: missing file not reported')
+            print(out)
+            failed = True
+        server.shutdown()
+    finally:
+        remove_tap(options.tap)
+
+    if failed:
+        return 1
+    print('Test passed')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(run_tests())
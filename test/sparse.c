@@ -0,0 +1,283 @@
+/*
+ * Test for the fastboot sparse image writer, streamed and from RAM
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <fb_mmc.h>
+#include <malloc.h>
+#include <part.h>
+#include <sparse_format.h>
+
+/* The test partition on the emulated eMMC, CONFIG_FASTBOOT_FLASH_MMC_DEV */
+#define TEST_PART		"sparse_test"
+#define TEST_PART_SIZE		(1 << 20)
+#define TEST_GPT		"gpt write mmc 0 \"" \
+	"uuid_disk=3ed9b9a4-4cfd-4a5c-9e2f-8b8e2e1f5f10;" \
+	"name=" TEST_PART ",size=0x100000," \
+	"uuid=6e1c5f5a-2d0b-4f53-a1c3-0e4f6b1d2a77\""
+
+#define TEST_BLK_SZ		4096	/* Block size of the sparse images */
+#define TEST_MAX_IMAGE		(64 << 10)
+#define TEST_ERASED		0x5a	/* Partition contents before a test */
+
+/* The 64 defined bytes plus the '\0' */
+#define RESPONSE_LEN		(64 + 1)
+
+/* A sparse image being built, and what it should expand to */
+struct test_image {
+	unsigned char *buf;
+	uint len;
+	uint hdr_pad;		/* Extra bytes in the file and chunk headers */
+	sparse_header_t *header;
+	unsigned char *expect;
+	uint blk;		/* Next block of the expansion */
+};
+
+static void fill_buffer(unsigned char *buf, uint len, uint32_t seed)
+{
+	while (len--) {
+		seed = seed * 1103515245 + 12345;
+		*buf++ = seed >> 16;
+	}
+}
+
+static void image_start(struct test_image *img, uint hdr_pad)
+{
+	sparse_header_t *header = (sparse_header_t *)img->buf;
+
+	memset(header, 0, sizeof(*header) + hdr_pad);
+	header->magic = SPARSE_HEADER_MAGIC;
+	header->major_version = 1;
+	header->file_hdr_sz = sizeof(sparse_header_t) + hdr_pad;
+	header->chunk_hdr_sz = sizeof(chunk_header_t) + hdr_pad;
+	header->blk_sz = TEST_BLK_SZ;
+
+	img->header = header;
+	img->hdr_pad = hdr_pad;
+	img->len = header->file_hdr_sz;
+	img->blk = 0;
+	memset(img->expect, TEST_ERASED, TEST_PART_SIZE);
+}
+
+/* Add a chunk of 'blocks' blocks followed by 'len' bytes from 'data' */
+static void image_add(struct test_image *img, uint16_t type, uint blocks,
+		      const void *data, uint len)
+{
+	chunk_header_t *chunk = (chunk_header_t *)(img->buf + img->len);
+	unsigned char *expect;
+	uint32_t fill;
+	uint i;
+
+	memset(chunk, 0, img->header->chunk_hdr_sz);
+	chunk->chunk_type = type;
+	chunk->chunk_sz = blocks;
+	chunk->total_sz = img->header->chunk_hdr_sz + len;
+	img->len += img->header->chunk_hdr_sz;
+	memcpy(img->buf + img->len, data, len);
+	img->len += len;
+
+	img->header->total_chunks++;
+	img->header->total_blks += blocks;
+
+	expect = img->expect + img->blk * TEST_BLK_SZ;
+	img->blk += blocks;
+	/* An image too large for the partition has nothing to expect */
+	if (img->blk * TEST_BLK_SZ > TEST_PART_SIZE)
+		return;
+
+	if (type == CHUNK_TYPE_RAW) {
+		memcpy(expect, data, len);
+	} else if (type == CHUNK_TYPE_FILL) {
+		memcpy(&fill, data, sizeof(fill));
+		for (i = 0; i < blocks * TEST_BLK_SZ; i += sizeof(fill))
+			memcpy(expect + i, &fill, sizeof(fill));
+	}
+}
+
+/* Raw, don't care, fill and CRC32 chunks, with fills of many blocks */
+static void image_build(struct test_image *img, uint hdr_pad)
+{
+	unsigned char raw[3 * TEST_BLK_SZ];
+	uint32_t fill = 0xdeadbeef, crc = 0;
+
+	image_start(img, hdr_pad);
+	fill_buffer(raw, sizeof(raw), 1);
+	image_add(img, CHUNK_TYPE_RAW, 3, raw, sizeof(raw));
+	image_add(img, CHUNK_TYPE_DONT_CARE, 2, NULL, 0);
+	image_add(img, CHUNK_TYPE_FILL, 20, &fill, sizeof(fill));
+	image_add(img, CHUNK_TYPE_CRC32, 0, &crc, sizeof(crc));
+	fill_buffer(raw, TEST_BLK_SZ, 2);
+	image_add(img, CHUNK_TYPE_RAW, 1, raw, TEST_BLK_SZ);
+	fill = 0;
+	image_add(img, CHUNK_TYPE_FILL, 1, &fill, sizeof(fill));
+	image_add(img, CHUNK_TYPE_DONT_CARE, 200, NULL, 0);
+}
+
+static int part_erase(block_dev_desc_t *dev_desc, disk_partition_t *info,
+		      unsigned char *buf)
+{
+	memset(buf, TEST_ERASED, TEST_PART_SIZE);
+	if (dev_desc->block_write(dev_desc->dev, info->start, info->size,
+				  buf) != info->size)
+		return -1;
+
+	return 0;
+}
+
+static int part_check(block_dev_desc_t *dev_desc, disk_partition_t *info,
+		      unsigned char *buf, const unsigned char *expect)
+{
+	if (dev_desc->block_read(dev_desc->dev, info->start, info->size,
+				 buf) != info->size)
+		return -1;
+
+	return memcmp(buf, expect, TEST_PART_SIZE) ? -1 : 0;
+}
+
+/* Stream 'len' bytes of 'data' in pieces of 'piece' bytes */
+static int stream_image(const unsigned char *data, uint len, uint piece,
+			const char *flash_part, char *response)
+{
+	uint off, n;
+
+	memset(response, 0, RESPONSE_LEN);
+	fb_mmc_stream_prepare(TEST_PART, response);
+	if (strcmp(response, "OKAY") ||
+	    fb_mmc_stream_max_size() != TEST_PART_SIZE)
+		return -1;
+
+	fb_mmc_stream_start(len);
+	/* Only this download is streamed */
+	if (fb_mmc_stream_max_size())
+		return -1;
+
+	for (off = 0; off < len; off += n) {
+		n = min(piece, len - off);
+		fb_mmc_stream_write(data + off, n);
+	}
+	fb_mmc_stream_end();
+
+	memset(response, 0, RESPONSE_LEN);
+	if (!fb_mmc_flash_streamed(flash_part, response))
+		return -1;
+
+	return 0;
+}
+
+#define errcheck(statement) if (!(statement)) { \
+	printf("\tFailed: %s (piece %u)\n", #statement, piece); \
+	ret = 1; \
+	goto out; \
+}
+
+static int run_test(void)
+{
+	static const uint pieces[] = { 1, 3, 12, 28, 29, 511, 512, 4095, 4097,
+				       TEST_MAX_IMAGE };
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+	struct test_image img;
+	char response[RESPONSE_LEN];
+	unsigned char *buf = NULL;
+	uint i, pad, piece = 0, raw_len;
+	int ret;
+
+	img.buf = malloc(TEST_MAX_IMAGE);
+	img.expect = malloc(TEST_PART_SIZE);
+	buf = malloc(TEST_PART_SIZE);
+	errcheck(img.buf && img.expect && buf);
+
+	errcheck(run_command(TEST_GPT, 0) == 0);
+	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	errcheck(dev_desc);
+	errcheck(!get_partition_info_efi_by_name(dev_desc, TEST_PART, &info));
+	errcheck(info.size * info.blksz == TEST_PART_SIZE);
+
+	/* With and without longer headers than the parser knows */
+	for (pad = 0; pad <= 4; pad += 4) {
+		image_build(&img, pad);
+		errcheck(img.len <= TEST_MAX_IMAGE);
+
+		/* From RAM */
+		piece = img.len;
+		errcheck(!part_erase(dev_desc, &info, buf));
+		memset(response, 0, RESPONSE_LEN);
+		fb_mmc_flash_write(TEST_PART, img.buf, img.len, response);
+		errcheck(!strcmp(response, "OKAY"));
+		errcheck(!part_check(dev_desc, &info, buf, img.expect));
+
+		/* Streamed, in pieces that split headers and chunks */
+		for (i = 0; i < ARRAY_SIZE(pieces); i++) {
+			piece = pieces[i];
+			errcheck(!part_erase(dev_desc, &info, buf));
+			errcheck(!stream_image(img.buf, img.len, piece,
+					       TEST_PART, response));
+			errcheck(!strcmp(response, "OKAY"));
+			errcheck(!part_check(dev_desc, &info, buf,
+					     img.expect));
+		}
+	}
+
+	/* A raw image that ends in the middle of a block */
+	raw_len = 3 * TEST_BLK_SZ + 100;
+	fill_buffer(img.buf, raw_len, 3);
+	memset(img.expect, TEST_ERASED, TEST_PART_SIZE);
+	memcpy(img.expect, img.buf, raw_len);
+	memset(img.expect + raw_len, 0, info.blksz - raw_len % info.blksz);
+	for (i = 0; i < ARRAY_SIZE(pieces); i++) {
+		piece = pieces[i];
+		errcheck(!part_erase(dev_desc, &info, buf));
+		errcheck(!stream_image(img.buf, raw_len, piece, TEST_PART,
+				       response));
+		errcheck(!strcmp(response, "OKAY"));
+		errcheck(!part_check(dev_desc, &info, buf, img.expect));
+	}
+
+	/* A truncated sparse image */
+	image_build(&img, 0);
+	piece = 512;
+	errcheck(!stream_image(img.buf, img.len - 5, piece, TEST_PART,
+			       response));
+	errcheck(!strcmp(response, "FAILimage is incomplete"));
+
+	/* A flash command for another partition than the one written */
+	errcheck(!stream_image(img.buf, img.len, piece, "other", response));
+	errcheck(!strncmp(response, "FAIL", 4));
+
+	/* A sparse image larger than the partition */
+	image_start(&img, 0);
+	image_add(&img, CHUNK_TYPE_FILL, TEST_PART_SIZE / TEST_BLK_SZ + 1,
+		  &raw_len, sizeof(uint32_t));
+	errcheck(!stream_image(img.buf, img.len, piece, TEST_PART, response));
+	errcheck(!strncmp(response, "FAIL", 4));
+
+	/* Got here, everything is fine. */
+	ret = 0;
+
+out:
+	free(buf);
+	free(img.expect);
+	free(img.buf);
+
+	return ret;
+}
+
+static int do_test_sparse(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char * const argv[])
+{
+	int err;
+
+	err = run_test();
+	printf("test_sparse %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err;
+}
+
+U_BOOT_CMD(
+	test_sparse,	1,	1,	do_test_sparse,
+	"Check the fastboot sparse image writer",
+	""
+);
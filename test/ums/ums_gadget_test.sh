@@ -43,6 +43,18 @@ die () {
     exit 1
 }
 
+TX_BYTES=0
+TX_MS=0
+RX_BYTES=0
+RX_MS=0
+
+# Print the rate at which $2 bytes went $1 from $3 to $4 (ns)
+print_rate () {
+    MS=$(( ($4 - $3) / 1000000 ))
+    [ $MS -gt 0 ] || MS=1
+    echo "$1: $2 bytes in $MS ms, $(( $2 * 1000 / 1024 / MS )) KiB/s"
+}
+
 calculate_md5sum () {
     MD5SUM=`md5sum $1`
     MD5SUM=`echo $MD5SUM | cut -d ' ' -f1`
@@ -58,9 +70,15 @@ ums_test_file () {
 	rm $MNT_DIR/dat_*
     fi
 
+    # Unmounting flushes the file to the target
+    SIZE=`stat -c %s $1`
+    START=`date +%s%N`
     cp ./$1 $MNT_DIR
     umount $MNT_DIR
-
+    END=`date +%s%N`
+    print_rate TX $SIZE $START $END
+    TX_BYTES=$(( TX_BYTES + SIZE ))
+    TX_MS=$(( TX_MS + (END - START) / 1000000 ))
 
     echo -n "TX: "
     calculate_md5sum $1
@@ -70,7 +88,12 @@ ums_test_file () {
     N_FILE=$DIR$RCV_DIR${1:2}"_rcv"
 
     mount /dev/$MEM_DEV $MNT_DIR
+    START=`date +%s%N`
     cp $MNT_DIR/$1 $N_FILE || die $?
+    END=`date +%s%N`
+    print_rate RX $SIZE $START $END
+    RX_BYTES=$(( RX_BYTES + SIZE ))
+    RX_MS=$(( RX_MS + (END - START) / 1000000 ))
     rm $MNT_DIR/$1
     umount $MNT_DIR
 
@@ -170,6 +193,14 @@ else
     done
 fi
 
+printf "$COLOUR_GREEN========================================================================================= $COLOUR_DEFAULT\n"
+[ $TX_MS -gt 0 ] || TX_MS=1
+[ $RX_MS -gt 0 ] || RX_MS=1
+echo "Writes: $TX_BYTES bytes in $TX_MS ms," \
+     "$(( TX_BYTES * 1000 / 1024 / TX_MS )) KiB/s"
+echo "Reads: $RX_BYTES bytes in $RX_MS ms," \
+     "$(( RX_BYTES * 1000 / 1024 / RX_MS )) KiB/s"
+
 cleanup
 
 exit 0
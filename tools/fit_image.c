@@ -22,50 +22,299 @@
 
 static image_header_t header;
 
-static int fit_add_file_data(struct image_tool_params *params, size_t size_inc,
-			     const char *tmpfile)
+/* Room for a hash value property */
+#define FIT_HASH_SPACE		(12 + FIT_MAX_HASH_LEN)
+
+/*
+ * Room for the properties of a signature node, or for a public key in the
+ * keydest blob. Their sizes depend on the key and the nodes signed, so
+ * this is an estimate which allows for 4096-bit keys.
+ */
+#define FIT_SIG_SPACE		4096
+
+/* Room for the names of the properties added, and the timestamp */
+#define FIT_MISC_SPACE		256
+
+/**
+ * fit_read() - read an FDT blob into memory
+ *
+ * The blob comes from the output of @cmd if given, else from file @fname.
+ *
+ * @params:	mkimage parameters
+ * @fname:	file to read
+ * @cmd:	command to run instead, or NULL
+ * @sizep:	returns the size of the blob
+ * @return blob, allocated with malloc(), or NULL on error
+ */
+static void *fit_read(struct image_tool_params *params, const char *fname,
+		      const char *cmd, size_t *sizep)
 {
-	int tfd, destfd = 0;
-	void *dest_blob = NULL;
-	off_t destfd_size = 0;
+	size_t size = 0, alloced = 65536;
 	struct stat sbuf;
-	void *ptr;
+	char *buf, *new;
+	FILE *f;
+	int err;
+
+	if (cmd) {
+		debug("Trying to execute \"%s\"\n", cmd);
+		f = popen(cmd, "r");
+	} else {
+		f = fopen(fname, "rb");
+	}
+	if (!f) {
+		fprintf(stderr, "%s: Can't %s %s: %s\n", params->cmdname,
+			cmd ? "run" : "open", cmd ? cmd : fname,
+			strerror(errno));
+		return NULL;
+	}
+
+	/* Files are read in one go, dtc output as it comes */
+	if (!cmd && !fstat(fileno(f), &sbuf))
+		alloced = sbuf.st_size + 1;
+	buf = malloc(alloced);
+	while (buf) {
+		size += fread(buf + size, 1, alloced - size, f);
+		if (size < alloced)
+			break;
+		alloced = alloced * 2 + 65536;
+		new = realloc(buf, alloced);
+		if (!new)
+			free(buf);
+		buf = new;
+	}
+
+	err = buf ? ferror(f) : ENOMEM;
+	if (cmd) {
+		if (pclose(f) && !err) {
+			fprintf(stderr, "%s: %s failed\n", params->cmdname,
+				cmd);
+			free(buf);
+			return NULL;
+		}
+	} else {
+		fclose(f);
+	}
+	if (err) {
+		fprintf(stderr, "%s: Can't read %s: %s\n", params->cmdname,
+			cmd ? cmd : fname, strerror(err == ENOMEM ? err : EIO));
+		free(buf);
+		return NULL;
+	}
+
+	*sizep = size;
+	return buf;
+}
+
+/**
+ * fit_open() - read an FDT blob and check its header
+ *
+ * @params:	mkimage parameters
+ * @fname:	file to read
+ * @cmd:	command to run instead, or NULL
+ * @sizep:	returns the size the blob was read with
+ * @return blob, allocated with malloc(), or NULL on error
+ */
+static void *fit_open(struct image_tool_params *params, const char *fname,
+		      const char *cmd, size_t *sizep)
+{
+	void *blob;
+	size_t size;
+
+	blob = fit_read(params, fname, cmd, &size);
+	if (!blob)
+		return NULL;
+
+	if (size < sizeof(struct fdt_header) || fdt_check_header(blob) ||
+	    fdt_totalsize(blob) > size) {
+		fprintf(stderr, "%s: Invalid FIT blob\n", params->cmdname);
+		free(blob);
+		return NULL;
+	}
+
+	*sizep = size;
+	return blob;
+}
+
+/**
+ * fit_expand() - make room in an FDT blob
+ *
+ * @params:	mkimage parameters
+ * @blob:	FDT blob from fit_open(), freed on error
+ * @size:	size of the blob
+ * @size_inc:	room to add, in bytes
+ * @return blob, possibly moved, or NULL on error
+ */
+static void *fit_expand(struct image_tool_params *params, void *blob,
+			size_t size, size_t size_inc)
+{
+	void *buf;
+	int ret;
+
+	buf = realloc(blob, size + size_inc);
+	if (!buf) {
+		fprintf(stderr, "%s: Out of memory\n", params->cmdname);
+		free(blob);
+		return NULL;
+	}
+	memset(buf + size, '\0', size_inc);
+
+	ret = fdt_open_into(buf, buf, size + size_inc);
+	if (ret) {
+		fprintf(stderr, "%s: Cannot expand FDT: %s\n",
+			params->cmdname, fdt_strerror(ret));
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/**
+ * fit_write() - write an FDT blob which was added to
+ *
+ * Free space left in the blob as read, e.g. from dtc -p, is used first,
+ * so the file only grows by what did not fit there. The blob goes to a
+ * temporary file which then replaces @fname, so that @fname is left as
+ * it was if anything goes wrong.
+ *
+ * @params:	mkimage parameters
+ * @fname:	file to write
+ * @blob:	FDT blob
+ * @min_size:	size of the blob as read
+ * @return 0 if ok, -EIO on error
+ */
+static int fit_write(struct image_tool_params *params, const char *fname,
+		     void *blob, size_t min_size)
+{
+	char tmpfile[MKIMAGE_MAX_TMPFILE_LEN];
+	size_t size;
+	int fd;
+
+	if (strlen(fname) + strlen(MKIMAGE_TMPFILE_SUFFIX) + 1 >
+	    sizeof(tmpfile)) {
+		fprintf(stderr, "%s: Image file name (%s) too long, "
+			"can't create tmpfile\n", params->cmdname, fname);
+		return -EIO;
+	}
+	sprintf(tmpfile, "%s%s", fname, MKIMAGE_TMPFILE_SUFFIX);
+
+	fdt_pack(blob);
+	size = fdt_totalsize(blob);
+	if (size < min_size) {
+		memset(blob + size, '\0', min_size - size);
+		size = min_size;
+		fdt_set_totalsize(blob, size);
+	}
+
+	fd = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+	if (fd < 0) {
+		fprintf(stderr, "%s: Can't open %s: %s\n", params->cmdname,
+			tmpfile, strerror(errno));
+		return -EIO;
+	}
+	if (write(fd, blob, size) != size) {
+		fprintf(stderr, "%s: Can't write %s: %s\n", params->cmdname,
+			tmpfile, strerror(errno));
+		close(fd);
+		goto err;
+	}
+	if (close(fd)) {
+		fprintf(stderr, "%s: Can't write %s: %s\n", params->cmdname,
+			tmpfile, strerror(errno));
+		goto err;
+	}
+
+	if (rename(tmpfile, fname) == -1) {
+		fprintf(stderr, "%s: Can't rename %s to %s: %s\n",
+			params->cmdname, tmpfile, fname, strerror(errno));
+		goto err;
+	}
+
+	return 0;
+
+err:
+	unlink(tmpfile);
+	return -EIO;
+}
+
+/* Estimate the room needed for hashes and signatures in a FIT */
+static size_t fit_space_needed(const void *fit, const char *comment,
+			       size_t *keyspacep)
+{
+	size_t space = FIT_MISC_SPACE, keyspace = FIT_MISC_SPACE;
+	int noffset, depth = 0;
+
+	for (noffset = fdt_next_node(fit, 0, &depth);
+	     noffset >= 0 && depth > 0;
+	     noffset = fdt_next_node(fit, noffset, &depth)) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (!strncmp(name, FIT_HASH_NODENAME,
+			     strlen(FIT_HASH_NODENAME))) {
+			space += FIT_HASH_SPACE;
+		} else if (!strncmp(name, FIT_SIG_NODENAME,
+				    strlen(FIT_SIG_NODENAME))) {
+			space += FIT_SIG_SPACE;
+			if (comment)
+				space += strlen(comment);
+			keyspace += FIT_SIG_SPACE;
+		}
+	}
+
+	*keyspacep = keyspace;
+	return space;
+}
+
+static int fit_add_file_data(struct image_tool_params *params,
+			     const char *cmd, size_t size_inc)
+{
+	void *fit, *dest_blob = NULL;
+	size_t fit_size, dest_size = 0, space, keyspace;
 	int ret = 0;
 
-	tfd = mmap_fdt(params->cmdname, tmpfile, size_inc, &ptr, &sbuf, true);
-	if (tfd < 0)
+	/* Read the FIT and make enough room for what we add */
+	fit = fit_open(params, params->imagefile, cmd, &fit_size);
+	if (!fit)
+		return -EIO;
+	space = fit_space_needed(fit, params->comment, &keyspace);
+	fit = fit_expand(params, fit, fit_size, space + size_inc);
+	if (!fit)
 		return -EIO;
 
 	if (params->keydest) {
-		struct stat dest_sbuf;
-
-		destfd = mmap_fdt(params->cmdname, params->keydest, size_inc,
-				  &dest_blob, &dest_sbuf, false);
-		if (destfd < 0) {
+		dest_blob = fit_open(params, params->keydest, NULL,
+				     &dest_size);
+		if (dest_blob)
+			dest_blob = fit_expand(params, dest_blob, dest_size,
+					       keyspace + size_inc);
+		if (!dest_blob) {
 			ret = -EIO;
-			goto err_keydest;
+			goto err;
 		}
-		destfd_size = dest_sbuf.st_size;
 	}
 
 	/* for first image creation, add a timestamp at offset 0 i.e., root  */
 	if (params->datafile)
-		ret = fit_set_timestamp(ptr, 0, sbuf.st_mtime);
+		ret = fit_set_timestamp(fit, 0, time(NULL));
 
 	if (!ret) {
-		ret = fit_add_verification_data(params->keydir, dest_blob, ptr,
+		ret = fit_add_verification_data(params->keydir, dest_blob, fit,
 						params->comment,
 						params->require_keys);
 	}
 
-	if (dest_blob) {
-		munmap(dest_blob, destfd_size);
-		close(destfd);
-	}
+	/*
+	 * Write the public keys first, so that a signed FIT never replaces
+	 * the old one unless the keydest blob which verifies it is in place
+	 */
+	if (!ret && dest_blob)
+		ret = fit_write(params, params->keydest, dest_blob, dest_size);
+	if (!ret)
+		ret = fit_write(params, params->imagefile, fit, fit_size);
 
-err_keydest:
-	munmap(ptr, sbuf.st_size);
-	close(tfd);
+err:
+	free(dest_blob);
+	free(fit);
 
 	return ret;
 }
@@ -75,6 +324,7 @@ err_keydest:
  *
  * fit_handle_file() runs dtc to convert .its to .itb, includes
  * binary data, updates timestamp property and calculates hashes.
+ * The FIT is built up in memory and written once it is complete.
  *
  * datafile  - .its file
  * imagefile - .itb file
@@ -84,7 +334,6 @@ err_keydest:
  */
 static int fit_handle_file(struct image_tool_params *params)
 {
-	char tmpfile[MKIMAGE_MAX_TMPFILE_LEN];
 	char cmd[MKIMAGE_MAX_DTC_CMDLINE_LEN];
 	size_t size_inc;
 	int ret;
@@ -92,67 +341,34 @@ static int fit_handle_file(struct image_tool_params *params)
 	/* Flattened Image Tree (FIT) format  handling */
 	debug ("FIT format handling\n");
 
-	/* call dtc to include binary properties into the tmp file */
-	if (strlen (params->imagefile) +
-		strlen (MKIMAGE_TMPFILE_SUFFIX) + 1 > sizeof (tmpfile)) {
-		fprintf (stderr, "%s: Image file name (%s) too long, "
-				"can't create tmpfile",
-				params->imagefile, params->cmdname);
-		return (EXIT_FAILURE);
-	}
-	sprintf (tmpfile, "%s%s", params->imagefile, MKIMAGE_TMPFILE_SUFFIX);
-
 	/* We either compile the source file, or use the existing FIT image */
 	if (params->datafile) {
-		/* dtc -I dts -O dtb -p 500 datafile > tmpfile */
-		snprintf(cmd, sizeof(cmd), "%s %s %s > %s",
-			 MKIMAGE_DTC, params->dtc, params->datafile, tmpfile);
-		debug("Trying to execute \"%s\"\n", cmd);
-	} else {
-		snprintf(cmd, sizeof(cmd), "cp %s %s",
-			 params->imagefile, tmpfile);
-	}
-	if (system (cmd) == -1) {
-		fprintf (stderr, "%s: system(%s) failed: %s\n",
-				params->cmdname, cmd, strerror(errno));
-		goto err_system;
+		/* dtc -I dts -O dtb -p 500 datafile */
+		snprintf(cmd, sizeof(cmd), "%s %s %s",
+			 MKIMAGE_DTC, params->dtc, params->datafile);
 	}
 
 	/*
-	 * Set hashes for images in the blob. Unfortunately we may need more
-	 * space in either FDT, so keep trying until we succeed.
-	 *
-	 * Note: this is pretty inefficient for signing, since we must
-	 * calculate the signature every time. It would be better to calculate
-	 * all the data and then store it in a separate step. However, this
-	 * would be considerably more complex to implement. Generally a few
-	 * steps of this loop is enough to sign with several keys.
+	 * Set hashes for images in the blob. The room needed is worked out
+	 * beforehand, but signatures can only be estimated, so if that was
+	 * not enough start again with more.
 	 */
-	for (size_inc = 0; size_inc < 64 * 1024; size_inc += 1024) {
-		ret = fit_add_file_data(params, size_inc, tmpfile);
-		if (!ret || ret != -ENOSPC)
+	for (size_inc = 0; size_inc <= 1024 * 1024;
+	     size_inc = size_inc * 2 + 4096) {
+		ret = fit_add_file_data(params,
+					params->datafile ? cmd : NULL,
+					size_inc);
+		if (ret != -ENOSPC)
 			break;
 	}
 
 	if (ret) {
 		fprintf(stderr, "%s Can't add hashes to FIT blob\n",
 			params->cmdname);
-		goto err_system;
+		return -1;
 	}
 
-	if (rename (tmpfile, params->imagefile) == -1) {
-		fprintf (stderr, "%s: Can't rename %s to %s: %s\n",
-				params->cmdname, tmpfile, params->imagefile,
-				strerror (errno));
-		unlink (tmpfile);
-		unlink (params->imagefile);
-		return EXIT_FAILURE;
-	}
 	return EXIT_SUCCESS;
-
-err_system:
-	unlink(tmpfile);
-	return -1;
 }
 
 static int fit_check_params(struct image_tool_params *params)
@@ -12,6 +12,7 @@
 #include "mkimage.h"
 #include <bootm.h>
 #include <image.h>
+#include <pthread.h>
 #include <version.h>
 
 /**
@@ -26,7 +27,8 @@
  *
  * returns
  *     0, on success
- *     -1, on failure
+ *     -ENOSPC, if the FIT has no room for the value
+ *     -1, on other failures
  */
 static int fit_set_hash_value(void *fit, int noffset, uint8_t *value,
 				int value_len)
@@ -34,6 +36,8 @@ static int fit_set_hash_value(void *fit, int noffset, uint8_t *value,
 	int ret;
 
 	ret = fdt_setprop(fit, noffset, FIT_VALUE_PROP, value, value_len);
+	if (ret == -FDT_ERR_NOSPACE)
+		return -ENOSPC;
 	if (ret) {
 		printf("Can't set hash '%s' property for '%s' node(%s)\n",
 		       FIT_VALUE_PROP, fit_get_name(fit, noffset, NULL),
@@ -44,46 +48,225 @@ static int fit_set_hash_value(void *fit, int noffset, uint8_t *value,
 	return 0;
 }
 
+/* A hash node of a component image, and the value calculated for it */
+struct fit_hash_job {
+	int noffset;
+	const char *algo;
+	const void *data;
+	size_t size;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+	int ret;
+};
+
+struct fit_hash_list {
+	struct fit_hash_job *jobs;
+	int count;
+	int alloced;
+	struct fit_hash_job **queue;	/* Largest first */
+	int next;
+	pthread_mutex_t lock;
+};
+
 /**
- * fit_image_process_hash - Process a single subnode of the images/ node
+ * fit_image_add_hashes() - list the hash nodes of a component image
+ *
+ * All existing hash subnodes are listed. The hashes are calculated later
+ * by fit_calc_hashes(), so nothing may change the FIT in between, and
+ * then fit_write_hashes() sets the value property, for example:
+ *
+ * Input component image node structure:
  *
- * Check each subnode and process accordingly. For hash nodes we generate
- * a hash of the supplised data and store it in the node.
+ * o image@1 (at image_noffset)
+ *   | - data = [binary data]
+ *   o hash@1
+ *     |- algo = "sha1"
+ *
+ * Output component image node structure:
+ *
+ * o image@1 (at image_noffset)
+ *   | - data = [binary data]
+ *   o hash@1
+ *     |- algo = "sha1"
+ *     |- value = sha1(data)
  *
  * @fit:	pointer to the FIT format image header
- * @image_name:	name of image being processes (used to display errors)
- * @noffset:	subnode offset
- * @data:	data to process
- * @size:	size of data in bytes
+ * @image_noffset: component image node
+ * @list:	list to add to
  * @return 0 if ok, -1 on error
  */
-static int fit_image_process_hash(void *fit, const char *image_name,
-		int noffset, const void *data, size_t size)
+static int fit_image_add_hashes(void *fit, int image_noffset,
+				struct fit_hash_list *list)
 {
-	uint8_t value[FIT_MAX_HASH_LEN];
-	const char *node_name;
-	int value_len;
-	char *algo;
-
-	node_name = fit_get_name(fit, noffset, NULL);
+	const char *image_name;
+	const void *data;
+	size_t size;
+	int noffset;
 
-	if (fit_image_hash_get_algo(fit, noffset, &algo)) {
-		printf("Can't get hash algo property for '%s' hash node in '%s' image node\n",
-		       node_name, image_name);
+	/* Get image data and data length */
+	if (fit_image_get_data(fit, image_noffset, &data, &size)) {
+		printf("Can't get image data/size\n");
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
-		printf("Unsupported hash algorithm (%s) for '%s' hash node in '%s' image node\n",
-		       algo, node_name, image_name);
-		return -1;
+	image_name = fit_get_name(fit, image_noffset, NULL);
+
+	/*
+	 * Check subnode name, must be equal to "hash". Multiple hash nodes
+	 * require unique unit node names, e.g. hash@1, hash@2, etc.
+	 */
+	for (noffset = fdt_first_subnode(fit, image_noffset);
+	     noffset >= 0;
+	     noffset = fdt_next_subnode(fit, noffset)) {
+		struct fit_hash_job *job;
+		const char *node_name;
+		char *algo;
+
+		node_name = fit_get_name(fit, noffset, NULL);
+		if (strncmp(node_name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+
+		if (fit_image_hash_get_algo(fit, noffset, &algo)) {
+			printf("Can't get hash algo property for '%s' hash node in '%s' image node\n",
+			       node_name, image_name);
+			return -1;
+		}
+
+		if (list->count == list->alloced) {
+			job = realloc(list->jobs, (list->alloced * 2 + 16) *
+				      sizeof(*list->jobs));
+			if (!job) {
+				printf("Out of memory listing hash nodes\n");
+				return -1;
+			}
+			list->jobs = job;
+			list->alloced = list->alloced * 2 + 16;
+		}
+		job = &list->jobs[list->count++];
+		job->noffset = noffset;
+		job->algo = algo;
+		job->data = data;
+		job->size = size;
+		job->ret = -1;
 	}
 
-	if (fit_set_hash_value(fit, noffset, value, value_len)) {
-		printf("Can't set hash value for '%s' hash node in '%s' image node\n",
-		       node_name, image_name);
+	return 0;
+}
+
+static void *fit_hash_worker(void *arg)
+{
+	struct fit_hash_list *list = arg;
+	struct fit_hash_job *job;
+
+	for (;;) {
+		pthread_mutex_lock(&list->lock);
+		job = list->next < list->count ? list->queue[list->next++] :
+			NULL;
+		pthread_mutex_unlock(&list->lock);
+		if (!job)
+			break;
+		job->ret = calculate_hash(job->data, job->size, job->algo,
+					  job->value, &job->value_len);
+	}
+
+	return NULL;
+}
+
+static int fit_hash_job_cmp(const void *a, const void *b)
+{
+	const struct fit_hash_job *ja = *(struct fit_hash_job **)a;
+	const struct fit_hash_job *jb = *(struct fit_hash_job **)b;
+
+	return ja->size < jb->size ? 1 : ja->size > jb->size ? -1 : 0;
+}
+
+/**
+ * fit_calc_hashes() - calculate all listed hashes
+ *
+ * The hashes are shared out among one thread per CPU, largest image
+ * first, since a FIT may hold many large images.
+ *
+ * @fit:	pointer to the FIT format image header
+ * @list:	hash nodes to calculate
+ * @return 0 if ok, -1 on error
+ */
+static int fit_calc_hashes(void *fit, struct fit_hash_list *list)
+{
+	pthread_t *threads;
+	long nthreads, started;
+	int i;
+
+	if (!list->count)
+		return 0;
+	list->queue = malloc(list->count * sizeof(*list->queue));
+	if (!list->queue) {
+		printf("Out of memory calculating hashes\n");
 		return -1;
 	}
+	for (i = 0; i < list->count; i++)
+		list->queue[i] = &list->jobs[i];
+	qsort(list->queue, list->count, sizeof(*list->queue),
+	      fit_hash_job_cmp);
+	list->next = 0;
+	pthread_mutex_init(&list->lock, NULL);
+
+	/* This thread works too, so start one fewer */
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > list->count)
+		nthreads = list->count;
+	if (nthreads < 1)
+		nthreads = 1;
+	threads = malloc(nthreads * sizeof(*threads));
+	for (started = 0; threads && started < nthreads - 1; started++) {
+		if (pthread_create(&threads[started], NULL, fit_hash_worker,
+				   list))
+			break;
+	}
+	fit_hash_worker(list);
+	while (started--)
+		pthread_join(threads[started], NULL);
+	free(threads);
+	pthread_mutex_destroy(&list->lock);
+	free(list->queue);
+
+	for (i = 0; i < list->count; i++) {
+		struct fit_hash_job *job = &list->jobs[i];
+
+		if (job->ret) {
+			printf("Unsupported hash algorithm (%s) for '%s' hash node in '%s' image node\n",
+			       job->algo, fit_get_name(fit, job->noffset, NULL),
+			       fit_get_name(fit, fdt_parent_offset(fit,
+							job->noffset), NULL));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * fit_write_hashes() - store the calculated hashes in their nodes
+ *
+ * The nodes are written last first, so that the offsets of those still
+ * to be written do not move.
+ *
+ * @fit:	pointer to the FIT format image header
+ * @list:	hash nodes, in the order they are in the FIT
+ * @return 0 if ok, -ENOSPC if the FIT is too small, -1 on other errors
+ */
+static int fit_write_hashes(void *fit, struct fit_hash_list *list)
+{
+	int i, ret;
+
+	for (i = list->count - 1; i >= 0; i--) {
+		struct fit_hash_job *job = &list->jobs[i];
+
+		ret = fit_set_hash_value(fit, job->noffset, job->value,
+					 job->value_len);
+		if (ret)
+			return ret;
+	}
 
 	return 0;
 }
@@ -247,40 +430,22 @@ static int fit_image_process_sig(const char *keydir, void *keydest,
 }
 
 /**
- * fit_image_add_verification_data() - calculate/set verig. data for image node
- *
- * This adds hash and signature values for an component image node.
+ * fit_image_add_signatures() - set signatures for image node
  *
- * All existing hash subnodes are checked, if algorithm property is set to
- * one of the supported hash algorithms, hash value is computed and
- * corresponding hash node property is set, for example:
- *
- * Input component image node structure:
- *
- * o image@1 (at image_noffset)
- *   | - data = [binary data]
- *   o hash@1
- *     |- algo = "sha1"
- *
- * Output component image node structure:
- *
- * o image@1 (at image_noffset)
- *   | - data = [binary data]
- *   o hash@1
- *     |- algo = "sha1"
- *     |- value = sha1(data)
+ * This signs the data of a component image for each signature subnode.
+ * Its hash subnodes are done beforehand by fit_image_add_hashes().
  *
  * For signature details, please see doc/uImage.FIT/signature.txt
  *
- * @keydir	Directory containing *.key and *.crt files (or NULL)
+ * @keydir	Directory containing *.key and *.crt files
  * @keydest	FDT Blob to write public keys into (NULL if none)
  * @fit:	Pointer to the FIT format image header
  * @image_noffset: Requested component image node
  * @comment:	Comment to add to signature nodes
  * @require_keys: Mark all keys as 'required'
- * @return: 0 on success, <0 on failure
+ * @return: 0 on success, -ENOSPC if out of room, other -ve on failure
  */
-int fit_image_add_verification_data(const char *keydir, void *keydest,
+static int fit_image_add_signatures(const char *keydir, void *keydest,
 		void *fit, int image_noffset, const char *comment,
 		int require_keys)
 {
@@ -297,32 +462,23 @@ int fit_image_add_verification_data(const char *keydir, void *keydest,
 
 	image_name = fit_get_name(fit, image_noffset, NULL);
 
-	/* Process all hash subnodes of the component image node */
+	/* Process all signature subnodes of the component image node */
 	for (noffset = fdt_first_subnode(fit, image_noffset);
 	     noffset >= 0;
 	     noffset = fdt_next_subnode(fit, noffset)) {
 		const char *node_name;
-		int ret = 0;
+		int ret;
 
-		/*
-		 * Check subnode name, must be equal to "hash" or "signature".
-		 * Multiple hash nodes require unique unit node
-		 * names, e.g. hash@1, hash@2, signature@1, etc.
-		 */
 		node_name = fit_get_name(fit, noffset, NULL);
-		if (!strncmp(node_name, FIT_HASH_NODENAME,
-			     strlen(FIT_HASH_NODENAME))) {
-			ret = fit_image_process_hash(fit, image_name, noffset,
-						data, size);
-		} else if (IMAGE_ENABLE_SIGN && keydir &&
-			   !strncmp(node_name, FIT_SIG_NODENAME,
-				strlen(FIT_SIG_NODENAME))) {
-			ret = fit_image_process_sig(keydir, keydest,
-				fit, image_name, noffset, data, size,
-				comment, require_keys);
-		}
+		if (strncmp(node_name, FIT_SIG_NODENAME,
+			    strlen(FIT_SIG_NODENAME)))
+			continue;
+
+		ret = fit_image_process_sig(keydir, keydest, fit, image_name,
+					    noffset, data, size, comment,
+					    require_keys);
 		if (ret)
-			return -1;
+			return ret == -ENOSPC ? ret : -1;
 	}
 
 	return 0;
@@ -655,9 +811,10 @@ static int fit_config_add_verification_data(const char *keydir, void *keydest,
 int fit_add_verification_data(const char *keydir, void *keydest, void *fit,
 			      const char *comment, int require_keys)
 {
+	struct fit_hash_list list;
 	int images_noffset, confs_noffset;
 	int noffset;
-	int ret;
+	int ret = 0;
 
 	/* Find images parent node offset */
 	images_noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
@@ -667,24 +824,37 @@ int fit_add_verification_data(const char *keydir, void *keydest, void *fit,
 		return images_noffset;
 	}
 
-	/* Process its subnodes, print out component images details */
+	/* Hash all component images, then store the values */
+	memset(&list, '\0', sizeof(list));
 	for (noffset = fdt_first_subnode(fit, images_noffset);
 	     noffset >= 0;
 	     noffset = fdt_next_subnode(fit, noffset)) {
-		/*
-		 * Direct child node of the images parent node,
-		 * i.e. component image node.
-		 */
-		ret = fit_image_add_verification_data(keydir, keydest,
-				fit, noffset, comment, require_keys);
+		ret = fit_image_add_hashes(fit, noffset, &list);
 		if (ret)
-			return ret;
+			break;
 	}
+	if (!ret)
+		ret = fit_calc_hashes(fit, &list);
+	if (!ret)
+		ret = fit_write_hashes(fit, &list);
+	free(list.jobs);
+	if (ret)
+		return ret;
 
-	/* If there are no keys, we can't sign configurations */
+	/* If there are no keys, we can't sign images or configurations */
 	if (!IMAGE_ENABLE_SIGN || !keydir)
 		return 0;
 
+	images_noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
+	for (noffset = fdt_first_subnode(fit, images_noffset);
+	     noffset >= 0;
+	     noffset = fdt_next_subnode(fit, noffset)) {
+		ret = fit_image_add_signatures(keydir, keydest, fit, noffset,
+					       comment, require_keys);
+		if (ret)
+			return ret;
+	}
+
 	/* Find configurations parent node offset */
 	confs_noffset = fdt_path_offset(fit, FIT_CONFS_PATH);
 	if (confs_noffset < 0) {